@@ -22,8 +22,9 @@ tf.compat.v1.logging.set_verbosity(tf.compat.v1.logging.ERROR)
 
 import os
 os.environ['NGRAPH_TF_BACKEND'] = "INTERPRETER"
-#os.environ['NGRAPH_TF_USE_PREFETCH'] = "1"
 import ngraph_bridge
+# Stage the dataset elements on the device
+#ngraph_bridge.enable_prefetch()
 
 import sys
 
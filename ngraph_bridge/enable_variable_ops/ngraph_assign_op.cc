@@ -50,6 +50,8 @@ class NGraphAssignOp : public OpKernel {
   bool copy_to_tf_;
   int ng_graph_id_;
   bool just_looking_;
+  // Shared name of the variable assigned to, looked up in the Catalog once
+  string ref_var_name_;
   static int s_instance_count;
   int my_instance_id{0};
 
@@ -77,6 +79,11 @@ class NGraphAssignOp : public OpKernel {
 
     OP_REQUIRES(context, IsRefType(context->input_type(0)),
                 errors::InvalidArgument("lhs input needs to be a ref type"));
+    if (NGraphCatalog::ExistsInInputVariableSharedNameMap(ng_graph_id_,
+                                                          def().name(), 0)) {
+      ref_var_name_ = NGraphCatalog::GetInputVariableSharedName(
+          ng_graph_id_, def().name(), 0);
+    }
     my_instance_id = s_instance_count;
     s_instance_count++;
   }
@@ -100,21 +107,15 @@ class NGraphAssignOp : public OpKernel {
                  << ", just_looking " << PrintBool(just_looking_) << "\n";
     int number_of_copies = 0;
 
-    bool ref_exists = NGraphCatalog::ExistsInInputVariableSharedNameMap(
-        ng_graph_id_, def().name(), 0);
-    if (!ref_exists) {
-      OP_REQUIRES(context, ref_exists,
-                  errors::Internal(
-                      "Caught exception : RefInput to NGAssign not found \n"));
-    }
-    string get_ref_var_name = NGraphCatalog::GetInputVariableSharedName(
-        ng_graph_id_, def().name(), 0);
+    OP_REQUIRES(context, !ref_var_name_.empty(),
+                errors::Internal(
+                    "Caught exception : RefInput to NGAssign not found \n"));
 
     NGraphVar* var;
     OP_REQUIRES_OK(context,
                    context->resource_manager()->Lookup<NGraphVar>(
                        context->resource_manager()->default_container(),
-                       get_ref_var_name, &var));
+                       ref_var_name_, &var));
 
     Tensor* rhs_tensor = (Tensor*)&(context->input(1));
 
@@ -0,0 +1,203 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/node_builder.h"
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_batch_ngraphassigns.h"
+#include "ngraph_bridge/ngraph_catalog.h"
+#include "ngraph_bridge/tf_graphcycles.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Replaces the NGraphAssigns in "batch" by one NGraphBatchedAssign
+static Status CreateBatchedAssign(Graph* graph, int graph_id,
+                                  const vector<Node*>& batch) {
+  Node* first = batch[0];
+  DataType dtype;
+  TF_RETURN_IF_ERROR(GetNodeAttr(first->attrs(), "T", &dtype));
+
+  vector<NodeBuilder::NodeOut> refs;
+  vector<NodeBuilder::NodeOut> values;
+  vector<bool> copy_to_tf;
+  vector<string> shared_names;
+  for (auto node : batch) {
+    const Edge* ref_edge;
+    const Edge* value_edge;
+    TF_RETURN_IF_ERROR(node->input_edge(0, &ref_edge));
+    TF_RETURN_IF_ERROR(node->input_edge(1, &value_edge));
+    refs.push_back(
+        NodeBuilder::NodeOut(ref_edge->src(), ref_edge->src_output()));
+    values.push_back(
+        NodeBuilder::NodeOut(value_edge->src(), value_edge->src_output()));
+
+    bool node_copy_to_tf;
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node->attrs(), "copy_to_tf", &node_copy_to_tf));
+    copy_to_tf.push_back(node_copy_to_tf);
+
+    shared_names.push_back(NGraphCatalog::GetInputVariableSharedName(
+        graph_id, node->name(), 0));
+  }
+
+  Node* batched_assign;
+  TF_RETURN_IF_ERROR(
+      NodeBuilder(graph->NewName("NGraphBatchedAssign"), "NGraphBatchedAssign")
+          .Input(refs)
+          .Input(values)
+          .Attr("T", dtype)
+          .Attr("copy_to_tf", copy_to_tf)
+          .Attr("ngraph_graph_id", graph_id)
+          .Device(first->assigned_device_name())
+          .Finalize(graph, &batched_assign));
+  batched_assign->set_assigned_device_name(first->assigned_device_name());
+
+  for (int i = 0; i < batch.size(); i++) {
+    Node* node = batch[i];
+    NGRAPH_VLOG(4) << "Batching " << node->name() << " into "
+                   << batched_assign->name() << " at index " << i;
+
+    // Move the Catalog entry over
+    NGraphCatalog::DeleteFromInputVariableSharedNameMap(
+        NGraphCatalog::CreateNodeKey(graph_id, node->name(), 0));
+    NGraphCatalog::AddToInputVariableSharedNameMap(
+        NGraphCatalog::CreateNodeKey(graph_id, batched_assign->name(), i),
+        shared_names[i]);
+
+    std::vector<std::tuple<Node*, int, Node*, int>> edges_to_add;
+    for (auto edge : node->in_edges()) {
+      if (edge->IsControlEdge()) {
+        edges_to_add.push_back(std::tuple<Node*, int, Node*, int>(
+            edge->src(), Graph::kControlSlot, batched_assign,
+            Graph::kControlSlot));
+      }
+    }
+    for (auto edge : node->out_edges()) {
+      if (edge->IsControlEdge()) {
+        edges_to_add.push_back(std::tuple<Node*, int, Node*, int>(
+            batched_assign, Graph::kControlSlot, edge->dst(),
+            Graph::kControlSlot));
+      } else {
+        edges_to_add.push_back(std::tuple<Node*, int, Node*, int>(
+            batched_assign, i, edge->dst(), edge->dst_input()));
+      }
+    }
+    for (const auto& e : edges_to_add) {
+      graph->AddEdge(get<0>(e), get<1>(e), get<2>(e), get<3>(e));
+    }
+    graph->RemoveNode(node);
+  }
+  return Status::OK();
+}
+
+Status BatchNGraphAssigns(Graph* graph, int graph_id) {
+  vector<Node*> ordered;
+  GetReversePostOrder(*graph, &ordered);
+
+  // Frames and deadness would have to match within a batch, keep it simple
+  for (auto node : ordered) {
+    if (node->IsControlFlow()) {
+      NGRAPH_VLOG(3) << "Not batching NGraphAssigns, graph has control flow "
+                     << node->name();
+      return Status::OK();
+    }
+  }
+
+  // Collect the candidates
+  vector<Node*> candidates;
+  for (auto node : ordered) {
+    if (node->type_string() == "NGraphAssign" &&
+        NGraphCatalog::ExistsInInputVariableSharedNameMap(graph_id,
+                                                          node->name(), 0)) {
+      candidates.push_back(node);
+    }
+  }
+  if (candidates.size() < 2) {
+    return Status::OK();
+  }
+
+  // Every batch is contracted into a single node of "gc", a candidate may
+  // only join a batch that neither reaches it nor is reached from it, so that
+  // the batched graph stays acyclic
+  GraphCycles gc;
+  std::map<Node*, int> gc_index;
+  for (auto node : graph->op_nodes()) {
+    gc_index[node] = gc.NewNode();
+  }
+  for (auto edge : graph->edges()) {
+    if (!edge->src()->IsOp() || !edge->dst()->IsOp()) {
+      continue;
+    }
+    if (!gc.InsertEdge(gc_index[edge->src()], gc_index[edge->dst()])) {
+      return errors::Internal(
+          "Input graph has a cycle (inserting an edge from ",
+          edge->src()->name(), " to ", edge->dst()->name(), ")");
+    }
+  }
+
+  // Greedily fill batches in topological order: a candidate joins the first
+  // batch of its device and type it is independent of
+  struct Batch {
+    int gc_node;
+    vector<Node*> members;
+  };
+  std::map<std::pair<string, DataType>, vector<Batch>> batches;
+  for (auto node : candidates) {
+    DataType dtype;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "T", &dtype));
+    auto& device_batches =
+        batches[std::make_pair(node->assigned_device_name(), dtype)];
+    int node_index = gc_index[node];
+
+    bool added = false;
+    for (auto& batch : device_batches) {
+      if (gc.IsReachable(batch.gc_node, node_index) ||
+          gc.IsReachable(node_index, batch.gc_node)) {
+        continue;
+      }
+      // Merge the candidate into the batch through a temporary edge
+      if (!gc.InsertEdge(batch.gc_node, node_index) ||
+          !gc.ContractEdge(batch.gc_node, node_index)) {
+        return errors::Internal("Unable to batch ", node->name());
+      }
+      batch.members.push_back(node);
+      added = true;
+      break;
+    }
+    if (!added) {
+      device_batches.push_back(Batch{node_index, {node}});
+    }
+  }
+
+  for (auto& kv : batches) {
+    for (auto& batch : kv.second) {
+      if (batch.members.size() < 2) {
+        continue;
+      }
+      TF_RETURN_IF_ERROR(CreateBatchedAssign(graph, graph_id, batch.members));
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -0,0 +1,45 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#ifndef NGRAPH_TF_BATCH_NGRAPHASSIGNS_H_
+#define NGRAPH_TF_BATCH_NGRAPHASSIGNS_H_
+
+#pragma once
+
+#include "tensorflow/core/graph/graph.h"
+
+#include "ngraph_bridge/ngraph_utils.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Coalesces the NGraphAssigns left in the graph after RemoveNGraphAssigns
+// (i.e. the ones whose value is computed by TF) into NGraphBatchedAssign
+// ops, one per device and data type, so that a step updates all these
+// variables from a single kernel. Assigns that depend on each other are
+// kept in separate batches. Graphs with control flow are left untouched.
+//
+// The Catalog entries of the NGraphAssigns are moved to the batched ops.
+// Enabled with NGRAPH_TF_BATCH_ASSIGNS.
+Status BatchNGraphAssigns(Graph* graph, int graph_id);
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_BATCH_NGRAPHASSIGNS_H_
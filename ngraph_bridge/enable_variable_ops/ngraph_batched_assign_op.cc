@@ -0,0 +1,245 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <map>
+#include <tuple>
+
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/platform/default/logging.h"
+
+#include "ngraph/event_tracing.hpp"
+
+#include "ngraph_bridge/enable_variable_ops/ngraph_var.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_var_arena.h"
+#include "ngraph_bridge/ngraph_catalog.h"
+#include "ngraph_bridge/ngraph_freshness_tracker.h"
+#include "ngraph_bridge/ngraph_utils.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+/* -------------------------------------------------
+//
+// NGraphBatchedAssignOp
+//
+---------------------------------------------------*/
+
+// Computes *input[i] = input[N + i] for i in [0, N)
+// Does for a batch of variables what NGraphAssign does for one, in a single
+// kernel launch: the variables are locked against snapshots once for the
+// whole batch, and the TF tensors that changed are marked stale at once
+class NGraphBatchedAssignOp : public OpKernel {
+ private:
+  std::vector<bool> copy_to_tf_;
+  int ng_graph_id_;
+  int num_vars_;
+  // Shared names of the variables assigned to, looked up in the Catalog once
+  std::vector<string> ref_var_names_;
+  NGraphFreshnessTracker* tracker_{nullptr};
+  // Order in which the variables are written, computed once they exist
+  mutex order_mu_;
+  std::vector<int> write_order_ GUARDED_BY(order_mu_);
+  static int s_instance_count;
+  int my_instance_id{0};
+
+  // The variables in an NGraphVarArena are written by their offset in it,
+  // so that the batch sweeps the contiguous block once from start to end.
+  // The others are written after them, in input order
+  void GetWriteOrder(OpKernelContext* context,
+                     const std::vector<NGraphVar*>& vars,
+                     std::vector<int>* order) {
+    mutex_lock l(order_mu_);
+    if (write_order_.empty()) {
+      ResourceMgr* rm = context->resource_manager();
+      std::map<string, int> arena_ranks;
+      std::vector<std::tuple<int, size_t, int>> keys;
+      for (int i = 0; i < num_vars_; i++) {
+        const string& backend_name = vars[i]->backend_name();
+        if (arena_ranks.find(backend_name) == arena_ranks.end()) {
+          int rank = arena_ranks.size();
+          arena_ranks[backend_name] = rank;
+        }
+        int rank = arena_ranks[backend_name];
+        size_t offset = 0;
+        NGraphVarArena* arena;
+        if (rm->Lookup<NGraphVarArena>(
+                  rm->default_container(),
+                  NGraphVarArena::ResourceName(ng_graph_id_, backend_name),
+                  &arena)
+                .ok()) {
+          const char* base =
+              static_cast<const char*>(DMAHelper::base(vars[i]->tensor()));
+          if (base >= arena->data() && base < arena->data() + arena->size()) {
+            offset = base - arena->data();
+          } else {
+            rank = num_vars_;
+          }
+          arena->Unref();
+        } else {
+          rank = num_vars_;
+        }
+        keys.push_back(std::make_tuple(rank, offset, i));
+      }
+      std::sort(keys.begin(), keys.end());
+      for (const auto& key : keys) {
+        write_order_.push_back(std::get<2>(key));
+      }
+    }
+    *order = write_order_;
+  }
+
+ public:
+  ~NGraphBatchedAssignOp() {
+    NGRAPH_VLOG(4) << "~NGraphBatchedAssignOp::" << name() << endl;
+    if (tracker_ != nullptr) {
+      tracker_->Unref();
+    }
+    // Delete from Input Variable Shared Name Map
+    for (int i = 0; i < num_vars_; i++) {
+      string key = NGraphCatalog::CreateNodeKey(ng_graph_id_, name(), i);
+      NGraphCatalog::DeleteFromInputVariableSharedNameMap(key);
+    }
+  }
+
+  explicit NGraphBatchedAssignOp(OpKernelConstruction* context)
+      : OpKernel(context), num_vars_(0) {
+    OP_REQUIRES_OK(context, context->GetAttr("copy_to_tf", &copy_to_tf_));
+    OP_REQUIRES_OK(context, context->GetAttr("ngraph_graph_id", &ng_graph_id_));
+    OP_REQUIRES_OK(context, context->GetAttr("N", &num_vars_));
+    OP_REQUIRES(context, copy_to_tf_.size() == num_vars_,
+                errors::InvalidArgument("copy_to_tf has ", copy_to_tf_.size(),
+                                        " entries, expected ", num_vars_));
+
+    NGRAPH_VLOG(4) << "NGraphBatchedAssign:: Constructor called for: "
+                   << def().name() << ", number of variables " << num_vars_
+                   << " ,Graph ID " << ng_graph_id_;
+
+    for (int i = 0; i < num_vars_; i++) {
+      OP_REQUIRES(context, IsRefType(context->input_type(i)),
+                  errors::InvalidArgument("lhs input ", i,
+                                          " needs to be a ref type"));
+      OP_REQUIRES(context, NGraphCatalog::ExistsInInputVariableSharedNameMap(
+                               ng_graph_id_, def().name(), i),
+                  errors::Internal("RefInput ", i,
+                                   " to NGraphBatchedAssign not found"));
+      ref_var_names_.push_back(NGraphCatalog::GetInputVariableSharedName(
+          ng_graph_id_, def().name(), i));
+    }
+    OP_REQUIRES_OK(
+        context,
+        context->resource_manager()->LookupOrCreate<NGraphFreshnessTracker>(
+            context->resource_manager()->default_container(),
+            "ngraph_freshness_tracker", &tracker_,
+            [](NGraphFreshnessTracker** tracker) {
+              *tracker = new NGraphFreshnessTracker();
+              return Status::OK();
+            }));
+    my_instance_id = s_instance_count;
+    s_instance_count++;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    std::ostringstream oss;
+    oss << "Execute: BatchedAssign_" << my_instance_id << ": " << name();
+    ngraph::Event event_compute(oss.str(), name(), "");
+
+    NGRAPH_VLOG(4) << "NGraphBatchedAssign:: Compute called for: "
+                   << def().name() << ", number of variables " << num_vars_
+                   << " ,Graph ID " << ng_graph_id_;
+
+    bool log_copies = false;
+    OP_REQUIRES_OK(context,
+                   IsNgraphTFLogTensorCopiesEnabled(ng_graph_id_, log_copies));
+    std::stringstream copy_log_str;
+    copy_log_str << "KERNEL[" << type_string() << "]: " << name()
+                 << " ,number of variables " << num_vars_ << "\n";
+    int number_of_copies = 0;
+
+    std::vector<NGraphVar*> vars(num_vars_, nullptr);
+    auto unref_vars = gtl::MakeCleanup([&vars] {
+      for (auto var : vars) {
+        if (var != nullptr) {
+          var->Unref();
+        }
+      }
+    });
+    for (int i = 0; i < num_vars_; i++) {
+      OP_REQUIRES_OK(context,
+                     context->resource_manager()->Lookup<NGraphVar>(
+                         context->resource_manager()->default_container(),
+                         ref_var_names_[i], &vars[i]));
+
+      // We always return the input refs
+      context->forward_ref_input_to_ref_output(i, i);
+    }
+
+    std::vector<int> write_order;
+    GetWriteOrder(context, vars, &write_order);
+    {
+      // No snapshot starts in the middle of the batch
+      NGraphVarWriteLock var_write_lock;
+      for (int i = 0; i < num_vars_; i++) {
+        var_write_lock.Add(vars[i]);
+      }
+      for (int i : write_order) {
+        Tensor* rhs_tensor = (Tensor*)&(context->input(num_vars_ + i));
+        if (vars[i]->write_ng_tensor(rhs_tensor)) {
+          number_of_copies++;
+          copy_log_str << " COPY_INP_VAL[" << i << "]";
+        }
+      }
+    }
+
+    // TF tensors written, through the shared buffer or the copy to TF
+    std::vector<const void*> stale_tensors;
+    for (int i = 0; i < num_vars_; i++) {
+      if (copy_to_tf_[i]) {
+        mutex_lock l(*context->input_ref_mutex(i));
+        if (vars[i]->copy_ng_to_tf()) {
+          number_of_copies++;
+          copy_log_str << " COPY_TO_TF[" << i << "]";
+        }
+      }
+      if (copy_to_tf_[i] || vars[i]->shares_buffer()) {
+        stale_tensors.push_back(DMAHelper::base(vars[i]->tensor()));
+      }
+    }
+    tracker_->MarkStale(stale_tensors);
+
+    copy_log_str << " Number of copies " << number_of_copies << "\n";
+    if (log_copies) {
+      cout << copy_log_str.str();
+    }
+
+    event_compute.Stop();
+    ngraph::Event::write_trace(event_compute);
+  }
+};
+
+int NGraphBatchedAssignOp::s_instance_count = 0;
+
+REGISTER_KERNEL_BUILDER(Name("NGraphBatchedAssign").Device(DEVICE_CPU),
+                        NGraphBatchedAssignOp);
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -20,7 +20,8 @@
 #include "ngraph_bridge/enable_variable_ops/ngraph_replace_op_utilities.h"
 #include "ngraph_bridge/ngraph_api.h"
 #include "ngraph_bridge/ngraph_capture_variables.h"
-#include "ngraph_bridge/ngraph_prefetch_shared_data.h"
+#include "ngraph_bridge/ngraph_catalog.h"
+#include "ngraph_bridge/ngraph_replace_cache_dataset.h"
 #include "ngraph_bridge/ngraph_utils.h"
 
 using namespace std;
@@ -37,7 +38,72 @@ namespace ngraph_bridge {
 //
 static bool NGraphPlacementRequested(const Node* node) { return true; }
 
-Status ReplacePrefetch(Graph* graph, Node* prefetch_node) {
+// Datasets that return the elements of their input dataset unchanged, so
+// that the elements staged by a NGraphPrefetchDataset below them are the
+// ones returned by the IteratorGetNext
+static const std::set<string> kPassThroughDatasets = {
+    "Identity", "ModelDataset", "OptimizeDataset",
+    "MaxIntraOpParallelismDataset", "PrivateThreadPoolDataset",
+    "ExperimentalMaxIntraOpParallelismDataset",
+    "ExperimentalPrivateThreadPoolDataset"};
+
+// Returns the iterator made from the dataset "node" (possibly
+// through pass-through datasets wrapping it), or nullptr if
+// prefetching "node" on the device is not safe, i.e. if
+// - there is no MakeIterator for it in this graph
+// - it reaches the MakeIterator through a dataset that changes its elements,
+//   or through a dataset used by more than one node
+// - the iterator is not read by an IteratorGetNext in this graph
+static Node* GetIterator(Node* node) {
+  Node* curr = node;
+  while (true) {
+    Node* next = nullptr;
+    for (auto edge : curr->out_edges()) {
+      if (edge->IsControlEdge()) {
+        continue;
+      }
+      if (next != nullptr) {
+        return nullptr;
+      }
+      next = edge->dst();
+    }
+    if (next == nullptr) {
+      return nullptr;
+    }
+    if (next->type_string() == "MakeIterator") {
+      Node* iterator;
+      if (!next->input_node(1, &iterator).ok()) {
+        return nullptr;
+      }
+      for (auto edge : iterator->out_edges()) {
+        if (!edge->IsControlEdge() &&
+            edge->dst()->type_string() == "IteratorGetNext") {
+          return iterator;
+        }
+      }
+      return nullptr;
+    }
+    if (kPassThroughDatasets.count(next->type_string()) == 0) {
+      return nullptr;
+    }
+    curr = next;
+  }
+}
+
+Status ReplacePrefetch(Graph* graph, Node* prefetch_node, int graph_id) {
+  // The NGraphEncapsulates fed by this iterator register with it by name
+  Node* iterator = GetIterator(prefetch_node);
+  if (iterator == nullptr) {
+    NGRAPH_VLOG(1) << "Not replacing " << prefetch_node->name()
+                   << ", its elements do not reach an IteratorGetNext as is";
+    return Status::OK();
+  }
+  string iterator_name = iterator->name();
+
+  // Keep the elements on the device if the dataset is cached
+  TF_RETURN_IF_ERROR(
+      ReplaceCacheDataset(graph, prefetch_node, iterator_name, graph_id));
+
   NodeBuilder::NodeOut input_dataset;
   NodeBuilder::NodeOut buffer_size;
 
@@ -68,6 +134,8 @@ Status ReplacePrefetch(Graph* graph, Node* prefetch_node) {
                          .Attr("output_types", output_types)
                          .Attr("output_shapes", output_shapes)
                          .Attr("slack_period", slack_period)
+                         .Attr("iterator_name", iterator_name)
+                         .Attr("graph_id", graph_id)
                          .Device(prefetch_node->assigned_device_name())
                          .Finalize(graph, &replacement));
   replacement->set_assigned_device_name(prefetch_node->assigned_device_name());
@@ -112,13 +180,150 @@ Status ReplacePrefetch(Graph* graph, Node* prefetch_node) {
   graph->RemoveNode(prefetch_node);
   NGRAPH_VLOG(4) << "Replaced TF Prefetch Node " << prefetch_node->name()
                  << " with NGraphPrefetch Node " << replacement->name();
+
+  // The inputs fed by this iterator are entered in the catalog once the
+  // graph is encapsulated, which may be done on a pruned copy of this graph
+  // with another graph id
+  iterator->AddAttr("_ngraph_prefetch_graph_id", graph_id);
+  NGraphCatalog::AddToPrefetchDatasetIterators(graph_id, iterator_name);
   return Status::OK();
 }
 
+// Reading a resource variable becomes a Snapshot of the NGraphVariable.
+// ReadVariableOp returns a copy of the value, which later modifiers of the
+// variable in the same step must not change. An Identity would alias the
+// buffer of the variable instead
+static Status ReplaceReadVariable(Graph* graph, Node* node, Node** replacement,
+                                  const string replacement_node_name,
+                                  const string replacement_node_type,
+                                  const bool just_looking,
+                                  const bool outputs_ng_supported,
+                                  const int graph_id,
+                                  const bool is_backend_set) {
+  DataType dtype;
+  TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "dtype", &dtype));
+  const Edge* input_edge;
+  TF_RETURN_IF_ERROR(node->input_edge(0, &input_edge));
+
+  TF_RETURN_IF_ERROR(NodeBuilder(replacement_node_name, replacement_node_type)
+                         .Input(input_edge->src(), input_edge->src_output())
+                         .Attr("T", dtype)
+                         .Device(node->assigned_device_name())
+                         .Finalize(graph, replacement));
+  (*replacement)->set_assigned_device_name(node->assigned_device_name());
+  return Status::OK();
+}
+
+// VarIsInitializedOp becomes an IsVariableInitialized of the NGraphVariable
+static Status ReplaceVarIsInitialized(
+    Graph* graph, Node* node, Node** replacement,
+    const string replacement_node_name, const string replacement_node_type,
+    const bool just_looking, const bool outputs_ng_supported,
+    const int graph_id, const bool is_backend_set) {
+  const Edge* input_edge;
+  TF_RETURN_IF_ERROR(node->input_edge(0, &input_edge));
+  DataType dtype;
+  TF_RETURN_IF_ERROR(
+      GetNodeAttr(input_edge->src()->attrs(), "dtype", &dtype));
+
+  TF_RETURN_IF_ERROR(NodeBuilder(replacement_node_name, replacement_node_type)
+                         .Input(input_edge->src(), input_edge->src_output())
+                         .Attr("dtype", dtype)
+                         .Device(node->assigned_device_name())
+                         .Finalize(graph, replacement));
+  (*replacement)->set_assigned_device_name(node->assigned_device_name());
+  return Status::OK();
+}
+
+// ApplyAdam is decomposed into TF ops by ReplaceModifiers, which only creates
+// the constants for floating point types. Other types are left to TF
+static bool CanCaptureModifier(const Node* node) {
+  static const std::set<string> kDecomposedOptimizers = {"ApplyAdam",
+                                                         "ResourceApplyAdam"};
+  static const std::set<DataType> kDecomposedTypes = {DT_FLOAT, DT_DOUBLE,
+                                                      DT_HALF, DT_BFLOAT16};
+  if (kDecomposedOptimizers.find(node->type_string()) ==
+      kDecomposedOptimizers.end()) {
+    return true;
+  }
+  DataType dtype = DT_INVALID;
+  if (GetNodeAttr(node->attrs(), "T", &dtype) != Status::OK() ||
+      kDecomposedTypes.find(dtype) == kDecomposedTypes.end()) {
+    NGRAPH_VLOG(4) << "Not capturing " << node->name() << " of type "
+                   << DataTypeString(dtype);
+    return false;
+  }
+  return true;
+}
+
+// Returns the resource variables (VarHandleOps) that can be captured: their
+// shape is known and all their consumers are in "consumer_ops", with all the
+// resource inputs of these consumers coming from capturable variables too
+static std::set<Node*> GetCapturableResourceVariables(
+    Graph* graph, const std::set<string>& consumer_ops) {
+  std::set<Node*> capturable;
+  for (auto node : graph->op_nodes()) {
+    if (node->type_string() != "VarHandleOp") {
+      continue;
+    }
+    PartialTensorShape shape;
+    if (GetNodeAttr(node->attrs(), "shape", &shape) != Status::OK() ||
+        !shape.IsFullyDefined()) {
+      NGRAPH_VLOG(4) << "Not capturing " << node->name()
+                     << ", shape is not fully defined";
+      continue;
+    }
+    capturable.insert(node);
+  }
+
+  // Drop the variables with unsupported consumers until nothing changes,
+  // as dropping one may make the consumers it shares with others unsupported
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto itr = capturable.begin(); itr != capturable.end();) {
+      Node* var_handle = *itr;
+      bool supported = true;
+      for (auto edge : var_handle->out_edges()) {
+        if (edge->IsControlEdge()) {
+          continue;
+        }
+        Node* dst = edge->dst();
+        if (consumer_ops.find(dst->type_string()) == consumer_ops.end() ||
+            !CanCaptureModifier(dst)) {
+          NGRAPH_VLOG(4) << "Not capturing " << var_handle->name()
+                         << ", read by " << dst->type_string();
+          supported = false;
+          break;
+        }
+        for (auto dst_edge : dst->in_edges()) {
+          if (!dst_edge->IsControlEdge() &&
+              dst->input_type(dst_edge->dst_input()) == DT_RESOURCE &&
+              capturable.find(dst_edge->src()) == capturable.end()) {
+            supported = false;
+            break;
+          }
+        }
+        if (!supported) {
+          break;
+        }
+      }
+      if (supported) {
+        ++itr;
+      } else {
+        itr = capturable.erase(itr);
+        changed = true;
+      }
+    }
+  }
+  return capturable;
+}
+
 //
 // Main entry point for the variable-capture.
 //
-Status CaptureVariables(Graph* graph, std::set<string> skip_these_nodes) {
+Status CaptureVariables(Graph* graph, std::set<string> skip_these_nodes,
+                        bool replace_prefetch, int graph_id) {
   const static std::map<
       const string,
       const pair<string,
@@ -133,14 +338,87 @@ Status CaptureVariables(Graph* graph, std::set<string> skip_these_nodes) {
            std::make_pair("NGraphApplyGradientDescent", ReplaceOptimizer)},
           {"ApplyMomentum",
            std::make_pair("NGraphApplyMomentum", ReplaceOptimizer)},
+          {"ApplyAdam", std::make_pair("NGraphApplyAdam", ReplaceOptimizer)},
 
           {"Assign", std::make_pair("NGraphAssign", ReplaceAssign)},
           {"AssignAdd", std::make_pair("NGraphAssignAdd", ReplaceAssign)},
           {"AssignSub", std::make_pair("NGraphAssignSub", ReplaceAssign)},
           {"VariableV2", std::make_pair("NGraphVariable", ReplaceVariable)}};
 
+  // Consumers of the resource variables, captured once the VarHandleOp was
+  // replaced by an NGraphVariable
+  const static std::map<
+      const string,
+      const pair<string,
+                 function<Status(
+                     Graph * graph, Node * node, Node * *replacement,
+                     const string replacement_node_name,
+                     const string replacement_op_type, const bool just_looking,
+                     const bool outputs_ng_supported, const int graph_id,
+                     const bool is_backend_set)>>>
+      CAPTURE_REPLACE_RESOURCE_OP_MAP{
+          {"ResourceApplyGradientDescent",
+           std::make_pair("NGraphApplyGradientDescent", ReplaceOptimizer)},
+          {"ResourceApplyMomentum",
+           std::make_pair("NGraphApplyMomentum", ReplaceOptimizer)},
+          {"ResourceApplyAdam",
+           std::make_pair("NGraphApplyAdam", ReplaceOptimizer)},
+
+          {"AssignVariableOp", std::make_pair("NGraphAssign", ReplaceAssign)},
+          {"AssignAddVariableOp",
+           std::make_pair("NGraphAssignAdd", ReplaceAssign)},
+          {"AssignSubVariableOp",
+           std::make_pair("NGraphAssignSub", ReplaceAssign)},
+          {"ReadVariableOp", std::make_pair("Snapshot", ReplaceReadVariable)},
+          {"VarIsInitializedOp",
+           std::make_pair("IsVariableInitialized", ReplaceVarIsInitialized)}};
+
+  // Resource variables: the VarHandleOp becomes an NGraphVariable, and its
+  // consumers the ref-style ops of the same variable, so that the rest of
+  // the passes handle them like VariableV2
+  std::set<Node*> resource_nodes_to_capture;
+  if (std::getenv("NGRAPH_TF_CAPTURE_RESOURCE_VARIABLES") != nullptr) {
+    std::set<string> consumer_ops;
+    for (const auto& kv : CAPTURE_REPLACE_RESOURCE_OP_MAP) {
+      consumer_ops.insert(kv.first);
+    }
+    for (auto var_handle :
+         GetCapturableResourceVariables(graph, consumer_ops)) {
+      for (auto edge : var_handle->out_edges()) {
+        if (!edge->IsControlEdge()) {
+          resource_nodes_to_capture.insert(edge->dst());
+        }
+      }
+
+      Node* replacement;
+      TF_RETURN_IF_ERROR(ReplaceVariable(graph, var_handle, &replacement,
+                                         var_handle->name(), "NGraphVariable",
+                                         true, false, 0, false));
+      NGRAPH_VLOG(4) << "Replacing resource variable "
+                     << var_handle->DebugString() << " with "
+                     << replacement->DebugString();
+      TF_RETURN_IF_ERROR(
+          ReplaceInputControlEdges(graph, var_handle, replacement));
+      TF_RETURN_IF_ERROR(ReplaceOutputEdges(graph, var_handle, replacement));
+      graph->RemoveNode(var_handle);
+    }
+  }
+
+  for (auto node : resource_nodes_to_capture) {
+    Node* replacement;
+    auto itr = CAPTURE_REPLACE_RESOURCE_OP_MAP.find(node->type_string());
+    TF_RETURN_IF_ERROR((itr->second.second)(graph, node, &replacement,
+                                            node->name(), itr->second.first,
+                                            true, false, 0, false));
+    NGRAPH_VLOG(4) << "Replacing Node " << node->DebugString() << " with "
+                   << replacement->DebugString();
+    TF_RETURN_IF_ERROR(ReplaceInputControlEdges(graph, node, replacement));
+    TF_RETURN_IF_ERROR(ReplaceOutputEdges(graph, node, replacement));
+    graph->RemoveNode(node);
+  }
+
   std::set<Node*> nodes_to_capture;
-  Node* prefetch_node = nullptr;
+  std::vector<Node*> prefetch_nodes;
   for (auto node : graph->op_nodes()) {
     std::set<Node*> ref_list;
     if (NGraphPlacementRequested(node)) {
@@ -157,16 +435,16 @@ Status CaptureVariables(Graph* graph, std::set<string> skip_these_nodes) {
         if (ref_list.size()) {
           for (auto n : ref_list) {
             auto itr = CAPTURE_REPLACE_OP_MAP.find(n->type_string());
-            if (itr != CAPTURE_REPLACE_OP_MAP.end()) {
+            if (itr != CAPTURE_REPLACE_OP_MAP.end() && CanCaptureModifier(n)) {
               nodes_to_capture.insert(n);
             }
           }
           ref_list.clear();
         }
       } else if (node->type_string() == "PrefetchDataset") {
-        // Collect the prefetch_node so that we can add
-        // the NGraphWriteToDevice Op after this one
-        prefetch_node = node;
+        // Collect the prefetch nodes so that we can add
+        // the NGraphWriteToDevice Op after them
+        prefetch_nodes.push_back(node);
       }
     }
   }
@@ -189,10 +467,10 @@ Status CaptureVariables(Graph* graph, std::set<string> skip_these_nodes) {
     graph->RemoveNode(node);
   }
 
-  if (std::getenv(NGraphPrefetchSharedResouce::NGRAPH_TF_USE_PREFETCH) !=
-      nullptr) {
-    if (prefetch_node != nullptr) {
-      return ReplacePrefetch(graph, prefetch_node);
+  if (replace_prefetch) {
+    NGraphCatalog::ClearPrefetchDatasetIterators(graph_id);
+    for (auto prefetch_node : prefetch_nodes) {
+      TF_RETURN_IF_ERROR(ReplacePrefetch(graph, prefetch_node, graph_id));
     }
   }
 
@@ -88,7 +88,10 @@ Status ReplaceAssign(Graph* graph, Node* node, Node** replacement,
                      const int graph_id, const bool is_backend_set) {
   NGRAPH_VLOG(1) << "Replacing  " << node->name();
   DataType dtype;
-  TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "T", &dtype));
+  if (GetNodeAttr(node->attrs(), "T", &dtype) != Status::OK()) {
+    // AssignVariableOp, AssignAddVariableOp and AssignSubVariableOp
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "dtype", &dtype));
+  }
 
   std::vector<const Edge*> input_edges;
   TF_RETURN_IF_ERROR(node->input_edges(&input_edges));
@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "tensorflow/core/graph/node_builder.h"
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_replace_save_ops.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// SaveV2 inputs: prefix, tensor_names, shape_and_slices, tensors...
+static const int kNumSaveV2FixedInputs = 3;
+
+static Status ReplaceSaveOp(Graph* graph, Node* save_node) {
+  std::vector<const Edge*> input_edges;
+  TF_RETURN_IF_ERROR(save_node->input_edges(&input_edges));
+
+  std::vector<NodeBuilder::NodeOut> tensors;
+  std::vector<DataType> dtypes;
+  std::vector<string> variable_shared_names;
+  std::vector<Node*> variables;
+  for (int i = kNumSaveV2FixedInputs; i < input_edges.size(); i++) {
+    Node* src = input_edges[i]->src();
+    if (src->type_string() == "NGraphVariable") {
+      string shared_name;
+      TF_RETURN_IF_ERROR(
+          GetNodeAttr(src->attrs(), "shared_name", &shared_name));
+      variable_shared_names.push_back(shared_name.empty() ? src->name()
+                                                          : shared_name);
+      variables.push_back(src);
+    } else {
+      variable_shared_names.push_back("");
+      tensors.push_back(
+          NodeBuilder::NodeOut(src, input_edges[i]->src_output()));
+      dtypes.push_back(save_node->input_type(i));
+    }
+  }
+
+  if (variables.empty()) {
+    return Status::OK();
+  }
+
+  Node* replacement;
+  TF_RETURN_IF_ERROR(
+      NodeBuilder(graph->NewName("NGraph" + save_node->name()), "NGraphSaveV2")
+          .Input(NodeBuilder::NodeOut(input_edges[0]->src(),
+                                      input_edges[0]->src_output()))
+          .Input(NodeBuilder::NodeOut(input_edges[1]->src(),
+                                      input_edges[1]->src_output()))
+          .Input(NodeBuilder::NodeOut(input_edges[2]->src(),
+                                      input_edges[2]->src_output()))
+          .Input(tensors)
+          .Attr("dtypes", dtypes)
+          .Attr("variable_shared_names", variable_shared_names)
+          .Device(save_node->assigned_device_name())
+          .Finalize(graph, &replacement));
+  replacement->set_assigned_device_name(save_node->assigned_device_name());
+
+  // The variables have to be created before they are saved
+  for (auto variable : variables) {
+    graph->AddControlEdge(variable, replacement);
+  }
+
+  std::vector<std::tuple<Node*, int, Node*, int>> edges_to_add;
+  for (auto edge : save_node->in_edges()) {
+    if (edge->IsControlEdge()) {
+      edges_to_add.push_back(std::tuple<Node*, int, Node*, int>(
+          edge->src(), Graph::kControlSlot, replacement, Graph::kControlSlot));
+    }
+  }
+  // SaveV2 has no outputs, only control edges leave it
+  for (auto edge : save_node->out_edges()) {
+    edges_to_add.push_back(std::tuple<Node*, int, Node*, int>(
+        replacement, Graph::kControlSlot, edge->dst(), Graph::kControlSlot));
+  }
+  for (const auto& e : edges_to_add) {
+    graph->AddEdge(get<0>(e), get<1>(e), get<2>(e), get<3>(e));
+  }
+
+  NGRAPH_VLOG(4) << "Replaced " << save_node->name() << " with "
+                 << replacement->name() << ", saving " << variables.size()
+                 << " variables from their NG Tensors";
+  graph->RemoveNode(save_node);
+  return Status::OK();
+}
+
+Status ReplaceSaveOps(Graph* graph) {
+  std::vector<Node*> save_nodes;
+  for (auto node : graph->op_nodes()) {
+    if (node->type_string() == "SaveV2") {
+      save_nodes.push_back(node);
+    }
+  }
+  for (auto node : save_nodes) {
+    TF_RETURN_IF_ERROR(ReplaceSaveOp(graph, node));
+  }
+  return Status::OK();
+}
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -0,0 +1,42 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#ifndef NGRAPH_TF_REPLACE_SAVE_OPS_H_
+#define NGRAPH_TF_REPLACE_SAVE_OPS_H_
+#pragma once
+
+#include "tensorflow/core/graph/graph.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Replaces the SaveV2 ops that save NGraphVariables with NGraphSaveV2 ops.
+// NGraphSaveV2 reads the variables from their NG Tensors itself, through
+// copy-on-write snapshots, and writes the checkpoint on a background thread.
+// The variables only have a control edge to it, so saving does not sync their
+// TF Tensors inside the step.
+// Must run before RewriteForTracking. Enabled with
+// NGRAPH_TF_STREAMING_CHECKPOINT.
+Status ReplaceSaveOps(Graph* graph);
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_REPLACE_SAVE_OPS_H_
@@ -14,6 +14,7 @@
  * limitations under the License.
  *******************************************************************************/
 
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/node_builder.h"
 
@@ -54,6 +55,80 @@ Status CreateBinaryOpNode(NodeBuilder::NodeOut* ndef_gen_op,
   return Status::OK();
 }
 
+static Status CreateUnaryOpNode(NodeBuilder::NodeOut* ndef_gen_op,
+                                std::string new_name_op, std::string op_type,
+                                NodeBuilder::NodeOut input, DataType dtype,
+                                Node*& node, Graph*& graph) {
+  Node* generic_op;
+
+  TF_RETURN_IF_ERROR(NodeBuilder(new_name_op, op_type)
+                         .Input(input)
+                         .Attr("T", dtype)
+                         .Device(node->assigned_device_name())
+                         .Finalize(graph, &(generic_op)));
+  generic_op->set_assigned_device_name(node->assigned_device_name());
+
+  *ndef_gen_op = NodeBuilder::NodeOut(generic_op, 0);
+  return Status::OK();
+}
+
+// Creates the scalar constant "value" of type dtype
+static Status CreateScalarConstNode(NodeBuilder::NodeOut* ndef_const_op,
+                                    std::string new_name_op, double value,
+                                    DataType dtype, Node*& node,
+                                    Graph*& graph) {
+  Tensor const_value(dtype, TensorShape({}));
+  switch (dtype) {
+    case DT_FLOAT:
+      const_value.scalar<float>()() = static_cast<float>(value);
+      break;
+    case DT_DOUBLE:
+      const_value.scalar<double>()() = value;
+      break;
+    case DT_HALF:
+      const_value.scalar<Eigen::half>()() =
+          Eigen::half(static_cast<float>(value));
+      break;
+    case DT_BFLOAT16:
+      const_value.scalar<bfloat16>()() = bfloat16(static_cast<float>(value));
+      break;
+    default:
+      return errors::Unimplemented("Cannot create a constant of type ",
+                                   DataTypeString(dtype), " for ",
+                                   node->name());
+  }
+
+  Node* const_op;
+  TF_RETURN_IF_ERROR(NodeBuilder(new_name_op, "Const")
+                         .Attr("dtype", dtype)
+                         .Attr("value", const_value)
+                         .Device(node->assigned_device_name())
+                         .Finalize(graph, &(const_op)));
+  const_op->set_assigned_device_name(node->assigned_device_name());
+
+  *ndef_const_op = NodeBuilder::NodeOut(const_op, 0);
+  return Status::OK();
+}
+
+static Status CreateNGraphAssignNode(Node** ngraphassign_op,
+                                     std::string new_name_op,
+                                     NodeBuilder::NodeOut input_ref,
+                                     NodeBuilder::NodeOut input_val,
+                                     DataType dtype, Node*& node,
+                                     Graph*& graph) {
+  TF_RETURN_IF_ERROR(NodeBuilder(new_name_op, "NGraphAssign")
+                         .Attr("validate_shape", true)
+                         .Attr("use_locking", true)
+                         .Attr("T", dtype)
+                         .Attr("ngraph_graph_id", 0)
+                         .Input(input_ref)
+                         .Input(input_val)
+                         .Device(node->assigned_device_name())
+                         .Finalize(graph, ngraphassign_op));
+  (*ngraphassign_op)->set_assigned_device_name(node->assigned_device_name());
+  return Status::OK();
+}
+
 Status ReplaceModifiers(Graph* graph, int graph_id) {
   // Go over the nodes and replace variable modifiers
   // Each Modifier is replaced with the corresponding computational TF
@@ -239,14 +314,15 @@ Status ReplaceModifiers(Graph* graph, int graph_id) {
                              .Device(node->assigned_device_name())
                              .Finalize(graph, &accumassign_op));
       accumassign_op->set_assigned_device_name(node->assigned_device_name());
-      NodeBuilder::NodeOut ndef_accumassign_op =
-          NodeBuilder::NodeOut(accumassign_op, 0);
 
+      // The var update reads the new accumulator value rather than the
+      // output of the NGraphAssign, so that both updates can be computed by
+      // the same encapsulate
       string new_name_mul_1 = node->name() + "_Mul1";
       NodeBuilder::NodeOut ndef_mul_op_1;
       TF_RETURN_IF_ERROR(CreateBinaryOpNode(&ndef_mul_op_1, new_name_mul_1,
-                                            "Mul", ndef_accumassign_op,
-                                            input_lr, dtype, node, graph));
+                                            "Mul", ndef_add_op, input_lr,
+                                            dtype, node, graph));
 
       bool use_nesterov;
       TF_RETURN_IF_ERROR(
@@ -323,7 +399,184 @@ Status ReplaceModifiers(Graph* graph, int graph_id) {
       remove_nodes.push_back(node);
 
       NGRAPH_VLOG(1) << "Replaced ApplyMomentum";
-    }
+    }  // Apply Momentum
+    else if (node->type_string() == "NGraphApplyAdam") {
+      std::vector<const Edge*> input_edges;
+      TF_RETURN_IF_ERROR(node->input_edges(&input_edges));
+
+      NGRAPH_VLOG(1) << "No of input edges to ApplyAdam "
+                     << input_edges.size();
+
+      auto input_var = NodeBuilder::NodeOut(input_edges[0]->src(),
+                                            input_edges[0]->src_output());
+      auto input_m = NodeBuilder::NodeOut(input_edges[1]->src(),
+                                          input_edges[1]->src_output());
+      auto input_v = NodeBuilder::NodeOut(input_edges[2]->src(),
+                                          input_edges[2]->src_output());
+      auto input_beta1_power = NodeBuilder::NodeOut(
+          input_edges[3]->src(), input_edges[3]->src_output());
+      auto input_beta2_power = NodeBuilder::NodeOut(
+          input_edges[4]->src(), input_edges[4]->src_output());
+      auto input_lr = NodeBuilder::NodeOut(input_edges[5]->src(),
+                                           input_edges[5]->src_output());
+      auto input_beta1 = NodeBuilder::NodeOut(input_edges[6]->src(),
+                                              input_edges[6]->src_output());
+      auto input_beta2 = NodeBuilder::NodeOut(input_edges[7]->src(),
+                                              input_edges[7]->src_output());
+      auto input_epsilon = NodeBuilder::NodeOut(input_edges[8]->src(),
+                                                input_edges[8]->src_output());
+      auto input_grad = NodeBuilder::NodeOut(input_edges[9]->src(),
+                                             input_edges[9]->src_output());
+      DataType dtype;
+      TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "T", &dtype));
+      bool use_nesterov;
+      TF_RETURN_IF_ERROR(
+          GetNodeAttr(node->attrs(), "use_nesterov", &use_nesterov));
+
+      // Equations, with all the updates computed from the old values:
+      //  lr_t = lr * sqrt(1 - beta2_power) / (1 - beta1_power)
+      //  m_t = m + (grad - m) * (1 - beta1)
+      //  v_t = v + (grad * grad - v) * (1 - beta2)
+      //  var -= lr_t * m_t / (sqrt(v_t) + epsilon)
+      // or with use_nesterov
+      //  var -= lr_t * (grad * (1 - beta1) + m_t * beta1) /
+      //         (sqrt(v_t) + epsilon)
+      // The three NGraphAssigns are fed by the same computation, so once they
+      // are removed the whole update is done by one encapsulate writing into
+      // the variables in place
+      NodeBuilder::NodeOut ndef_one;
+      TF_RETURN_IF_ERROR(CreateScalarConstNode(
+          &ndef_one, node->name() + "_One", 1.0, dtype, node, graph));
+      // Every computation below starts from the constant, so it carries the
+      // control dependencies of the optimizer (and stays in the frame of the
+      // gradient)
+      TF_RETURN_IF_ERROR(
+          ReplaceInputControlEdges(graph, node, ndef_one.node));
+      graph->AddControlEdge(input_grad.node, ndef_one.node);
+
+      NodeBuilder::NodeOut ndef_one_minus_beta1;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_one_minus_beta1, node->name() + "_Sub_Beta1", "Sub", ndef_one,
+          input_beta1, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_one_minus_beta2;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_one_minus_beta2, node->name() + "_Sub_Beta2", "Sub", ndef_one,
+          input_beta2, dtype, node, graph));
+
+      // lr_t
+      NodeBuilder::NodeOut ndef_one_minus_beta1_power;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_one_minus_beta1_power, node->name() + "_Sub_Beta1Power",
+          "Sub", ndef_one, input_beta1_power, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_one_minus_beta2_power;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_one_minus_beta2_power, node->name() + "_Sub_Beta2Power",
+          "Sub", ndef_one, input_beta2_power, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_sqrt_beta2_power;
+      TF_RETURN_IF_ERROR(CreateUnaryOpNode(
+          &ndef_sqrt_beta2_power, node->name() + "_Sqrt_Beta2Power", "Sqrt",
+          ndef_one_minus_beta2_power, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_mul_lr;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_mul_lr, node->name() + "_Mul_Lr", "Mul", input_lr,
+          ndef_sqrt_beta2_power, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_lr_t;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_lr_t, node->name() + "_Lr_t", "RealDiv", ndef_mul_lr,
+          ndef_one_minus_beta1_power, dtype, node, graph));
+
+      // m_t
+      NodeBuilder::NodeOut ndef_sub_m;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_sub_m, node->name() + "_Sub_M", "Sub", input_grad, input_m,
+          dtype, node, graph));
+      NodeBuilder::NodeOut ndef_mul_m;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_mul_m, node->name() + "_Mul_M", "Mul", ndef_sub_m,
+          ndef_one_minus_beta1, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_m_t;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(&ndef_m_t, node->name() + "_M_t",
+                                            "Add", input_m, ndef_mul_m, dtype,
+                                            node, graph));
+
+      // v_t
+      NodeBuilder::NodeOut ndef_square_grad;
+      TF_RETURN_IF_ERROR(CreateUnaryOpNode(
+          &ndef_square_grad, node->name() + "_Square_Grad", "Square",
+          input_grad, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_sub_v;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_sub_v, node->name() + "_Sub_V", "Sub", ndef_square_grad,
+          input_v, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_mul_v;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_mul_v, node->name() + "_Mul_V", "Mul", ndef_sub_v,
+          ndef_one_minus_beta2, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_v_t;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(&ndef_v_t, node->name() + "_V_t",
+                                            "Add", input_v, ndef_mul_v, dtype,
+                                            node, graph));
+
+      Node* massign_op;
+      TF_RETURN_IF_ERROR(CreateNGraphAssignNode(&massign_op,
+                                                node->name() + "_MAssign",
+                                                input_m, ndef_m_t, dtype, node,
+                                                graph));
+      Node* vassign_op;
+      TF_RETURN_IF_ERROR(CreateNGraphAssignNode(&vassign_op,
+                                                node->name() + "_VAssign",
+                                                input_v, ndef_v_t, dtype, node,
+                                                graph));
+
+      // var
+      NodeBuilder::NodeOut ndef_numerator = ndef_m_t;
+      if (use_nesterov) {
+        NodeBuilder::NodeOut ndef_mul_grad;
+        TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+            &ndef_mul_grad, node->name() + "_Mul_Grad", "Mul", input_grad,
+            ndef_one_minus_beta1, dtype, node, graph));
+        NodeBuilder::NodeOut ndef_mul_m_t;
+        TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+            &ndef_mul_m_t, node->name() + "_Mul_M_t", "Mul", ndef_m_t,
+            input_beta1, dtype, node, graph));
+        TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+            &ndef_numerator, node->name() + "_Add_Nesterov", "Add",
+            ndef_mul_grad, ndef_mul_m_t, dtype, node, graph));
+      }
+      NodeBuilder::NodeOut ndef_sqrt_v_t;
+      TF_RETURN_IF_ERROR(CreateUnaryOpNode(&ndef_sqrt_v_t,
+                                           node->name() + "_Sqrt_V_t", "Sqrt",
+                                           ndef_v_t, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_denominator;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_denominator, node->name() + "_Add_Epsilon", "Add",
+          ndef_sqrt_v_t, input_epsilon, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_mul_lr_t;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_mul_lr_t, node->name() + "_Mul_Lr_t", "Mul", ndef_lr_t,
+          ndef_numerator, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_update;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(
+          &ndef_update, node->name() + "_Update", "RealDiv", ndef_mul_lr_t,
+          ndef_denominator, dtype, node, graph));
+      NodeBuilder::NodeOut ndef_sub_op;
+      TF_RETURN_IF_ERROR(CreateBinaryOpNode(&ndef_sub_op, node->name() + "_Sub",
+                                            "Sub", input_var, ndef_update,
+                                            dtype, node, graph));
+
+      Node* ngraphassign_op;
+      TF_RETURN_IF_ERROR(CreateNGraphAssignNode(
+          &ngraphassign_op, node->name() + "_NGraphAssign", input_var,
+          ndef_sub_op, dtype, node, graph));
+      NGRAPH_VLOG(1) << "Assign op name: " << ngraphassign_op->name();
+      NGRAPH_VLOG(1) << "Assign op assigned device: "
+                     << ngraphassign_op->assigned_device_name();
+      TF_RETURN_IF_ERROR(ReplaceOutputEdges(graph, node, ngraphassign_op));
+
+      remove_nodes.push_back(node);
+
+      NGRAPH_VLOG(1) << "Replaced ApplyAdam";
+    }  // Apply Adam
   }
 
   for (auto node : remove_nodes) {
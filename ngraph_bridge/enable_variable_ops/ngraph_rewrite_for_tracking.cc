@@ -43,6 +43,7 @@ Status RewriteForTracking(Graph* graph, int graph_id) {
 
   std::vector<Node*> replaced_nodes;
   std::set<Node*> add_sync_nodes_to;
+  std::vector<Node*> add_sync_to_tf_nodes_to;
   for (auto node : graph->op_nodes()) {
     auto itr = REWRITE_REPLACE_OP_MAP.find(node->type_string());
     if (itr != REWRITE_REPLACE_OP_MAP.end()) {
@@ -92,6 +93,28 @@ Status RewriteForTracking(Graph* graph, int graph_id) {
         }
       }
 
+      // TF ops that only read the value of an NGraphVariable get it through
+      // an NGraphVariableSyncTFTensor node, which copies the value from the
+      // device only when that TF op runs and the value changed. The variable
+      // itself only syncs the TF tensor for the TF ops taking a reference.
+      bool copy_to_tf = !outputs_ng_supported;
+      bool has_non_ng_value_readers = false;
+      if (node->type_string() == "NGraphVariable") {
+        copy_to_tf = false;
+        for (auto edge : node->out_edges()) {
+          auto dst = edge->dst();
+          if (!dst->IsOp() || edge->IsControlEdge() ||
+              IsNGSupportedType(dst->type_string())) {
+            continue;
+          }
+          if (IsRefType(dst->input_type(edge->dst_input()))) {
+            copy_to_tf = true;
+          } else {
+            has_non_ng_value_readers = true;
+          }
+        }
+      }
+
       NGRAPH_VLOG(1) << "Just_Looking: " << PrintBool(just_looking);
       NGRAPH_VLOG(1) << "Outputs supported by nGraph: "
                      << PrintBool(outputs_ng_supported);
@@ -114,13 +137,19 @@ Status RewriteForTracking(Graph* graph, int graph_id) {
       Node* replacement;
 
       // Create and add the replacement node
+      // The replace functions set copy_to_tf when the outputs are not all
+      // supported by nGraph
       TF_RETURN_IF_ERROR((itr->second)(graph, node, &replacement, node_new_name,
                                        node->type_string(), just_looking,
-                                       outputs_ng_supported, graph_id, true));
+                                       !copy_to_tf, graph_id, true));
 
       TF_RETURN_IF_ERROR(ReplaceInputControlEdges(graph, node, replacement));
       TF_RETURN_IF_ERROR(ReplaceOutputEdges(graph, node, replacement));
 
+      if (has_non_ng_value_readers) {
+        add_sync_to_tf_nodes_to.push_back(replacement);
+      }
+
       replaced_nodes.push_back(node);
 
     }  // end of checking if it is NGVariableType
@@ -184,6 +213,64 @@ Status RewriteForTracking(Graph* graph, int graph_id) {
     }
   }
 
+  for (auto var_node : add_sync_to_tf_nodes_to) {
+    // Group the edges by the TF op reading the variable value
+    std::map<Node*, std::vector<const Edge*>> value_readers;
+    for (auto edge : var_node->out_edges()) {
+      auto dst = edge->dst();
+      if (dst->IsOp() && !edge->IsControlEdge() &&
+          !IsNGSupportedType(dst->type_string()) &&
+          !IsRefType(dst->input_type(edge->dst_input()))) {
+        value_readers[dst].push_back(edge);
+      }
+    }
+
+    DataType dtype;
+    TF_RETURN_IF_ERROR(GetNodeAttr(var_node->attrs(), "dtype", &dtype));
+    string shared_name;
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(var_node->attrs(), "shared_name", &shared_name));
+
+    // One sync node per reader, so that it can inherit the control
+    // dependencies of the reader without creating cycles
+    for (const auto& reader : value_readers) {
+      Node* dst = reader.first;
+      string sync_node_name = var_node->name() + "/sync_to_tf/" + dst->name();
+      Node* sync_node;
+      TF_RETURN_IF_ERROR(
+          NodeBuilder(sync_node_name, "NGraphVariableSyncTFTensor")
+              .Input(NodeBuilder::NodeOut(var_node, 0))
+              .Attr("ngraph_graph_id", graph_id)
+              .Attr("ngraph_variable_shared_name", shared_name)
+              .Attr("T", dtype)
+              .Device(var_node->assigned_device_name())
+              .Finalize(graph, &sync_node));
+      sync_node->set_assigned_device_name(var_node->assigned_device_name());
+
+      NGRAPH_VLOG(1) << "Adding " << sync_node_name << " before "
+                     << DebugNode(dst);
+
+      for (auto edge : reader.second) {
+        int dst_input = edge->dst_input();
+        graph->RemoveEdge(edge);
+        graph->AddEdge(sync_node, 0, dst, dst_input);
+      }
+
+      // The reader may wait for nGraph to update the variable, so should
+      // the sync
+      std::vector<Node*> control_inputs;
+      for (auto edge : dst->in_edges()) {
+        if (edge->IsControlEdge()) {
+          control_inputs.push_back(edge->src());
+        }
+      }
+      for (auto control_input : control_inputs) {
+        graph->AddEdge(control_input, Graph::kControlSlot, sync_node,
+                       Graph::kControlSlot);
+      }
+    }
+  }
+
   return Status::OK();
 }
 
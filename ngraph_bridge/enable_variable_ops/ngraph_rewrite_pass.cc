@@ -21,15 +21,20 @@
 
 #include "logging/ngraph_log.h"
 #include "logging/tf_graph_writer.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_batch_ngraphassigns.h"
 #include "ngraph_bridge/enable_variable_ops/ngraph_enter_in_catalog.h"
 #include "ngraph_bridge/enable_variable_ops/ngraph_remove_ngraphassigns.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_replace_save_ops.h"
 #include "ngraph_bridge/enable_variable_ops/ngraph_replace_variable_modifiers.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_var_arena.h"
 #include "ngraph_bridge/ngraph_api.h"
 #include "ngraph_bridge/ngraph_assign_clusters.h"
 #include "ngraph_bridge/ngraph_capture_variables.h"
 #include "ngraph_bridge/ngraph_cluster_manager.h"
+#include "ngraph_bridge/ngraph_clustering_cache.h"
 #include "ngraph_bridge/ngraph_deassign_clusters.h"
 #include "ngraph_bridge/ngraph_encapsulate_clusters.h"
+#include "ngraph_bridge/ngraph_enter_prefetch_in_catalog.h"
 #include "ngraph_bridge/ngraph_mark_for_clustering.h"
 #include "ngraph_bridge/ngraph_rewrite_for_tracking.h"
 #include "ngraph_bridge/ngraph_utils.h"
@@ -176,9 +181,15 @@ class NGraphVariableCapturePass : public NGraphRewritePass {
     }
 
     // Do variable capture then, if requested, dump the graphs.
+    // The input pipelines are prefetched on the device if the session asks
+    // for it
     std::set<string> skip_these_nodes = {};
-    TF_RETURN_IF_ERROR(
-        CaptureVariables(options.graph->get(), skip_these_nodes));
+    bool replace_prefetch =
+        options.session_options != nullptr
+            ? config::IsPrefetchEnabled(options.session_options->config)
+            : config::IsPrefetchEnabled();
+    TF_RETURN_IF_ERROR(CaptureVariables(options.graph->get(), skip_these_nodes,
+                                        replace_prefetch, idx));
 
     if (DumpCapturedGraphs()) {
       DumpGraphs(options, idx, "captured", "Graph With Variables Captured");
@@ -285,59 +296,96 @@ class NGraphEncapsulationPass : public NGraphRewritePass {
                  "Graph with Modifiers replaced");
     }
 
-    // 1. Mark for clustering then, if requested, dump the graphs.
+    // Steps 1. to 4. are skipped if the clustering of this graph is cached
     std::set<string> skip_these_nodes = {};
-    TF_RETURN_IF_ERROR(MarkForClustering(options.graph->get(), skip_these_nodes,
-                                         backend_name));
-    if (DumpMarkedGraphs()) {
-      DumpGraphs(options, idx, "marked", "Graph Marked for Clustering");
+    uint64 clustering_key = 0;
+    bool clustering_cached = false;
+    if (NGraphClusteringCache::IsEnabled()) {
+      clustering_key = NGraphClusteringCache::ComputeKey(
+          *options.graph->get(), backend_name, config_map, skip_these_nodes);
+      TF_RETURN_IF_ERROR(NGraphClusteringCache::Lookup(
+          clustering_key, idx, options.graph, &clustering_cached));
     }
 
-    // 2. Assign clusters then, if requested, dump the graphs.
-    TF_RETURN_IF_ERROR(AssignClusters(options.graph->get()));
-    if (DumpClusteredGraphs()) {
-      DumpGraphs(options, idx, "clustered", "Graph with Clusters Assigned");
-    }
+    if (!clustering_cached) {
+      // 1. Mark for clustering then, if requested, dump the graphs.
+      TF_RETURN_IF_ERROR(MarkForClustering(options.graph->get(),
+                                           skip_these_nodes, backend_name));
+      if (DumpMarkedGraphs()) {
+        DumpGraphs(options, idx, "marked", "Graph Marked for Clustering");
+      }
+
+      // 2. Assign clusters then, if requested, dump the graphs.
+      TF_RETURN_IF_ERROR(AssignClusters(options.graph->get()));
+      if (DumpClusteredGraphs()) {
+        DumpGraphs(options, idx, "clustered", "Graph with Clusters Assigned");
+      }
+
+      // 3. Deassign trivial clusters then, if requested, dump the graphs.
+      TF_RETURN_IF_ERROR(DeassignClusters(options.graph->get()));
+      if (DumpDeclusteredGraphs()) {
+        DumpGraphs(options, idx, "declustered",
+                   "Graph with Trivial Clusters De-Assigned");
+      }
+
+      // 4. Encapsulate clusters then, if requested, dump the graphs.
+      FunctionDefLibrary* fdeflib_new = new FunctionDefLibrary();
+      TF_RETURN_IF_ERROR(EncapsulateClusters(options.graph->get(), idx,
+                                             fdeflib_new, config_map, {0, {}}));
+      // TODO: not using fdeflib_new in this path. Only grappler path uses it
+      free(fdeflib_new);
+      if (DumpEncapsulatedGraphs()) {
+        DumpGraphs(options, idx, "encapsulated",
+                   "Graph with Clusters Encapsulated");
+      }
 
-    // 3. Deassign trivial clusters then, if requested, dump the graphs.
-    TF_RETURN_IF_ERROR(DeassignClusters(options.graph->get()));
-    if (DumpDeclusteredGraphs()) {
-      DumpGraphs(options, idx, "declustered",
-                 "Graph with Trivial Clusters De-Assigned");
+      if (NGraphClusteringCache::IsEnabled()) {
+        TF_RETURN_IF_ERROR(NGraphClusteringCache::Insert(
+            clustering_key, *options.graph->get()));
+      }
     }
 
-    // 4. Encapsulate clusters then, if requested, dump the graphs.
-    FunctionDefLibrary* fdeflib_new = new FunctionDefLibrary();
-    TF_RETURN_IF_ERROR(EncapsulateClusters(options.graph->get(), idx,
-                                           fdeflib_new, config_map, {0, {}}));
-    // TODO: not using fdeflib_new in this path. Only grappler path uses it
-    free(fdeflib_new);
-    if (DumpEncapsulatedGraphs()) {
-      DumpGraphs(options, idx, "encapsulated",
-                 "Graph with Clusters Encapsulated");
+    // 5. Save checkpoints straight from the NG Tensors, if requested.
+    if (std::getenv("NGRAPH_TF_STREAMING_CHECKPOINT") != nullptr) {
+      TF_RETURN_IF_ERROR(ReplaceSaveOps(options.graph->get()));
     }
 
-    // 5. Rewrite for tracking then, if requested, dump the graphs.
+    // 6. Rewrite for tracking then, if requested, dump the graphs.
     TF_RETURN_IF_ERROR(RewriteForTracking(options.graph->get(), idx));
     if (DumpTrackedGraphs()) {
       DumpGraphs(options, idx, "tracked",
                  "Graph with Variables Rewritten for Tracking");
     }
 
-    // 6. Enter in catalog then.
+    // 7. Enter in catalog then.
     TF_RETURN_IF_ERROR(EnterInCatalog(options.graph->get(), idx));
+    TF_RETURN_IF_ERROR(EnterPrefetchInCatalog(options.graph->get(), idx));
     if (DumpCatalogedGraphs()) {
       DumpGraphs(options, idx, "cataloged",
                  "Graph with Variables Inputs Entered in Catalog");
     }
 
-    // 7. Remove Certain NGraphAssigns then.
+    // 8. Remove Certain NGraphAssigns then.
     TF_RETURN_IF_ERROR(RemoveNGraphAssigns(options.graph->get()));
     if (DumpRemoveNGraphAssignsGraphs()) {
       DumpGraphs(options, idx, "ngraphassigns_optimized",
                  "Graph with NGraphAssigns Optimized/Removed");
     }
 
+    // 9. Plan the variable arenas, if requested.
+    if (NGraphVarArena::IsEnabled()) {
+      TF_RETURN_IF_ERROR(PlanVariableArenas(options.graph->get(), idx));
+    }
+
+    // 10. Batch the remaining NGraphAssigns, if requested.
+    if (std::getenv("NGRAPH_TF_BATCH_ASSIGNS") != nullptr) {
+      TF_RETURN_IF_ERROR(BatchNGraphAssigns(options.graph->get(), idx));
+      if (DumpBatchedNGraphAssignsGraphs()) {
+        DumpGraphs(options, idx, "ngraphassigns_batched",
+                   "Graph with NGraphAssigns Batched");
+      }
+    }
+
     return Status::OK();
   }
 
@@ -380,6 +428,11 @@ class NGraphEncapsulationPass : public NGraphRewritePass {
     return DumpAllGraphs() ||
            std::getenv("NGRAPH_TF_DUMP_REMOVENGASSIGNS_GRAPHS") != nullptr;
   }
+
+  static bool DumpBatchedNGraphAssignsGraphs() {
+    return DumpAllGraphs() ||
+           std::getenv("NGRAPH_TF_DUMP_BATCHEDNGASSIGNS_GRAPHS") != nullptr;
+  }
 };
 
 }  // namespace ngraph_bridge
@@ -0,0 +1,237 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/util/saved_tensor_slice_util.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+#include "ngraph/event_tracing.hpp"
+
+#include "ngraph_bridge/enable_variable_ops/ngraph_var.h"
+#include "ngraph_bridge/ngraph_utils.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+/* -------------------------------------------------
+//
+// NGraphSaveV2Op
+//
+---------------------------------------------------*/
+
+// Same as SaveV2, except that the entries with a non empty
+// variable_shared_names are read from the NG Tensors of these NGraphVars
+// instead of from an input. Each variable is snapshotted (copy-on-write) when
+// the op starts, then the checkpoint is written one variable at a time on a
+// background thread, so only one variable is staged on the host at a time.
+class NGraphSaveV2Op : public AsyncOpKernel {
+ private:
+  std::vector<string> variable_shared_names_;
+  // Snapshot epochs, unique in the process
+  static std::atomic<int64> s_epoch;
+
+ public:
+  explicit NGraphSaveV2Op(OpKernelConstruction* context)
+      : AsyncOpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("variable_shared_names",
+                                             &variable_shared_names_));
+    NGRAPH_VLOG(4) << "NGraphSaveV2:: Constructor called for: " << name()
+                   << ", number of entries " << variable_shared_names_.size();
+  }
+
+  void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
+    const Tensor& prefix = context->input(0);
+    const Tensor& tensor_names = context->input(1);
+    const Tensor& shape_and_slices = context->input(2);
+    const int num_entries = variable_shared_names_.size();
+    OP_REQUIRES_ASYNC(
+        context, prefix.NumElements() == 1,
+        errors::InvalidArgument("Input prefix should have a single element, "
+                                "got ",
+                                prefix.NumElements()),
+        done);
+    OP_REQUIRES_ASYNC(
+        context, tensor_names.NumElements() == num_entries &&
+                     shape_and_slices.NumElements() == num_entries,
+        errors::InvalidArgument("Expected ", num_entries,
+                                " tensor names and shape and slices, got ",
+                                tensor_names.NumElements(), " and ",
+                                shape_and_slices.NumElements()),
+        done);
+
+    // Look up the variables
+    const int64 epoch = s_epoch++;
+    std::vector<NGraphVar*> vars(num_entries, nullptr);
+    for (int i = 0; i < num_entries; i++) {
+      if (variable_shared_names_[i].empty()) {
+        continue;
+      }
+      Status status = context->resource_manager()->Lookup<NGraphVar>(
+          context->resource_manager()->default_container(),
+          variable_shared_names_[i], &vars[i]);
+      if (!status.ok()) {
+        vars[i] = nullptr;
+        for (auto var : vars) {
+          if (var != nullptr) {
+            var->Unref();
+          }
+        }
+        context->SetStatus(status);
+        done();
+        return;
+      }
+    }
+
+    // Start their snapshots, the value saved is the one they have now.
+    // begin_snapshot waits for the snapshot of an earlier save to be read, so
+    // they are started once per variable and in address order: concurrent
+    // saves of overlapping variables then cannot wait for each other
+    std::vector<NGraphVar*> snapshot_vars;
+    for (auto var : vars) {
+      if (var != nullptr) {
+        snapshot_vars.push_back(var);
+      }
+    }
+    std::sort(snapshot_vars.begin(), snapshot_vars.end());
+    snapshot_vars.erase(std::unique(snapshot_vars.begin(), snapshot_vars.end()),
+                        snapshot_vars.end());
+    for (auto var : snapshot_vars) {
+      var->begin_snapshot(epoch);
+    }
+
+    NGRAPH_VLOG(4) << "NGraphSaveV2:: " << name() << " started snapshot "
+                   << epoch;
+
+    // The input tensors are kept alive by the copies captured here
+    std::vector<Tensor> inputs;
+    for (int i = 3; i < context->num_inputs(); i++) {
+      inputs.push_back(context->input(i));
+    }
+    string prefix_string = prefix.scalar<string>()();
+    Tensor names = tensor_names;
+    Tensor slices = shape_and_slices;
+
+    auto write = [this, context, done, epoch, vars, inputs, prefix_string,
+                  names, slices]() {
+      ngraph::Event event_save("NGraphSaveV2 " + name(), name(), "");
+      Status status =
+          WriteCheckpoint(context->env(), epoch, vars, inputs, prefix_string,
+                          names, slices);
+      for (auto var : vars) {
+        if (var != nullptr) {
+          var->Unref();
+        }
+      }
+      event_save.Stop();
+      ngraph::Event::write_trace(event_save);
+      context->SetStatus(status);
+      done();
+    };
+    context->env()->SchedClosure(write);
+  }
+
+ private:
+  Status WriteCheckpoint(Env* env, int64 epoch,
+                         const std::vector<NGraphVar*>& vars,
+                         const std::vector<Tensor>& inputs,
+                         const string& prefix, const Tensor& tensor_names,
+                         const Tensor& shape_and_slices) {
+    const auto& names_flat = tensor_names.flat<string>();
+    const auto& slices_flat = shape_and_slices.flat<string>();
+
+    BundleWriter writer(env, prefix);
+    Status status = writer.status();
+    int input_index = 0;
+    // The snapshot of a variable saved more than once is read once, and kept
+    // until its last entry is written
+    std::map<NGraphVar*, int> entries_left;
+    for (auto var : vars) {
+      if (var != nullptr) {
+        entries_left[var]++;
+      }
+    }
+    std::map<NGraphVar*, Tensor> snapshots;
+    for (int i = 0; i < vars.size(); i++) {
+      Tensor value;
+      if (vars[i] != nullptr) {
+        auto itr = snapshots.find(vars[i]);
+        if (itr != snapshots.end()) {
+          value = itr->second;
+        } else {
+          // Always end the snapshot, even if the checkpoint already failed
+          Status read_status = vars[i]->read_snapshot(epoch, &value);
+          if (status.ok()) {
+            status = read_status;
+          }
+          snapshots[vars[i]] = value;
+        }
+        if (--entries_left[vars[i]] == 0) {
+          snapshots.erase(vars[i]);
+        }
+      } else {
+        value = inputs[input_index++];
+      }
+      if (!status.ok()) {
+        continue;
+      }
+
+      const string& tensor_name = names_flat(i);
+      const string& shape_spec = slices_flat(i);
+      if (shape_spec.empty()) {
+        status = writer.Add(tensor_name, value);
+      } else {
+        TensorShape shape;
+        TensorSlice slice(value.dims());
+        TensorShape slice_shape;
+        status = checkpoint::ParseShapeAndSlice(shape_spec, &shape, &slice,
+                                                &slice_shape);
+        if (status.ok() && !slice_shape.IsSameSize(value.shape())) {
+          status = errors::InvalidArgument(
+              "Slice in shape_and_slice specification does not match the "
+              "shape of the tensor to save: ",
+              shape_spec, ", tensor: ", value.shape().DebugString());
+        }
+        if (status.ok()) {
+          status = writer.AddSlice(tensor_name, shape, slice, value);
+        }
+      }
+      NGRAPH_VLOG(5) << "NGraphSaveV2:: wrote " << tensor_name;
+    }
+    if (status.ok()) {
+      status = writer.Finish();
+    }
+    return status;
+  }
+};
+
+std::atomic<int64> NGraphSaveV2Op::s_epoch{0};
+
+REGISTER_KERNEL_BUILDER(Name("NGraphSaveV2").Device(DEVICE_CPU),
+                        NGraphSaveV2Op);
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
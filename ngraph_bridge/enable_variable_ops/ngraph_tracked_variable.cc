@@ -24,6 +24,7 @@
 #include "ngraph/runtime/backend.hpp"
 
 #include "ngraph_bridge/enable_variable_ops/ngraph_var.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_var_arena.h"
 #include "ngraph_bridge/ngraph_backend_manager.h"
 #include "ngraph_bridge/ngraph_catalog.h"
 #include "ngraph_bridge/ngraph_freshness_tracker.h"
@@ -71,7 +72,10 @@ class NGraphVariableOp : public OpKernel {
   bool copy_to_tf_;
   DataType dtype_;
   string ng_backend_name_;
+  // Size of the NGraphVarArena the variable is placed in, 0 if none
+  int64 arena_size_;
   mutex init_mu_;
+  NGraphVarArena* arena_ GUARDED_BY(init_mu_){nullptr};
   ContainerInfo cinfo_ GUARDED_BY(init_mu_);
   bool initialized_ GUARDED_BY(init_mu_){false};
   static int s_instance_count;
@@ -87,7 +91,8 @@ NGraphVariableOp::NGraphVariableOp(OpKernelConstruction* context)
       tracker_(nullptr),
       just_looking_(false),
       copy_to_tf_(false),
-      dtype_(RemoveRefType(context->output_type(0))) {
+      dtype_(RemoveRefType(context->output_type(0))),
+      arena_size_(0) {
   my_instance_id = s_instance_count;
   s_instance_count++;
 
@@ -97,6 +102,10 @@ NGraphVariableOp::NGraphVariableOp(OpKernelConstruction* context)
   OP_REQUIRES_OK(context, context->GetAttr("ngraph_graph_id", &ng_graph_id_));
   OP_REQUIRES_OK(context,
                  context->GetAttr("_ngraph_backend", &ng_backend_name_));
+  if (HasNodeAttr(def(), "_ngraph_arena_size")) {
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("_ngraph_arena_size", &arena_size_));
+  }
   NGRAPH_VLOG(4) << "NGraphVariable:: Constructor called for: " << def().name()
                  << " ,just looking " << just_looking_ << " ,copy-to-tf "
                  << copy_to_tf_ << " ,Graph ID " << ng_graph_id_
@@ -108,6 +117,9 @@ NGraphVariableOp::~NGraphVariableOp() {
   string node_key = NGraphCatalog::CreateNodeKey(ng_graph_id_, name(), 0);
   NGraphCatalog::DeleteFromInputVariableSharedNameMap(node_key);
   tracker_->Unref();
+  if (arena_ != nullptr) {
+    arena_->Unref();
+  }
 }
 
 // (Changes: Renamed from VariableOp, modified to pass TensorShape to NGraphVar
@@ -159,9 +171,22 @@ void NGraphVariableOp::Compute(OpKernelContext* ctx) {
     initialized_ = true;
   }
 
+  // The first variable of the graph allocates the whole arena
+  if (arena_size_ > 0 && arena_ == nullptr) {
+    auto arena_creator = [this](NGraphVarArena** arena) {
+      *arena = new NGraphVarArena(arena_size_);
+      return Status::OK();
+    };
+    OP_REQUIRES_OK(
+        ctx, cinfo_.resource_manager()->LookupOrCreate<NGraphVarArena>(
+                 cinfo_.container(),
+                 NGraphVarArena::ResourceName(ng_graph_id_, ng_backend_name_),
+                 &arena_, arena_creator));
+  }
+
   auto creator = [this](NGraphVar** var) {
     NGRAPH_VLOG(4) << "Create NGraphVar Tensors for " << name() << endl;
-    *var = new NGraphVar(dtype_, shape_, ng_backend_name_);
+    *var = new NGraphVar(dtype_, shape_, ng_backend_name_, arena_);
     return Status::OK();
   };
 
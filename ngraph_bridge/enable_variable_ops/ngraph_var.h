@@ -16,6 +16,10 @@
 #ifndef NGRAPH_TF_NGRAPHVAR_H_
 #define NGRAPH_TF_NGRAPHVAR_H_
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -40,8 +44,13 @@ namespace ngraph_bridge {
 // THIS CLASS IS NOT BEING USED ANYWHERE
 class NGraphVar : public ResourceBase {
  public:
-  explicit NGraphVar(DataType dtype, TensorShape shape, string BackendName)
-      : tf_tensor_(dtype, shape), ng_backend_name_(BackendName) {
+  // If "allocator" is given the TF Tensor is allocated from it, e.g. from
+  // the NGraphVarArena of the graph
+  explicit NGraphVar(DataType dtype, TensorShape shape, string BackendName,
+                     Allocator* allocator = nullptr)
+      : tf_tensor_(allocator == nullptr ? Tensor(dtype, shape)
+                                        : Tensor(allocator, dtype, shape)),
+        ng_backend_name_(BackendName) {
     // TF datatype to nGraph element type
     ng::element::Type ng_element_type;
     TFDataTypeToNGraphElementType(dtype, &ng_element_type);
@@ -100,17 +109,30 @@ class NGraphVar : public ResourceBase {
   mutex* mu() { return &mu_; }
   Tensor* tensor() { return &tf_tensor_; }
   shared_ptr<ngraph::runtime::Tensor> ng_tensor() { return ng_tensor_; };
+  const string& backend_name() const { return ng_backend_name_; }
 
   string DebugString() const override {
     return strings::StrCat(DataTypeString(tf_tensor_.dtype()), "/",
                            tf_tensor_.shape().DebugString());
   }
 
-  // Copies the NG Tensor to TF Tensor for this variable
+  // Marks the NG Tensor as newer than the TF Tensor, e.g. after an
+  // NGraphEncapsulateOp wrote the variable. The TF Tensor is only refreshed
+  // when it is read, see copy_ng_to_tf()
+  void mark_ng_tensor_dirty() {
+    if (!ng_tf_share_buffer_) {
+      ng_tensor_dirty_ = true;
+    }
+  }
+
+  bool is_ng_tensor_dirty() { return ng_tensor_dirty_; }
+
+  // Copies the NG Tensor to TF Tensor for this variable, if the NG Tensor
+  // was written since the last copy
   // Involves a copy from device to host
   // Returns the number of tensor copies made (0 or 1)
   int copy_ng_to_tf() {
-    if (ng_tf_share_buffer_) {
+    if (ng_tf_share_buffer_ || !ng_tensor_dirty_.exchange(false)) {
       return 0;
     }
     ReadNGTensor(ng_tensor_, &tf_tensor_);
@@ -121,10 +143,14 @@ class NGraphVar : public ResourceBase {
   // Involves a copy from host to device
   // Returns the number of tensor copies made (0 or 1)
   int copy_tf_to_ng() {
+    tf_shared_lock l(write_mu_);
+    prepare_for_write();
     if (ng_tf_share_buffer_) {
       return 0;
     }
     WriteNGTensor(ng_tensor_, &tf_tensor_);
+    // The TF Tensor was modified by TF, it is now the latest value
+    ng_tensor_dirty_ = false;
     return 1;
   }
 
@@ -134,7 +160,10 @@ class NGraphVar : public ResourceBase {
   // and saved in Catalog
   // Returns the number of tensor copies made (0 or 1)
   int update_ng_tensor(shared_ptr<ngraph::runtime::Tensor> new_value) {
+    tf_shared_lock l(write_mu_);
+    prepare_for_write();
     ng_tensor_->copy_from(*new_value);
+    mark_ng_tensor_dirty();
     return 0;
   }
 
@@ -142,20 +171,111 @@ class NGraphVar : public ResourceBase {
   // This new_value could be from tf-tensor, for e.g. when computed from a TF op
   // Returns the number of tensor copies made (0 or 1)
   int update_ng_tensor(Tensor* new_value) {
+    tf_shared_lock l(write_mu_);
+    prepare_for_write();
+    return write_ng_tensor(new_value);
+  }
+
+  // Same as update_ng_tensor(Tensor*), for a variable already held in
+  // begin_write(), e.g. by an NGraphVarWriteLock
+  int write_ng_tensor(Tensor* new_value) SHARED_LOCKS_REQUIRED(write_mu_) {
     WriteNGTensor(ng_tensor_, new_value);
     if (ng_tf_share_buffer_) {
       return 0;
     }
-
+    mark_ng_tensor_dirty();
     return 1;
   }
 
+  // The NG Tensor aliases the TF Tensor, writing one writes the other
+  bool shares_buffer() const { return ng_tf_share_buffer_; }
+
+  // Must be called before nGraph overwrites the NG Tensor, e.g. by an
+  // executable that outputs into it, and held until the write is done. No
+  // snapshot starts in between, see NGraphVarWriteLock
+  void begin_write() SHARED_LOCK_FUNCTION(write_mu_) {
+    write_mu_.lock_shared();
+    prepare_for_write();
+  }
+
+  void end_write() UNLOCK_FUNCTION(write_mu_) { write_mu_.unlock_shared(); }
+
+  // Copy-on-write snapshots, used to stream checkpoints from the NG Tensor
+  // while training goes on.
+  // Starts a snapshot of the current value for "epoch", once no write is in
+  // progress. Waits for the previous snapshot to be read first
+  void begin_snapshot(int64 epoch) {
+    while (true) {
+      {
+        mutex_lock l(snapshot_mu_);
+        while (snapshot_epoch_ >= 0) {
+          snapshot_cv_.wait(l);
+        }
+      }
+      mutex_lock w(write_mu_);
+      mutex_lock l(snapshot_mu_);
+      // Another snapshot may have started while we were not holding the lock
+      if (snapshot_epoch_ < 0) {
+        snapshot_epoch_ = epoch;
+        snapshot_pending_ = true;
+        return;
+      }
+    }
+  }
+
+  // Returns the value of the variable when the snapshot for "epoch" was
+  // started in the host tensor "value", and ends the snapshot. Reads the NG
+  // Tensor if it was not written since
+  Status read_snapshot(int64 epoch, Tensor* value) {
+    mutex_lock w(write_mu_);
+    mutex_lock l(snapshot_mu_);
+    if (snapshot_epoch_ != epoch) {
+      return errors::Internal("No snapshot ", epoch, " of variable, found ",
+                              snapshot_epoch_);
+    }
+    if (snapshot_pending_) {
+      *value = Tensor(tf_tensor_.dtype(), tf_tensor_.shape());
+      ReadNGTensor(ng_tensor_, value);
+      snapshot_pending_ = false;
+    } else {
+      *value = snapshot_;
+      snapshot_ = Tensor();
+    }
+    snapshot_epoch_ = -1;
+    snapshot_cv_.notify_all();
+    return Status::OK();
+  }
+
  private:
+  // Saves the value of a pending snapshot before the NG Tensor is
+  // overwritten. Called with write_mu_ held shared, so the snapshot cannot
+  // start or end meanwhile
+  void prepare_for_write() {
+    mutex_lock l(snapshot_mu_);
+    if (snapshot_pending_) {
+      snapshot_ = Tensor(tf_tensor_.dtype(), tf_tensor_.shape());
+      ReadNGTensor(ng_tensor_, &snapshot_);
+      snapshot_pending_ = false;
+    }
+  }
+
   mutex mu_;
   Tensor tf_tensor_;
   shared_ptr<ngraph::runtime::Tensor> ng_tensor_;
   string ng_backend_name_;
   bool ng_tf_share_buffer_;
+  // The NG Tensor holds a value the TF Tensor does not have yet
+  std::atomic<bool> ng_tensor_dirty_{false};
+  // Held shared while the NG Tensor is written, and exclusively while a
+  // snapshot starts or reads the NG Tensor
+  mutex write_mu_;
+  // Copy-on-write snapshot state
+  mutex snapshot_mu_;
+  condition_variable snapshot_cv_;
+  int64 snapshot_epoch_ GUARDED_BY(snapshot_mu_){-1};
+  // The snapshot was started and the NG Tensor not written since
+  bool snapshot_pending_ GUARDED_BY(snapshot_mu_){false};
+  Tensor snapshot_ GUARDED_BY(snapshot_mu_);
   ~NGraphVar() override {
     // Release the backend
     NGRAPH_VLOG(2) << "~NGraphVar::ReleaseBackend";
@@ -163,6 +283,33 @@ class NGraphVar : public ResourceBase {
   }
 };
 
+// Holds the variables written by nGraph in begin_write() for its lifetime,
+// e.g. for the whole call of an executable that outputs into them. Each
+// variable is locked once, even if the executable writes it more than once
+class NGraphVarWriteLock {
+ public:
+  NGraphVarWriteLock() {}
+  ~NGraphVarWriteLock() {
+    for (auto var : vars_) {
+      var->end_write();
+    }
+  }
+  // Not copyable or movable.
+  NGraphVarWriteLock(const NGraphVarWriteLock&) = delete;
+  NGraphVarWriteLock& operator=(const NGraphVarWriteLock&) = delete;
+
+  void Add(NGraphVar* var) {
+    if (std::find(vars_.begin(), vars_.end(), var) != vars_.end()) {
+      return;
+    }
+    var->begin_write();
+    vars_.push_back(var);
+  }
+
+ private:
+  std::vector<NGraphVar*> vars_;
+};
+
 }  // namespace ng-bridge
 }  // namespace tf
 
@@ -0,0 +1,154 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mem.h"
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_var_arena.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+static size_t RoundUp(size_t bytes, size_t alignment) {
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+NGraphVarArena::NGraphVarArena(size_t capacity)
+    : base_(nullptr), capacity_(capacity), used_(0) {
+  if (capacity_ > 0) {
+    base_ = static_cast<char*>(
+        port::AlignedMalloc(capacity_, Allocator::kAllocatorAlignment));
+    if (base_ == nullptr) {
+      NGRAPH_VLOG(1) << "NGraphVarArena: could not allocate " << capacity_
+                     << " bytes, falling back to separate allocations";
+      capacity_ = 0;
+    }
+  }
+  NGRAPH_VLOG(4) << "NGraphVarArena: allocated " << capacity_ << " bytes";
+}
+
+NGraphVarArena::~NGraphVarArena() {
+  NGRAPH_VLOG(4) << "~NGraphVarArena: releasing " << capacity_ << " bytes";
+  if (base_ != nullptr) {
+    port::AlignedFree(base_);
+  }
+}
+
+void* NGraphVarArena::AllocateRaw(size_t alignment, size_t num_bytes) {
+  alignment = std::max<size_t>(alignment, Allocator::kAllocatorAlignment);
+  void* ptr = nullptr;
+  {
+    mutex_lock l(mu_);
+    size_t offset = RoundUp(used_, alignment);
+    if (base_ != nullptr && offset + num_bytes <= capacity_) {
+      ptr = base_ + offset;
+      used_ = offset + num_bytes;
+    }
+  }
+  if (ptr == nullptr) {
+    NGRAPH_VLOG(4) << "NGraphVarArena: " << num_bytes
+                   << " bytes do not fit, using the CPU allocator";
+    ptr = cpu_allocator()->AllocateRaw(alignment, num_bytes);
+  }
+  // Released in DeallocateRaw
+  Ref();
+  return ptr;
+}
+
+void NGraphVarArena::DeallocateRaw(void* ptr) {
+  // Arena memory is only given back when the arena goes away
+  if (!Contains(ptr)) {
+    cpu_allocator()->DeallocateRaw(ptr);
+  }
+  Unref();
+}
+
+size_t NGraphVarArena::size() {
+  mutex_lock l(mu_);
+  return used_;
+}
+
+bool NGraphVarArena::Contains(const void* ptr) const {
+  const char* p = static_cast<const char*>(ptr);
+  return base_ != nullptr && p >= base_ && p < base_ + capacity_;
+}
+
+string NGraphVarArena::DebugString() const {
+  return strings::StrCat("NGraphVarArena of ", capacity_, " bytes");
+}
+
+string NGraphVarArena::ResourceName(int graph_id, const string& backend_name) {
+  return strings::StrCat("ngraph_var_arena_", graph_id, "_", backend_name);
+}
+
+size_t NGraphVarArena::AlignedSize(DataType dtype, const TensorShape& shape) {
+  return RoundUp(shape.num_elements() * DataTypeSize(dtype),
+                 Allocator::kAllocatorAlignment);
+}
+
+bool NGraphVarArena::IsEnabled() {
+  return std::getenv("NGRAPH_TF_VAR_ARENA") != nullptr;
+}
+
+Status PlanVariableArenas(Graph* graph, int graph_id) {
+  // Per backend, the NGraphVariables placed in the arena and its size
+  std::map<string, vector<Node*>> arena_nodes;
+  std::map<string, int64> arena_sizes;
+  for (auto node : graph->op_nodes()) {
+    if (node->type_string() != "NGraphVariable") {
+      continue;
+    }
+    PartialTensorShape partial_shape;
+    DataType dtype;
+    string backend_name;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "shape", &partial_shape));
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "dtype", &dtype));
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node->attrs(), "_ngraph_backend", &backend_name));
+
+    TensorShape shape;
+    if (!partial_shape.AsTensorShape(&shape) || !DataTypeCanUseMemcpy(dtype)) {
+      NGRAPH_VLOG(4) << "Not placing " << node->name() << " in the arena";
+      continue;
+    }
+    arena_nodes[backend_name].push_back(node);
+    arena_sizes[backend_name] += NGraphVarArena::AlignedSize(dtype, shape);
+  }
+
+  for (auto& kv : arena_nodes) {
+    int64 arena_size = arena_sizes[kv.first];
+    NGRAPH_VLOG(2) << "Variable arena for graph " << graph_id << " backend "
+                   << kv.first << ": " << kv.second.size() << " variables, "
+                   << arena_size << " bytes";
+    for (auto node : kv.second) {
+      node->AddAttr("_ngraph_arena_size", arena_size);
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#ifndef NGRAPH_TF_NGRAPH_VAR_ARENA_H_
+#define NGRAPH_TF_NGRAPH_VAR_ARENA_H_
+#pragma once
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/platform/mutex.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// A contiguous, aligned block of host memory holding the TF tensors of all
+// the NGraphVars of one graph and backend, allocated in one go the first time
+// one of these variables is created. With buffer sharing the NG tensors
+// alias the TF tensors, so the weights live in the arena on both sides.
+//
+// Variables are carved out of the block in creation order. Allocations that
+// do not fit fall back to the CPU allocator. Every tensor allocated from the
+// arena holds a reference on it, so the block outlives the last of them.
+class NGraphVarArena : public ResourceBase, public Allocator {
+ public:
+  explicit NGraphVarArena(size_t capacity);
+  // Not copyable or movable.
+  NGraphVarArena(const NGraphVarArena&) = delete;
+  NGraphVarArena& operator=(const NGraphVarArena&) = delete;
+
+  string Name() override { return "ngraph_var_arena"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void DeallocateRaw(void* ptr) override;
+
+  string DebugString() const override;
+
+  // Start of the block, the used bytes are [data(), data() + size())
+  const char* data() const { return base_; }
+  size_t size();
+  size_t capacity() const { return capacity_; }
+  bool Contains(const void* ptr) const;
+
+  // Name of the arena of (graph_id, backend) in the resource manager
+  static string ResourceName(int graph_id, const string& backend_name);
+  // Bytes a tensor of "dtype" and "shape" takes in the arena
+  static size_t AlignedSize(DataType dtype, const TensorShape& shape);
+  // NGRAPH_TF_VAR_ARENA
+  static bool IsEnabled();
+
+ private:
+  ~NGraphVarArena() override;
+
+  char* base_;
+  size_t capacity_;
+  mutex mu_;
+  size_t used_ GUARDED_BY(mu_);
+};
+
+// Sizes the arena of every backend used by the NGraphVariables of the graph,
+// and records it in their "_ngraph_arena_size" attribute. NGraphVariables
+// without a fully defined shape are left out and allocated separately.
+Status PlanVariableArenas(Graph* graph, int graph_id);
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_NGRAPH_VAR_ARENA_H_
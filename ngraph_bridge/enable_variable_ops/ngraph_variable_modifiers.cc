@@ -102,6 +102,38 @@ class NGraphApplyGradientDescentOp : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("NGraphApplyGradientDescent").Device(DEVICE_CPU),
                         NGraphApplyGradientDescentOp);
 
+/* -------------------------------------------------
+//
+// NGraphApplyAdamOp
+//
+---------------------------------------------------*/
+
+class NGraphApplyAdamOp : public OpKernel {
+ private:
+ public:
+  explicit NGraphApplyAdamOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES(context, false,
+                errors::Internal("This constructor should not get called",
+                                 name(), "\n"));
+  }
+
+  //---------------------------------------------------------------------------
+  //  ~NGraphApplyAdamOp()
+  //---------------------------------------------------------------------------
+  ~NGraphApplyAdamOp() override {}
+
+  // This will never be called
+  void Compute(OpKernelContext* context) override {
+    OP_REQUIRES(
+        context, false,
+        errors::Internal("This kernel should not get called", name(), "\n"));
+  }  // end of compute function
+};   // end of NGraphApplyAdam class definition
+
+REGISTER_KERNEL_BUILDER(Name("NGraphApplyAdam").Device(DEVICE_CPU),
+                        NGraphApplyAdamOp);
+
 /* -------------------------------------------------
 //
 // NGraphAssignSubOp
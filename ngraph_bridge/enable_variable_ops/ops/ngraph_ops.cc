@@ -47,6 +47,26 @@ REGISTER_OP("NGraphApplyMomentum")
     .Attr("just_looking: bool = false")
     .Attr("copy_to_tf: bool = false")
     .Attr("ngraph_graph_id: int");
+
+// ------------------------------------------------------------------
+REGISTER_OP("NGraphApplyAdam")
+    .Input("var: Ref(T)")
+    .Input("m: Ref(T)")
+    .Input("v: Ref(T)")
+    .Input("beta1_power: T")
+    .Input("beta2_power: T")
+    .Input("lr: T")
+    .Input("beta1: T")
+    .Input("beta2: T")
+    .Input("epsilon: T")
+    .Input("grad: T")
+    .Output("out: Ref(T)")
+    .Attr("T: numbertype")
+    .Attr("use_locking: bool = false")
+    .Attr("use_nesterov: bool = false")
+    .Attr("just_looking: bool = false")
+    .Attr("copy_to_tf: bool = false")
+    .Attr("ngraph_graph_id: int");
 // ------------------------------------------------------------------
 REGISTER_OP("NGraphAssign")
     .Input("ref: Ref(T)")
@@ -59,6 +79,18 @@ REGISTER_OP("NGraphAssign")
     .Attr("copy_to_tf: bool = false")
     .Attr("ngraph_graph_id: int");
 
+// ------------------------------------------------------------------
+// Computes *refs[i] = values[i] for all i, created by the
+// BatchNGraphAssigns pass from NGraphAssigns with the same device and type
+REGISTER_OP("NGraphBatchedAssign")
+    .Input("refs: N * Ref(T)")
+    .Input("values: N * T")
+    .Output("output_refs: N * Ref(T)")
+    .Attr("N: int >= 1")
+    .Attr("T: type")
+    .Attr("copy_to_tf: list(bool)")
+    .Attr("ngraph_graph_id: int");
+
 // ------------------------------------------------------------------
 REGISTER_OP("NGraphAssignAdd")
     .Input("ref: Ref(T)")
@@ -109,6 +141,19 @@ REGISTER_OP("NGraphVariable")
     .SetIsStateful()
     .SetShapeFn(shape_inference::ExplicitShape);
 
+// ------------------------------------------------------------------
+// SaveV2 that reads the entries with a variable shared name from the
+// NG Tensors of these variables, "tensors" holds the other entries
+REGISTER_OP("NGraphSaveV2")
+    .Input("prefix: string")
+    .Input("tensor_names: string")
+    .Input("shape_and_slices: string")
+    .Input("tensors: dtypes")
+    .Attr("dtypes: list(type) >= 0")
+    .Attr("variable_shared_names: list(string)")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::NoOutputs);
+
 // ------------------------------------------------------------------
 REGISTER_OP("NGraphVariableUpdateNGTensor")
     .Input("var: Ref(T)")
@@ -120,6 +165,17 @@ REGISTER_OP("NGraphVariableUpdateNGTensor")
         "nGraph variable update NG tensor op. For updating the NG Tensor when "
         "TF tensor is modified by a TF variable modifier op");
 
+// ------------------------------------------------------------------
+REGISTER_OP("NGraphVariableSyncTFTensor")
+    .Input("var: Ref(T)")
+    .Output("out: Ref(T)")
+    .Attr("T: type")
+    .Attr("ngraph_graph_id: int")
+    .Attr("ngraph_variable_shared_name: string = ''")
+    .Doc(
+        "nGraph variable sync TF tensor op. For updating the TF Tensor, if the "
+        "NG Tensor was modified by nGraph, before a TF op reads the variable");
+
 // // ------------------------------------------------------------------
 // // The NGraphPrefetchDataset below is defined exactly the same as
 // // TesorFlow PrefetchDataset but the implementation is changed in the sense
@@ -133,6 +189,8 @@ REGISTER_OP("NGraphPrefetchDataset")
     .Attr("output_types: list(type) >= 1")
     .Attr("output_shapes: list(shape) >= 1")
     .Attr("slack_period: int = 0")
+    .Attr("iterator_name: string = ''")
+    .Attr("graph_id: int = 0")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
       shape_inference::ShapeHandle unused;
       // buffer_size should be a scalar.
@@ -140,5 +198,26 @@ REGISTER_OP("NGraphPrefetchDataset")
       return shape_inference::ScalarShape(c);
     });
 
+// Fuses an in-memory CacheDataset and the RepeatDataset after it, so that
+// the NGraphPrefetchDataset reading from it can keep the elements on the
+// device for the later epochs
+REGISTER_OP("NGraphCacheDataset")
+    .Input("input_dataset: variant")
+    .Input("count: int64")
+    .Output("handle: variant")
+    .Attr("output_types: list(type) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .Attr("max_bytes: int = 0")
+    .Attr("shuffle: bool = false")
+    .Attr("seed: int = 0")
+    .Attr("iterator_name: string = ''")
+    .Attr("graph_id: int = 0")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // count should be a scalar.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      return shape_inference::ScalarShape(c);
+    });
+
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
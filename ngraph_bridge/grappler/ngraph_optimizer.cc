@@ -28,6 +28,7 @@
 #include "ngraph_bridge/grappler/ngraph_optimizer.h"
 #include "ngraph_bridge/ngraph_backend_manager.h"
 #include "ngraph_bridge/ngraph_cluster_manager.h"
+#include "ngraph_bridge/ngraph_clustering_cache.h"
 
 #if defined NGRAPH_DISTRIBUTED
 #include "ngraph/distributed.hpp"
@@ -53,10 +54,15 @@ Status NgraphOptimizer::Init(
   config_backend_name = params.at("ngraph_backend").s();
   config_device_id = params.at("device_id").s();
   NGRAPH_VLOG(3) << "Backend name from config: " << config_backend_name;
+  auto use_prefetch = params.find("use_prefetch");
+  config_use_prefetch = use_prefetch != params.end()
+                            ? use_prefetch->second.s() == "1"
+                            : config::IsPrefetchEnabled();
+  NGRAPH_VLOG(3) << "Use prefetch from config: " << config_use_prefetch;
   std::set<ShapeHintMap> shape_hints;
   // typedef std::map<std::string, std::vector<int>> ShapeHintMap;
   for (auto i : params) {
-    if (i.first != "ngraph_backend") {
+    if (i.first != "ngraph_backend" && i.first != "use_prefetch") {
       // TODO: slightly hacky. The bridge reserves the right to use optional
       // attributes whose names start with shape_hint
       if (i.first.rfind("shape_hint", 0) != 0) {
@@ -190,7 +196,8 @@ Status NgraphOptimizer::Optimize(tensorflow::grappler::Cluster* cluster,
   //
 
   // Do variable capture then, if requested, dump the graphs.
-  TF_RETURN_IF_ERROR(CaptureVariables(&graph, skip_these_nodes));
+  TF_RETURN_IF_ERROR(
+      CaptureVariables(&graph, skip_these_nodes, config_use_prefetch, idx));
   if (DumpCapturedGraphs()) {
     DumpGraphs(graph, idx, "captured", "Graph With Variables Captured");
   }
@@ -238,44 +245,80 @@ Status NgraphOptimizer::Optimize(tensorflow::grappler::Cluster* cluster,
 
   NGRAPH_VLOG(0) << "NGraph using backend: " << backend_creation_string;
 
-  // 1. Mark for clustering then, if requested, dump the graphs.
-  TF_RETURN_IF_ERROR(
-      MarkForClustering(&graph, skip_these_nodes, backend_creation_string));
-  if (DumpMarkedGraphs()) {
-    DumpGraphs(graph, idx, "marked", "Graph Marked for Clustering");
+  // Steps 1. to 4. are skipped if the clustering of this graph is cached.
+  // The graphs compiled ahead of time are not cached
+  bool use_clustering_cache =
+      NGraphClusteringCache::IsEnabled() && !aot_info.first;
+  uint64 clustering_key = 0;
+  bool clustering_cached = false;
+  GraphDef cached_graph_def;
+  FunctionDefLibrary* fdeflib_new = new FunctionDefLibrary();
+  if (use_clustering_cache) {
+    clustering_key = NGraphClusteringCache::ComputeKey(
+        graph, backend_creation_string, config_map, skip_these_nodes);
+    clustering_cached = NGraphClusteringCache::Lookup(
+        clustering_key, idx, &cached_graph_def, fdeflib_new);
   }
 
-  // 2. Assign clusters then, if requested, dump the graphs.
-  TF_RETURN_IF_ERROR(AssignClusters(&graph));
-  if (DumpClusteredGraphs()) {
-    DumpGraphs(graph, idx, "clustered", "Graph with Clusters Assigned");
-  }
+  // The rest of the passes run on the cached graph instead, on a hit
+  Graph cached_graph(OpRegistry::Global());
+  Graph* encapsulated_graph = &graph;
+  if (clustering_cached) {
+    *cached_graph_def.mutable_library() = item.graph.library();
+    TF_RETURN_IF_ERROR(
+        ConvertGraphDefToGraph(opts, cached_graph_def, &cached_graph));
+    encapsulated_graph = &cached_graph;
+  } else {
+    // 1. Mark for clustering then, if requested, dump the graphs.
+    TF_RETURN_IF_ERROR(
+        MarkForClustering(&graph, skip_these_nodes, backend_creation_string));
+    if (DumpMarkedGraphs()) {
+      DumpGraphs(graph, idx, "marked", "Graph Marked for Clustering");
+    }
 
-  // 3. Deassign trivial clusters then, if requested, dump the graphs.
-  TF_RETURN_IF_ERROR(DeassignClusters(&graph));
-  if (DumpDeclusteredGraphs()) {
-    DumpGraphs(graph, idx, "declustered",
-               "Graph with Trivial Clusters De-Assigned");
-  }
+    // 2. Assign clusters then, if requested, dump the graphs.
+    TF_RETURN_IF_ERROR(AssignClusters(&graph));
+    if (DumpClusteredGraphs()) {
+      DumpGraphs(graph, idx, "clustered", "Graph with Clusters Assigned");
+    }
 
-  // 4. Encapsulate clusters then, if requested, dump the graphs.
-  FunctionDefLibrary* fdeflib_new = new FunctionDefLibrary();
-  TF_RETURN_IF_ERROR(
-      // TODO: right now _ngraph_aot_requested is passed along in config_map.
-      EncapsulateClusters(&graph, idx, fdeflib_new, config_map, aot_info));
-  if (DumpEncapsulatedGraphs()) {
-    DumpGraphs(graph, idx, "encapsulated", "Graph with Clusters Encapsulated");
+    // 3. Deassign trivial clusters then, if requested, dump the graphs.
+    TF_RETURN_IF_ERROR(DeassignClusters(&graph));
+    if (DumpDeclusteredGraphs()) {
+      DumpGraphs(graph, idx, "declustered",
+                 "Graph with Trivial Clusters De-Assigned");
+    }
+
+    // 4. Encapsulate clusters then, if requested, dump the graphs.
+    TF_RETURN_IF_ERROR(
+        // TODO: right now _ngraph_aot_requested is passed along in config_map.
+        EncapsulateClusters(&graph, idx, fdeflib_new, config_map, aot_info));
+    if (DumpEncapsulatedGraphs()) {
+      DumpGraphs(graph, idx, "encapsulated",
+                 "Graph with Clusters Encapsulated");
+    }
+
+    if (use_clustering_cache) {
+      GraphDef encapsulated_graph_def;
+      graph.ToGraphDef(&encapsulated_graph_def);
+      encapsulated_graph_def.clear_library();
+      TF_RETURN_IF_ERROR(NGraphClusteringCache::Insert(
+          clustering_key, encapsulated_graph_def, fdeflib_new));
+    }
   }
 
   // Rewrite for tracking then, if requested, dump the graphs.
-  TF_RETURN_IF_ERROR(RewriteForTracking(&graph, idx));
+  TF_RETURN_IF_ERROR(RewriteForTracking(encapsulated_graph, idx));
   if (DumpTrackedGraphs()) {
-    DumpGraphs(graph, idx, "tracked",
+    DumpGraphs(*encapsulated_graph, idx, "tracked",
                "Graph with Variables Rewritten for Tracking");
   }
 
+  // Enter the inputs fed by the prefetched iterators in the catalog
+  TF_RETURN_IF_ERROR(EnterPrefetchInCatalog(encapsulated_graph, idx));
+
   // Convert the graph back to Graphdef
-  graph.ToGraphDef(output);
+  encapsulated_graph->ToGraphDef(output);
   // According to the doc, the message takes ownership of the allocated object
   // https://developers.google.com/protocol-buffers/docs/reference/cpp-generated#proto3_string
   // Hence no need to free fdeflib_new
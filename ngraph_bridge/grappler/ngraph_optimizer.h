@@ -33,6 +33,7 @@
 #include "ngraph_bridge/ngraph_capture_variables.h"
 #include "ngraph_bridge/ngraph_deassign_clusters.h"
 #include "ngraph_bridge/ngraph_encapsulate_clusters.h"
+#include "ngraph_bridge/ngraph_enter_prefetch_in_catalog.h"
 #include "ngraph_bridge/ngraph_mark_for_clustering.h"
 #include "ngraph_bridge/ngraph_rewrite_for_tracking.h"
 #include "ngraph_bridge/ngraph_utils.h"
@@ -75,6 +76,9 @@ class NgraphOptimizer : public tensorflow::grappler::CustomGraphOptimizer {
   std::string config_backend_name;
   std::string config_device_id;
   std::unordered_map<std::string, std::string> config_map;
+  // Replace the PrefetchDatasets with NGraphPrefetchDatasets, from the
+  // optional use_prefetch attribute
+  bool config_use_prefetch = false;
   std::vector<string> compulsory_attrs = {"ngraph_backend", "device_id"};
 
   void DumpGraphs(Graph&, int, std::string, std::string);
@@ -15,6 +15,7 @@
  *******************************************************************************/
 
 #include "ngraph_bridge/ngraph_api.h"
+#include "ngraph_bridge/ngraph_cache_budget.h"
 
 namespace ng = ngraph;
 
@@ -25,6 +26,8 @@ namespace config {
 static bool _is_enabled = true;
 static bool _is_logging_placement = false;
 static std::set<std::string> disabled_op_types{};
+static bool _is_prefetch_enabled =
+    std::getenv("NGRAPH_TF_USE_PREFETCH") != nullptr;
 
 extern "C" {
 void ngraph_enable() { Enable(); }
@@ -72,6 +75,16 @@ extern void ngraph_set_disabled_ops(const char* op_type_list) {
 extern const char* ngraph_get_disabled_ops() {
   return ng::join(GetDisabledOps(), ",").c_str();
 }
+
+extern const char* ngraph_get_executable_cache_stats() {
+  static string cache_stats;
+  cache_stats = GetExecutableCacheStats();
+  return cache_stats.c_str();
+}
+
+void ngraph_enable_prefetch() { EnablePrefetch(); }
+void ngraph_disable_prefetch() { DisablePrefetch(); }
+bool ngraph_is_prefetch_enabled() { return IsPrefetchEnabled(); }
 }
 
 // note that TensorFlow always uses camel case for the C++ API, but not for
@@ -119,6 +132,26 @@ void SetDisabledOps(set<string> disabled_ops_set) {
   disabled_op_types = disabled_ops_set;
 }
 
+string GetExecutableCacheStats() { return NGraphCacheBudget::StatsToString(); }
+
+void EnablePrefetch() { _is_prefetch_enabled = true; }
+void DisablePrefetch() { _is_prefetch_enabled = false; }
+bool IsPrefetchEnabled() { return _is_prefetch_enabled; }
+
+bool IsPrefetchEnabled(const ConfigProto& session_config) {
+  for (const auto& optimizer :
+       session_config.graph_options().rewrite_options().custom_optimizers()) {
+    if (optimizer.name() != "ngraph-optimizer") {
+      continue;
+    }
+    auto itr = optimizer.parameter_map().find("use_prefetch");
+    if (itr != optimizer.parameter_map().end()) {
+      return itr->second.s() == "1";
+    }
+  }
+  return IsPrefetchEnabled();
+}
+
 }  // namespace config
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
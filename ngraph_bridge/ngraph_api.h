@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 
 #include "ngraph_bridge/ngraph_backend_manager.h"
 
@@ -47,6 +48,12 @@ extern bool ngraph_is_logging_placement();
 
 extern void ngraph_set_disabled_ops(const char* op_type_list);
 extern const char* ngraph_get_disabled_ops();
+
+extern const char* ngraph_get_executable_cache_stats();
+
+extern void ngraph_enable_prefetch();
+extern void ngraph_disable_prefetch();
+extern bool ngraph_is_prefetch_enabled();
 }
 
 extern void Enable();
@@ -67,6 +74,20 @@ extern bool IsLoggingPlacement();
 extern std::set<string> GetDisabledOps();
 extern void SetDisabledOps(std::set<string>);
 extern void SetDisabledOps(string);
+
+// Executable cache budget, per cluster hit/miss ratios and the recent cache
+// resize decisions
+extern string GetExecutableCacheStats();
+
+// Replacing the PrefetchDataset of the input pipelines with the
+// NGraphPrefetchDataset, which stages the elements in the device tensors of
+// the NGraphEncapsulates. Off by default unless NGRAPH_TF_USE_PREFETCH is set
+extern void EnablePrefetch();
+extern void DisablePrefetch();
+extern bool IsPrefetchEnabled();
+// A session overrides the process wide setting by passing "use_prefetch"
+// ("0" or "1") to the ngraph-optimizer in its RewriterConfig
+extern bool IsPrefetchEnabled(const ConfigProto& session_config);
 }  // namespace config
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
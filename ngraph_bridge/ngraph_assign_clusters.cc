@@ -14,13 +14,21 @@
  * limitations under the License.
  *******************************************************************************/
 #include <algorithm>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <queue>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/attr_value_util.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/platform/default/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -29,6 +37,7 @@
 #include "logging/ngraph_log.h"
 #include "ngraph_bridge/ngraph_api.h"
 #include "ngraph_bridge/ngraph_assign_clusters.h"
+#include "ngraph_bridge/ngraph_cluster_cost_model.h"
 #include "ngraph_bridge/ngraph_cluster_manager.h"
 #include "ngraph_bridge/ngraph_mark_for_clustering.h"
 #include "ngraph_bridge/ngraph_utils.h"
@@ -75,6 +84,11 @@ namespace ngraph_bridge {
 //       cluster (More on static inputs in ngraph_mark_for_clustering)
 //   (2) If N1 and N2 have mismatching deadness predicates, they are not
 //       placed in the same cluster (More on deadness in tf_deadness_analysis)
+//   (3) If NGRAPH_TF_MAX_CLUSTER_SIZE is set, no cluster gets more nodes than
+//       that. If NGRAPH_TF_MAX_CLUSTER_FLOPS is set, the clusters whose
+//       estimated flops are over it are split after contraction (see
+//       SplitOversizedClusters). Smaller clusters compile faster, and in
+//       parallel, and can run concurrently with each other and the host ops
 //
 // Given the above constraints, we try to find the "biggest" clusters we can.
 //
@@ -91,14 +105,34 @@ namespace ngraph_bridge {
 namespace {
 struct Cluster {
   int index;
-  std::set<tensorflow::Node*> nodes;
+  std::vector<tensorflow::Node*> nodes;
   std::string backend;
 #if !defined(NGRAPH_TF_DISABLE_DEADNESS_CHECK)
   std::string predicate_string;
-  std::set<const Edge*> outgoing_edges;
+  // Outgoing edges of the nodes in the cluster. Edges that became internal to
+  // the cluster by contraction are dropped lazily
+  std::vector<const Edge*> outgoing_edges;
 #endif
+  // Edges incident to the cluster that could not be contracted so far, but
+  // may become contractible once this cluster changes
+  std::vector<const Edge*> deferred_edges;
 };
 
+// Maps a node id to the cluster the node currently belongs to. The clusters
+// themselves are owned by a vector indexed by their GraphCycles node id
+using ClusterMap = std::vector<Cluster*>;
+
+// Moves the elements of "from" to the end of "to". The longer of the two
+// vectors is the one kept, so that repeated merges stay cheap
+template <typename T>
+void MoveAppend(std::vector<T>* to, std::vector<T>* from) {
+  if (to->size() < from->size()) {
+    to->swap(*from);
+  }
+  to->insert(to->end(), from->begin(), from->end());
+  from->clear();
+}
+
 Status InitialiseNodeBackend(Node* node, string* backend) {
   NGRAPH_VLOG(5) << "Initialize Node Backend " << node->name();
   if (!HasNodeAttr(node->def(), "_ngraph_backend")) {
@@ -111,14 +145,14 @@ Status InitialiseNodeBackend(Node* node, string* backend) {
   return Status::OK();
 }
 
-Status CanContractEdgeBackendCheck(
-    Edge* edge, const std::map<Node*, std::shared_ptr<Cluster>>& cluster_map,
-    bool& is_backend_ok) {
+Status CanContractEdgeBackendCheck(const Edge* edge,
+                                   const ClusterMap& cluster_map,
+                                   bool& is_backend_ok) {
   Node* src = edge->src();
   Node* dst = edge->dst();
 
-  string src_backend = cluster_map.at(src)->backend;
-  string dst_backend = cluster_map.at(dst)->backend;
+  const string& src_backend = cluster_map[src->id()]->backend;
+  const string& dst_backend = cluster_map[dst->id()]->backend;
 
   if (src_backend == dst_backend) {
     is_backend_ok = true;
@@ -141,14 +175,17 @@ inline string GetMergedClusterPred(const string& src_predicate,
 
 // Checks whether it's ok to contract the edge as far as deadness is concerned
 // Source and Dst Predicates of the edge should match
+// If the edge cannot be contracted because of the other outputs of the src
+// cluster, the clusters at the other ends of those outputs are added to
+// "blocking_clusters" (when not null)
 Status CanContractEdgeDeadnessCheck(
-    Edge* edge, const std::map<Node*, std::shared_ptr<Cluster>>& cluster_map,
-    bool& is_deadness_ok) {
+    const Edge* edge, const ClusterMap& cluster_map, bool& is_deadness_ok,
+    std::vector<Cluster*>* blocking_clusters = nullptr) {
   Node* src = edge->src();
   Node* dst = edge->dst();
 
-  string src_predicate = cluster_map.at(src)->predicate_string;
-  string dst_predicate = cluster_map.at(dst)->predicate_string;
+  const string& src_predicate = cluster_map[src->id()]->predicate_string;
+  const string& dst_predicate = cluster_map[dst->id()]->predicate_string;
 
   // If the node marked for clustering has CONTROL_FLOW_PRED_STRING, it
   // breaks our assumption that all supported ops are data flow ops
@@ -182,27 +219,40 @@ Status CanContractEdgeDeadnessCheck(
   // when, all outputs of the src cluster (other than the current edge) have the
   // predicate Y
   if (DeadnessAnalysis::IsTruePredString(src_predicate)) {
-    auto src_cluster_out_edges = cluster_map.at(src)->outgoing_edges;
-    bool found_same_out_preds = true;
-    std::string pred_check = dst_predicate;
+    // Note that if dst predicate is True, then it does not matter what the
+    // predicates of the other outputs are; After merge the merged cluster will
+    // always have a less strict predicate, True (since True is the least
+    // strict predicate)
+    if (DeadnessAnalysis::IsTruePredString(dst_predicate)) {
+      is_deadness_ok = true;
+      return Status::OK();
+    }
 
+    Cluster* src_cluster = cluster_map[src->id()];
+    auto& src_cluster_out_edges = src_cluster->outgoing_edges;
+    bool found_same_out_preds = true;
+    // Edges internal to the src cluster are not outputs of the merged
+    // cluster, drop them while scanning. Any other output, including one to a
+    // True cluster, would become dead along with Y
+    size_t num_kept = 0;
     for (const Edge* src_cluster_edge : src_cluster_out_edges) {
+      Cluster* src_cluster_dst = cluster_map[src_cluster_edge->dst()->id()];
+      if (src_cluster_dst == src_cluster) {
+        continue;
+      }
+      src_cluster_out_edges[num_kept++] = src_cluster_edge;
       if (src_cluster_edge == edge) {
         continue;
       }
-      Node* src_cluster_dst = src_cluster_edge->dst();
-      std::string src_cluster_dst_pred =
-          cluster_map.at(src_cluster_dst)->predicate_string;
-      // Note that if dst predicate is True, then it does not matter what the
-      // src_cluster_dst_pred is; After merge the merged cluster will always
-      // have a less strict predicate, True (since True is the least strict
-      // predicate)
-      if (!DeadnessAnalysis::IsTruePredString(pred_check) &&
-          pred_check != src_cluster_dst_pred) {
+      if (src_cluster_dst->predicate_string != dst_predicate) {
         found_same_out_preds = false;
-        break;
+        if (blocking_clusters != nullptr) {
+          blocking_clusters->push_back(src_cluster_dst);
+        }
       }
     }
+    src_cluster_out_edges.resize(num_kept);
+
     // Cannot contract this edge
     if (!found_same_out_preds) {
       is_deadness_ok = false;
@@ -220,14 +270,13 @@ Status CanContractEdgeDeadnessCheck(
 
 // Some sanity checks for Node's cluster assignment wrt Deadness
 Status CheckNodeClusterAssignmentWRTDeadness(
-    Node* node, const std::map<Node*, string>& nodes_predicate_map,
-    const std::map<Node*, std::shared_ptr<Cluster>>& cluster_map) {
-  auto itr = nodes_predicate_map.find(node);
-  if (itr == nodes_predicate_map.end()) {
+    Node* node, const std::vector<string>& nodes_predicate_map,
+    const ClusterMap& cluster_map) {
+  const std::string& node_pred_string = nodes_predicate_map[node->id()];
+  if (node_pred_string.empty()) {
     return errors::Internal("Node ", node->name(), " [", node->type_string(),
                             "]", " not found in predicate map");
   }
-  std::string node_pred_string = itr->second;
 
   if (DeadnessAnalysis::IsControlFlowPredString(node_pred_string)) {
     return errors::Internal(
@@ -235,8 +284,9 @@ Status CheckNodeClusterAssignmentWRTDeadness(
         " should not be clustered as it is a control flow op");
   }
 
-  std::string cluster_pred_string = cluster_map.at(node)->predicate_string;
-  int node_cluster_index = cluster_map.at(node)->index;
+  const std::string& cluster_pred_string =
+      cluster_map[node->id()]->predicate_string;
+  int node_cluster_index = cluster_map[node->id()]->index;
 
   // If the node has Non-True Pred (P1) it can only be placed in a cluster with
   // the same pred
@@ -255,8 +305,9 @@ Status CheckNodeClusterAssignmentWRTDeadness(
       !DeadnessAnalysis::IsTruePredString(cluster_pred_string)) {
     for (auto e : node->out_edges()) {
       Node* e_dst = e->dst();
-      if (cluster_map.at(e_dst)->index != node_cluster_index) {
-        string e_dst_cluster_pred = cluster_map.at(e_dst)->predicate_string;
+      if (cluster_map[e_dst->id()]->index != node_cluster_index) {
+        const string& e_dst_cluster_pred =
+            cluster_map[e_dst->id()]->predicate_string;
         if (e_dst_cluster_pred != cluster_pred_string) {
           return errors::Internal(
               "Node ", node->name(), " [", node->type_string(), "]",
@@ -278,12 +329,12 @@ Status CheckNodeClusterAssignmentWRTDeadness(
 // This function does not do any checks for merging, but rather implements the
 // merge, i.e. updates the properties of the merged cluster
 // WARNING : Use this function when ready to merge
-void MergeClusters(Edge* edge,
-                   std::map<Node*, std::shared_ptr<Cluster>>& cluster_map) {
+void MergeClusters(const Edge* edge, ClusterMap& cluster_map,
+                   std::vector<std::unique_ptr<Cluster>>& clusters) {
   Node* src = edge->src();
   Node* dst = edge->dst();
-  int src_index = cluster_map[src]->index;
-  int dst_index = cluster_map[dst]->index;
+  int src_index = cluster_map[src->id()]->index;
+  int dst_index = cluster_map[dst->id()]->index;
 
   // Merge dst cluster into src cluster
   NGRAPH_VLOG(5) << "Contracting: " << src->name() << "[" << src->type_string()
@@ -291,29 +342,197 @@ void MergeClusters(Edge* edge,
                  << dst->name() << "[" << dst->type_string() << " , "
                  << edge->dst_input() << "]@" << dst_index;
 
+  std::unique_ptr<Cluster> merged = std::move(clusters[src_index]);
+  std::unique_ptr<Cluster> absorbed = std::move(clusters[dst_index]);
+
 #if !defined(NGRAPH_TF_DISABLE_DEADNESS_CHECK)
-  string src_predicate = cluster_map[src]->predicate_string;
-  string dst_predicate = cluster_map[dst]->predicate_string;
+  const string& src_predicate = merged->predicate_string;
+  const string& dst_predicate = absorbed->predicate_string;
   NGRAPH_VLOG(5) << "Src pred: " << src_predicate
                  << ", Dst pred: " << dst_predicate;
 
   std::string cluster_pred = GetMergedClusterPred(src_predicate, dst_predicate);
+#endif
 
-  cluster_map[src]->predicate_string = cluster_pred;
+  // The merged cluster keeps the index of the src cluster (that is what
+  // GraphCycles::ContractEdge does), but the nodes of the smaller cluster are
+  // the ones that get moved, so that merging a long chain stays linear
+  if (merged->nodes.size() < absorbed->nodes.size()) {
+    std::swap(merged, absorbed);
+    merged->index = src_index;
+  }
+
+#if !defined(NGRAPH_TF_DISABLE_DEADNESS_CHECK)
+  merged->predicate_string = cluster_pred;
   // Update outgoing edges of the merged cluster
-  cluster_map[src]->outgoing_edges.insert(
-      cluster_map[dst]->outgoing_edges.begin(),
-      cluster_map[dst]->outgoing_edges.end());
-  cluster_map[src]->outgoing_edges.erase(edge);
+  MoveAppend(&merged->outgoing_edges, &absorbed->outgoing_edges);
 #endif
+  MoveAppend(&merged->deferred_edges, &absorbed->deferred_edges);
 
-  auto cluster_dst = cluster_map[dst];
-  // using cluster_map[dst]->nodes in the loop directly appears to
-  // invalidate the iterator when `node` == `dst`
-  // this happens with clang but not gcc
-  for (auto node : cluster_dst->nodes) {
-    cluster_map[src]->nodes.insert(node);
-    cluster_map[node] = cluster_map[src];
+  for (auto node : absorbed->nodes) {
+    merged->nodes.push_back(node);
+    cluster_map[node->id()] = merged.get();
+  }
+  clusters[src_index] = std::move(merged);
+}
+
+// Reads a cluster size limit from the environment, 0 means unlimited
+int64 GetClusterLimitFromEnv(const char* env_name) {
+  const char* value = std::getenv(env_name);
+  if (value == nullptr) {
+    return 0;
+  }
+  return std::max<int64>(0, atoll(value));
+}
+
+// Splits the clusters whose estimated flops exceed "max_flops". The nodes of
+// such a cluster are laid out in topological order and cut into consecutive
+// pieces of at most "max_flops" each (a single node over the limit is a piece
+// of its own). Among all such cuttings, the one with the least boundary cost
+// (as per the ClusterCostModel) of the tensors crossing the cuts is picked.
+//
+// The pieces of a cluster cannot form a cycle with each other or through the
+// rest of the graph, since the edges between pieces all go forward in the
+// topological order and no path leaves the cluster and comes back. Clusters
+// with a non-True predicate are not split, to keep the deadness checks
+// simple.
+void SplitOversizedClusters(const Graph& graph, int64 max_flops,
+                            GraphCycles& gc, ClusterMap& cluster_map,
+                            std::vector<std::unique_ptr<Cluster>>& clusters) {
+  OutputShapes shapes;
+  ClusterCostModel::InferOutputShapes(graph, &shapes);
+  std::shared_ptr<const ClusterCostModel> cost_model =
+      ClusterCostModel::GetModel();
+
+  std::vector<int> topo_position(graph.num_node_ids(), -1);
+  std::vector<Node*> order;
+  GetReversePostOrder(graph, &order);
+  for (size_t i = 0; i < order.size(); i++) {
+    topo_position[order[i]->id()] = i;
+  }
+  // Position of a node within the cluster being split, -1 for the others
+  std::vector<int> local_index(graph.num_node_ids(), -1);
+
+  size_t num_clusters = clusters.size();
+  for (size_t c = 0; c < num_clusters; c++) {
+    Cluster* cluster = clusters[c].get();
+    if (cluster == nullptr || cluster->nodes.size() < 2) {
+      continue;
+    }
+#if !defined(NGRAPH_TF_DISABLE_DEADNESS_CHECK)
+    if (!DeadnessAnalysis::IsTruePredString(cluster->predicate_string)) {
+      continue;
+    }
+#endif
+
+    std::vector<Node*> nodes = cluster->nodes;
+    std::sort(nodes.begin(), nodes.end(),
+              [&topo_position](const Node* a, const Node* b) {
+                return topo_position[a->id()] < topo_position[b->id()];
+              });
+    int n = nodes.size();
+    std::vector<int64> node_flops(n, 0);
+    int64 total_flops = 0;
+    for (int i = 0; i < n; i++) {
+      int64 bytes;
+      cost_model->EstimateNode(nodes[i], shapes, &node_flops[i], &bytes);
+      total_flops += node_flops[i];
+      local_index[nodes[i]->id()] = i;
+    }
+
+    if (total_flops > max_flops) {
+      // traffic[k] is the number of bytes crossing the cut in front of node k
+      // (edges with unknown shapes count as a byte)
+      std::vector<int64> traffic(n + 1, 0);
+      for (int i = 0; i < n; i++) {
+        for (auto edge : nodes[i]->out_edges()) {
+          int j = local_index[edge->dst()->id()];
+          if (edge->IsControlEdge() || j < 0) {
+            continue;
+          }
+          int64 bytes = ClusterCostModel::OutputBytes(
+              nodes[i], edge->src_output(), shapes);
+          bytes = std::max<int64>(bytes, 1);
+          traffic[i + 1] += bytes;
+          traffic[j + 1] -= bytes;
+        }
+      }
+      for (int k = 1; k <= n; k++) {
+        traffic[k] += traffic[k - 1];
+      }
+
+      // best[j] is the least cost of cutting the first j nodes into pieces,
+      // where the last piece starts at node parent[j]. The candidates for
+      // parent[j] form a sliding window, whose minimum is kept in a deque
+      std::vector<double> best(n + 1, 0);
+      std::vector<int> parent(n + 1, 0);
+      auto cost_of_cut_before = [&](int i) {
+        return i == 0 ? best[0]
+                      : best[i] + cost_model->BoundaryCost(traffic[i], 1);
+      };
+      std::deque<int> window;
+      int window_start = 0;
+      int64 window_flops = 0;
+      for (int j = 1; j <= n; j++) {
+        int candidate = j - 1;
+        while (!window.empty() && cost_of_cut_before(window.back()) >=
+                                      cost_of_cut_before(candidate)) {
+          window.pop_back();
+        }
+        window.push_back(candidate);
+        window_flops += node_flops[j - 1];
+        while (window_flops > max_flops && window_start < j - 1) {
+          window_flops -= node_flops[window_start];
+          window_start++;
+        }
+        while (window.front() < window_start) {
+          window.pop_front();
+        }
+        parent[j] = window.front();
+        best[j] = cost_of_cut_before(parent[j]);
+      }
+
+      // The first piece stays in the cluster, the others get new clusters
+      std::vector<int> piece_starts;
+      for (int j = n; j > 0; j = parent[j]) {
+        piece_starts.push_back(parent[j]);
+      }
+      std::reverse(piece_starts.begin(), piece_starts.end());
+      piece_starts.push_back(n);
+
+      NGRAPH_VLOG(2) << "Splitting cluster " << cluster->index << " ("
+                     << total_flops << " flops) into "
+                     << piece_starts.size() - 1 << " clusters";
+      if (config::IsLoggingPlacement()) {
+        std::cout << "NGTF_SUMMARY: Split cluster " << cluster->index << " ("
+                  << total_flops << " estimated flops) into "
+                  << piece_starts.size() - 1 << " clusters" << std::endl;
+      }
+
+      cluster->nodes.assign(nodes.begin(), nodes.begin() + piece_starts[1]);
+      for (size_t p = 1; p + 1 < piece_starts.size(); p++) {
+        int new_index = gc.NewNode();
+        if (clusters.size() <= static_cast<size_t>(new_index)) {
+          clusters.resize(new_index + 1);
+        }
+        clusters[new_index].reset(new Cluster());
+        Cluster* piece = clusters[new_index].get();
+        piece->index = new_index;
+        piece->backend = cluster->backend;
+#if !defined(NGRAPH_TF_DISABLE_DEADNESS_CHECK)
+        piece->predicate_string = cluster->predicate_string;
+#endif
+        piece->nodes.assign(nodes.begin() + piece_starts[p],
+                            nodes.begin() + piece_starts[p + 1]);
+        for (auto node : piece->nodes) {
+          cluster_map[node->id()] = piece;
+        }
+      }
+    }
+
+    for (auto node : nodes) {
+      local_index[node->id()] = -1;
+    }
   }
 }
 
@@ -323,13 +542,16 @@ void MergeClusters(Edge* edge,
 // Adds an attribute "_ngraph_cluster" (cluster_id) to each Node that can be
 // encapsulated
 Status AssignClusters(Graph* graph) {
-  std::map<Node*, std::shared_ptr<Cluster>> cluster_map;
+  // Dense map from node id to cluster, and the owned clusters indexed by their
+  // GraphCycles node id (merged away clusters are null)
+  ClusterMap cluster_map(graph->num_node_ids(), nullptr);
+  std::vector<std::unique_ptr<Cluster>> clusters;
 
 #if !defined(NGRAPH_TF_DISABLE_DEADNESS_CHECK)
   std::unique_ptr<DeadnessAnalysis> deadness_analyzer;
   TF_RETURN_IF_ERROR(DeadnessAnalysis::Run(*graph, &deadness_analyzer));
-  // This map is used only for error checking
-  std::map<Node*, std::string> nodes_predicate_map;
+  // This map (indexed by node id) is used only for error checking
+  std::vector<std::string> nodes_predicate_map(graph->num_node_ids());
 #endif
 
   GraphCycles gc;
@@ -337,13 +559,18 @@ Status AssignClusters(Graph* graph) {
   // Initial Step: Each node is a cluster of its own
   for (auto node : graph->nodes()) {
     int new_index = gc.NewNode();
-    cluster_map[node] = std::make_shared<Cluster>();
-    cluster_map[node]->index = new_index;
+    if (clusters.size() <= static_cast<size_t>(new_index)) {
+      clusters.resize(new_index + 1);
+    }
+    clusters[new_index].reset(new Cluster());
+    Cluster* cluster = clusters[new_index].get();
+    cluster_map[node->id()] = cluster;
+    cluster->index = new_index;
     string backend;
     TF_RETURN_IF_ERROR(InitialiseNodeBackend(node, &backend));
 
-    cluster_map[node]->backend = backend;
-    cluster_map[node]->nodes.insert(node);
+    cluster->backend = backend;
+    cluster->nodes.push_back(node);
     NGRAPH_VLOG(5) << "Creating graphcycle Node: " << new_index << " for "
                    << node->name() << "[" << node->type_string() << "]"
                    << " backend " << backend;
@@ -352,11 +579,11 @@ Status AssignClusters(Graph* graph) {
     // get predicate string for the node
     string pred_string;
     TF_RETURN_IF_ERROR(deadness_analyzer->GetNodePredicate(*node, pred_string));
-    nodes_predicate_map[node] = pred_string;
-    cluster_map[node]->predicate_string = pred_string;
+    nodes_predicate_map[node->id()] = pred_string;
+    cluster->predicate_string = pred_string;
 
-    cluster_map[node]->outgoing_edges = std::set<const Edge*>(
-        node->out_edges().begin(), node->out_edges().end());
+    cluster->outgoing_edges.assign(node->out_edges().begin(),
+                                   node->out_edges().end());
     NGRAPH_VLOG(5) << node->name() << "[" << node->type_string() << "]"
                    << "  : Predicate " << pred_string;
 #endif
@@ -377,7 +604,8 @@ Status AssignClusters(Graph* graph) {
       continue;
     }
 
-    if (!gc.InsertEdge(cluster_map[src]->index, cluster_map[dst]->index)) {
+    if (!gc.InsertEdge(cluster_map[src->id()]->index,
+                       cluster_map[dst->id()]->index)) {
       NGRAPH_VLOG(5) << "Failing due to cycle";
       return errors::Unimplemented(
           "Input graph has a cycle (inserting an edge from ",
@@ -423,9 +651,9 @@ Status AssignClusters(Graph* graph) {
         if (static_edge->src()->type_string() != "Const") {
           int shadow_node_index = gc.NewNode();
           bool gc_success = gc.InsertEdge(
-              cluster_map[static_edge->src()]->index, shadow_node_index);
-          gc_success &= gc.InsertEdge(shadow_node_index,
-                                      cluster_map[static_edge->dst()]->index);
+              cluster_map[static_edge->src()->id()]->index, shadow_node_index);
+          gc_success &= gc.InsertEdge(
+              shadow_node_index, cluster_map[static_edge->dst()->id()]->index);
           if (!gc_success)
             return errors::Internal(
                 "Unable to create shadow edges in GraphCycles");
@@ -435,10 +663,10 @@ Status AssignClusters(Graph* graph) {
   }
 
   NGRAPH_VLOG(2) << "Starting contraction";
-  bool changed;
+  int64 max_cluster_size = GetClusterLimitFromEnv("NGRAPH_TF_MAX_CLUSTER_SIZE");
   bool collect_non_contracting_edge_info = false;  // Must init with false
 
-  // 7 exhaustive reasons why edges might non contract
+  // 8 exhaustive reasons why edges might non contract
   // The reasons are not mutually exclusive, but there is an order of priority
   // that makes them mutually exclusive
   enum EdgeNonContractionReasons {
@@ -448,11 +676,12 @@ Status AssignClusters(Graph* graph) {
     BACKEND,      // different backends
     SAMECLUSTER,  // both ends lie in the same cluster
     STATICINPUT,  // static input in dst (not fed by const)
+    CLUSTERSIZE,  // merged cluster would exceed NGRAPH_TF_MAX_CLUSTER_SIZE
     PATHEXISTS    // base case reason. contraction causes cycles
   };
   static std::vector<string> reason_string(  // to convert the enum to string
       {"NOTANOP", "UNSUPPORTED", "DEADNESS", "BACKEND", "SAMECLUSTER",
-       "STATICINPUT", "PATHEXISTS"});
+       "STATICINPUT", "CLUSTERSIZE", "PATHEXISTS"});
   // a cluster pair is the string "cluster1_id, cluster2_id"
   // Using string, because a pair won't hash unless implemented
   // Note that we store a vector of "reasons", because there could be multiple
@@ -468,153 +697,272 @@ Status AssignClusters(Graph* graph) {
   std::unordered_map<std::string, tuple<string, string, vector<string>>>
       deadness_info;
 
-  do {
-    changed = false;
-
-    auto log_reason = [](EdgeNonContractionReasons reason, Edge* edge) {
-      NGRAPH_VLOG(0) << "NONCONTRACTION: " << reason_string[reason] << ": "
-                     << edge->src()->name() << "<" << edge->src()->type_string()
-                     << ">"
-                     << "[" << edge->src_output() << "] -> "
-                     << edge->dst()->name() << "<" << edge->dst()->type_string()
-                     << ">"
-                     << "[" << edge->dst_input() << "]";
-    };
+  auto log_reason = [](EdgeNonContractionReasons reason, const Edge* edge) {
+    NGRAPH_VLOG(0) << "NONCONTRACTION: " << reason_string[reason] << ": "
+                   << edge->src()->name() << "<" << edge->src()->type_string()
+                   << ">"
+                   << "[" << edge->src_output() << "] -> "
+                   << edge->dst()->name() << "<" << edge->dst()->type_string()
+                   << ">"
+                   << "[" << edge->dst_input() << "]";
+  };
 
-    for (auto edge : graph->edges()) {
-      Node* src = edge->src();
-      Node* dst = edge->dst();
+  // Attempts to contract one edge. "contracted" is set if the clusters at the
+  // two ends were merged. If the edge was not contracted for a reason that may
+  // go away later (deadness, or a longer path between the clusters), the
+  // clusters whose merging can lift that reason are returned in "park_on":
+  // the two ends, plus for deadness the neighbours of the src cluster whose
+  // predicate blocked the edge. An empty "park_on" means the reason is
+  // permanent.
+  auto try_contract_edge = [&](const Edge* edge, bool* contracted,
+                               std::vector<Cluster*>* park_on) -> Status {
+    *contracted = false;
+    park_on->clear();
 
-      int src_index = cluster_map[src]->index;
-      int dst_index = cluster_map[dst]->index;
+    Node* src = edge->src();
+    Node* dst = edge->dst();
 
-      if (!src->IsOp() || !dst->IsOp()) {
-        if (collect_non_contracting_edge_info) {
-          log_reason(EdgeNonContractionReasons::NOTANOP, edge);
-          cluster_separation_reason[get_string_key(src_index, dst_index)]
-              .push_back(EdgeNonContractionReasons::NOTANOP);
-        }
-        continue;
+    int src_index = cluster_map[src->id()]->index;
+    int dst_index = cluster_map[dst->id()]->index;
+
+    if (!src->IsOp() || !dst->IsOp()) {
+      if (collect_non_contracting_edge_info) {
+        log_reason(EdgeNonContractionReasons::NOTANOP, edge);
+        cluster_separation_reason[get_string_key(src_index, dst_index)]
+            .push_back(EdgeNonContractionReasons::NOTANOP);
       }
+      return Status::OK();
+    }
 
-      if (!NodeIsMarkedForClustering(src) || !NodeIsMarkedForClustering(dst)) {
-        NGRAPH_VLOG(5) << "Skipping (not marked): " << src->name() << "["
-                       << edge->src_output() << "]@" << src_index << " -> "
-                       << dst->name() << "[" << edge->dst_input() << "]@"
-                       << dst_index;
-        if (collect_non_contracting_edge_info) {
-          log_reason(EdgeNonContractionReasons::UNSUPPORTED, edge);
-          cluster_separation_reason[get_string_key(src_index, dst_index)]
-              .push_back(EdgeNonContractionReasons::UNSUPPORTED);
-        }
-        continue;
+    if (!NodeIsMarkedForClustering(src) || !NodeIsMarkedForClustering(dst)) {
+      NGRAPH_VLOG(5) << "Skipping (not marked): " << src->name() << "["
+                     << edge->src_output() << "]@" << src_index << " -> "
+                     << dst->name() << "[" << edge->dst_input() << "]@"
+                     << dst_index;
+      if (collect_non_contracting_edge_info) {
+        log_reason(EdgeNonContractionReasons::UNSUPPORTED, edge);
+        cluster_separation_reason[get_string_key(src_index, dst_index)]
+            .push_back(EdgeNonContractionReasons::UNSUPPORTED);
       }
+      return Status::OK();
+    }
 
 #if !defined(NGRAPH_TF_DISABLE_DEADNESS_CHECK)
-      // check if the edge can be contracted with respect to deadness
-      bool is_deadness_ok = false;
-      TF_RETURN_IF_ERROR(
-          CanContractEdgeDeadnessCheck(edge, cluster_map, is_deadness_ok));
-      if (!is_deadness_ok) {
-        // do not contract, src and dst node cannot be in the same cluster
-        NGRAPH_VLOG(5) << "Skipping (deadness not ok): " << src->name() << "["
-                       << edge->src_output() << "]@" << src_index << " -> "
-                       << dst->name() << "[" << edge->dst_input() << "]@"
-                       << dst_index;
-        if (collect_non_contracting_edge_info) {
-          log_reason(EdgeNonContractionReasons::DEADNESS, edge);
-          cluster_separation_reason[get_string_key(src_index, dst_index)]
-              .push_back(EdgeNonContractionReasons::DEADNESS);
-
-          auto src_cluster = cluster_map[src];
-          auto dst_cluster = cluster_map[dst];
-          vector<string> neighbours_predicate;
-          // Collect predicates of src's neighbours (except dst)
-          for (const Edge* src_cluster_edge : src_cluster->outgoing_edges) {
-            if (src_cluster_edge != edge) {
-              neighbours_predicate.push_back(
-                  cluster_map[src_cluster_edge->dst()]->predicate_string);
-            }
+    // check if the edge can be contracted with respect to deadness
+    bool is_deadness_ok = false;
+    TF_RETURN_IF_ERROR(CanContractEdgeDeadnessCheck(edge, cluster_map,
+                                                    is_deadness_ok, park_on));
+    if (!is_deadness_ok) {
+      // do not contract, src and dst node cannot be in the same cluster
+      NGRAPH_VLOG(5) << "Skipping (deadness not ok): " << src->name() << "["
+                     << edge->src_output() << "]@" << src_index << " -> "
+                     << dst->name() << "[" << edge->dst_input() << "]@"
+                     << dst_index;
+      park_on->push_back(cluster_map[src->id()]);
+      park_on->push_back(cluster_map[dst->id()]);
+      if (collect_non_contracting_edge_info) {
+        log_reason(EdgeNonContractionReasons::DEADNESS, edge);
+        cluster_separation_reason[get_string_key(src_index, dst_index)]
+            .push_back(EdgeNonContractionReasons::DEADNESS);
+
+        Cluster* src_cluster = cluster_map[src->id()];
+        Cluster* dst_cluster = cluster_map[dst->id()];
+        vector<string> neighbours_predicate;
+        // Collect predicates of src's neighbours (except dst)
+        for (const Edge* src_cluster_edge : src_cluster->outgoing_edges) {
+          if (src_cluster_edge != edge) {
+            neighbours_predicate.push_back(
+                cluster_map[src_cluster_edge->dst()->id()]->predicate_string);
           }
-          deadness_info[get_string_key(src_index, dst_index)] = make_tuple(
-              cluster_map.at(src)->predicate_string,
-              cluster_map.at(dst)->predicate_string, neighbours_predicate);
         }
-        continue;
+        deadness_info[get_string_key(src_index, dst_index)] =
+            make_tuple(src_cluster->predicate_string,
+                       dst_cluster->predicate_string, neighbours_predicate);
       }
+      return Status::OK();
+    }
 #endif
 
-      // check if the edge can be constracted with respect to backend
-      bool is_backend_ok = false;
-      TF_RETURN_IF_ERROR(
-          CanContractEdgeBackendCheck(edge, cluster_map, is_backend_ok));
-      if (!is_backend_ok) {
-        NGRAPH_VLOG(5) << "Skipping (backend not ok): " << src->name() << "["
-                       << edge->src_output() << "]@" << src_index << " -> "
-                       << dst->name() << "[" << edge->dst_input() << "]@"
-                       << dst_index;
-        if (collect_non_contracting_edge_info) {
-          log_reason(EdgeNonContractionReasons::BACKEND, edge);
-          cluster_separation_reason[get_string_key(src_index, dst_index)]
-              .push_back(EdgeNonContractionReasons::BACKEND);
+    // check if the edge can be constracted with respect to backend
+    bool is_backend_ok = false;
+    TF_RETURN_IF_ERROR(
+        CanContractEdgeBackendCheck(edge, cluster_map, is_backend_ok));
+    if (!is_backend_ok) {
+      NGRAPH_VLOG(5) << "Skipping (backend not ok): " << src->name() << "["
+                     << edge->src_output() << "]@" << src_index << " -> "
+                     << dst->name() << "[" << edge->dst_input() << "]@"
+                     << dst_index;
+      if (collect_non_contracting_edge_info) {
+        log_reason(EdgeNonContractionReasons::BACKEND, edge);
+        cluster_separation_reason[get_string_key(src_index, dst_index)]
+            .push_back(EdgeNonContractionReasons::BACKEND);
+      }
+      // do not contract, src and dst node cannot be in the same cluster
+      return Status::OK();
+    }
+
+    // check if the merged cluster would be too big (clusters only grow, so
+    // this is permanent)
+    if (max_cluster_size > 0 && src_index != dst_index &&
+        cluster_map[src->id()]->nodes.size() +
+                cluster_map[dst->id()]->nodes.size() >
+            static_cast<size_t>(max_cluster_size)) {
+      NGRAPH_VLOG(5) << "Skipping (cluster too big): " << src->name() << "["
+                     << edge->src_output() << "]@" << src_index << " -> "
+                     << dst->name() << "[" << edge->dst_input() << "]@"
+                     << dst_index;
+      if (collect_non_contracting_edge_info) {
+        log_reason(EdgeNonContractionReasons::CLUSTERSIZE, edge);
+        cluster_separation_reason[get_string_key(src_index, dst_index)]
+            .push_back(EdgeNonContractionReasons::CLUSTERSIZE);
+      }
+      return Status::OK();
+    }
+
+    // Check if contracting the edge will lead to cycles
+    // if not, MergeClusters
+    if (gc.HasEdge(src_index, dst_index) &&
+        gc.ContractEdge(src_index, dst_index)) {
+      MergeClusters(edge, cluster_map, clusters);
+      *contracted = true;
+      return Status::OK();
+    }
+
+    // either static input
+    // or there exists a longer path, so contracting this edge causes
+    // cycles
+    std::vector<int32> static_inputs;
+    GetStaticInputs(dst, &static_inputs);
+    bool is_static = std::find(static_inputs.begin(), static_inputs.end(),
+                               edge->dst_input()) != static_inputs.end();
+    bool is_not_const = src->type_string() != "Const";
+    // 3 possible reasons here:
+    // src dst lies in same cluster, so nothing to do (trivial cycle
+    // induced in graphcycles)
+    // dst has static input (the shadow path never goes away)
+    // a longer irreducible path exists
+    auto reason = (src_index == dst_index
+                       ? EdgeNonContractionReasons::SAMECLUSTER
+                       : ((is_not_const && is_static)
+                              ? EdgeNonContractionReasons::STATICINPUT
+                              : EdgeNonContractionReasons::PATHEXISTS));
+    if (reason == EdgeNonContractionReasons::PATHEXISTS) {
+      park_on->push_back(cluster_map[src->id()]);
+      park_on->push_back(cluster_map[dst->id()]);
+    }
+    if (collect_non_contracting_edge_info) {
+      log_reason(reason, edge);
+      cluster_separation_reason[get_string_key(src_index, dst_index)]
+          .push_back(reason);
+    }
+    return Status::OK();
+  };
+
+  // Worklist driven contraction. It makes exactly the same decisions as
+  // sweeping over all the edges (in id order) until nothing changes, but only
+  // retries an edge when something it depends on has changed:
+  //   - an edge refused for a permanent reason (not marked, backend, static
+  //     input, cluster size) is refused again on every sweep,
+  //   - a longer path between two clusters only goes away when a node on it is
+  //     merged into one of the two clusters,
+  //   - the deadness check only reads the predicates and the outputs of the
+  //     src and dst clusters, and the predicates of the neighbours that blocked
+  //     the edge. A predicate changes (True -> P) only when its cluster is
+  //     merged.
+  // A refused edge is parked on the clusters returned by try_contract_edge and
+  // is put back on the worklist when one of them is merged. The worklist is
+  // ordered by (sweep, edge id), where the sweep of a woken edge is the next
+  // sweep that would have reached it, so that edges are tried in the order
+  // the sweeps would have tried them.
+  // NGRAPH_TF_ASSIGN_CLUSTERS_SWEEP=1 runs the plain sweeps instead, as a
+  // reference to check the worklist against.
+  int num_contracted = 0;
+  std::vector<Cluster*> park_on;
+  if (std::getenv("NGRAPH_TF_ASSIGN_CLUSTERS_SWEEP") != nullptr) {
+    bool changed;
+    do {
+      changed = false;
+      for (auto edge : graph->edges()) {
+        bool contracted = false;
+        TF_RETURN_IF_ERROR(try_contract_edge(edge, &contracted, &park_on));
+        if (contracted) {
+          num_contracted++;
+          changed = true;
         }
-        // do not contract, src and dst node cannot be in the same cluster
-        continue;
       }
+    } while (changed);
+  } else {
+    using SweepPosition = std::pair<int, int>;
+    std::priority_queue<SweepPosition, std::vector<SweepPosition>,
+                        std::greater<SweepPosition>>
+        worklist;
+    SweepPosition current(0, -1);
+    // Indexed by edge id
+    std::vector<bool> on_worklist(graph->num_edge_ids(), false);
+    auto push_edge = [&worklist, &on_worklist, &current](const Edge* edge) {
+      if (!on_worklist[edge->id()]) {
+        on_worklist[edge->id()] = true;
+        int sweep = edge->id() > current.second ? current.first
+                                                : current.first + 1;
+        worklist.push(SweepPosition(sweep, edge->id()));
+      }
+    };
+    for (auto edge : graph->edges()) {
+      push_edge(edge);
+    }
 
-      // Check if contracting the edge will lead to cycles
-      // if not, MergeClusters
-      if (gc.HasEdge(src_index, dst_index) &&
-          gc.ContractEdge(src_index, dst_index)) {
-        MergeClusters(edge, cluster_map);
-        // something changed
-        changed = true;
+    while (!worklist.empty()) {
+      current = worklist.top();
+      worklist.pop();
+      const Edge* edge = graph->FindEdgeId(current.second);
+      on_worklist[edge->id()] = false;
+
+      bool contracted = false;
+      TF_RETURN_IF_ERROR(try_contract_edge(edge, &contracted, &park_on));
+      if (contracted) {
+        num_contracted++;
+        std::vector<const Edge*> deferred_edges;
+        deferred_edges.swap(cluster_map[edge->src()->id()]->deferred_edges);
+        for (auto deferred_edge : deferred_edges) {
+          push_edge(deferred_edge);
+        }
       } else {
-        if (collect_non_contracting_edge_info) {
-          // either static input
-          // or there exists a longer path, so contracting this edge causes
-          // cycles
-          std::vector<int32> static_inputs;
-          GetStaticInputs(dst, &static_inputs);
-          bool is_static = std::find(static_inputs.begin(), static_inputs.end(),
-                                     edge->dst_input()) != static_inputs.end();
-          bool is_not_const = src->type_string() != "Const";
-          // 3 possible reasons here:
-          // src dst lies in same cluster, so nothing to do (trivial cycle
-          // induced in graphcycles)
-          // dst has static input
-          // a longer irreducible path exists
-          auto reason = (src_index == dst_index
-                             ? EdgeNonContractionReasons::SAMECLUSTER
-                             : ((is_not_const && is_static)
-                                    ? EdgeNonContractionReasons::STATICINPUT
-                                    : EdgeNonContractionReasons::PATHEXISTS));
-          log_reason(reason, edge);
-          cluster_separation_reason[get_string_key(src_index, dst_index)]
-              .push_back(reason);
+        for (Cluster* cluster : park_on) {
+          cluster->deferred_edges.push_back(edge);
         }
       }
     }
+  }
+  NGRAPH_VLOG(2) << "Contracted " << num_contracted << " edges";
 
-    if (!changed && config::IsLoggingPlacement()) {
-      // This will be entered only once if logging is enabled
-      // When entered, it will force the do-while to run one last time,
-      // collecting information
-      if (!collect_non_contracting_edge_info) {
-        changed = true;
-        collect_non_contracting_edge_info = true;
+  if (config::IsLoggingPlacement()) {
+    // One last sweep over all the edges, collecting the reasons why they were
+    // not contracted. Nothing contracts at this point
+    collect_non_contracting_edge_info = true;
+    for (auto edge : graph->edges()) {
+      bool contracted = false;
+      TF_RETURN_IF_ERROR(try_contract_edge(edge, &contracted, &park_on));
+      if (contracted) {
+        return errors::Internal("Edge ", edge->DebugString(),
+                                " was contracted after the fixed point");
       }
     }
-  } while (changed);
+  }
+
+  int64 max_cluster_flops =
+      GetClusterLimitFromEnv("NGRAPH_TF_MAX_CLUSTER_FLOPS");
+  if (max_cluster_flops > 0) {
+    SplitOversizedClusters(*graph, max_cluster_flops, gc, cluster_map,
+                           clusters);
+  }
 
   NGRAPH_VLOG(2) << "Contraction done";
 
   NGRAPH_VLOG(2) << "Starting tagging";
-  std::set<Cluster*> seen;
   unordered_map<int, int> cluster_to_encapsulate;
-  for (auto kv : cluster_map) {
-    auto cluster = kv.second.get();
-    if (seen.count(cluster) != 0) {
+  for (const auto& owned_cluster : clusters) {
+    Cluster* cluster = owned_cluster.get();
+    if (cluster == nullptr) {
       continue;
     }
 
@@ -649,7 +997,6 @@ Status AssignClusters(Graph* graph) {
     }
 
     if (!has_ngraph_ops) {
-      seen.insert(cluster);
       continue;
     }
 
@@ -676,13 +1023,11 @@ Status AssignClusters(Graph* graph) {
         cluster_to_encapsulate[cluster->index] = cluster_idx;
       }
     }
-
-    seen.insert(cluster);
   }
   NGRAPH_VLOG(2) << "Tagging done";
 
   if (config::IsLoggingPlacement()) {
-    int num_reasons = 7;  // the number of elements in the reasons enum
+    int num_reasons = 8;  // the number of elements in the reasons enum
     // histogram of reasons of non-contraction of clusters
     vector<int> reason_count_clusters(num_reasons, 0);
     vector<int> reason_count_encapsulates(num_reasons, 0);
@@ -5099,6 +5099,20 @@ Status Builder::TranslateGraph(
     const std::vector<TensorShape>& inputs,
     const std::vector<const Tensor*>& static_input_map,
     const Graph* input_graph, shared_ptr<ng::Function>& ng_function) {
+  vector<ng::PartialShape> ng_input_shapes;
+  for (const auto& input : inputs) {
+    ng::Shape ng_shape;
+    TF_RETURN_IF_ERROR(TFTensorShapeToNGraphShape(input, &ng_shape));
+    ng_input_shapes.push_back(ng::PartialShape(ng_shape));
+  }
+  return TranslateGraph(ng_input_shapes, static_input_map, input_graph,
+                        ng_function);
+}
+
+Status Builder::TranslateGraph(
+    const std::vector<ng::PartialShape>& inputs,
+    const std::vector<const Tensor*>& static_input_map,
+    const Graph* input_graph, shared_ptr<ng::Function>& ng_function) {
   //
   // We will visit ops in topological order.
   //
@@ -5165,13 +5179,10 @@ Status Builder::TranslateGraph(
     ng::element::Type ng_et;
     TF_RETURN_IF_ERROR(TFDataTypeToNGraphElementType(dtype, &ng_et));
 
-    ng::Shape ng_shape;
-    TF_RETURN_IF_ERROR(TFTensorShapeToNGraphShape(inputs[index], &ng_shape));
-
     string prov_tag;
     GetNodeAttr(parm->attrs(), "_prov_tag", &prov_tag);
     auto ng_param =
-        ConstructNgNode<ng::op::Parameter>(prov_tag, ng_et, ng_shape);
+        ConstructNgNode<ng::op::Parameter>(prov_tag, ng_et, inputs[index]);
     SaveNgOp(ng_op_map, parm->name(), ng_param);
     ng_parameter_list[index] = ng_param;
   }
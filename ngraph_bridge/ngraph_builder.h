@@ -37,6 +37,14 @@ class Builder {
       const std::vector<const Tensor*>& static_input_map, const Graph* tf_graph,
       std::shared_ptr<ngraph::Function>& ng_function);
 
+  // Same as above, but the parameters are created with (possibly) dynamic
+  // shapes, so that one function can serve a family of input shapes. Fails
+  // if any of the op translations needs a dimension that is dynamic.
+  static Status TranslateGraph(
+      const std::vector<ngraph::PartialShape>& inputs,
+      const std::vector<const Tensor*>& static_input_map, const Graph* tf_graph,
+      std::shared_ptr<ngraph::Function>& ng_function);
+
   using OpMap = std::unordered_map<std::string,
                                    std::vector<std::shared_ptr<ngraph::Node>>>;
 
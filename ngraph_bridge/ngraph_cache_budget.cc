@@ -0,0 +1,327 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/ngraph_cache_budget.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Number of resize decisions kept around for StatsToString()
+static const size_t kResizeLogLength = 64;
+// Number of most recent lookups used to estimate the working set of
+// signatures, when the executable cache depth is adaptive
+static const int kSignatureWindowSize = 64;
+// The adaptive cache depth is re-evaluated every these many lookups
+static const int kCacheResizeInterval = 16;
+static const int kMinCacheDepth = 2;
+
+static int64 GetLimitFromEnv(const char* env_name, int64 default_value) {
+  const char* value = std::getenv(env_name);
+  if (value == nullptr) {
+    return default_value;
+  }
+  return std::max<int64>(0, atoll(value));
+}
+
+// Static initializers
+int64 NGraphCacheBudget::s_max_items =
+    GetLimitFromEnv("NGRAPH_TF_FUNCTION_CACHE_MAX_ITEMS", 1024);
+int64 NGraphCacheBudget::s_max_bytes =
+    GetLimitFromEnv("NGRAPH_TF_FUNCTION_CACHE_MAX_BYTES", 0);
+int64 NGraphCacheBudget::s_reserved_items = 0;
+int64 NGraphCacheBudget::s_cached_bytes = 0;
+std::map<int, NGraphCacheBudget::ExecutorStats>
+    NGraphCacheBudget::s_executor_stats;
+std::deque<std::string> NGraphCacheBudget::s_resize_log;
+std::mutex NGraphCacheBudget::s_mutex;
+
+void NGraphCacheBudget::AcquireItems(int count) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_reserved_items += count;
+}
+
+int NGraphCacheBudget::TryReserveItems(int requested) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  int64 granted = requested;
+  if (s_max_items > 0) {
+    granted = std::max<int64>(
+        0, std::min<int64>(requested, s_max_items - s_reserved_items));
+  }
+  s_reserved_items += granted;
+  return static_cast<int>(granted);
+}
+
+void NGraphCacheBudget::ReleaseItems(int count) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_reserved_items = std::max<int64>(0, s_reserved_items - count);
+}
+
+void NGraphCacheBudget::AddBytes(int64 bytes) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_cached_bytes += bytes;
+}
+
+void NGraphCacheBudget::RemoveBytes(int64 bytes) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_cached_bytes = std::max<int64>(0, s_cached_bytes - bytes);
+}
+
+bool NGraphCacheBudget::IsByteBudgetExceeded() {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  return s_max_bytes > 0 && s_cached_bytes >= s_max_bytes;
+}
+
+void NGraphCacheBudget::SetLimits(int64 max_items, int64 max_bytes) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_max_items = max_items;
+  s_max_bytes = max_bytes;
+}
+
+int64 NGraphCacheBudget::GetMaxItems() {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  return s_max_items;
+}
+
+int64 NGraphCacheBudget::GetMaxBytes() {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  return s_max_bytes;
+}
+
+int64 NGraphCacheBudget::GetReservedItems() {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  return s_reserved_items;
+}
+
+int64 NGraphCacheBudget::GetCachedBytes() {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  return s_cached_bytes;
+}
+
+void NGraphCacheBudget::UpdateStats(int instance_id,
+                                    const ExecutorStats& stats) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_executor_stats[instance_id] = stats;
+}
+
+void NGraphCacheBudget::RemoveStats(int instance_id) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_executor_stats.erase(instance_id);
+}
+
+bool NGraphCacheBudget::GetStats(int instance_id, ExecutorStats* stats) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  auto itr = s_executor_stats.find(instance_id);
+  if (itr == s_executor_stats.end()) {
+    return false;
+  }
+  *stats = itr->second;
+  return true;
+}
+
+void NGraphCacheBudget::RecordResize(int instance_id, int cluster_id,
+                                     int old_depth, int new_depth,
+                                     int working_set,
+                                     double window_hit_ratio) {
+  std::stringstream ss;
+  ss << "instance " << instance_id << " cluster " << cluster_id << ": depth "
+     << old_depth << " -> " << new_depth << " (working set " << working_set
+     << ", window hit ratio " << std::fixed << std::setprecision(2)
+     << window_hit_ratio << ")";
+  NGRAPH_VLOG(1) << "Executable cache resize: " << ss.str();
+
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_resize_log.push_back(ss.str());
+  if (s_resize_log.size() > kResizeLogLength) {
+    s_resize_log.pop_front();
+  }
+}
+
+std::string NGraphCacheBudget::StatsToString() {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  std::stringstream ss;
+  ss << "Executable cache budget: items " << s_reserved_items << "/"
+     << s_max_items << " bytes " << s_cached_bytes << "/" << s_max_bytes
+     << "\n";
+  for (const auto& kv : s_executor_stats) {
+    const ExecutorStats& stats = kv.second;
+    int64 lookups = stats.hits + stats.misses;
+    double hit_ratio =
+        lookups > 0 ? static_cast<double>(stats.hits) / lookups : 0.0;
+    ss << "instance " << kv.first << " cluster " << stats.cluster_id
+       << ": depth " << stats.depth << " working set " << stats.working_set
+       << " hits " << stats.hits << " misses " << stats.misses
+       << " hit ratio " << std::fixed << std::setprecision(2) << hit_ratio
+       << " grows " << stats.grows << " shrinks " << stats.shrinks << "\n";
+  }
+  for (const auto& entry : s_resize_log) {
+    ss << "resize: " << entry << "\n";
+  }
+  return ss.str();
+}
+
+NGraphCacheDepth::NGraphCacheDepth(int instance_id, int cluster_id,
+                                   int depth)
+    : m_instance_id(instance_id),
+      m_cluster_id(cluster_id),
+      m_depth(depth),
+      m_max_depth(depth) {
+  NGraphCacheBudget::ExecutorStats stats;
+  stats.cluster_id = m_cluster_id;
+  stats.depth = m_depth;
+  NGraphCacheBudget::UpdateStats(m_instance_id, stats);
+}
+
+NGraphCacheDepth::~NGraphCacheDepth() {
+  if (m_items_acquired) {
+    NGraphCacheBudget::ReleaseItems(m_depth);
+  }
+  NGraphCacheBudget::RemoveStats(m_instance_id);
+}
+
+void NGraphCacheDepth::SetClusterId(int cluster_id) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cluster_id = cluster_id;
+}
+
+void NGraphCacheDepth::EnableAdaptive(int max_depth) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_adaptive = true;
+  m_max_depth = std::max(max_depth, kMinCacheDepth);
+  NGRAPH_VLOG(3) << "Executable cache of " << m_instance_id
+                 << ": adaptive depth, initial: " << m_depth
+                 << " max: " << m_max_depth;
+}
+
+bool NGraphCacheDepth::IsAdaptive() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_adaptive;
+}
+
+int NGraphCacheDepth::GetDepth() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_depth;
+}
+
+void NGraphCacheDepth::RecordLookup(const std::string& signature,
+                                    bool cache_hit,
+                                    const ResizeCallback& resize) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (cache_hit) {
+    m_hits++;
+  } else {
+    m_misses++;
+    if (!m_items_acquired) {
+      NGraphCacheBudget::AcquireItems(m_depth);
+      m_items_acquired = true;
+    }
+  }
+
+  if (m_adaptive) {
+    size_t signature_hash = std::hash<std::string>()(signature);
+    m_signature_window.push_back(std::make_pair(signature_hash, cache_hit));
+    m_signature_counts[signature_hash]++;
+    if (!cache_hit) {
+      m_window_misses++;
+    }
+    if (m_signature_window.size() > kSignatureWindowSize) {
+      auto oldest = m_signature_window.front();
+      m_signature_window.pop_front();
+      if (--m_signature_counts[oldest.first] == 0) {
+        m_signature_counts.erase(oldest.first);
+      }
+      if (!oldest.second) {
+        m_window_misses--;
+      }
+    }
+    if (++m_lookups_since_resize >= kCacheResizeInterval &&
+        m_items_acquired) {
+      m_lookups_since_resize = 0;
+      Resize(resize);
+    }
+  }
+
+  NGraphCacheBudget::ExecutorStats stats;
+  stats.cluster_id = m_cluster_id;
+  stats.depth = m_depth;
+  stats.working_set = m_signature_counts.size();
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  stats.grows = m_grows;
+  stats.shrinks = m_shrinks;
+  NGraphCacheBudget::UpdateStats(m_instance_id, stats);
+}
+
+void NGraphCacheDepth::Resize(const ResizeCallback& resize) {
+  int working_set = m_signature_counts.size();
+  // Leave some headroom above the working set, so that a new signature does
+  // not immediately evict one that is still in use
+  int target_depth =
+      std::min(m_max_depth,
+               std::max(kMinCacheDepth, working_set + working_set / 4 + 1));
+  bool window_full = (m_signature_window.size() == kSignatureWindowSize);
+
+  int new_depth = m_depth;
+  if (target_depth > m_depth) {
+    // Grow only if we are actually missing, and there is room left
+    if (m_window_misses > 0 && !NGraphCacheBudget::IsByteBudgetExceeded()) {
+      new_depth += NGraphCacheBudget::TryReserveItems(target_depth - m_depth);
+    }
+  } else if (window_full && (2 * target_depth <= m_depth ||
+                             NGraphCacheBudget::IsByteBudgetExceeded())) {
+    // Shrink only on a full window and with some hysteresis, unless we are
+    // over the byte budget
+    new_depth = target_depth;
+  }
+
+  if (new_depth == m_depth) {
+    return;
+  }
+
+  Status status = resize(new_depth);
+  if (status != Status::OK()) {
+    NGRAPH_VLOG(1) << "Failed to resize executable cache of " << m_instance_id
+                   << ": " << status.error_message();
+    if (new_depth > m_depth) {
+      NGraphCacheBudget::ReleaseItems(new_depth - m_depth);
+    }
+    return;
+  }
+
+  double window_hit_ratio =
+      1.0 - static_cast<double>(m_window_misses) / m_signature_window.size();
+  NGraphCacheBudget::RecordResize(m_instance_id, m_cluster_id, m_depth,
+                                  new_depth, working_set, window_hit_ratio);
+  if (new_depth > m_depth) {
+    m_grows++;
+  } else {
+    NGraphCacheBudget::ReleaseItems(m_depth - new_depth);
+    m_shrinks++;
+  }
+  m_depth = new_depth;
+}
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#ifndef NGRAPH_TF_CACHE_BUDGET_H_
+#define NGRAPH_TF_CACHE_BUDGET_H_
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "tensorflow/core/lib/core/status.h"
+
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Process wide accounting for the executable caches owned by the
+// NGraphExecutors (and the legacy NGraphEncapsulateImpl).
+//
+// Every executor holds item slots equal to its cache depth and reports the
+// (estimated) bytes held by the items it has cached. Executors that adapt
+// their cache depth ask for slots here before growing, so that the sum of all
+// the caches stays within NGRAPH_TF_FUNCTION_CACHE_MAX_ITEMS executables and
+// NGRAPH_TF_FUNCTION_CACHE_MAX_BYTES bytes (0 means unlimited).
+//
+// The per-executor hit/miss counters and the resize decisions are recorded
+// here as well, and can be queried through config::GetExecutableCacheStats().
+class NGraphCacheBudget {
+ public:
+  struct ExecutorStats {
+    int cluster_id{-1};
+    int depth{0};
+    int working_set{0};
+    int64 hits{0};
+    int64 misses{0};
+    int64 grows{0};
+    int64 shrinks{0};
+  };
+
+  // Unconditionally accounts for "count" item slots, used for the initial
+  // depth of an executor
+  static void AcquireItems(int count);
+  // Reserves up to "requested" item slots within the global limit. Returns
+  // the number of slots granted
+  static int TryReserveItems(int requested);
+  static void ReleaseItems(int count);
+
+  static void AddBytes(int64 bytes);
+  static void RemoveBytes(int64 bytes);
+  static bool IsByteBudgetExceeded();
+
+  static void SetLimits(int64 max_items, int64 max_bytes);
+  static int64 GetMaxItems();
+  static int64 GetMaxBytes();
+  static int64 GetReservedItems();
+  static int64 GetCachedBytes();
+
+  static void UpdateStats(int instance_id, const ExecutorStats& stats);
+  static void RemoveStats(int instance_id);
+  static bool GetStats(int instance_id, ExecutorStats* stats);
+  static void RecordResize(int instance_id, int cluster_id, int old_depth,
+                           int new_depth, int working_set,
+                           double window_hit_ratio);
+
+  // Human readable dump of the budget, the per-executor statistics and the
+  // most recent resize decisions
+  static std::string StatsToString();
+
+ private:
+  static int64 s_max_items;
+  static int64 s_max_bytes;
+  static int64 s_reserved_items;
+  static int64 s_cached_bytes;
+  static std::map<int, ExecutorStats> s_executor_stats;
+  static std::deque<std::string> s_resize_log;
+  static std::mutex s_mutex;
+};
+
+// The depth of the executable cache of one executor, in items accounted for
+// in NGraphCacheBudget. The items are only acquired on the first compilation,
+// so that encapsulates that never run do not hold any.
+//
+// If adaptive, the depth follows the number of distinct signatures seen over
+// the recent lookups, up to max_depth items and within the global budget.
+class NGraphCacheDepth {
+ public:
+  // Resizes the cache of the executor to the given depth, evicting items if
+  // it shrinks
+  using ResizeCallback = std::function<Status(int)>;
+
+  NGraphCacheDepth(int instance_id, int cluster_id, int depth);
+  ~NGraphCacheDepth();
+
+  void SetClusterId(int cluster_id);
+  void EnableAdaptive(int max_depth);
+  bool IsAdaptive();
+  int GetDepth();
+
+  // Records a lookup in the hit/miss counters and the signature window, and
+  // resizes the cache (through the callback) if it is adaptive
+  void RecordLookup(const std::string& signature, bool cache_hit,
+                    const ResizeCallback& resize);
+
+ private:
+  // Picks the new depth from the signature window. Called with m_mutex held
+  void Resize(const ResizeCallback& resize);
+
+  const int m_instance_id;
+  int m_cluster_id;
+  int m_depth;
+  int m_max_depth;
+  bool m_adaptive{false};
+  bool m_items_acquired{false};
+  // Hashes of the most recent signatures, and whether they were cache hits
+  std::deque<std::pair<size_t, bool>> m_signature_window;
+  std::unordered_map<size_t, int> m_signature_counts;
+  int m_window_misses{0};
+  int m_lookups_since_resize{0};
+  int64 m_hits{0};
+  int64 m_misses{0};
+  int64 m_grows{0};
+  int64 m_shrinks{0};
+  std::mutex m_mutex;
+};
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_CACHE_BUDGET_H_
@@ -0,0 +1,278 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "ngraph_bridge/ngraph_cache_dataset_op.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/ngraph_prefetch_shared_data.h"
+
+namespace tensorflow {
+namespace data {
+
+constexpr char kDatasetName[] = "NGraphCache";
+
+class NGraphCacheDatasetOp::Dataset : public DatasetBase {
+ public:
+  Dataset(OpKernelContext* ctx, const DatasetBase* input, int64 count,
+          int64 max_bytes, bool shuffle, int64 seed,
+          const string& iterator_name, int graph_id)
+      : DatasetBase(DatasetContext(ctx)),
+        input_(input),
+        count_(count),
+        max_bytes_(max_bytes),
+        shuffle_(shuffle),
+        seed_(seed),
+        iterator_name_(iterator_name),
+        graph_id_(graph_id) {
+    input_->Ref();
+    m_resource_mgr = ctx->resource_manager();
+  }
+
+  ~Dataset() override { input_->Unref(); }
+
+  std::unique_ptr<IteratorBase> MakeIteratorInternal(
+      const string& prefix) const override {
+    return absl::make_unique<Iterator>(
+        Iterator::Params{this, strings::StrCat(prefix, "::", kDatasetName)},
+        m_resource_mgr);
+  }
+
+  const DataTypeVector& output_dtypes() const override {
+    return input_->output_dtypes();
+  }
+
+  const std::vector<PartialTensorShape>& output_shapes() const override {
+    return input_->output_shapes();
+  }
+
+  string DebugString() const override {
+    return "NGraphCacheDatasetOp::Dataset";
+  }
+
+  int64 Cardinality() const override {
+    if (count_ < 0) {
+      return kInfiniteCardinality;
+    }
+    int64 n = input_->Cardinality();
+    return n < 0 ? n : n * count_;
+  }
+
+ protected:
+  Status AsGraphDefInternal(SerializationContext* ctx,
+                            DatasetGraphDefBuilder* b,
+                            Node** output) const override {
+    Node* input_graph_node = nullptr;
+    TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph_node));
+    Node* count = nullptr;
+    TF_RETURN_IF_ERROR(b->AddScalar(count_, &count));
+    AttrValue max_bytes_attr;
+    b->BuildAttrValue(max_bytes_, &max_bytes_attr);
+    AttrValue shuffle_attr;
+    b->BuildAttrValue(shuffle_, &shuffle_attr);
+    AttrValue seed_attr;
+    b->BuildAttrValue(seed_, &seed_attr);
+    AttrValue iterator_name_attr;
+    b->BuildAttrValue(iterator_name_, &iterator_name_attr);
+    AttrValue graph_id_attr;
+    b->BuildAttrValue(graph_id_, &graph_id_attr);
+    TF_RETURN_IF_ERROR(
+        b->AddDataset(this, {input_graph_node, count},
+                      {std::make_pair("max_bytes", max_bytes_attr),
+                       std::make_pair("shuffle", shuffle_attr),
+                       std::make_pair("seed", seed_attr),
+                       std::make_pair("iterator_name", iterator_name_attr),
+                       std::make_pair("graph_id", graph_id_attr)},
+                      output));
+    return Status::OK();
+  }
+
+ private:
+  class Iterator : public DatasetIterator<Dataset> {
+   public:
+    explicit Iterator(const Params& params, ResourceMgr* rm)
+        : DatasetIterator<Dataset>(params), m_resource_mgr(rm) {}
+
+    ~Iterator() override {
+      if (cached_elements_ != nullptr) {
+        cached_elements_->Unref();
+      }
+    }
+
+    Status Initialize(IteratorContext* ctx) override {
+      TF_RETURN_IF_ERROR(
+          m_resource_mgr->LookupOrCreate<ngraph_bridge::NGraphCachedElements>(
+              ngraph_bridge::NGraphPrefetchSharedResouce::CONTAINER_NAME,
+              ngraph_bridge::NGraphCachedElements::ResourceName(
+                  dataset()->graph_id_, dataset()->iterator_name_),
+              &cached_elements_,
+              [](ngraph_bridge::NGraphCachedElements** cached_elements) {
+                *cached_elements = new ngraph_bridge::NGraphCachedElements();
+                return Status::OK();
+              }));
+      // Drop the elements of a previous iterator that were never staged
+      cached_elements_->Clear();
+      cached_elements_->SetMaxBytes(dataset()->max_bytes_);
+      rng_.seed(dataset()->seed_ != 0 ? dataset()->seed_
+                                      : std::random_device()());
+      return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
+    }
+
+    Status GetNextInternal(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence) override {
+      mutex_lock l(mu_);
+      while (dataset()->count_ < 0 || epoch_ < dataset()->count_) {
+        if (replaying_) {
+          if (position_ < order_.size()) {
+            int64 element = order_[position_++];
+            *out_tensors = cache_[element];
+            cached_elements_->Push(element);
+            *end_of_sequence = false;
+            return Status::OK();
+          }
+          StartEpoch();
+          continue;
+        }
+
+        TF_RETURN_IF_ERROR(
+            input_impl_->GetNext(ctx, out_tensors, end_of_sequence));
+        if (!*end_of_sequence) {
+          num_read_in_epoch_++;
+          cached_elements_->Push(epoch_ == 0 ? CacheElement(*out_tensors)
+                                             : -1);
+          return Status::OK();
+        }
+        if (num_read_in_epoch_ == 0) {
+          // Like RepeatDataset, an empty input ends the sequence
+          break;
+        }
+        if (epoch_ == 0 && caching_) {
+          NGRAPH_VLOG(1) << "NGraphCacheDataset: cached " << cache_.size()
+                         << " elements, " << cached_bytes_ << " bytes";
+          replaying_ = true;
+          input_impl_.reset();
+        } else {
+          TF_RETURN_IF_ERROR(
+              dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_));
+        }
+        StartEpoch();
+      }
+      *end_of_sequence = true;
+      return Status::OK();
+    }
+
+   protected:
+    std::shared_ptr<model::Node> CreateNode(
+        IteratorContext* ctx, model::Node::Args args) const override {
+      return model::MakeKnownRatioNode(std::move(args),
+                                       /*ratio=*/1);
+    }
+
+   private:
+    // Keeps the element of the first epoch if it fits in the budget, and
+    // returns its position. Once the input does not fit, nothing is kept
+    int64 CacheElement(const std::vector<Tensor>& value)
+        EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (!caching_) {
+        return -1;
+      }
+      int64 bytes = 0;
+      for (const auto& tensor : value) {
+        bytes += tensor.TotalBytes();
+      }
+      if (dataset()->max_bytes_ > 0 &&
+          cached_bytes_ + bytes > dataset()->max_bytes_) {
+        NGRAPH_VLOG(1) << "NGraphCacheDataset: the input does not fit in "
+                       << dataset()->max_bytes_ << " bytes, not caching it";
+        caching_ = false;
+        cache_.clear();
+        cached_bytes_ = 0;
+        return -1;
+      }
+      cache_.push_back(value);
+      cached_bytes_ += bytes;
+      return cache_.size() - 1;
+    }
+
+    void StartEpoch() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      epoch_++;
+      num_read_in_epoch_ = 0;
+      if (replaying_) {
+        order_.resize(cache_.size());
+        std::iota(order_.begin(), order_.end(), 0);
+        if (dataset()->shuffle_) {
+          std::shuffle(order_.begin(), order_.end(), rng_);
+        }
+        position_ = 0;
+      }
+    }
+
+    mutex mu_;
+    std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
+    int64 epoch_ GUARDED_BY(mu_) = 0;
+    int64 num_read_in_epoch_ GUARDED_BY(mu_) = 0;
+    // Set until the first epoch does not fit in the budget
+    bool caching_ GUARDED_BY(mu_) = true;
+    // Set once the first epoch is cached, the input is not read anymore
+    bool replaying_ GUARDED_BY(mu_) = false;
+    std::vector<std::vector<Tensor>> cache_ GUARDED_BY(mu_);
+    int64 cached_bytes_ GUARDED_BY(mu_) = 0;
+    // Order in which the current epoch replays the cached elements
+    std::vector<int64> order_ GUARDED_BY(mu_);
+    size_t position_ GUARDED_BY(mu_) = 0;
+    std::mt19937_64 rng_ GUARDED_BY(mu_);
+
+    ResourceMgr* m_resource_mgr{nullptr};
+    ngraph_bridge::NGraphCachedElements* cached_elements_{nullptr};
+  };
+
+  const DatasetBase* const input_;
+  const int64 count_;
+  const int64 max_bytes_;
+  const bool shuffle_;
+  const int64 seed_;
+  const string iterator_name_;
+  const int graph_id_;
+
+  // Store the resource manager
+  ResourceMgr* m_resource_mgr{nullptr};
+};
+
+void NGraphCacheDatasetOp::MakeDataset(OpKernelContext* ctx,
+                                       DatasetBase* input,
+                                       DatasetBase** output) {
+  int64 count = 0;
+  OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "count", &count));
+  OP_REQUIRES(ctx, count >= -1,
+              errors::InvalidArgument("count must be >= -1, got ", count));
+  *output = new Dataset(ctx, input, count, max_bytes_, shuffle_, seed_,
+                        iterator_name_, graph_id_);
+}
+
+namespace {
+REGISTER_KERNEL_BUILDER(Name("NGraphCacheDataset").Device(DEVICE_CPU),
+                        NGraphCacheDatasetOp);
+}  // namespace
+
+}  // namespace data
+}  // namespace tensorflow
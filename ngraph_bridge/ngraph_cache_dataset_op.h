@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#ifndef NGRAPH_TF_CACHE_DATASET_OP_H_
+#define NGRAPH_TF_CACHE_DATASET_OP_H_
+#pragma once
+
+#include "tensorflow/core/framework/dataset.h"
+
+namespace tensorflow {
+namespace data {
+
+// Caches the elements of its input dataset and repeats them "count" times
+// (forever if count is -1), i.e. dataset.cache().repeat(count) kept in
+// memory.
+//
+// It is placed in front of an NGraphPrefetchDataset. The elements of the
+// first epoch are read from the input and are kept, up to max_bytes (0 means
+// unlimited). The later epochs replay them, shuffled if "shuffle" is set, and
+// the NGraphPrefetchDataset runs the NGraphEncapsulates on the device tensors
+// it kept for them in the first epoch instead of copying them again. If the
+// input does not fit in max_bytes, every epoch reads the input again.
+class NGraphCacheDatasetOp : public UnaryDatasetOpKernel {
+ public:
+  explicit NGraphCacheDatasetOp(OpKernelConstruction* ctx)
+      : UnaryDatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("max_bytes", &max_bytes_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("shuffle", &shuffle_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("seed", &seed_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("iterator_name", &iterator_name_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("graph_id", &graph_id_));
+  }
+
+ protected:
+  void MakeDataset(OpKernelContext* ctx, DatasetBase* input,
+                   DatasetBase** output) override;
+
+ private:
+  class Dataset;
+  int64 max_bytes_ = 0;
+  bool shuffle_ = false;
+  int64 seed_ = 0;
+  // Iterator made from the NGraphPrefetchDataset reading from this dataset
+  string iterator_name_;
+  // Id of the graph the iterator was captured in
+  int graph_id_ = 0;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_CACHE_DATASET_OP_H_
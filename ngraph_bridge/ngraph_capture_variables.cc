@@ -19,7 +19,8 @@
 
 #include "ngraph_bridge/ngraph_api.h"
 #include "ngraph_bridge/ngraph_capture_variables.h"
-#include "ngraph_bridge/ngraph_prefetch_shared_data.h"
+#include "ngraph_bridge/ngraph_catalog.h"
+#include "ngraph_bridge/ngraph_replace_cache_dataset.h"
 #include "ngraph_bridge/ngraph_utils.h"
 
 using namespace std;
@@ -41,7 +42,72 @@ static bool IsOutputNode(const Node* node,
   return found;
 }
 
-Status ReplacePrefetch(Graph* graph, Node* prefetch_node) {
+// Datasets that return the elements of their input dataset unchanged, so
+// that the elements staged by a NGraphPrefetchDataset below them are the
+// ones returned by the IteratorGetNext
+static const std::set<string> kPassThroughDatasets = {
+    "Identity", "ModelDataset", "OptimizeDataset",
+    "MaxIntraOpParallelismDataset", "PrivateThreadPoolDataset",
+    "ExperimentalMaxIntraOpParallelismDataset",
+    "ExperimentalPrivateThreadPoolDataset"};
+
+// Returns the iterator made from the dataset "node" (possibly
+// through pass-through datasets wrapping it), or nullptr if
+// prefetching "node" on the device is not safe, i.e. if
+// - there is no MakeIterator for it in this graph
+// - it reaches the MakeIterator through a dataset that changes its elements,
+//   or through a dataset used by more than one node
+// - the iterator is not read by an IteratorGetNext in this graph
+static Node* GetIterator(Node* node) {
+  Node* curr = node;
+  while (true) {
+    Node* next = nullptr;
+    for (auto edge : curr->out_edges()) {
+      if (edge->IsControlEdge()) {
+        continue;
+      }
+      if (next != nullptr) {
+        return nullptr;
+      }
+      next = edge->dst();
+    }
+    if (next == nullptr) {
+      return nullptr;
+    }
+    if (next->type_string() == "MakeIterator") {
+      Node* iterator;
+      if (!next->input_node(1, &iterator).ok()) {
+        return nullptr;
+      }
+      for (auto edge : iterator->out_edges()) {
+        if (!edge->IsControlEdge() &&
+            edge->dst()->type_string() == "IteratorGetNext") {
+          return iterator;
+        }
+      }
+      return nullptr;
+    }
+    if (kPassThroughDatasets.count(next->type_string()) == 0) {
+      return nullptr;
+    }
+    curr = next;
+  }
+}
+
+Status ReplacePrefetch(Graph* graph, Node* prefetch_node, int graph_id) {
+  // The NGraphEncapsulates fed by this iterator register with it by name
+  Node* iterator = GetIterator(prefetch_node);
+  if (iterator == nullptr) {
+    NGRAPH_VLOG(1) << "Not replacing " << prefetch_node->name()
+                   << ", its elements do not reach an IteratorGetNext as is";
+    return Status::OK();
+  }
+  string iterator_name = iterator->name();
+
+  // Keep the elements on the device if the dataset is cached
+  TF_RETURN_IF_ERROR(
+      ReplaceCacheDataset(graph, prefetch_node, iterator_name, graph_id));
+
   NodeBuilder::NodeOut input_dataset;
   NodeBuilder::NodeOut buffer_size;
 
@@ -72,6 +138,8 @@ Status ReplacePrefetch(Graph* graph, Node* prefetch_node) {
                          .Attr("output_types", output_types)
                          .Attr("output_shapes", output_shapes)
                          .Attr("slack_period", slack_period)
+                         .Attr("iterator_name", iterator_name)
+                         .Attr("graph_id", graph_id)
                          .Device(prefetch_node->assigned_device_name())
                          .Finalize(graph, &replacement));
   replacement->set_assigned_device_name(prefetch_node->assigned_device_name());
@@ -117,20 +185,27 @@ Status ReplacePrefetch(Graph* graph, Node* prefetch_node) {
   NGRAPH_VLOG(4) << "Replaced TF Prefetch Node " << prefetch_node->name()
                  << " with NGraphPrefetch Node " << replacement->name();
 
+  // The inputs fed by this iterator are entered in the catalog once the
+  // graph is encapsulated, which may be done on a pruned copy of this graph
+  // with another graph id
+  iterator->AddAttr("_ngraph_prefetch_graph_id", graph_id);
+  NGraphCatalog::AddToPrefetchDatasetIterators(graph_id, iterator_name);
+
   return Status::OK();
 }
 
 //
 // Main entry point for the variable-capture.
 //
-Status CaptureVariables(Graph* graph, const std::set<string> skip_these_nodes) {
+Status CaptureVariables(Graph* graph, const std::set<string> skip_these_nodes,
+                        bool replace_prefetch, int graph_id) {
   if (config::IsEnabled() == false) {
     return Status::OK();
   }
 
   std::vector<Node*> replaced_nodes;
 
-  Node* prefetch_node = nullptr;
+  std::vector<Node*> prefetch_nodes;
 
   for (auto node : graph->op_nodes()) {
     if (!IsOutputNode(node, skip_these_nodes)) {
@@ -204,9 +279,9 @@ Status CaptureVariables(Graph* graph, const std::set<string> skip_these_nodes) {
 
         replaced_nodes.push_back(node);
       } else if (node->type_string() == "PrefetchDataset") {
-        // Collect the prefetch_node so that we can add
-        // the NGraphWriteToDevice Op after this one
-        prefetch_node = node;
+        // Collect the prefetch nodes so that we can add
+        // the NGraphWriteToDevice Op after them
+        prefetch_nodes.push_back(node);
       }
     }
   }
@@ -216,10 +291,10 @@ Status CaptureVariables(Graph* graph, const std::set<string> skip_these_nodes) {
     graph->RemoveNode(node);
   }
 
-  if (std::getenv(NGraphPrefetchSharedResouce::NGRAPH_TF_USE_PREFETCH) !=
-      nullptr) {
-    if (prefetch_node != nullptr) {
-      return ReplacePrefetch(graph, prefetch_node);
+  if (replace_prefetch) {
+    NGraphCatalog::ClearPrefetchDatasetIterators(graph_id);
+    for (auto prefetch_node : prefetch_nodes) {
+      TF_RETURN_IF_ERROR(ReplacePrefetch(graph, prefetch_node, graph_id));
     }
   }
   return Status::OK();
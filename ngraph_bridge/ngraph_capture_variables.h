@@ -24,7 +24,12 @@ namespace tensorflow {
 
 namespace ngraph_bridge {
 
-Status CaptureVariables(Graph* graph, std::set<string> skip_these_nodes);
+// Replaces the variables with NGraphVariables. If replace_prefetch is true,
+// also replaces the PrefetchDatasets whose elements reach an IteratorGetNext
+// unchanged with NGraphPrefetchDatasets, recording their iterators in the
+// catalog under graph_id
+Status CaptureVariables(Graph* graph, std::set<string> skip_these_nodes,
+                        bool replace_prefetch = false, int graph_id = 0);
 
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
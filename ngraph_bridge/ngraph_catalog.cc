@@ -35,6 +35,11 @@ unordered_map<string, tuple<string, bool>>
     NGraphCatalog::encap_output_info_map_;
 unordered_map<string, unordered_set<int>>
     NGraphCatalog::prefetched_input_index_map_;
+unordered_map<string, int> NGraphCatalog::prefetched_input_component_map_;
+unordered_map<string, pair<int, string>> NGraphCatalog::prefetch_iterator_map_;
+unordered_map<int, unordered_set<string>>
+    NGraphCatalog::prefetch_dataset_iterators_;
+std::mutex NGraphCatalog::catalog_mutex_;
 
 // Function to create the Node Key
 string NGraphCatalog::CreateNodeKey(const int& graph_id,
@@ -55,33 +60,40 @@ void NGraphCatalog::ClearCatalog() {
   NGraphCatalog::ClearEncapOutputCopyIndexesMap();
   NGraphCatalog::ClearEncapOutputInfoMap();
   NGraphCatalog::ClearPrefetchedInputIndexMap();
+  NGraphCatalog::ClearPrefetchedInputComponentMap();
+  NGraphCatalog::ClearPrefetchIteratorMap();
+  NGraphCatalog::ClearPrefetchDatasetIterators();
 }
 
 // Functions for Encapsulate Output Copy Indexes Map
 void NGraphCatalog::AddToEncapOutputCopyIndexesMap(
     const int& graphid, const string& node_name,
     const unordered_set<int>& val) {
-  if (NGraphCatalog::EncapOutputNeedsCopy(graphid, node_name)) {
+  string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  if (!NGraphCatalog::encap_output_copy_indexes_map_.insert({key, val})
+           .second) {
     throw runtime_error(
         "Trying to add an already existing key in EncapOutputIndexesCopy Map");
   }
-  string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
-  NGraphCatalog::encap_output_copy_indexes_map_.insert({key, val});
 }
 
 void NGraphCatalog::ClearEncapOutputCopyIndexesMap() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGraphCatalog::encap_output_copy_indexes_map_.clear();
 }
 
-const unordered_set<int>& NGraphCatalog::GetEncapOutputIndexesThatNeedCopy(
+unordered_set<int> NGraphCatalog::GetEncapOutputIndexesThatNeedCopy(
     const int& graphid, const string& node_name) {
   string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   return NGraphCatalog::encap_output_copy_indexes_map_.at(key);
 }
 
 bool NGraphCatalog::EncapOutputNeedsCopy(const int& graphid,
                                          const string& node_name) {
   string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   auto itr = NGraphCatalog::encap_output_copy_indexes_map_.find(key);
   return itr != NGraphCatalog::encap_output_copy_indexes_map_.end();
 }
@@ -90,9 +102,10 @@ bool NGraphCatalog::EncapOutputIndexNeedsCopy(const int& graphid,
                                               const string& node_name,
                                               const int& index) {
   string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   auto itr = NGraphCatalog::encap_output_copy_indexes_map_.find(key);
   if (itr != NGraphCatalog::encap_output_copy_indexes_map_.end()) {
-    auto op_copy_indexes = itr->second;
+    const auto& op_copy_indexes = itr->second;
     return (op_copy_indexes.find(index) != op_copy_indexes.end());
   }
   return false;
@@ -101,31 +114,37 @@ bool NGraphCatalog::EncapOutputIndexNeedsCopy(const int& graphid,
 void NGraphCatalog::DeleteFromEncapOutputCopyIndexesMap(
     const int& graphid, const string& node_name) {
   string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGraphCatalog::encap_output_copy_indexes_map_.erase(key);
 }
 
 // Functions relating Input Variable Shared Name Map
 void NGraphCatalog::AddToInputVariableSharedNameMap(const string& key,
                                                     const string& val) {
-  if (NGraphCatalog::ExistsInInputVariableSharedNameMap(key)) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  if (!NGraphCatalog::input_variable_sharedname_map_.insert({key, val})
+           .second) {
     throw runtime_error(
         "Trying to add an already existing key in InputVariableSharedName Map");
   }
-  NGraphCatalog::input_variable_sharedname_map_.insert({key, val});
 }
 
 void NGraphCatalog::ClearInputVariableSharedNameMap() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGraphCatalog::input_variable_sharedname_map_.clear();
 }
 
-const string& NGraphCatalog::GetInputVariableSharedName(
-    const int& graphid, const string& node_name, const int& input_index) {
+string NGraphCatalog::GetInputVariableSharedName(const int& graphid,
+                                                 const string& node_name,
+                                                 const int& input_index) {
   string node_key =
       NGraphCatalog::CreateNodeKey(graphid, node_name, input_index);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   return NGraphCatalog::input_variable_sharedname_map_.at(node_key);
 }
 
 bool NGraphCatalog::ExistsInInputVariableSharedNameMap(const string& key) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   auto itr = NGraphCatalog::input_variable_sharedname_map_.find(key);
   return itr != NGraphCatalog::input_variable_sharedname_map_.end();
 }
@@ -138,33 +157,30 @@ bool NGraphCatalog::ExistsInInputVariableSharedNameMap(const int& graphid,
 }
 
 void NGraphCatalog::DeleteFromInputVariableSharedNameMap(const string& key) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGraphCatalog::input_variable_sharedname_map_.erase(key);
 }
 
 // Functions for EncapOutputInfo Map
 void NGraphCatalog::AddToEncapOutputInfoMap(const string& key,
                                             const tuple<string, bool>& val) {
-  if (NGraphCatalog::ExistsInEncapOutputInfoMap(key)) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  if (!NGraphCatalog::encap_output_info_map_.insert({key, val}).second) {
     throw runtime_error(
         "Trying to add an already existing key in EncapOutputInfo Map");
   }
-  NGraphCatalog::encap_output_info_map_.insert({key, val});
 }
 
 void NGraphCatalog::AddToEncapOutputInfoMap(const string& key,
                                             const string& shared_name,
                                             const bool& copy_to_tf) {
-  if (NGraphCatalog::ExistsInEncapOutputInfoMap(key)) {
-    throw runtime_error(
-        "Trying to add an already existing key in EncapOutputInfo Map");
-  }
-
   // create a tuple
   tuple<string, bool> val = make_tuple(shared_name, copy_to_tf);
-  NGraphCatalog::encap_output_info_map_.insert({key, val});
+  NGraphCatalog::AddToEncapOutputInfoMap(key, val);
 }
 
 bool NGraphCatalog::ExistsInEncapOutputInfoMap(const string& key) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   auto itr = NGraphCatalog::encap_output_info_map_.find(key);
   return itr != NGraphCatalog::encap_output_info_map_.end();
 }
@@ -172,37 +188,39 @@ bool NGraphCatalog::ExistsInEncapOutputInfoMap(const string& key) {
 bool NGraphCatalog::ExistsInEncapOutputInfoMap(const int& graphid,
                                                const string& node_name,
                                                const int& input_index) {
-  string key = NGraphCatalog::CreateNodeKey(graphid, node_name, input_index);
-  auto itr = NGraphCatalog::encap_output_info_map_.find(key);
-  return itr != NGraphCatalog::encap_output_info_map_.end();
+  return NGraphCatalog::ExistsInEncapOutputInfoMap(
+      NGraphCatalog::CreateNodeKey(graphid, node_name, input_index));
 }
 
-const tuple<string, bool>& NGraphCatalog::GetInfoFromEncapOutputInfoMap(
+tuple<string, bool> NGraphCatalog::GetInfoFromEncapOutputInfoMap(
     const string& key) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   return NGraphCatalog::encap_output_info_map_.at(key);
 }
 
-const string& NGraphCatalog::GetVariableSharedNameFromEncapOutputInfoMap(
+string NGraphCatalog::GetVariableSharedNameFromEncapOutputInfoMap(
     const string& key) {
-  tuple<string, bool>& val = NGraphCatalog::encap_output_info_map_.at(key);
-  return get<0>(val);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  return get<0>(NGraphCatalog::encap_output_info_map_.at(key));
 }
 
-const bool& NGraphCatalog::GetCopyToTFFromEncapOutputInfoMap(
-    const string& key) {
-  tuple<string, bool>& val = NGraphCatalog::encap_output_info_map_.at(key);
-  return get<1>(val);
+bool NGraphCatalog::GetCopyToTFFromEncapOutputInfoMap(const string& key) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  return get<1>(NGraphCatalog::encap_output_info_map_.at(key));
 }
 
 void NGraphCatalog::DeleteFromEncapOutputInfoMap(const string& key) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGraphCatalog::encap_output_info_map_.erase(key);
 }
 
 void NGraphCatalog::ClearEncapOutputInfoMap() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGraphCatalog::encap_output_info_map_.clear();
 }
 
 void NGraphCatalog::PrintEncapOutputInfoMap() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGRAPH_VLOG(4) << "EncapOutputInfoMap";
   for (auto it : encap_output_info_map_) {
     NGRAPH_VLOG(4) << "Key: (GraphId_NodeName:OutputIndex) " << it.first
@@ -216,11 +234,11 @@ void NGraphCatalog::AddToPrefetchedInputIndexMap(
     const int& graphid, const string& node_name,
     const unordered_set<int>& val) {
   string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
-  if (NGraphCatalog::ExistsInPrefetchedInputIndexMap(key)) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  if (!NGraphCatalog::prefetched_input_index_map_.insert({key, val}).second) {
     throw runtime_error("Trying to add an already existing key ( " + key +
                         " ) in PrefetchedInputIndexMap ");
   }
-  NGraphCatalog::prefetched_input_index_map_.insert({key, val});
 }
 
 bool NGraphCatalog::ExistsInPrefetchedInputIndexMap(const int& graphid,
@@ -230,21 +248,25 @@ bool NGraphCatalog::ExistsInPrefetchedInputIndexMap(const int& graphid,
 }
 
 bool NGraphCatalog::ExistsInPrefetchedInputIndexMap(const string& key) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   auto itr = NGraphCatalog::prefetched_input_index_map_.find(key);
   return itr != NGraphCatalog::prefetched_input_index_map_.end();
 }
 
-const unordered_set<int>& NGraphCatalog::GetIndexesFromPrefetchedInputIndexMap(
+unordered_set<int> NGraphCatalog::GetIndexesFromPrefetchedInputIndexMap(
     const int& graphid, const string& node_name) {
   string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   return NGraphCatalog::prefetched_input_index_map_.at(key);
 }
 
 void NGraphCatalog::ClearPrefetchedInputIndexMap() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGraphCatalog::prefetched_input_index_map_.clear();
 }
 
 void NGraphCatalog::PrintPrefetchedInputIndexMap() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
   NGRAPH_VLOG(4) << "PrefetchedInputIndexMap";
   for (auto it : prefetched_input_index_map_) {
     NGRAPH_VLOG(4) << "Key: (GraphId_NodeName) " << it.first;
@@ -253,5 +275,142 @@ void NGraphCatalog::PrintPrefetchedInputIndexMap() {
     }
   }
 }
+
+// Functions for PrefetchedInputComponent Map
+void NGraphCatalog::AddToPrefetchedInputComponentMap(const int& graphid,
+                                                     const string& node_name,
+                                                     const int& input_index,
+                                                     const int& component) {
+  string key = NGraphCatalog::CreateNodeKey(graphid, node_name, input_index);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  if (!NGraphCatalog::prefetched_input_component_map_.insert({key, component})
+           .second) {
+    throw runtime_error("Trying to add an already existing key ( " + key +
+                        " ) in PrefetchedInputComponentMap ");
+  }
+}
+
+bool NGraphCatalog::ExistsInPrefetchedInputComponentMap(
+    const int& graphid, const string& node_name, const int& input_index) {
+  string key = NGraphCatalog::CreateNodeKey(graphid, node_name, input_index);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  auto itr = NGraphCatalog::prefetched_input_component_map_.find(key);
+  return itr != NGraphCatalog::prefetched_input_component_map_.end();
+}
+
+int NGraphCatalog::GetPrefetchedInputComponent(const int& graphid,
+                                               const string& node_name,
+                                               const int& input_index) {
+  string key = NGraphCatalog::CreateNodeKey(graphid, node_name, input_index);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  return NGraphCatalog::prefetched_input_component_map_.at(key);
+}
+
+void NGraphCatalog::ClearPrefetchedInputComponentMap() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  NGraphCatalog::prefetched_input_component_map_.clear();
+}
+
+// Functions for PrefetchIterator Map
+void NGraphCatalog::AddToPrefetchIteratorMap(const int& graphid,
+                                             const string& node_name,
+                                             const int& iterator_graph_id,
+                                             const string& iterator_name) {
+  string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  if (!NGraphCatalog::prefetch_iterator_map_
+           .insert({key, make_pair(iterator_graph_id, iterator_name)})
+           .second) {
+    throw runtime_error("Trying to add an already existing key ( " + key +
+                        " ) in PrefetchIteratorMap ");
+  }
+}
+
+bool NGraphCatalog::ExistsInPrefetchIteratorMap(const int& graphid,
+                                                const string& node_name) {
+  string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  auto itr = NGraphCatalog::prefetch_iterator_map_.find(key);
+  return itr != NGraphCatalog::prefetch_iterator_map_.end();
+}
+
+string NGraphCatalog::GetPrefetchIterator(const int& graphid,
+                                          const string& node_name) {
+  string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  return NGraphCatalog::prefetch_iterator_map_.at(key).second;
+}
+
+int NGraphCatalog::GetPrefetchIteratorGraphId(const int& graphid,
+                                              const string& node_name) {
+  string key = NGraphCatalog::CreateNodeKey(graphid, node_name);
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  return NGraphCatalog::prefetch_iterator_map_.at(key).first;
+}
+
+void NGraphCatalog::ClearPrefetchIteratorMap() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  NGraphCatalog::prefetch_iterator_map_.clear();
+}
+
+// Functions for PrefetchDatasetIterators Set
+void NGraphCatalog::AddToPrefetchDatasetIterators(
+    const int& graphid, const string& iterator_name) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  NGraphCatalog::prefetch_dataset_iterators_[graphid].insert(iterator_name);
+}
+
+bool NGraphCatalog::ExistsInPrefetchDatasetIterators(
+    const int& graphid, const string& iterator_name) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  auto itr = NGraphCatalog::prefetch_dataset_iterators_.find(graphid);
+  return itr != NGraphCatalog::prefetch_dataset_iterators_.end() &&
+         itr->second.find(iterator_name) != itr->second.end();
+}
+
+void NGraphCatalog::ClearPrefetchDatasetIterators(const int& graphid) {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  NGraphCatalog::prefetch_dataset_iterators_.erase(graphid);
+}
+
+void NGraphCatalog::ClearPrefetchDatasetIterators() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  NGraphCatalog::prefetch_dataset_iterators_.clear();
+}
+
+NGraphCatalog::EncapsulateEntries NGraphCatalog::GetEncapsulateEntries(
+    const int& graphid, const string& node_name, const int& num_inputs,
+    const int& num_outputs) {
+  EncapsulateEntries entries;
+  entries.input_variable_shared_names.resize(num_inputs);
+  entries.output_variable_shared_names.resize(num_outputs);
+  entries.output_copy_to_tf.resize(num_outputs, false);
+  entries.output_needs_copy.resize(num_outputs, false);
+
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  for (int i = 0; i < num_inputs; i++) {
+    auto itr = NGraphCatalog::input_variable_sharedname_map_.find(
+        NGraphCatalog::CreateNodeKey(graphid, node_name, i));
+    if (itr != NGraphCatalog::input_variable_sharedname_map_.end()) {
+      entries.input_variable_shared_names[i] = itr->second;
+    }
+  }
+
+  auto copy_itr = NGraphCatalog::encap_output_copy_indexes_map_.find(
+      NGraphCatalog::CreateNodeKey(graphid, node_name));
+  for (int i = 0; i < num_outputs; i++) {
+    auto itr = NGraphCatalog::encap_output_info_map_.find(
+        NGraphCatalog::CreateNodeKey(graphid, node_name, i));
+    if (itr != NGraphCatalog::encap_output_info_map_.end()) {
+      entries.output_variable_shared_names[i] = get<0>(itr->second);
+      entries.output_copy_to_tf[i] = get<1>(itr->second);
+    }
+    if (copy_itr != NGraphCatalog::encap_output_copy_indexes_map_.end()) {
+      entries.output_needs_copy[i] = copy_itr->second.count(i) > 0;
+    }
+  }
+  return entries;
+}
+
 }  // ngraph_bridge
 }  // tensorflow
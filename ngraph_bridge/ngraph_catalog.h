@@ -20,6 +20,8 @@
 #include <atomic>
 #include <mutex>
 #include <ostream>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "tensorflow/core/lib/core/errors.h"
@@ -47,7 +49,6 @@ class NGraphCatalog {
   //   otherwise
   //     string : GraphId + _ + nodename + : + input_index
   // Value : variable shared_name
-  // LOCK?
   static unordered_map<string, string> input_variable_sharedname_map_;
 
   // Map keeps track of output indexes of NGraphEncapsulate Op
@@ -85,7 +86,69 @@ class NGraphCatalog {
   // Value : Set of indices
   static unordered_map<string, unordered_set<int>> prefetched_input_index_map_;
 
+  // Map keeps track of the IteratorGetNext output (i.e. the dataset
+  // component) feeding each input in PrefetchedInputIndexMap.
+  // Will be used by NGraphEncapsulate Op and NGraphPrefetchDataset to stage
+  // the components in the right input tensors.
+  // Map of
+  // Key
+  //   when input index ==0
+  //      string : GraphId + _ + nodename
+  //   otherwise
+  //     string : GraphId + _ + nodename + : + input_index
+  // Value : IteratorGetNext output index
+  static unordered_map<string, int> prefetched_input_component_map_;
+
+  // Map keeps track of the iterator feeding the prefetched inputs of the
+  // encap nodes in PrefetchedInputIndexMap.
+  // Will be used by NGraphEncapsulate Op to register with the
+  // NGraphPrefetchDataset of that iterator.
+  // Map of
+  // Key
+  //      string : GraphId + _ + nodename
+  // Value : pair of the id of the graph the iterator was captured in, and
+  //         the iterator node name
+  static unordered_map<string, pair<int, string>> prefetch_iterator_map_;
+
+  // Keeps track of the iterators whose PrefetchDataset was replaced by
+  // a NGraphPrefetchDataset when the variables of a graph were captured.
+  // Will be used when entering the prefetched inputs in the catalog, which
+  // usually happens on a different (pruned) graph: the iterator node carries
+  // the id of the graph it was captured in ("_ngraph_prefetch_graph_id").
+  // Iterators of different graphs may have the same name.
+  // Map of
+  // Key
+  //      int : GraphId of the captured graph
+  // Value : set of iterator node names
+  static unordered_map<int, unordered_set<string>> prefetch_dataset_iterators_;
+
+  // The maps are filled by the rewrite passes of every graph in the process
+  // and pruned by the kernel destructors, possibly concurrently.
+  // This mutex guards all of them
+  static std::mutex catalog_mutex_;
+
  public:
+  // Catalog entries of one NGraphEncapsulate Op, indexed by input/output
+  // index. The kernel resolves them once when it is constructed so that the
+  // per step code does not build or hash any key.
+  // An empty shared name means that the input is not fed by a variable
+  // (the output is not assigned to a variable)
+  struct EncapsulateEntries {
+    vector<string> input_variable_shared_names;
+    vector<string> output_variable_shared_names;
+    vector<bool> output_copy_to_tf;
+    vector<bool> output_needs_copy;
+
+    bool IsInputFromVariable(const int& index) const {
+      return index < input_variable_shared_names.size() &&
+             !input_variable_shared_names[index].empty();
+    }
+    bool IsOutputToVariable(const int& index) const {
+      return index < output_variable_shared_names.size() &&
+             !output_variable_shared_names[index].empty();
+    }
+  };
+
   // Utility to create key to query the maps
   static string CreateNodeKey(const int& graph_id, const string& node_name,
                               const int& index);
@@ -107,7 +170,7 @@ class NGraphCatalog {
   static bool EncapOutputIndexNeedsCopy(const int& graphid,
                                         const string& node_name,
                                         const int& index);
-  static const unordered_set<int>& GetEncapOutputIndexesThatNeedCopy(
+  static unordered_set<int> GetEncapOutputIndexesThatNeedCopy(
       const int& graphid, const string& node_name);
   static void DeleteFromEncapOutputCopyIndexesMap(const int& graphid,
                                                   const string& node_name);
@@ -117,9 +180,9 @@ class NGraphCatalog {
                                               const string& val);
 
   static void ClearInputVariableSharedNameMap();
-  static const string& GetInputVariableSharedName(const int& graphid,
-                                                  const string& node_name,
-                                                  const int& input_index);
+  static string GetInputVariableSharedName(const int& graphid,
+                                           const string& node_name,
+                                           const int& input_index);
   static bool ExistsInInputVariableSharedNameMap(const string& key);
   static bool ExistsInInputVariableSharedNameMap(const int& graphid,
                                                  const string& node_name,
@@ -136,11 +199,9 @@ class NGraphCatalog {
   static bool ExistsInEncapOutputInfoMap(const int& graphid,
                                          const string& node_name,
                                          const int& output_index);
-  static const tuple<string, bool>& GetInfoFromEncapOutputInfoMap(
-      const string& key);
-  static const string& GetVariableSharedNameFromEncapOutputInfoMap(
-      const string& key);
-  static const bool& GetCopyToTFFromEncapOutputInfoMap(const string& key);
+  static tuple<string, bool> GetInfoFromEncapOutputInfoMap(const string& key);
+  static string GetVariableSharedNameFromEncapOutputInfoMap(const string& key);
+  static bool GetCopyToTFFromEncapOutputInfoMap(const string& key);
   static void DeleteFromEncapOutputInfoMap(const string& key);
   static void ClearEncapOutputInfoMap();
   static void PrintEncapOutputInfoMap();
@@ -152,11 +213,51 @@ class NGraphCatalog {
   static bool ExistsInPrefetchedInputIndexMap(const int& graphid,
                                               const string& node_name);
   static bool ExistsInPrefetchedInputIndexMap(const string& key);
-  static const unordered_set<int>& GetIndexesFromPrefetchedInputIndexMap(
+  static unordered_set<int> GetIndexesFromPrefetchedInputIndexMap(
       const int& graphid, const string& node_name);
 
   static void ClearPrefetchedInputIndexMap();
   static void PrintPrefetchedInputIndexMap();
+
+  // Functions for PrefetchedInputComponent Map
+  static void AddToPrefetchedInputComponentMap(const int& graphid,
+                                               const string& node_name,
+                                               const int& input_index,
+                                               const int& component);
+  static bool ExistsInPrefetchedInputComponentMap(const int& graphid,
+                                                  const string& node_name,
+                                                  const int& input_index);
+  static int GetPrefetchedInputComponent(const int& graphid,
+                                         const string& node_name,
+                                         const int& input_index);
+  static void ClearPrefetchedInputComponentMap();
+
+  // Functions for PrefetchIterator Map
+  static void AddToPrefetchIteratorMap(const int& graphid,
+                                       const string& node_name,
+                                       const int& iterator_graph_id,
+                                       const string& iterator_name);
+  static bool ExistsInPrefetchIteratorMap(const int& graphid,
+                                          const string& node_name);
+  static string GetPrefetchIterator(const int& graphid,
+                                    const string& node_name);
+  static int GetPrefetchIteratorGraphId(const int& graphid,
+                                        const string& node_name);
+  static void ClearPrefetchIteratorMap();
+
+  // Functions for PrefetchDatasetIterators Set
+  static void AddToPrefetchDatasetIterators(const int& graphid,
+                                            const string& iterator_name);
+  static bool ExistsInPrefetchDatasetIterators(const int& graphid,
+                                               const string& iterator_name);
+  static void ClearPrefetchDatasetIterators(const int& graphid);
+  static void ClearPrefetchDatasetIterators();
+
+  // Looks up all the entries of the encapsulate "node_name" at once
+  static EncapsulateEntries GetEncapsulateEntries(const int& graphid,
+                                                  const string& node_name,
+                                                  const int& num_inputs,
+                                                  const int& num_outputs);
 };
 
 }  // ngraph_bridge
@@ -0,0 +1,261 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "tensorflow/core/common_runtime/shape_refiner.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/algorithm.h"
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/ngraph_cluster_cost_model.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Copying a byte into or out of a cluster is taken to be worth as much as
+// this many flops
+static const double kBoundaryFlopsPerByte = 4.0;
+// Fixed overhead of every tensor crossing the boundary (allocation,
+// conversion to and from nGraph tensors)
+static const double kBoundaryFlopsPerEdge = 1e4;
+// Fixed overhead of every cluster (executable lookup and call)
+static const double kClusterOverheadFlops = 1e5;
+
+// Static shape of the tensor feeding input "index" of "node"
+static bool GetInputShape(const Node* node, int index,
+                          const OutputShapes& shapes,
+                          PartialTensorShape* shape) {
+  const Edge* edge;
+  if (!node->input_edge(index, &edge).ok()) {
+    return false;
+  }
+  const auto& src_shapes = shapes[edge->src()->id()];
+  if (edge->src_output() >= static_cast<int>(src_shapes.size())) {
+    return false;
+  }
+  *shape = src_shapes[edge->src_output()];
+  return shape->IsFullyDefined();
+}
+
+bool ClusterCostModel::EstimateNode(const Node* node,
+                                    const OutputShapes& shapes, int64* flops,
+                                    int64* bytes) const {
+  *flops = 0;
+  *bytes = 0;
+  const auto& node_shapes = shapes[node->id()];
+  if (static_cast<int>(node_shapes.size()) != node->num_outputs()) {
+    return false;
+  }
+
+  int64 output_elements = 0;
+  for (int i = 0; i < node->num_outputs(); i++) {
+    if (!node_shapes[i].IsFullyDefined()) {
+      return false;
+    }
+    int64 num_elements = node_shapes[i].num_elements();
+    output_elements += num_elements;
+    *bytes += num_elements * DataTypeSize(BaseType(node->output_type(i)));
+  }
+
+  const string& op = node->type_string();
+  if (op == "Const" || op == "Identity" || op == "Reshape" ||
+      op == "Squeeze" || op == "ExpandDims") {
+    return true;
+  }
+
+  if (op == "MatMul") {
+    PartialTensorShape a;
+    bool transpose_a = false;
+    if (!GetInputShape(node, 0, shapes, &a) || a.dims() != 2) {
+      return false;
+    }
+    GetNodeAttr(node->attrs(), "transpose_a", &transpose_a);
+    *flops = 2 * output_elements * a.dim_size(transpose_a ? 0 : 1);
+    return true;
+  }
+
+  if (op == "BatchMatMul" || op == "BatchMatMulV2") {
+    PartialTensorShape x;
+    bool adj_x = false;
+    if (!GetInputShape(node, 0, shapes, &x) || x.dims() < 2) {
+      return false;
+    }
+    GetNodeAttr(node->attrs(), "adj_x", &adj_x);
+    *flops = 2 * output_elements * x.dim_size(x.dims() - (adj_x ? 2 : 1));
+    return true;
+  }
+
+  if (op == "Conv2D" || op == "Conv3D" || op == "DepthwiseConv2dNative") {
+    // filter is [spatial dims..., in_channels, out_channels (or multiplier)]
+    PartialTensorShape filter;
+    if (!GetInputShape(node, 1, shapes, &filter) || filter.dims() < 3) {
+      return false;
+    }
+    int64 macs_per_output = 1;
+    int num_reduced_dims =
+        op == "DepthwiseConv2dNative" ? filter.dims() - 2 : filter.dims() - 1;
+    for (int i = 0; i < num_reduced_dims; i++) {
+      macs_per_output *= filter.dim_size(i);
+    }
+    *flops = 2 * output_elements * macs_per_output;
+    return true;
+  }
+
+  if (op == "Sum" || op == "Mean" || op == "Max" || op == "Min" ||
+      op == "Prod" || op == "All" || op == "Any") {
+    PartialTensorShape input;
+    if (!GetInputShape(node, 0, shapes, &input)) {
+      return false;
+    }
+    *flops = input.num_elements();
+    return true;
+  }
+
+  *flops = output_elements;
+  return true;
+}
+
+double ClusterCostModel::BoundaryCost(int64 bytes, int num_edges) const {
+  return kBoundaryFlopsPerByte * bytes + kBoundaryFlopsPerEdge * num_edges;
+}
+
+double ClusterCostModel::Gain(const ClusterCost& cost) const {
+  return cost.flops - BoundaryCost(cost.boundary_bytes, cost.boundary_edges) -
+         kClusterOverheadFlops;
+}
+
+ClusterCost ClusterCostModel::Estimate(const std::set<Node*>& nodes,
+                                       const OutputShapes& shapes) const {
+  ClusterCost cost = ClusterCost();
+  cost.complete = true;
+
+  for (auto node : nodes) {
+    int64 node_flops = 0;
+    int64 node_bytes = 0;
+    if (!EstimateNode(node, shapes, &node_flops, &node_bytes)) {
+      NGRAPH_VLOG(5) << "Cannot estimate cost of " << node->name() << " ["
+                     << node->type_string() << "]";
+      cost.complete = false;
+    }
+    cost.flops += node_flops;
+    cost.bytes += node_bytes;
+
+    for (auto edge : node->in_edges()) {
+      if (edge->IsControlEdge() || nodes.count(edge->src()) != 0) {
+        continue;
+      }
+      int64 bytes = OutputBytes(edge->src(), edge->src_output(), shapes);
+      cost.complete &= (bytes >= 0);
+      cost.boundary_bytes += std::max<int64>(bytes, 0);
+      cost.boundary_edges++;
+    }
+    for (auto edge : node->out_edges()) {
+      if (edge->IsControlEdge() || nodes.count(edge->dst()) != 0) {
+        continue;
+      }
+      int64 bytes = OutputBytes(node, edge->src_output(), shapes);
+      cost.complete &= (bytes >= 0);
+      cost.boundary_bytes += std::max<int64>(bytes, 0);
+      cost.boundary_edges++;
+    }
+  }
+
+  cost.gain = Gain(cost);
+  return cost;
+}
+
+void ClusterCostModel::InferOutputShapes(const Graph& graph,
+                                         OutputShapes* shapes) {
+  shapes->assign(graph.num_node_ids(), std::vector<PartialTensorShape>());
+  ShapeRefiner refiner(graph.versions(), graph.op_registry());
+
+  std::vector<Node*> order;
+  GetReversePostOrder(graph, &order);
+  for (auto node : order) {
+    if (!node->IsOp()) {
+      continue;
+    }
+    auto& node_shapes = (*shapes)[node->id()];
+    std::vector<PartialTensorShape> output_shapes;
+    if (GetNodeAttr(node->attrs(), "_output_shapes", &output_shapes).ok() &&
+        static_cast<int>(output_shapes.size()) == node->num_outputs()) {
+      node_shapes = output_shapes;
+    }
+
+    // Shape inference fails for the nodes fed by a loop back edge (and
+    // everything downstream of them), these are left unknown
+    Status status = refiner.AddNode(node);
+    if (!status.ok()) {
+      NGRAPH_VLOG(5) << "Shape inference failed for " << node->name() << ": "
+                     << status.error_message();
+      if (node_shapes.empty()) {
+        node_shapes.resize(node->num_outputs());
+      }
+      continue;
+    }
+    if (node_shapes.empty()) {
+      shape_inference::InferenceContext* ctx = refiner.GetContext(node);
+      for (int i = 0; i < ctx->num_outputs(); i++) {
+        TensorShapeProto proto;
+        ctx->ShapeHandleToProto(ctx->output(i), &proto);
+        node_shapes.emplace_back(proto);
+      }
+    }
+  }
+}
+
+int64 ClusterCostModel::OutputBytes(const Node* node, int index,
+                                    const OutputShapes& shapes) {
+  const auto& node_shapes = shapes[node->id()];
+  if (index >= static_cast<int>(node_shapes.size()) ||
+      !node_shapes[index].IsFullyDefined()) {
+    return -1;
+  }
+  return node_shapes[index].num_elements() *
+         DataTypeSize(BaseType(node->output_type(index)));
+}
+
+bool ClusterCostModel::IsEnabled() {
+  return std::getenv("NGRAPH_TF_CLUSTER_COST_MODEL") != nullptr;
+}
+
+std::shared_ptr<const ClusterCostModel> ClusterCostModel::s_model =
+    std::make_shared<ClusterCostModel>();
+std::mutex ClusterCostModel::s_mutex;
+
+std::shared_ptr<const ClusterCostModel> ClusterCostModel::GetModel() {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  return s_model;
+}
+
+void ClusterCostModel::SetModel(std::unique_ptr<ClusterCostModel> model) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  if (model == nullptr) {
+    s_model = std::make_shared<ClusterCostModel>();
+  } else {
+    s_model = std::move(model);
+  }
+}
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#ifndef NGRAPH_TF_CLUSTER_COST_MODEL_H_
+#define NGRAPH_TF_CLUSTER_COST_MODEL_H_
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Static output shapes of the nodes of a graph, indexed by node id
+using OutputShapes = std::vector<std::vector<PartialTensorShape>>;
+
+// Estimates for the nodes of a single cluster. The costs are in "flops", i.e.
+// the boundary copies are expressed as the compute they are worth
+struct ClusterCost {
+  int64 flops;           // compute of the nodes in the cluster
+  int64 bytes;           // bytes of the tensors produced in the cluster
+  int64 boundary_bytes;  // bytes of the tensors crossing the cluster boundary
+  int boundary_edges;    // number of data edges crossing the boundary
+  bool complete;         // false if some shape was not statically known
+  double gain;           // expected benefit of running the cluster in nGraph
+};
+
+// Cost model used by DeassignClusters to decide whether a cluster is worth
+// running through nGraph: a cluster whose boundary copies cost more than its
+// compute is given back to TensorFlow.
+//
+// The default model counts the multiply-adds of MatMul, BatchMatMul and
+// convolutions, the input elements of reductions and the output elements of
+// everything else, and charges the bytes crossing the cluster boundary plus a
+// fixed overhead per boundary edge and per cluster. Other models can be
+// plugged in with SetModel().
+//
+// Enabled by NGRAPH_TF_CLUSTER_COST_MODEL. Clusters with shapes that are not
+// statically known are always kept.
+class ClusterCostModel {
+ public:
+  virtual ~ClusterCostModel() {}
+
+  // Estimated flops and output bytes of "node". Returns false if they cannot
+  // be estimated from the static shapes
+  virtual bool EstimateNode(const Node* node, const OutputShapes& shapes,
+                            int64* flops, int64* bytes) const;
+  // Cost of copying "bytes" over "num_edges" edges into or out of a cluster
+  virtual double BoundaryCost(int64 bytes, int num_edges) const;
+  // Expected gain of a cluster with the given estimates. A negative gain
+  // means the cluster is better left to TensorFlow
+  virtual double Gain(const ClusterCost& cost) const;
+  // Identifies the model in the key of the NGraphClusteringCache. Models
+  // with settings that change their decisions should return them as well
+  virtual std::string Signature() const { return "default"; }
+
+  // Estimates the cluster made of "nodes"
+  ClusterCost Estimate(const std::set<Node*>& nodes,
+                       const OutputShapes& shapes) const;
+
+  // Static output shapes of the nodes of "graph", taken from their
+  // _output_shapes attribute or else from shape inference
+  static void InferOutputShapes(const Graph& graph, OutputShapes* shapes);
+  // Bytes of output "index" of "node", or -1 if its shape is not static
+  static int64 OutputBytes(const Node* node, int index,
+                           const OutputShapes& shapes);
+
+  static bool IsEnabled();
+  // The model in use, the default one unless replaced by SetModel()
+  static std::shared_ptr<const ClusterCostModel> GetModel();
+  // Replaces the model in use, nullptr restores the default one
+  static void SetModel(std::unique_ptr<ClusterCostModel> model);
+
+ private:
+  static std::shared_ptr<const ClusterCostModel> s_model;
+  static std::mutex s_mutex;
+};
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_CLUSTER_COST_MODEL_H_
@@ -0,0 +1,392 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+#include <typeinfo>
+
+#include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/ngraph_api.h"
+#include "ngraph_bridge/ngraph_cluster_cost_model.h"
+#include "ngraph_bridge/ngraph_cluster_manager.h"
+#include "ngraph_bridge/ngraph_clustering_cache.h"
+#include "ngraph_bridge/version.h"
+
+extern char** environ;
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Static initializers
+std::map<uint64, std::shared_ptr<NGraphClusteringCache::Entry>>
+    NGraphClusteringCache::s_entries;
+std::deque<uint64> NGraphClusteringCache::s_insertion_order;
+std::mutex NGraphClusteringCache::s_mutex;
+
+static const char* GetCacheDir() {
+  return std::getenv("NGRAPH_TF_CLUSTERING_CACHE_DIR");
+}
+
+static size_t GetMaxItems() {
+  const char* value = std::getenv("NGRAPH_TF_CLUSTERING_CACHE_MAX_ITEMS");
+  return value == nullptr ? 16 : std::max(1, atoi(value));
+}
+
+static string ClusterFunctionName(int cluster_id) {
+  return "ngraph_cluster_" + to_string(cluster_id);
+}
+
+bool NGraphClusteringCache::IsEnabled() {
+  return std::getenv("NGRAPH_TF_CLUSTERING_CACHE") != nullptr;
+}
+
+uint64 NGraphClusteringCache::ComputeKey(
+    const GraphDef& graph_def, const string& backend,
+    const std::unordered_map<string, string>& config_map,
+    const std::set<string>& skip_these_nodes) {
+  // Canonical form of the graph: nodes sorted by name, control inputs sorted,
+  // no graph ids and the functions and gradients of the library sorted by
+  // name
+  GraphDef canonical = graph_def;
+  std::sort(canonical.mutable_node()->pointer_begin(),
+            canonical.mutable_node()->pointer_end(),
+            [](const NodeDef* a, const NodeDef* b) {
+              return a->name() < b->name();
+            });
+  for (auto& node : *canonical.mutable_node()) {
+    auto inputs = node.mutable_input();
+    auto first_control = std::find_if(
+        inputs->begin(), inputs->end(),
+        [](const string& input) { return !input.empty() && input[0] == '^'; });
+    std::sort(first_control, inputs->end());
+    node.mutable_attr()->erase("ngraph_graph_id");
+  }
+  auto library = canonical.mutable_library();
+  std::sort(library->mutable_function()->pointer_begin(),
+            library->mutable_function()->pointer_end(),
+            [](const FunctionDef* a, const FunctionDef* b) {
+              return a->signature().name() < b->signature().name();
+            });
+  std::sort(library->mutable_gradient()->pointer_begin(),
+            library->mutable_gradient()->pointer_end(),
+            [](const GradientDef* a, const GradientDef* b) {
+              return a->function_name() < b->function_name();
+            });
+  string serialized;
+  SerializeToStringDeterministic(canonical, &serialized);
+  uint64 key = Fingerprint64(serialized);
+
+  key = FingerprintCat64(key, Fingerprint64(backend));
+  std::map<string, string> sorted_config(config_map.begin(), config_map.end());
+  for (const auto& itr : sorted_config) {
+    key = FingerprintCat64(key, Fingerprint64(itr.first));
+    key = FingerprintCat64(key, Fingerprint64(itr.second));
+  }
+  for (const auto& node_name : skip_these_nodes) {
+    key = FingerprintCat64(key, Fingerprint64(node_name));
+  }
+  for (const auto& op_type : config::GetDisabledOps()) {
+    key = FingerprintCat64(key, Fingerprint64("disabled:" + op_type));
+  }
+  // The model decides which clusters are deassigned
+  if (ClusterCostModel::IsEnabled()) {
+    auto model = ClusterCostModel::GetModel();
+    key = FingerprintCat64(
+        key, Fingerprint64(string("cost_model:") + typeid(*model).name() +
+                           ":" + model->Signature()));
+  }
+
+  std::set<string> env;
+  for (char** var = environ; var != nullptr && *var != nullptr; var++) {
+    if (strncmp(*var, "NGRAPH_TF_", strlen("NGRAPH_TF_")) == 0) {
+      env.insert(*var);
+    }
+  }
+  for (const auto& var : env) {
+    key = FingerprintCat64(key, Fingerprint64(var));
+  }
+
+  key = FingerprintCat64(key, Fingerprint64(ngraph_tf_version()));
+  key = FingerprintCat64(key, Fingerprint64(ngraph_lib_version()));
+  return key;
+}
+
+Status NGraphClusteringCache::Insert(uint64 key, const GraphDef& encapsulated,
+                                     const FunctionDefLibrary* fdeflib) {
+  auto entry = std::make_shared<Entry>();
+  entry->graph = encapsulated;
+  if (fdeflib != nullptr) {
+    entry->library = *fdeflib;
+  }
+  for (const auto& node : encapsulated.node()) {
+    if (node.op() != "NGraphEncapsulate") {
+      continue;
+    }
+    auto itr = node.attr().find("ngraph_cluster");
+    if (itr == node.attr().end()) {
+      return errors::Internal("No ngraph_cluster attribute for ", node.name());
+    }
+    int cluster_id = itr->second.i();
+    GraphDef* cluster_graph = NGraphClusterManager::GetClusterGraph(cluster_id);
+    if (cluster_graph == nullptr) {
+      return errors::Internal("Did not find cluster ", cluster_id, " of ",
+                              node.name(), " in NGraphClusterManager");
+    }
+    entry->clusters[cluster_id] = *cluster_graph;
+  }
+
+  InsertEntry(key, entry);
+  NGRAPH_VLOG(1) << "Clustering cache: inserted " << key << " with "
+                 << entry->clusters.size() << " clusters";
+
+  // Failing to share the results with the other processes only costs them
+  // the clustering, so it is not an error
+  const char* dir = GetCacheDir();
+  if (dir != nullptr) {
+    Status status = WriteEntry(EntryFilename(dir, key), *entry);
+    if (!status.ok()) {
+      NGRAPH_VLOG(0) << "Clustering cache: could not write " << key << " to "
+                     << dir << ": " << status.error_message();
+    }
+  }
+  return Status::OK();
+}
+
+bool NGraphClusteringCache::Lookup(uint64 key, int graph_id,
+                                   GraphDef* encapsulated,
+                                   FunctionDefLibrary* fdeflib) {
+  std::shared_ptr<Entry> entry;
+  {
+    std::lock_guard<std::mutex> guard(s_mutex);
+    auto itr = s_entries.find(key);
+    if (itr != s_entries.end()) {
+      entry = itr->second;
+    }
+  }
+
+  const char* dir = GetCacheDir();
+  if (entry == nullptr && dir != nullptr) {
+    string filename = EntryFilename(dir, key);
+    if (Env::Default()->FileExists(filename).ok()) {
+      auto read_entry = std::make_shared<Entry>();
+      Status status = ReadEntry(filename, read_entry.get());
+      if (status.ok()) {
+        entry = read_entry;
+        InsertEntry(key, entry);
+      } else {
+        NGRAPH_VLOG(0) << "Clustering cache: could not read " << filename
+                       << ": " << status.error_message();
+      }
+    }
+  }
+
+  if (entry == nullptr) {
+    NGRAPH_VLOG(1) << "Clustering cache: missed " << key;
+    return false;
+  }
+
+  // The cluster ids of the cached graph may have been given to other
+  // clusters since, or evicted from the NGraphClusterManager
+  std::map<int, int> cluster_ids;
+  for (const auto& itr : entry->clusters) {
+    size_t cluster_id = NGraphClusterManager::NewCluster();
+    *NGraphClusterManager::GetClusterGraph(cluster_id) = itr.second;
+    cluster_ids[itr.first] = cluster_id;
+  }
+
+  *encapsulated = entry->graph;
+  for (auto& node : *encapsulated->mutable_node()) {
+    auto attrs = node.mutable_attr();
+    auto itr = attrs->find("ngraph_graph_id");
+    if (itr != attrs->end()) {
+      itr->second.set_i(graph_id);
+    }
+    if (node.op() == "NGraphEncapsulate") {
+      auto& cluster = (*attrs)["ngraph_cluster"];
+      cluster.set_i(cluster_ids.at(cluster.i()));
+    }
+  }
+
+  if (fdeflib != nullptr) {
+    *fdeflib = entry->library;
+    std::map<string, string> function_names;
+    for (const auto& itr : cluster_ids) {
+      function_names[ClusterFunctionName(itr.first)] =
+          ClusterFunctionName(itr.second);
+    }
+    for (auto& fdef : *fdeflib->mutable_function()) {
+      auto itr = function_names.find(fdef.signature().name());
+      if (itr != function_names.end()) {
+        fdef.mutable_signature()->set_name(itr->second);
+      }
+    }
+  }
+
+  NGRAPH_VLOG(1) << "Clustering cache: hit " << key << ", "
+                 << cluster_ids.size() << " clusters";
+  return true;
+}
+
+uint64 NGraphClusteringCache::ComputeKey(
+    const Graph& graph, const string& backend,
+    const std::unordered_map<string, string>& config_map,
+    const std::set<string>& skip_these_nodes) {
+  GraphDef graph_def;
+  graph.ToGraphDef(&graph_def);
+  return ComputeKey(graph_def, backend, config_map, skip_these_nodes);
+}
+
+Status NGraphClusteringCache::Insert(uint64 key, const Graph& graph) {
+  GraphDef graph_def;
+  graph.ToGraphDef(&graph_def);
+  graph_def.clear_library();
+  return Insert(key, graph_def, nullptr);
+}
+
+Status NGraphClusteringCache::Lookup(uint64 key, int graph_id,
+                                     std::unique_ptr<Graph>* graph,
+                                     bool* hit) {
+  GraphDef graph_def;
+  *hit = Lookup(key, graph_id, &graph_def, nullptr);
+  if (!*hit) {
+    return Status::OK();
+  }
+
+  std::unique_ptr<Graph> cached_graph(new Graph((*graph)->flib_def()));
+  GraphConstructorOptions opts;
+  opts.allow_internal_ops = true;
+  opts.expect_device_spec = true;
+  TF_RETURN_IF_ERROR(
+      ConvertGraphDefToGraph(opts, graph_def, cached_graph.get()));
+  // The graphs are placed when the rewrite passes run
+  for (auto node : cached_graph->op_nodes()) {
+    node->set_assigned_device_name(node->requested_device());
+  }
+  graph->swap(cached_graph);
+  return Status::OK();
+}
+
+void NGraphClusteringCache::Clear() {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  s_entries.clear();
+  s_insertion_order.clear();
+}
+
+void NGraphClusteringCache::InsertEntry(uint64 key,
+                                        std::shared_ptr<Entry> entry) {
+  std::lock_guard<std::mutex> guard(s_mutex);
+  if (s_entries.find(key) == s_entries.end()) {
+    s_insertion_order.push_back(key);
+  }
+  s_entries[key] = entry;
+  while (s_insertion_order.size() > GetMaxItems()) {
+    s_entries.erase(s_insertion_order.front());
+    s_insertion_order.pop_front();
+  }
+}
+
+string NGraphClusteringCache::EntryFilename(const string& dir, uint64 key) {
+  std::stringstream ss;
+  ss << "ngraph_clustering_" << std::hex << std::setw(16) << std::setfill('0')
+     << key << ".rec";
+  return io::JoinPath(dir, ss.str());
+}
+
+// An entry is stored as the records
+//   encapsulated graph, function library, (cluster id, cluster graph)*
+// It is written to a temporary file first and renamed, so that the processes
+// sharing the directory never read a partial entry. The temporary file is
+// unique to the write, as the threads of a process may write the same entry
+Status NGraphClusteringCache::WriteEntry(const string& filename,
+                                         const Entry& entry) {
+  static std::atomic<uint64> s_write_count{0};
+  Env* env = Env::Default();
+  string tmp_filename = filename + ".tmp." + to_string(getpid()) + "." +
+                        to_string(env->NowMicros()) + "." +
+                        to_string(s_write_count++);
+  std::unique_ptr<WritableFile> file;
+  TF_RETURN_IF_ERROR(env->NewWritableFile(tmp_filename, &file));
+  io::RecordWriter writer(file.get());
+  string record;
+  entry.graph.SerializeToString(&record);
+  TF_RETURN_IF_ERROR(writer.WriteRecord(record));
+  entry.library.SerializeToString(&record);
+  TF_RETURN_IF_ERROR(writer.WriteRecord(record));
+  for (const auto& itr : entry.clusters) {
+    TF_RETURN_IF_ERROR(writer.WriteRecord(to_string(itr.first)));
+    itr.second.SerializeToString(&record);
+    TF_RETURN_IF_ERROR(writer.WriteRecord(record));
+  }
+  TF_RETURN_IF_ERROR(writer.Close());
+  TF_RETURN_IF_ERROR(file->Close());
+  return env->RenameFile(tmp_filename, filename);
+}
+
+Status NGraphClusteringCache::ReadEntry(const string& filename,
+                                        Entry* entry) {
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(Env::Default()->NewRandomAccessFile(filename, &file));
+  io::RecordReader reader(file.get());
+  uint64 offset = 0;
+  string record;
+  TF_RETURN_IF_ERROR(reader.ReadRecord(&offset, &record));
+  if (!entry->graph.ParseFromString(record)) {
+    return errors::DataLoss("Could not parse the graph in ", filename);
+  }
+  TF_RETURN_IF_ERROR(reader.ReadRecord(&offset, &record));
+  if (!entry->library.ParseFromString(record)) {
+    return errors::DataLoss("Could not parse the library in ", filename);
+  }
+  while (true) {
+    Status status = reader.ReadRecord(&offset, &record);
+    if (errors::IsOutOfRange(status)) {
+      break;
+    }
+    TF_RETURN_IF_ERROR(status);
+    int cluster_id;
+    if (!strings::safe_strto32(record, &cluster_id)) {
+      return errors::DataLoss("Could not parse a cluster id in ", filename);
+    }
+    TF_RETURN_IF_ERROR(reader.ReadRecord(&offset, &record));
+    if (!entry->clusters[cluster_id].ParseFromString(record)) {
+      return errors::DataLoss("Could not parse cluster ", cluster_id, " in ",
+                              filename);
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
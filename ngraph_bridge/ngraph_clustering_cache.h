@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#ifndef NGRAPH_TF_CLUSTERING_CACHE_H_
+#define NGRAPH_TF_CLUSTERING_CACHE_H_
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Process wide cache of the clustering results, i.e. of the graphs rewritten
+// by MarkForClustering, AssignClusters, DeassignClusters and
+// EncapsulateClusters, along with the cluster graphs of their
+// NGraphEncapsulates. A graph that was clustered before (e.g. by another
+// session of the same model) reuses the encapsulated graph instead of being
+// clustered again.
+//
+// Enabled by NGRAPH_TF_CLUSTERING_CACHE, which keeps up to
+// NGRAPH_TF_CLUSTERING_CACHE_MAX_ITEMS (default 16) graphs in memory. If
+// NGRAPH_TF_CLUSTERING_CACHE_DIR is set, the results are also written to that
+// directory and read back by the processes that miss in memory.
+class NGraphClusteringCache {
+ public:
+  static bool IsEnabled();
+
+  // Key of "graph_def" clustered for "backend" with the attributes in
+  // "config_map", skipping "skip_these_nodes". It covers the disabled ops,
+  // the cluster cost model in use, the NGRAPH_TF_ environment variables and
+  // the bridge and nGraph versions as well, but not the order of the nodes
+  // or library functions, or the ngraph_graph_id attributes
+  static uint64 ComputeKey(
+      const GraphDef& graph_def, const string& backend,
+      const std::unordered_map<string, string>& config_map,
+      const std::set<string>& skip_these_nodes);
+
+  // Caches "encapsulated" and "fdeflib" (which can be null) under "key". The
+  // cluster graphs of the NGraphEncapsulates are read from the
+  // NGraphClusterManager
+  static Status Insert(uint64 key, const GraphDef& encapsulated,
+                       const FunctionDefLibrary* fdeflib);
+
+  // Returns false if nothing is cached under "key". Otherwise sets
+  // "encapsulated" and "fdeflib" (unless null) to the cached results, whose
+  // cluster graphs are registered with the NGraphClusterManager under fresh
+  // cluster ids and whose ngraph_graph_id attributes are set to "graph_id"
+  static bool Lookup(uint64 key, int graph_id, GraphDef* encapsulated,
+                     FunctionDefLibrary* fdeflib);
+
+  // Same as above for the graphs rewritten in place by the rewrite passes.
+  // The cached graphs do not keep the function library, and on a hit the
+  // cached graph (with the devices of its nodes assigned) replaces "graph"
+  // and shares its function library
+  static uint64 ComputeKey(
+      const Graph& graph, const string& backend,
+      const std::unordered_map<string, string>& config_map,
+      const std::set<string>& skip_these_nodes);
+  static Status Insert(uint64 key, const Graph& graph);
+  static Status Lookup(uint64 key, int graph_id, std::unique_ptr<Graph>* graph,
+                       bool* hit);
+
+  static void Clear();
+
+ private:
+  struct Entry {
+    GraphDef graph;
+    FunctionDefLibrary library;
+    std::map<int, GraphDef> clusters;
+  };
+
+  static void InsertEntry(uint64 key, std::shared_ptr<Entry> entry);
+  static string EntryFilename(const string& dir, uint64 key);
+  static Status WriteEntry(const string& filename, const Entry& entry);
+  static Status ReadEntry(const string& filename, Entry* entry);
+
+  static std::map<uint64, std::shared_ptr<Entry>> s_entries;
+  static std::deque<uint64> s_insertion_order;
+  static std::mutex s_mutex;
+};
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_CLUSTERING_CACHE_H_
@@ -66,6 +66,13 @@ class NgraphDataCache {
                     std::function<void(ValueType)> callback_destroy_item);
   Status RemoveAll(std::function<void(ValueType)> callback_destroy_item);
 
+  // Changes the number of items the cache can hold. If the cache holds more
+  // items than the new depth, the least recently used ones are evicted
+  Status SetDepth(int depth,
+                  std::function<void(ValueType)> callback_destroy_item);
+  int GetDepth();
+  int GetSize();
+
  private:
   std::unordered_map<KeyType, ValueType> m_ng_items_map;
   std::deque<KeyType> m_lru;
@@ -101,7 +108,7 @@ Status NgraphDataCache<KeyType, ValueType>::RemoveItem(
           "Failed to destroy item. Invalid Callback to Destroy");
     }
     m_ng_items_map.erase(key);
-    m_lru.pop_back();
+    m_lru.erase(find(m_lru.begin(), m_lru.end(), key));
   }
   if (m_ng_items_map.size() != m_lru.size()) {
     return errors::Internal(
@@ -149,7 +156,12 @@ NgraphDataCache<KeyType, ValueType>::LookUpOrCreate(
     auto it = m_ng_items_map.find(key);
     found_in_cache = (it != m_ng_items_map.end());
     if (found_in_cache) {
-      return std::make_pair(Status::OK(), m_ng_items_map.at(key));
+      // Mark the item as the most recently used
+      if (m_lru.front() != key) {
+        m_lru.erase(find(m_lru.begin(), m_lru.end(), key));
+        m_lru.push_front(key);
+      }
+      return std::make_pair(Status::OK(), it->second);
     }
   }
   // Item not found in cache, create item
@@ -167,32 +179,33 @@ NgraphDataCache<KeyType, ValueType>::LookUpOrCreate(
   if (status_item_pair.first == Status::OK()) {
     item = status_item_pair.second;
     // lock begins
-    {
-      absl::MutexLock lock(&m_mutex);
-      // Remove item if cache is full
-      if (m_ng_items_map.size() == m_depth) {
-        auto key_to_evict = m_lru.back();
-        try {
+    absl::MutexLock lock(&m_mutex);
+    auto it = m_ng_items_map.find(key);
+    try {
+      if (it != m_ng_items_map.end()) {
+        // Another thread created the same item while we were creating ours.
+        // Keep the cached one, so that all the callers share the same item.
+        callback_destroy_item(item);
+        item = it->second;
+        m_lru.erase(find(m_lru.begin(), m_lru.end(), key));
+      } else {
+        // Remove items if cache is full
+        while (!m_lru.empty() && m_ng_items_map.size() >= m_depth) {
+          auto key_to_evict = m_lru.back();
           callback_destroy_item(m_ng_items_map.at(key_to_evict));
-        } catch (std::bad_function_call& exception) {
-          return std::make_pair(
-              errors::Internal(
-                  "Failed to destroy item. Invalid Callback to Destroy"),
-              item);
+          m_ng_items_map.erase(key_to_evict);
+          m_lru.pop_back();
         }
-        m_ng_items_map.erase(key_to_evict);
-        m_lru.pop_back();
-      }
-      // Add item to cache
-      auto it = m_ng_items_map.emplace(key, item);
-      if (it.second == true) {
-        m_lru.push_front(key);
-      } else {
-        auto key_itr = find(m_lru.begin(), m_lru.end(), key);
-        m_lru.erase(key_itr);
-        m_lru.push_front(key);
+        // Add item to cache
+        m_ng_items_map.emplace(key, item);
       }
-    }  // lock ends here.
+    } catch (std::bad_function_call& exception) {
+      return std::make_pair(
+          errors::Internal(
+              "Failed to destroy item. Invalid Callback to Destroy"),
+          item);
+    }
+    m_lru.push_front(key);
 
     if (m_ng_items_map.size() != m_lru.size()) {
       return std::make_pair(
@@ -215,6 +228,37 @@ NgraphDataCache<KeyType, ValueType>::LookUpOrCreate(
   return LookUpOrCreate(key, callback_create_item, [](ValueType) {},
                         found_in_cache);
 }
+
+template <typename KeyType, typename ValueType>
+Status NgraphDataCache<KeyType, ValueType>::SetDepth(
+    int depth, std::function<void(ValueType)> callback_destroy_item) {
+  absl::MutexLock lock(&m_mutex);
+  m_depth = depth;
+  while (!m_lru.empty() && m_ng_items_map.size() > m_depth) {
+    auto key_to_evict = m_lru.back();
+    try {
+      callback_destroy_item(m_ng_items_map.at(key_to_evict));
+    } catch (std::bad_function_call& exception) {
+      return errors::Internal(
+          "Failed to destroy item. Invalid Callback to Destroy");
+    }
+    m_ng_items_map.erase(key_to_evict);
+    m_lru.pop_back();
+  }
+  return Status::OK();
+}
+
+template <typename KeyType, typename ValueType>
+int NgraphDataCache<KeyType, ValueType>::GetDepth() {
+  absl::MutexLock lock(&m_mutex);
+  return m_depth;
+}
+
+template <typename KeyType, typename ValueType>
+int NgraphDataCache<KeyType, ValueType>::GetSize() {
+  absl::MutexLock lock(&m_mutex);
+  return m_ng_items_map.size();
+}
 }
 }
 #endif  // NGRAPH_DATA_CACHE_H_
@@ -30,6 +30,7 @@
 #include "logging/ngraph_log.h"
 #include "ngraph_bridge/ngraph_api.h"
 #include "ngraph_bridge/ngraph_assign_clusters.h"
+#include "ngraph_bridge/ngraph_cluster_cost_model.h"
 #include "ngraph_bridge/ngraph_deassign_clusters.h"
 #include "ngraph_bridge/ngraph_mark_for_clustering.h"
 #include "ngraph_bridge/ngraph_utils.h"
@@ -48,6 +49,11 @@ namespace ngraph_bridge {
 // two non-trivial ops in the graph, where a "trivial op" means "Const" or
 // "Identity".
 //
+// If NGRAPH_TF_CLUSTER_COST_MODEL is set, the remaining clusters are also
+// deassigned when their expected gain, as estimated by the ClusterCostModel
+// from the static shapes, is negative (i.e. copying the tensors into and out
+// of the cluster costs more than the compute it takes over).
+//
 // For unit testing purposes, this pass can be bypassed by setting
 // NGRAPH_TF_DISABLE_DEASSIGN_CLUSTERS=1.
 //
@@ -179,6 +185,13 @@ Status DeassignClusters(Graph* graph) {
     cluster_map[cluster_idx].insert(node);
   }
 
+  std::shared_ptr<const ClusterCostModel> cost_model;
+  OutputShapes output_shapes;
+  if (ClusterCostModel::IsEnabled()) {
+    cost_model = ClusterCostModel::GetModel();
+    ClusterCostModel::InferOutputShapes(*graph, &output_shapes);
+  }
+
   for (auto& kv : cluster_map) {
     int cluster_idx = kv.first;
     std::set<Node*>& nodes = kv.second;
@@ -192,7 +205,25 @@ Status DeassignClusters(Graph* graph) {
       }
     }
 
-    if (non_trivial_count < MIN_NONTRIVIAL_NODES) {
+    bool bust = non_trivial_count < MIN_NONTRIVIAL_NODES;
+
+    if (!bust && cost_model != nullptr) {
+      ClusterCost cost = cost_model->Estimate(nodes, output_shapes);
+      bust = cost.complete && cost.gain < 0;
+      std::stringstream ss;
+      ss << "Cluster[" << cluster_idx << "] cost estimate: flops "
+         << cost.flops << ", bytes " << cost.bytes << ", boundary bytes "
+         << cost.boundary_bytes << " over " << cost.boundary_edges
+         << " edges, gain " << cost.gain
+         << (cost.complete ? "" : " (shapes not static)") << ": "
+         << (bust ? "deassigned" : "kept");
+      NGRAPH_VLOG(2) << ss.str();
+      if (config::IsLoggingPlacement()) {
+        std::cout << "NGTF_SUMMARY: " << ss.str() << std::endl;
+      }
+    }
+
+    if (bust) {
       NGRAPH_VLOG(2) << "Busting cluster " << cluster_idx;
       for (auto node : nodes) {
         NGRAPH_VLOG(2) << "Busting node: " << node->name() << " ["
@@ -0,0 +1,134 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/ngraph_device_prefetch_autotuner.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Weight of the latest sample in the moving averages
+static const double kSmoothing = 0.2;
+// A side is considered to be waiting when it waited for more than this
+// fraction of its busy time within the tuning window
+static const double kStallFraction = 0.05;
+
+static double Smooth(double average, int64 sample) {
+  return average == 0 ? sample
+                      : (1 - kSmoothing) * average + kSmoothing * sample;
+}
+
+NGraphDevicePrefetchAutotuner::NGraphDevicePrefetchAutotuner(int max_depth)
+    : m_max_depth(std::max(1, max_depth)) {}
+
+int NGraphDevicePrefetchAutotuner::GetMaxDepthFromEnv() {
+  const char* max_depth = std::getenv("NGRAPH_TF_PREFETCH_MAX_DEVICE_DEPTH");
+  if (max_depth == nullptr) {
+    return 4;
+  }
+  return std::max(1, atoi(max_depth));
+}
+
+void NGraphDevicePrefetchAutotuner::RecordCopy(int64 copy_us, int64 stall_us) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_copy_us = Smooth(m_copy_us, copy_us);
+  m_producer_stall_us += stall_us;
+  m_window_copy_us += copy_us;
+  m_window_producer_stall_us += stall_us;
+}
+
+void NGraphDevicePrefetchAutotuner::RecordCompute(int64 compute_us,
+                                                  int64 stall_us) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_compute_us = Smooth(m_compute_us, compute_us);
+  m_consumer_stall_us += stall_us;
+  m_window_compute_us += compute_us;
+  m_window_consumer_stall_us += stall_us;
+  if (++m_window_computes >= kTuneInterval) {
+    Tune();
+  }
+}
+
+void NGraphDevicePrefetchAutotuner::Tune() {
+  // Number of copies that fit in one execution
+  int ratio_depth =
+      static_cast<int>(std::ceil(m_copy_us / std::max(m_compute_us, 1.0)));
+  ratio_depth = std::max(1, ratio_depth);
+
+  bool consumer_waited =
+      m_window_consumer_stall_us > kStallFraction * m_window_compute_us;
+  bool producer_waited =
+      m_window_producer_stall_us > kStallFraction * m_window_copy_us;
+
+  int depth = m_depth;
+  if (consumer_waited && producer_waited) {
+    depth = std::max(ratio_depth, m_depth + 1);
+  } else if (consumer_waited) {
+    depth = ratio_depth;
+  } else {
+    depth = std::max(m_depth - 1, std::min(ratio_depth, m_depth));
+  }
+  depth = std::min(std::max(depth, 1), m_max_depth);
+
+  if (depth != m_depth) {
+    NGRAPH_VLOG(2) << "[PREFETCH] Device depth " << m_depth << " -> " << depth
+                   << " copy " << m_copy_us << "us compute " << m_compute_us
+                   << "us";
+    m_depth = depth;
+  }
+
+  m_window_computes = 0;
+  m_window_copy_us = 0;
+  m_window_compute_us = 0;
+  m_window_producer_stall_us = 0;
+  m_window_consumer_stall_us = 0;
+}
+
+int NGraphDevicePrefetchAutotuner::GetDepth() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_depth;
+}
+
+double NGraphDevicePrefetchAutotuner::GetCopyTimeUs() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_copy_us;
+}
+
+double NGraphDevicePrefetchAutotuner::GetComputeTimeUs() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_compute_us;
+}
+
+int64 NGraphDevicePrefetchAutotuner::GetProducerStallUs() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_producer_stall_us;
+}
+
+int64 NGraphDevicePrefetchAutotuner::GetConsumerStallUs() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_consumer_stall_us;
+}
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
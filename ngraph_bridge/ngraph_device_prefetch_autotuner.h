@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#ifndef NGRAPH_TF_DEVICE_PREFETCH_AUTOTUNER_H_
+#define NGRAPH_TF_DEVICE_PREFETCH_AUTOTUNER_H_
+#pragma once
+
+#include <mutex>
+
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// NGraphDevicePrefetchAutotuner picks the number of dataset elements that are
+// kept staged on the device ahead of one NGraphEncapsulate, i.e. the number of
+// pipelined input tensor sets the NGraphEncapsulate lends to the prefetcher.
+//
+// The prefetcher reports how long it took to copy an element to the device
+// and how long it waited for a free staging slot. The NGraphEncapsulate
+// reports how long it executed and how long it waited for a staged element.
+// Every kTuneInterval executions the depth is adjusted as follows:
+//  - both sides waited: the copies are bursty, add a slot
+//  - only the NGraphEncapsulate waited: the copies are slower than the
+//    executions, use as many slots as copies fit in one execution
+//  - the NGraphEncapsulate did not wait: drop a slot, but keep as many as
+//    copies fit in one execution
+// The depth stays within [1, max_depth].
+//
+// NGraphDevicePrefetchAutotuner is thread safe.
+class NGraphDevicePrefetchAutotuner {
+ public:
+  explicit NGraphDevicePrefetchAutotuner(int max_depth);
+
+  // Upper bound for the depth, NGRAPH_TF_PREFETCH_MAX_DEVICE_DEPTH (default 4)
+  static int GetMaxDepthFromEnv();
+
+  // Called by the prefetcher after it staged one element
+  void RecordCopy(int64 copy_us, int64 stall_us);
+  // Called by the NGraphEncapsulate after it executed on a staged element
+  void RecordCompute(int64 compute_us, int64 stall_us);
+
+  int GetDepth();
+  int GetMaxDepth() const { return m_max_depth; }
+
+  // Moving averages of the copy and execution times
+  double GetCopyTimeUs();
+  double GetComputeTimeUs();
+
+  // Total time the prefetcher waited for a free staging slot
+  int64 GetProducerStallUs();
+  // Total time the NGraphEncapsulate waited for a staged element
+  int64 GetConsumerStallUs();
+
+  static const int kTuneInterval = 16;
+
+ private:
+  // Called with m_mutex held
+  void Tune();
+
+  const int m_max_depth;
+  int m_depth{1};
+
+  double m_copy_us{0};
+  double m_compute_us{0};
+  int64 m_producer_stall_us{0};
+  int64 m_consumer_stall_us{0};
+
+  // Accumulated since the last Tune()
+  int m_window_computes{0};
+  int64 m_window_copy_us{0};
+  int64 m_window_compute_us{0};
+  int64 m_window_producer_stall_us{0};
+  int64 m_window_consumer_stall_us{0};
+
+  std::mutex m_mutex;
+};
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_DEVICE_PREFETCH_AUTOTUNER_H_
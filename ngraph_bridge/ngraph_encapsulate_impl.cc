@@ -98,6 +98,224 @@ Status NGraphEncapsulateImpl::ComputeSignature(
   return Status::OK();
 }
 
+// Same as ComputeSignature, but the batch dimension of the non-static inputs
+// is replaced by "?"
+Status NGraphEncapsulateImpl::ComputeDynamicSignature(
+    const std::vector<Tensor>& tf_input_tensors,
+    std::vector<ng::PartialShape>& input_shapes,
+    std::vector<const Tensor*>& static_input_map,
+    std::stringstream& signature_ss) {
+  signature_ss << "dynamic/";
+  for (int i = 0; i < tf_input_tensors.size(); i++) {
+    const TensorShape& tf_shape = tf_input_tensors[i].shape();
+    std::vector<ng::Dimension> dims;
+    for (int j = 0; j < tf_shape.dims(); j++) {
+      if (j == 0 && !m_input_is_static[i]) {
+        dims.push_back(ng::Dimension::dynamic());
+        signature_ss << "?,";
+      } else {
+        dims.push_back(ng::Dimension(tf_shape.dim_size(j)));
+        signature_ss << tf_shape.dim_size(j) << ",";
+      }
+    }
+    input_shapes.push_back(ng::PartialShape(dims));
+    signature_ss << ";";
+  }
+
+  signature_ss << "/";
+
+  static_input_map.resize(tf_input_tensors.size());
+  for (int i = 0; i < tf_input_tensors.size(); i++) {
+    const Tensor& input_tensor = tf_input_tensors[i];
+    if (m_input_is_static[i]) {
+      static_input_map[i] = &input_tensor;
+      TF_RETURN_IF_ERROR(TensorToStream(signature_ss, input_tensor));
+      signature_ss << ";";
+    }
+  }
+  return Status::OK();
+}
+
+// Looks up the executable for the signature in m_ng_exec_map, and marks it as
+// the most recently used. Called with m_exec_map_mutex held
+bool NGraphEncapsulateImpl::LookUpNgExecutable(
+    const string& signature,
+    std::shared_ptr<ngraph::runtime::Executable>& ng_exec) {
+  auto it = m_ng_exec_map.find(signature);
+  if (it == m_ng_exec_map.end()) {
+    return false;
+  }
+  if (signature != m_lru.front()) {
+    m_lru.remove(signature);
+    m_lru.push_front(signature);
+  }
+  ng_exec = it->second;
+  return true;
+}
+
+// Adds the newly compiled executable to m_ng_exec_map, evicting the least
+// recently used one if the cache is full. If another step compiled the same
+// signature in the meantime, that executable is used instead.
+// The executable is removed from the backend (and the freshness tracker)
+// only when the cache and the last step running it have dropped it.
+void NGraphEncapsulateImpl::InsertNgExecutable(
+    const string& signature, const string& serialized_ng_func,
+    const bool is_dynamic, ng::runtime::Backend* const op_backend,
+    std::shared_ptr<ngraph::runtime::Executable>& ng_exec) {
+  ng_exec = MakeRemovableExecutable(
+      op_backend, ng_exec,
+      [this](const std::shared_ptr<ngraph::runtime::Executable>& exec) {
+        // The tracker does not keep its users alive, drop the executable
+        // before its address can be reused
+        if (m_freshness_tracker != nullptr) {
+          m_freshness_tracker->RemoveUser(exec);
+        }
+      });
+
+  std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+  std::shared_ptr<ngraph::runtime::Executable> cached_ng_exec;
+  if (LookUpNgExecutable(signature, cached_ng_exec)) {
+    // Dropping the duplicate removes it
+    ng_exec = cached_ng_exec;
+    return;
+  }
+
+  // Evict the cache if the number of elements exceeds the limit
+  if (m_ng_exec_map.size() >= my_function_cache_depth_in_items) {
+    EvictNgExecutable();
+  }
+
+  m_ng_exec_map[signature] = ng_exec;
+  // caching ng_function to serialize to ngraph if needed
+  m_serialized_ng_function_map[ng_exec] = serialized_ng_func;
+  if (is_dynamic) {
+    m_dynamic_execs.insert(ng_exec);
+  }
+  m_lru.push_front(signature);
+}
+
+void NGraphEncapsulateImpl::EvictNgExecutable() {
+  if (m_lru.empty()) {
+    return;
+  }
+  int input_tensors_bytes_free = 0;
+  int output_tensors_bytes_free = 0;
+  std::shared_ptr<ngraph::runtime::Executable> evicted_ng_exec =
+      m_ng_exec_map[m_lru.back()];
+  m_ng_exec_map.erase(m_lru.back());
+  m_serialized_ng_function_map.erase(evicted_ng_exec);
+  m_dynamic_execs.erase(evicted_ng_exec);
+
+  // Now clean the input and output caches. Steps still running the evicted
+  // executable keep it and their slot alive until they are done
+  auto it = m_ng_exec_io_cache_map.find(evicted_ng_exec);
+  if (it != m_ng_exec_io_cache_map.end()) {
+    for (auto& io_cache_slot : it->second) {
+      for (auto& next_input : io_cache_slot->inputs) {
+        if (next_input.second != nullptr) {
+          input_tensors_bytes_free += next_input.second->get_size_in_bytes();
+        }
+      }
+      for (auto& next_output : io_cache_slot->outputs) {
+        if (next_output.second != nullptr) {
+          output_tensors_bytes_free += next_output.second->get_size_in_bytes();
+        }
+      }
+    }
+    m_ng_exec_io_cache_map.erase(it);
+  }
+  {
+    std::lock_guard<std::mutex> pipelined_lock(m_pipelined_tensors_mutex);
+    m_executable_pipelined_tensors_map.erase(evicted_ng_exec);
+  }
+  m_lru.pop_back();
+  NGRAPH_VLOG(1) << "NGRAPH_TF_MEM_PROFILE:  OP_ID: " << my_instance_id
+                 << " Cluster: " << m_name << " Input Tensors freed: "
+                 << input_tensors_bytes_free / (1024 * 1024) << " MB"
+                 << " Output Tensors freed: "
+                 << output_tensors_bytes_free / (1024 * 1024) << " MB";
+}
+
+void NGraphEncapsulateImpl::SetCacheDepth(int instance_id, int cache_depth,
+                                          int max_cache_depth) {
+  std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+  my_function_cache_depth_in_items = cache_depth;
+  m_cache_depth.reset(
+      new NGraphCacheDepth(instance_id, m_ngraph_cluster, cache_depth));
+  if (max_cache_depth > 0) {
+    m_cache_depth->EnableAdaptive(max_cache_depth);
+  }
+}
+
+void NGraphEncapsulateImpl::RecordCacheLookup(const string& signature,
+                                              bool cache_hit) {
+  if (m_cache_depth == nullptr) {
+    return;
+  }
+  m_cache_depth->RecordLookup(signature, cache_hit, [this](int depth) {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+    my_function_cache_depth_in_items = depth;
+    while (m_ng_exec_map.size() > depth) {
+      EvictNgExecutable();
+    }
+    return Status::OK();
+  });
+}
+
+// Looks up (or translates and compiles) the executable for the family of
+// shapes the inputs belong to
+Status NGraphEncapsulateImpl::GetDynamicNgExecutable(
+    const std::vector<Tensor>& tf_input_tensors,
+    std::vector<const Tensor*>& static_input_map,
+    ng::runtime::Backend* const op_backend,
+    std::shared_ptr<ngraph::runtime::Executable>& ng_exec) {
+  std::stringstream signature_ss;
+  std::vector<ng::PartialShape> input_shapes;
+  TF_RETURN_IF_ERROR(ComputeDynamicSignature(tf_input_tensors, input_shapes,
+                                             static_input_map, signature_ss));
+  string signature = signature_ss.str();
+  NGRAPH_VLOG(5) << "Computed dynamic signature: " << signature;
+
+  bool cache_hit;
+  {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+    cache_hit = LookUpNgExecutable(signature, ng_exec);
+  }
+  if (cache_hit) {
+    RecordCacheLookup(signature, true);
+    return Status::OK();
+  }
+
+  NGRAPH_VLOG(1) << "Dynamic shape compilation cache miss: " << m_name;
+  std::shared_ptr<ngraph::Function> ng_function;
+  TF_RETURN_IF_ERROR(Builder::TranslateGraph(input_shapes, static_input_map,
+                                             &m_graph, ng_function));
+  ng_function->set_friendly_name(m_name);
+
+  ngraph::Event event_compile("Compile nGraph", m_name, "");
+  BackendManager::LockBackend(m_op_backend_name);
+  try {
+    ng_exec = op_backend->compile(ng_function);
+  } catch (const std::exception& exp) {
+    BackendManager::UnlockBackend(m_op_backend_name);
+    return errors::Internal(
+        "Caught exception while compiling op_backend with dynamic shapes: ",
+        exp.what());
+  } catch (...) {
+    BackendManager::UnlockBackend(m_op_backend_name);
+    return errors::Internal(
+        "Error in compiling op_backend with dynamic shapes");
+  }
+  BackendManager::UnlockBackend(m_op_backend_name);
+  event_compile.Stop();
+  ngraph::Event::write_trace(event_compile);
+
+  InsertNgExecutable(signature, ngraph::serialize(ng_function, 4), true,
+                     op_backend, ng_exec);
+  RecordCacheLookup(signature, false);
+  return Status::OK();
+}
+
 // Calls ComputeSignature and gets ngraph executable
 Status NGraphEncapsulateImpl::GetNgExecutable(
     const std::vector<Tensor>& tf_input_tensors,
@@ -109,12 +327,29 @@ Status NGraphEncapsulateImpl::GetNgExecutable(
   string signature;
 
   std::shared_ptr<ngraph::Function> ng_function;
-  std::shared_ptr<ngraph::runtime::Executable> evicted_ng_exec;
 
   NGRAPH_VLOG(4) << "GetNgExecutable: Got backend of type: "
                  << m_op_backend_name;
   op_backend = BackendManager::GetBackend(m_op_backend_name);
 
+  if (m_dynamic_shapes && !m_do_aot) {
+    Status status = GetDynamicNgExecutable(tf_input_tensors, static_input_map,
+                                           op_backend, ng_exec);
+    if (status == Status::OK()) {
+      for (const auto& input_tensor : tf_input_tensors) {
+        input_shapes.push_back(input_tensor.shape());
+      }
+      return Status::OK();
+    }
+    // Some of the ops of this cluster need static shapes, fall back to
+    // compiling one executable per input shape
+    NGRAPH_VLOG(1) << "Cannot compile " << m_name
+                   << " with dynamic shapes, falling back to static shapes: "
+                   << status.error_message();
+    m_dynamic_shapes = false;
+    static_input_map.clear();
+  }
+
   // Compute Signature
   TF_RETURN_IF_ERROR(ComputeSignature(tf_input_tensors, input_shapes,
                                       static_input_map, signature_ss));
@@ -122,156 +357,155 @@ Status NGraphEncapsulateImpl::GetNgExecutable(
 
   NGRAPH_VLOG(5) << "Computed signature: " << signature;
 
-  auto it = m_ng_exec_map.find(signature);
-
   NGRAPH_VLOG(4) << "NGraphEncapsulateOp::Compute got inputs for cluster "
                  << m_ngraph_cluster;
 
-  // Translate the TensorFlow graph to nGraph.
-  if (it == m_ng_exec_map.end()) {
-    // Measure the current total memory usage
-    long vm, rss, vm0, rss0;
-    MemoryProfile(vm0, rss0);
-
-    NGRAPH_VLOG(1) << "Compilation cache miss: " << m_name;
-    string serialized_ng_func;
-    if (!m_do_aot) {
-      TF_RETURN_IF_ERROR(Builder::TranslateGraph(input_shapes, static_input_map,
-                                                 &m_graph, ng_function));
-      ng_function->set_friendly_name(m_name);
-      int json_indentation = 4;
-      serialized_ng_func = ngraph::serialize(ng_function, json_indentation);
-    } else {
-      auto itr = m_aot_functions.find(signature);
-      if (itr == m_aot_functions.end()) {
-        return errors::Internal(
-            "Expected to find AOT precompiled ng function of signature: ",
-            signature);
-      }
-      serialized_ng_func = itr->second;
+  bool cache_hit;
+  {
+    // Found the input signature in m_ng_exec_map, use the cached executable
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+    cache_hit = LookUpNgExecutable(signature, ng_exec);
+  }
+  if (cache_hit) {
+    RecordCacheLookup(signature, true);
+    return Status::OK();
+  }
+
+  // Translate the TensorFlow graph to nGraph. This is done without holding
+  // m_exec_map_mutex, so that concurrent steps hitting the cache can proceed.
+  // Measure the current total memory usage
+  long vm, rss, vm0, rss0;
+  MemoryProfile(vm0, rss0);
+
+  NGRAPH_VLOG(1) << "Compilation cache miss: " << m_name;
+  string serialized_ng_func;
+  if (!m_do_aot) {
+    TF_RETURN_IF_ERROR(Builder::TranslateGraph(input_shapes, static_input_map,
+                                               &m_graph, ng_function));
+    ng_function->set_friendly_name(m_name);
+    int json_indentation = 4;
+    serialized_ng_func = ngraph::serialize(ng_function, json_indentation);
+  } else {
+    auto itr = m_aot_functions.find(signature);
+    if (itr == m_aot_functions.end()) {
+      return errors::Internal(
+          "Expected to find AOT precompiled ng function of signature: ",
+          signature);
     }
+    serialized_ng_func = itr->second;
+  }
 
-    // Serialize to nGraph if needed
-    if (std::getenv("NGRAPH_ENABLE_SERIALIZE") != nullptr) {
-      std::string file_name = "tf_function_" + m_name + ".json";
-      TF_RETURN_IF_ERROR(
-          StringToFile("tf_function_" + m_name + ".json", serialized_ng_func));
+  // Serialize to nGraph if needed
+  if (std::getenv("NGRAPH_ENABLE_SERIALIZE") != nullptr) {
+    std::string file_name = "tf_function_" + m_name + ".json";
+    TF_RETURN_IF_ERROR(
+        StringToFile("tf_function_" + m_name + ".json", serialized_ng_func));
 #if defined NGRAPH_DISTRIBUTED
-      int rank_id;
-      rank_id = ng::get_distributed_interface()->get_rank();
-      TF_RETURN_IF_ERROR(StringToFile(
-          "tf_function_" + m_name + "_" + to_string(rank_id) + ".json",
-          serialized_ng_func));
+    int rank_id;
+    rank_id = ng::get_distributed_interface()->get_rank();
+    TF_RETURN_IF_ERROR(StringToFile(
+        "tf_function_" + m_name + "_" + to_string(rank_id) + ".json",
+        serialized_ng_func));
 #endif
-    }
-    // Evict the cache if the number of elements exceeds the limit
-    const char* cache_depth_specified =
-        std::getenv("NGRAPH_TF_FUNCTION_CACHE_ITEM_DEPTH");
-    if (cache_depth_specified != nullptr) {
-      my_function_cache_depth_in_items = atoi(cache_depth_specified);
-    }
-    if (m_ng_exec_map.size() >= my_function_cache_depth_in_items) {
-      int input_tensors_bytes_free = 0;
-      evicted_ng_exec = m_ng_exec_map[m_lru.back()];
-      m_ng_exec_map.erase(m_lru.back());
-      m_serialized_ng_function_map.erase(evicted_ng_exec);
-
-      // Call delete function here for the erased func
-      op_backend->remove_compiled_function(evicted_ng_exec);
-      // Now clean the input cache
-      std::vector<std::pair<void*, std::shared_ptr<ng::runtime::Tensor>>>&
-          input_caches = m_ng_exec_input_cache_map[evicted_ng_exec];
-      for (auto& next_input : input_caches) {
-        input_tensors_bytes_free += next_input.second->get_size_in_bytes();
-        next_input.second.reset();
-      }
-      m_ng_exec_input_cache_map.erase(evicted_ng_exec);
-
-      // Clean the output cache
-      std::vector<std::pair<void*, std::shared_ptr<ng::runtime::Tensor>>>&
-          output_caches = m_ng_exec_output_cache_map[evicted_ng_exec];
-      int output_tensors_bytes_free = 0;
-      for (auto& next_output : output_caches) {
-        output_tensors_bytes_free += next_output.second->get_size_in_bytes();
-        next_output.second.reset();
-      }
-      m_ng_exec_output_cache_map.erase(evicted_ng_exec);
-      m_lru.pop_back();
-      NGRAPH_VLOG(1) << "NGRAPH_TF_MEM_PROFILE:  OP_ID: " << my_instance_id
-                     << " Cluster: " << m_name << " Input Tensors freed: "
-                     << input_tensors_bytes_free / (1024 * 1024) << " MB"
-                     << " Output Tensors freed: "
-                     << output_tensors_bytes_free / (1024 * 1024) << " MB";
-    }  // cache eviction if cache size greater than cache depth
-
-    ngraph::Event event_compile("Compile nGraph", m_name, "");
-    BackendManager::LockBackend(m_op_backend_name);
-    try {
-      if (m_do_aot) {
-        auto itr = m_aot_execs.find(signature);
-        if (itr == m_aot_execs.end()) {
-          BackendManager::UnlockBackend(m_op_backend_name);
-          return errors::Internal(
-              "Requested AOT, but could not find string with the "
-              "signature: ",
-              signature);
-        }
-        stringstream serialized_exec_read;
-        serialized_exec_read << (itr->second);
-        ng_exec = op_backend->load(serialized_exec_read);
-      } else {
-        ng_exec = op_backend->compile(ng_function);
+  }
+
+  ngraph::Event event_compile("Compile nGraph", m_name, "");
+  BackendManager::LockBackend(m_op_backend_name);
+  try {
+    if (m_do_aot) {
+      auto itr = m_aot_execs.find(signature);
+      if (itr == m_aot_execs.end()) {
+        BackendManager::UnlockBackend(m_op_backend_name);
+        return errors::Internal(
+            "Requested AOT, but could not find string with the "
+            "signature: ",
+            signature);
       }
-    } catch (const std::exception& exp) {
-      BackendManager::UnlockBackend(m_op_backend_name);
-      Status st = StringToFile("tf_function_error_" + m_name + ".json",
-                               serialized_ng_func);
-      string status_string =
-          "Caught exception while compiling op_backend: " + string(exp.what()) +
-          (st.ok() ? "" : (" Also error in dumping serialized function: " +
-                           st.error_message()));
-      return errors::Internal(status_string);
-    } catch (...) {
-      BackendManager::UnlockBackend(m_op_backend_name);
-      Status st = StringToFile("tf_function_error_" + m_name + ".json",
-                               serialized_ng_func);
-      string status_string =
-          "Error in compiling op_backend." +
-          (st.ok() ? "" : (" Also error in dumping serialized function: " +
-                           st.error_message()));
-      return errors::Internal(status_string);
+      stringstream serialized_exec_read;
+      serialized_exec_read << (itr->second);
+      ng_exec = op_backend->load(serialized_exec_read);
+    } else {
+      ng_exec = op_backend->compile(ng_function);
     }
+  } catch (const std::exception& exp) {
     BackendManager::UnlockBackend(m_op_backend_name);
-    event_compile.Stop();
-    ngraph::Event::write_trace(event_compile);
-
-    SetNgExecMap(signature, ng_exec);
-
-    // caching ng_function to serialize to ngraph if needed
-    m_serialized_ng_function_map[ng_exec] = serialized_ng_func;
+    Status st = StringToFile("tf_function_error_" + m_name + ".json",
+                             serialized_ng_func);
+    string status_string =
+        "Caught exception while compiling op_backend: " + string(exp.what()) +
+        (st.ok() ? "" : (" Also error in dumping serialized function: " +
+                         st.error_message()));
+    return errors::Internal(status_string);
+  } catch (...) {
+    BackendManager::UnlockBackend(m_op_backend_name);
+    Status st = StringToFile("tf_function_error_" + m_name + ".json",
+                             serialized_ng_func);
+    string status_string =
+        "Error in compiling op_backend." +
+        (st.ok() ? "" : (" Also error in dumping serialized function: " +
+                         st.error_message()));
+    return errors::Internal(status_string);
+  }
+  BackendManager::UnlockBackend(m_op_backend_name);
+  event_compile.Stop();
+  ngraph::Event::write_trace(event_compile);
+
+  InsertNgExecutable(signature, serialized_ng_func, false, op_backend,
+                     ng_exec);
+  RecordCacheLookup(signature, false);
+
+  // Memory after
+  MemoryProfile(vm, rss);
+  auto delta_vm_mem = vm - vm0;
+  auto delta_res_mem = rss - rss0;
+  NGRAPH_VLOG(1) << "NGRAPH_TF_CACHE_PROFILE: OP_ID: " << my_instance_id
+                 << " Cache length: " << GetNgExecMap().size()
+                 << " Cluster: " << m_name << " Delta VM: " << delta_vm_mem
+                 << " Delta RSS: " << delta_res_mem
+                 << " KB Total RSS: " << rss / (1024 * 1024) << " GB "
+                 << " VM: " << vm / (1024 * 1024) << " GB" << endl;
+  return Status::OK();
+}
 
-    m_lru.push_front(signature);
-    // Memory after
-    MemoryProfile(vm, rss);
-    auto delta_vm_mem = vm - vm0;
-    auto delta_res_mem = rss - rss0;
-    NGRAPH_VLOG(1) << "NGRAPH_TF_CACHE_PROFILE: OP_ID: " << my_instance_id
-                   << " Cache length: " << m_ng_exec_map.size()
-                   << " Cluster: " << m_name << " Delta VM: " << delta_vm_mem
-                   << " Delta RSS: " << delta_res_mem
-                   << " KB Total RSS: " << rss / (1024 * 1024) << " GB "
-                   << " VM: " << vm / (1024 * 1024) << " GB" << endl;
-  }  // end of input signature not found in m_ng_exec_map
-  else {
-    // Found the input signature in m_ng_exec_map, use the cached executable
-    // Update the m_lru
-    if (signature != m_lru.front()) {
-      m_lru.remove(signature);
-      m_lru.push_front(signature);
+// Checks out a set of cached I/O tensors of the executable for this step.
+// The first slot is the primary one, further slots are only created when
+// steps run the same executable concurrently. Nothing is cached for an
+// executable that was evicted, its slot lives only as long as the step.
+std::shared_ptr<NGraphEncapsulateImpl::IOCacheSlot>
+NGraphEncapsulateImpl::AcquireIOCacheSlot(
+    const std::shared_ptr<ngraph::runtime::Executable>& ng_exec) {
+  auto io_cache_slot = std::make_shared<IOCacheSlot>();
+  io_cache_slot->in_use = true;
+  std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+  if (!IsCachedNgExecutable(ng_exec)) {
+    return io_cache_slot;
+  }
+  auto& io_cache_slots = m_ng_exec_io_cache_map[ng_exec];
+  for (auto& free_io_cache_slot : io_cache_slots) {
+    if (!free_io_cache_slot->in_use) {
+      free_io_cache_slot->in_use = true;
+      return free_io_cache_slot;
     }
-    ng_exec = it->second;
   }
-  return Status::OK();
+  io_cache_slot->primary = io_cache_slots.empty();
+  if (io_cache_slot->primary) {
+    // The only time the tracker's users lock is taken for the executable,
+    // the steps pass the id to IsFresh/MarkFresh
+    if (m_freshness_tracker != nullptr) {
+      io_cache_slot->freshness_user_id = m_freshness_tracker->AddUser(ng_exec);
+    }
+  } else {
+    io_cache_slot->freshness_user_id =
+        io_cache_slots.front()->freshness_user_id;
+  }
+  io_cache_slots.push_back(io_cache_slot);
+  return io_cache_slot;
+}
+
+void NGraphEncapsulateImpl::ReleaseIOCacheSlot(
+    const std::shared_ptr<IOCacheSlot>& io_cache_slot) {
+  std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+  io_cache_slot->in_use = false;
 }
 
 // Allocate tensors for input arguments. Creates ngraph input tensors using
@@ -280,27 +514,29 @@ Status NGraphEncapsulateImpl::AllocateNGInputTensors(
     const std::vector<Tensor>& tf_input_tensors,
     const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
     const PipelinedTensorVector& inp_group_from_pipeline,
+    const std::shared_ptr<IOCacheSlot>& io_cache_slot,
     ng::runtime::Backend* const op_backend,
     vector<shared_ptr<ng::runtime::Tensor>>& ng_inputs) {
   std::vector<std::unique_ptr<ngraph::Event>> input_copy_events;
   std::vector<TensorShape> input_shapes;
   std::vector<std::pair<void*, std::shared_ptr<ng::runtime::Tensor>>>&
-      input_caches = m_ng_exec_input_cache_map[ng_exec];
+      input_caches = io_cache_slot->inputs;
   input_caches.resize(tf_input_tensors.size());
 #if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
-  log_copies = false;
-  TF_RETURN_IF_ERROR(IsNgraphTFLogTensorCopiesEnabled(m_graph_id, log_copies));
-  std::stringstream copy_log_str;
-  copy_log_str << "["
-               << "NGraphEncapsulate:"
-               << "]: " << m_name << " ,GraphID " << m_graph_id << "\n";
-  number_of_copies = 0;
+  io_cache_slot->log_copies = false;
+  TF_RETURN_IF_ERROR(IsNgraphTFLogTensorCopiesEnabled(
+      m_graph_id, io_cache_slot->log_copies));
+  io_cache_slot->copy_log.str("");
+  io_cache_slot->copy_log << "["
+                          << "NGraphEncapsulate:"
+                          << "]: " << m_name << " ,GraphID " << m_graph_id
+                          << "\n";
+  io_cache_slot->number_of_copies = 0;
 #endif
 
   for (int i = 0; i < tf_input_tensors.size(); i++) {
 #if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
-    bool ref_exists = NGraphCatalog::ExistsInInputVariableSharedNameMap(
-        m_graph_id, m_name, i);
+    bool ref_exists = m_catalog_entries.IsInputFromVariable(i);
 
     // If the input is from a Variable node, we are dealing with later
     // just add a nullptr to the ng_inputs vector.
@@ -325,20 +561,30 @@ Status NGraphEncapsulateImpl::AllocateNGInputTensors(
     void* last_src_ptr = input_caches[i].first;
     std::shared_ptr<ng::runtime::Tensor> last_ng_tensor =
         input_caches[i].second;
+    // An executable compiled for a family of shapes sees different input
+    // shapes from call to call, the cached tensor is only good for its shape
+    if (last_ng_tensor != nullptr && last_ng_tensor->get_shape() != ng_shape) {
+      last_src_ptr = nullptr;
+      last_ng_tensor = nullptr;
+    }
     void* current_src_ptr = (void*)DMAHelper::base(&tf_input_tensors[i]);
     std::shared_ptr<ng::runtime::Tensor> current_ng_tensor = GetCurrentNgTensor(
-        current_src_ptr, last_src_ptr, last_ng_tensor, false, ng_exec,
+        current_src_ptr, last_src_ptr, last_ng_tensor, false,
+        io_cache_slot->freshness_user_id,
         op_backend, ng_element_type, ng_shape,
         m_executable_can_create_tensor ? inp_group_from_pipeline[i] : nullptr);
+    // The freshness tracker only knows about the tensors of the primary slot
+    if (!io_cache_slot->primary) {
+      current_ng_tensor->set_stale(true);
+    }
     bool is_cpu = m_op_backend_name == "CPU";
 
     if (!is_cpu && current_ng_tensor->get_stale()) {
       // Fresh or stale, in case of CPU this step is never needed
       try {
 #if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
-        int copies = number_of_copies;
-        SetNumberOfCopies(copies++);
-        copy_log_str << " COPY_INP_VAL[" << i << "]";
+        io_cache_slot->number_of_copies++;
+        io_cache_slot->copy_log << " COPY_INP_VAL[" << i << "]";
 #endif
         size_t copy_size =
             current_ng_tensor->get_element_count() * ng_element_type.size();
@@ -380,10 +626,11 @@ Status NGraphEncapsulateImpl::AllocateNGOutputTensors(
     const std::vector<Tensor*>& output_tensors,
     const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
     const PipelinedTensorVector& out_group_from_pipeline,
+    const std::shared_ptr<IOCacheSlot>& io_cache_slot,
     ng::runtime::Backend* const op_backend,
     vector<shared_ptr<ng::runtime::Tensor>>& ng_outputs) {
   std::vector<std::pair<void*, std::shared_ptr<ng::runtime::Tensor>>>&
-      output_caches = m_ng_exec_output_cache_map[ng_exec];
+      output_caches = io_cache_slot->outputs;
   output_caches.resize(ng_exec->get_results().size());
 
   // ngraph executable returns get_results, using that to get the tensor shape
@@ -401,8 +648,7 @@ Status NGraphEncapsulateImpl::AllocateNGOutputTensors(
     std::shared_ptr<ng::runtime::Tensor> current_ng_tensor = nullptr;
 
 #if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
-    bool ref_exists =
-        NGraphCatalog::ExistsInEncapOutputInfoMap(m_graph_id, m_name, i);
+    bool ref_exists = m_catalog_entries.IsOutputToVariable(i);
 
     // if the output tensor is going to be assigned to a variable
     // we are dealing with later, just add a nullptr to ng_outputs vectorç
@@ -415,7 +661,8 @@ Status NGraphEncapsulateImpl::AllocateNGOutputTensors(
 #endif
 
     current_ng_tensor = GetCurrentNgTensor(
-        current_dst_ptr, last_dst_ptr, last_ng_tensor, true, ng_exec,
+        current_dst_ptr, last_dst_ptr, last_ng_tensor, true,
+        io_cache_slot->freshness_user_id,
         op_backend, ng_element_type, ng_shape,
         m_executable_can_create_tensor ? out_group_from_pipeline[i] : nullptr);
 
@@ -427,12 +674,32 @@ Status NGraphEncapsulateImpl::AllocateNGOutputTensors(
   return Status::OK();
 }
 
+// Allocate dynamic tensors for the output results of an executable compiled
+// for a family of shapes
+Status NGraphEncapsulateImpl::AllocateNGDynamicOutputTensors(
+    const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
+    ng::runtime::Backend* const op_backend,
+    vector<shared_ptr<ng::runtime::Tensor>>& ng_outputs) {
+  for (auto i = 0; i < ng_exec->get_results().size(); i++) {
+    auto ng_element = ng_exec->get_results()[i];
+    try {
+      ng_outputs.push_back(op_backend->create_dynamic_tensor(
+          ng_element->get_element_type(),
+          ng_element->get_output_partial_shape(0)));
+    } catch (const std::exception& exp) {
+      return errors::Internal(
+          "Caught exception while creating dynamic output tensor: ",
+          exp.what());
+    }
+  }
+  return Status::OK();
+}
+
 // Get current ngraph tensor
 std::shared_ptr<ng::runtime::Tensor> NGraphEncapsulateImpl::GetCurrentNgTensor(
     void* current_tf_ptr, void* last_tf_ptr,
     const std::shared_ptr<ng::runtime::Tensor>& last_ng_tensor,
-    const bool& output_tensor,
-    const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
+    const bool& output_tensor, const int freshness_user_id,
     ng::runtime::Backend* const op_backend,
     const ng::element::Type& ng_element_type, const ng::Shape& ng_shape,
     std::shared_ptr<ng::runtime::Tensor> tensor_from_pipeline) {
@@ -464,7 +731,8 @@ std::shared_ptr<ng::runtime::Tensor> NGraphEncapsulateImpl::GetCurrentNgTensor(
   } else {
     is_stale = need_new_tensor_creation || tf_tensor_has_changed ||
                (!tf_tensor_has_changed &&
-                !m_freshness_tracker->IsFresh(current_tf_ptr, ng_exec));
+                !m_freshness_tracker->IsFresh(current_tf_ptr,
+                                              freshness_user_id));
   }
   // create a new ng tensor or use the last one
   std::shared_ptr<ng::runtime::Tensor> current_ng_tensor;
@@ -546,37 +814,42 @@ Status NGraphEncapsulateImpl::ParseNodeAttributes(
   return Status::OK();
 }
 
-Status NGraphEncapsulateImpl::UpdatePipelinedTensorCache(
-    std::shared_ptr<ngraph::runtime::Executable> ng_exec) {
-  if (!m_executable_can_create_tensor) {
-    return errors::Internal(
-        "UpdatePipelinedTensorCache called, but executable cannot create "
-        "tensors");
-  }
-  auto itr = m_executable_pipelined_tensors_map.find(ng_exec);
-  if (itr == m_executable_pipelined_tensors_map.end()) {
-    // Create these pipelined ng tensors only if needed, else reuse from cache
-    size_t num_inputs = ng_exec->get_parameters().size();
-    size_t num_outputs = ng_exec->get_results().size();
-    PipelinedTensorMatrix pipelined_input_tensors(num_inputs);
-    PipelinedTensorMatrix pipelined_output_tensors(num_outputs);
-    for (size_t i = 0; i < num_inputs; i++) {
-      pipelined_input_tensors[i] = ng_exec->create_input_tensor(i, m_depth);
-    }
-    for (size_t i = 0; i < num_outputs; i++) {
-      pipelined_output_tensors[i] = ng_exec->create_output_tensor(i, m_depth);
-    }
-    m_executable_pipelined_tensors_map.insert(
-        {ng_exec, PipelinedTensorsStore(pipelined_input_tensors,
-                                        pipelined_output_tensors)});
-  }
-  return Status::OK();
-}
-
+// Gets a free group of the pipelined tensors of the executable, creating
+// them on first use. Like the I/O cache, nothing is cached for an executable
+// that was evicted.
 std::tuple<int, PipelinedTensorVector, PipelinedTensorVector>
 NGraphEncapsulateImpl::GetTensorsFromPipeline(
     std::shared_ptr<ngraph::runtime::Executable> ng_exec) {
-  PipelinedTensorsStore pts = m_executable_pipelined_tensors_map.at(ng_exec);
+  // The copy shares the index library with the cached store, so that the
+  // (spinning) wait below does not need to hold the lock
+  std::unique_ptr<PipelinedTensorsStore> pts;
+  {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+    std::lock_guard<std::mutex> pipelined_lock(m_pipelined_tensors_mutex);
+    auto itr = m_executable_pipelined_tensors_map.find(ng_exec);
+    if (itr != m_executable_pipelined_tensors_map.end()) {
+      pts.reset(new PipelinedTensorsStore(itr->second));
+    } else {
+      // Create these pipelined ng tensors only if needed, else reuse from
+      // cache
+      size_t num_inputs = ng_exec->get_parameters().size();
+      size_t num_outputs = ng_exec->get_results().size();
+      PipelinedTensorMatrix pipelined_input_tensors(num_inputs);
+      PipelinedTensorMatrix pipelined_output_tensors(num_outputs);
+      for (size_t i = 0; i < num_inputs; i++) {
+        pipelined_input_tensors[i] = ng_exec->create_input_tensor(i, m_depth);
+      }
+      for (size_t i = 0; i < num_outputs; i++) {
+        pipelined_output_tensors[i] =
+            ng_exec->create_output_tensor(i, m_depth);
+      }
+      pts.reset(new PipelinedTensorsStore(pipelined_input_tensors,
+                                          pipelined_output_tensors));
+      if (IsCachedNgExecutable(ng_exec)) {
+        m_executable_pipelined_tensors_map.insert({ng_exec, *pts});
+      }
+    }
+  }
 
   // TODO: do something about this spin lock
   // get_tensors returns an index integer, that can be -1, 0, ... depth-1
@@ -584,7 +857,7 @@ NGraphEncapsulateImpl::GetTensorsFromPipeline(
   // or the pipeline is full. In that case, we need to wait, hence the while
   std::tuple<int, PipelinedTensorVector, PipelinedTensorVector> out_tpl;
   while (true) {
-    out_tpl = pts.get_tensors();
+    out_tpl = pts->get_tensors();
 
     if (std::get<0>(out_tpl) >= 0) {
       break;
@@ -596,6 +869,7 @@ NGraphEncapsulateImpl::GetTensorsFromPipeline(
 Status NGraphEncapsulateImpl::DumpNgFunction(
     const string& file_name,
     std::shared_ptr<ngraph::runtime::Executable> ng_exec) {
+  std::lock_guard<std::mutex> lock(m_exec_map_mutex);
   auto itr = m_serialized_ng_function_map.find(ng_exec);
   if (itr == m_serialized_ng_function_map.end()) {
     return errors::Internal(
@@ -606,20 +880,23 @@ Status NGraphEncapsulateImpl::DumpNgFunction(
 }
 
 void NGraphEncapsulateImpl::NGraphEncapsulateImpl::ClearExecMaps() {
-  m_ng_exec_input_cache_map.clear();
-  m_ng_exec_output_cache_map.clear();
+  std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+  m_ng_exec_io_cache_map.clear();
   m_ng_exec_map.clear();
   m_serialized_ng_function_map.clear();
+  m_dynamic_execs.clear();
+  std::lock_guard<std::mutex> pipelined_tensors_lock(m_pipelined_tensors_mutex);
   m_executable_pipelined_tensors_map.clear();
 }
 
 Status NGraphEncapsulateImpl::GetPipelineIdxAndTensors(
     const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
     std::tuple<int, PipelinedTensorVector, PipelinedTensorVector>& tpl) {
-  // Check if the pipelined tensors for this executable is created
-  // If not create and add them to the cache
-  TF_RETURN_IF_ERROR(UpdatePipelinedTensorCache(ng_exec));
-  // Cache must contain the ng_exec at this point
+  if (!m_executable_can_create_tensor) {
+    return errors::Internal(
+        "GetPipelineIdxAndTensors called, but executable cannot create "
+        "tensors");
+  }
 
   try {
     tpl = GetTensorsFromPipeline(ng_exec);
@@ -640,7 +917,12 @@ Status NGraphEncapsulateImpl::GetPipelineIdxAndTensors(
 Status NGraphEncapsulateImpl::ReturnPipelinedTensors(
     std::shared_ptr<ngraph::runtime::Executable> ng_exec, size_t idx) {
   try {
-    m_executable_pipelined_tensors_map.at(ng_exec).return_tensors(idx);
+    std::lock_guard<std::mutex> lock(m_pipelined_tensors_mutex);
+    // Nothing to return if the executable was evicted while the step ran
+    auto itr = m_executable_pipelined_tensors_map.find(ng_exec);
+    if (itr != m_executable_pipelined_tensors_map.end()) {
+      itr->second.return_tensors(idx);
+    }
   } catch (const std::exception& exp) {
     return errors::Internal(
         "Caught exception while returning pipelined tensors: ", exp.what(),
@@ -18,7 +18,11 @@
 #define NGRAPH_TF_ENCAPSULATE_IMPL_H_
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <ostream>
+#include <set>
+#include <sstream>
 #include <vector>
 
 #include "tensorflow/core/framework/tensor_shape.h"
@@ -27,6 +31,8 @@
 #include "ngraph/ngraph.hpp"
 
 #include "logging/ngraph_log.h"
+#include "ngraph_bridge/ngraph_cache_budget.h"
+#include "ngraph_bridge/ngraph_catalog.h"
 #include "ngraph_bridge/ngraph_freshness_tracker.h"
 #include "ngraph_bridge/ngraph_pipelined_tensors.h"
 
@@ -34,12 +40,30 @@ namespace tensorflow {
 
 namespace ngraph_bridge {
 
-using NgFunctionIOCache = std::unordered_map<
-    std::shared_ptr<ngraph::runtime::Executable>,
-    std::vector<std::pair<void*, shared_ptr<ng::runtime::Tensor>>>>;
-
 class NGraphEncapsulateImpl {
  public:
+  // The cached input/output tensors of an executable (with the TF buffers
+  // they were last used with). A step checks out a slot for its whole run, so
+  // that concurrent steps on the same executable do not share tensors. Only
+  // the first (primary) slot relies on the freshness tracker.
+  // The step also keeps its copy counts and log in the slot.
+  struct IOCacheSlot {
+    std::vector<std::pair<void*, shared_ptr<ng::runtime::Tensor>>> inputs;
+    std::vector<std::pair<void*, shared_ptr<ng::runtime::Tensor>>> outputs;
+    // Id of the executable in the freshness tracker, resolved once when its
+    // first slot is created. -1 if the executable is not cached
+    int freshness_user_id = -1;
+    bool primary = false;
+    bool in_use = false;
+    bool log_copies = false;
+    int number_of_copies = 0;
+    std::stringstream copy_log;
+  };
+
+  using NgFunctionIOCache =
+      std::unordered_map<std::shared_ptr<ngraph::runtime::Executable>,
+                         std::vector<std::shared_ptr<IOCacheSlot>>>;
+
   // Ngraph Encapsulate Implementation class for EncapsulateOp class
   explicit NGraphEncapsulateImpl();
 
@@ -50,6 +74,14 @@ class NGraphEncapsulateImpl {
                           std::vector<const Tensor*>& static_input_map,
                           std::stringstream& signature_ss);
 
+  // Like ComputeSignature, but the batch dimension of the non-static inputs is
+  // left dynamic, so that all the shapes of a family share the signature
+  Status ComputeDynamicSignature(
+      const std::vector<Tensor>& tf_input_tensors,
+      std::vector<ngraph::PartialShape>& input_shapes,
+      std::vector<const Tensor*>& static_input_map,
+      std::stringstream& signature_ss);
+
   // Calls Compute Signature and gets ngraph executable
   Status GetNgExecutable(const std::vector<Tensor>& tf_input_tensors,
                          std::vector<TensorShape>& input_shapes,
@@ -57,12 +89,21 @@ class NGraphEncapsulateImpl {
                          ng::runtime::Backend*& op_backend,
                          std::shared_ptr<ngraph::runtime::Executable>& ng_exec);
 
+  // Gets the executable compiled for the family of shapes the inputs belong
+  // to. Called from GetNgExecutable when dynamic shapes are enabled
+  Status GetDynamicNgExecutable(
+      const std::vector<Tensor>& tf_input_tensors,
+      std::vector<const Tensor*>& static_input_map,
+      ng::runtime::Backend* const op_backend,
+      std::shared_ptr<ngraph::runtime::Executable>& ng_exec);
+
   // Allocate tensors for input arguments. Creates ngraph input tensors using
   // tensorflow tensors required to execute ngraph function
   Status AllocateNGInputTensors(
       const std::vector<Tensor>& tf_input_tensors,
       const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
       const PipelinedTensorVector& inp_group_from_pipeline,
+      const std::shared_ptr<IOCacheSlot>& io_cache_slot,
       ng::runtime::Backend* const op_backend,
       vector<shared_ptr<ng::runtime::Tensor>>& ng_inputs);
 
@@ -72,6 +113,22 @@ class NGraphEncapsulateImpl {
       const std::vector<Tensor*>& tf_output_tensors,
       const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
       const PipelinedTensorVector& out_group_from_pipeline,
+      const std::shared_ptr<IOCacheSlot>& io_cache_slot,
+      ng::runtime::Backend* const op_backend,
+      vector<shared_ptr<ng::runtime::Tensor>>& ng_outputs);
+
+  // Checks out a slot of cached I/O tensors of the executable for this step,
+  // creating a new one if all of them are used by concurrent steps. An
+  // executable evicted from the cache gets a slot that is not cached
+  std::shared_ptr<IOCacheSlot> AcquireIOCacheSlot(
+      const std::shared_ptr<ngraph::runtime::Executable>& ng_exec);
+
+  void ReleaseIOCacheSlot(const std::shared_ptr<IOCacheSlot>& io_cache_slot);
+
+  // Allocate dynamic tensors for the output results of an executable compiled
+  // for a family of shapes. Their shapes are only known after the call
+  Status AllocateNGDynamicOutputTensors(
+      const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
       ng::runtime::Backend* const op_backend,
       vector<shared_ptr<ng::runtime::Tensor>>& ng_outputs);
 
@@ -79,8 +136,7 @@ class NGraphEncapsulateImpl {
   std::shared_ptr<ng::runtime::Tensor> GetCurrentNgTensor(
       void* current_tf_ptr, void* last_tf_ptr,
       const std::shared_ptr<ng::runtime::Tensor>& last_ng_tensor,
-      const bool& output_tensor,
-      const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
+      const bool& output_tensor, const int freshness_user_id,
       ng::runtime::Backend* const op_backend,
       const ng::element::Type& ng_element_type, const ng::Shape& ng_shape,
       std::shared_ptr<ng::runtime::Tensor> tensor_from_pipeline);
@@ -110,19 +166,19 @@ class NGraphEncapsulateImpl {
 
   void SetGraphId(const int& graph_id) { m_graph_id = graph_id; }
 
-#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
-  const int& GetNumberOfCopies() { return number_of_copies; }
-
-  void SetNumberOfCopies(const int& number) { number_of_copies = number; }
-
-  void AppendCopyLog(const string str) { copy_log_str << str; }
-#endif
-
   const int& GetNgraphCluster() { return m_ngraph_cluster; }
 
   void SetNgraphCluster(const int& cluster) { m_ngraph_cluster = cluster; }
 
-  const int& GetFunctionCache() { return my_function_cache_depth_in_items; }
+  // Accounts the executable cache in NGraphCacheBudget as the executor
+  // instance_id. If max_cache_depth is positive, its depth adapts to the
+  // signatures seen, up to max_cache_depth items
+  void SetCacheDepth(int instance_id, int cache_depth, int max_cache_depth);
+
+  int GetCacheDepth() {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+    return my_function_cache_depth_in_items;
+  }
 
   const int& GetNumberOfOutputs() { return m_number_outputs; }
 
@@ -132,6 +188,15 @@ class NGraphEncapsulateImpl {
 
   void SetNumberOfInputs(const int& n) { m_number_inputs = n; }
 
+  // Catalog entries of the encapsulate, set once when the kernel is built
+  const NGraphCatalog::EncapsulateEntries& GetCatalogEntries() {
+    return m_catalog_entries;
+  }
+
+  void SetCatalogEntries(const NGraphCatalog::EncapsulateEntries& entries) {
+    m_catalog_entries = entries;
+  }
+
   const int& GetInstanceId() { return my_instance_id; }
 
   const string& GetOpBackend() { return m_op_backend_name; }
@@ -140,12 +205,6 @@ class NGraphEncapsulateImpl {
     m_op_backend_name = backend_name;
   }
 
-  bool GetLogCopies() { return log_copies; }
-
-  void SetLogCopies(bool value) { log_copies = value; }
-
-  const string GetCopyLog() { return copy_log_str.str(); }
-
   const std::vector<bool> GetStaticInputVector() { return m_input_is_static; }
 
   void ResizeStaticInputVector(const int& size) {
@@ -157,35 +216,28 @@ class NGraphEncapsulateImpl {
 
   std::unordered_map<std::string, std::shared_ptr<ngraph::runtime::Executable>>
   GetNgExecMap() {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
     return m_ng_exec_map;
   }
 
   void SetNgExecMap(const std::string& ng_map_key,
                     const std::shared_ptr<ngraph::runtime::Executable>& exec) {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
     m_ng_exec_map[ng_map_key] = exec;
   }
 
-  void ClearNgExecMap() { m_ng_exec_map.clear(); }
-
-  // TODO:sindhu have another get function for output_cache which is only
-  // readable
-  std::vector<std::pair<void*, shared_ptr<ng::runtime::Tensor>>>&
-  GetNgExecOutputCacheMap(std::shared_ptr<ngraph::runtime::Executable> exec) {
-    return m_ng_exec_output_cache_map[exec];
+  void ClearNgExecMap() {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+    m_ng_exec_map.clear();
   }
 
-  void SetNgExecOutputCacheMap(
-      const std::shared_ptr<ngraph::runtime::Executable>& exec,
-      const std::vector<std::pair<void*, shared_ptr<ng::runtime::Tensor>>>&
-          cache) {
-    m_ng_exec_output_cache_map[exec] = cache;
+  void ClearNgExecIOCache() {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+    m_ng_exec_io_cache_map.clear();
   }
 
-  void ClearNgExecInputCache() { m_ng_exec_input_cache_map.clear(); }
-
-  void ClearNgExecOutputCache() { m_ng_exec_output_cache_map.clear(); }
-
   void ClearNgExecSerializedFunctionCache() {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
     m_serialized_ng_function_map.clear();
   }
 
@@ -206,7 +258,18 @@ class NGraphEncapsulateImpl {
 
   bool GetExecCanCreateTensor() { return m_executable_can_create_tensor; }
 
+  void SetDynamicShapes(bool b) { m_dynamic_shapes = b; }
+
+  bool GetDynamicShapes() { return m_dynamic_shapes; }
+
+  bool IsDynamicExecutable(
+      const std::shared_ptr<ngraph::runtime::Executable>& ng_exec) {
+    std::lock_guard<std::mutex> lock(m_exec_map_mutex);
+    return m_dynamic_execs.find(ng_exec) != m_dynamic_execs.end();
+  }
+
   void ClearNgExecPipelinedTensorMap() {
+    std::lock_guard<std::mutex> lock(m_pipelined_tensors_mutex);
     m_executable_pipelined_tensors_map.clear();
   }
 
@@ -214,17 +277,41 @@ class NGraphEncapsulateImpl {
   Graph m_graph;
 
  private:
-  int number_of_copies = 0;
+  // Called with m_exec_map_mutex held
+  bool IsCachedNgExecutable(
+      const std::shared_ptr<ngraph::runtime::Executable>& ng_exec) {
+    return m_serialized_ng_function_map.find(ng_exec) !=
+           m_serialized_ng_function_map.end();
+  }
+
+  // Called with m_exec_map_mutex held
+  bool LookUpNgExecutable(
+      const string& signature,
+      std::shared_ptr<ngraph::runtime::Executable>& ng_exec);
+
+  void InsertNgExecutable(
+      const string& signature, const string& serialized_ng_func,
+      const bool is_dynamic, ng::runtime::Backend* const op_backend,
+      std::shared_ptr<ngraph::runtime::Executable>& ng_exec);
+
+  // Drops the least recently used executable from the cache. It is removed
+  // from the backend once the steps still running it are done.
+  // Called with m_exec_map_mutex held
+  void EvictNgExecutable();
+
+  // Records a lookup of the executable cache in m_cache_depth, resizing the
+  // cache if it is adaptive. Called without m_exec_map_mutex held
+  void RecordCacheLookup(const string& signature, bool cache_hit);
+
   int m_ngraph_cluster{-1};
   int m_graph_id{-1};
   int my_function_cache_depth_in_items = 16;
   int m_number_outputs = -1;
   int m_number_inputs = -1;
+  NGraphCatalog::EncapsulateEntries m_catalog_entries;
   int my_instance_id{0};
   string m_op_backend_name;
   string m_name;
-  std::stringstream copy_log_str;
-  bool log_copies = false;
   std::vector<bool> m_input_is_static;
   std::list<std::string> m_lru;
   static int s_instance_count;
@@ -232,14 +319,20 @@ class NGraphEncapsulateImpl {
   map<string, string> m_aot_functions;
   map<string, string> m_aot_execs;
 
-  // ng_function, ng_executable, Output and Input Cache maps
+  // ng_function, ng_executable, Output and Input Cache maps. These (with
+  // m_lru and m_dynamic_execs) are guarded by m_exec_map_mutex, which is
+  // never held while translating, compiling or executing.
+  // The executables are wrapped by MakeRemovableExecutable, an executable
+  // is cached as long as it is in m_serialized_ng_function_map.
   std::unordered_map<std::string, std::shared_ptr<ngraph::runtime::Executable>>
       m_ng_exec_map;
   std::unordered_map<std::shared_ptr<ngraph::runtime::Executable>, std::string>
       m_serialized_ng_function_map;
 
-  NgFunctionIOCache m_ng_exec_input_cache_map;
-  NgFunctionIOCache m_ng_exec_output_cache_map;
+  NgFunctionIOCache m_ng_exec_io_cache_map;
+  std::mutex m_exec_map_mutex;
+  // Set by SetCacheDepth, my_function_cache_depth_in_items follows it
+  std::unique_ptr<NGraphCacheDepth> m_cache_depth;
 
   // Freshness tracker maintains a set of ng::functions using a particular base
   // pointer(for Tensor)
@@ -251,13 +344,17 @@ class NGraphEncapsulateImpl {
   std::unordered_map<std::shared_ptr<ngraph::runtime::Executable>,
                      PipelinedTensorsStore>
       m_executable_pipelined_tensors_map;
+  std::mutex m_pipelined_tensors_mutex;
 
-  Status UpdatePipelinedTensorCache(
-      std::shared_ptr<ngraph::runtime::Executable> ng_exec);
   std::tuple<int, PipelinedTensorVector, PipelinedTensorVector>
   GetTensorsFromPipeline(std::shared_ptr<ngraph::runtime::Executable> ng_exec);
 
   int m_depth{2};  // TODO make this settable
+
+  // Opt-in compilation of one executable per family of input shapes. Turned
+  // off for good if the cluster cannot be translated or compiled that way
+  std::atomic<bool> m_dynamic_shapes{false};
+  std::set<std::shared_ptr<ngraph::runtime::Executable>> m_dynamic_execs;
 };
 
 }  // namespace ngraph_bridge
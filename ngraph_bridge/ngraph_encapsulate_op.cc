@@ -13,6 +13,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  *******************************************************************************/
+#include <algorithm>
 #include <cstdlib>
 #include <mutex>
 #include <utility>
@@ -28,6 +29,7 @@
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 
 #include "ngraph/event_tracing.hpp"
 #include "ngraph/runtime/backend.hpp"
@@ -63,6 +65,51 @@ namespace ngraph_bridge {
 
 int NGraphEncapsulateOp::s_instance_id = 0;
 
+// Hands an I/O cache slot back to the encapsulate impl when a step of the
+// legacy executor finishes (or bails out)
+class IOCacheSlotReleaser {
+ public:
+  IOCacheSlotReleaser(
+      NGraphEncapsulateImpl& ng_encap_impl,
+      const std::shared_ptr<NGraphEncapsulateImpl::IOCacheSlot>& io_cache_slot)
+      : m_ng_encap_impl(ng_encap_impl), m_io_cache_slot(io_cache_slot) {}
+  ~IOCacheSlotReleaser() {
+    m_ng_encap_impl.ReleaseIOCacheSlot(m_io_cache_slot);
+  }
+
+ private:
+  NGraphEncapsulateImpl& m_ng_encap_impl;
+  std::shared_ptr<NGraphEncapsulateImpl::IOCacheSlot> m_io_cache_slot;
+};
+
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+// Removes the entries of the encapsulate from the Catalog
+static void RemoveFromCatalog(const int graph_id, const string& node_name,
+                              const int number_of_inputs,
+                              const int number_of_outputs) {
+  // Remove entries related to outputs
+  for (int i = 0; i < number_of_outputs; i++) {
+    string key = NGraphCatalog::CreateNodeKey(graph_id, node_name, i);
+    if (NGraphCatalog::ExistsInEncapOutputInfoMap(key)) {
+      NGraphCatalog::DeleteFromEncapOutputInfoMap(key);
+      NGRAPH_VLOG(2) << "Deleting from output info map " << key;
+    }
+  }
+
+  NGRAPH_VLOG(2) << "Deleting from Output Copy Index map " << node_name;
+  NGraphCatalog::DeleteFromEncapOutputCopyIndexesMap(graph_id, node_name);
+
+  // Remove entries related to inputs
+  for (int i = 0; i < number_of_inputs; i++) {
+    string key = NGraphCatalog::CreateNodeKey(graph_id, node_name, i);
+    if (NGraphCatalog::ExistsInInputVariableSharedNameMap(key)) {
+      NGraphCatalog::DeleteFromInputVariableSharedNameMap(key);
+      NGRAPH_VLOG(2) << "Deleting from input variable shared name map " << key;
+    }
+  }
+}
+#endif
+
 //---------------------------------------------------------------------------
 //  NGraphEncapsulateOp::ctor
 //---------------------------------------------------------------------------
@@ -87,13 +134,9 @@ NGraphEncapsulateOp::NGraphEncapsulateOp(OpKernelConstruction* ctx)
       ctx, backend != nullptr,
       errors::Internal("Cannot get the backend object for BE: ", be_name));
 
-// If we have the VARIABLE capture on then we can't use the
-// parallel executor until that support is added.
-#if !defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+  // With the VARIABLE capture on, the parallel executor binds the NGraphVar
+  // tensors directly and only pipelines the other inputs and outputs
   m_use_parallel_executor = backend->executable_can_create_tensors();
-#else
-  m_use_parallel_executor = false;
-#endif
 
   // Override the switch for debugging/testing
   if (std::getenv("NGRAPH_TF_USE_LEGACY_EXECUTOR") != nullptr) {
@@ -106,6 +149,76 @@ NGraphEncapsulateOp::NGraphEncapsulateOp(OpKernelConstruction* ctx)
   } else {
     CreateLegacyExecutor(ctx, be_name);
   }
+
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+  // The Catalog is complete once the graph is rewritten, resolve the entries
+  // of this op now so that Compute does not go through the Catalog
+  int graph_id{-1};
+  OP_REQUIRES_OK(ctx, ctx->GetAttr("ngraph_graph_id", &graph_id));
+  ng_encap_impl_.SetCatalogEntries(NGraphCatalog::GetEncapsulateEntries(
+      graph_id, name(), ctx->num_inputs(), ctx->num_outputs()));
+#endif
+}
+
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+//---------------------------------------------------------------------------
+//  LookUpVariables
+//---------------------------------------------------------------------------
+// The variables only exist once their NGraphVariable ops ran, so they are
+// looked up in the resource manager on the first step. The op then holds a
+// reference to each of them until it is destroyed
+Status NGraphEncapsulateOp::LookUpVariables(OpKernelContext* ctx) {
+  if (m_variables_looked_up_) {
+    return Status::OK();
+  }
+  std::lock_guard<std::mutex> lock(m_variables_mutex_);
+  if (m_variables_looked_up_) {
+    return Status::OK();
+  }
+
+  const auto& entries = ng_encap_impl_.GetCatalogEntries();
+  auto look_up = [ctx](const vector<string>& shared_names,
+                       vector<NGraphVar*>& vars) -> Status {
+    vars.resize(shared_names.size(), nullptr);
+    for (int i = 0; i < shared_names.size(); i++) {
+      if (shared_names[i].empty() || vars[i] != nullptr) {
+        continue;
+      }
+      TF_RETURN_IF_ERROR(ctx->resource_manager()->Lookup<NGraphVar>(
+          ctx->resource_manager()->default_container(), shared_names[i],
+          &vars[i]));
+    }
+    return Status::OK();
+  };
+  TF_RETURN_IF_ERROR(
+      look_up(entries.input_variable_shared_names, m_input_vars_));
+  TF_RETURN_IF_ERROR(
+      look_up(entries.output_variable_shared_names, m_output_vars_));
+
+  m_variables_looked_up_ = true;
+  return Status::OK();
+}
+#endif
+
+// If NGRAPH_TF_FUNCTION_CACHE_ITEM_DEPTH is set the executable cache depth is
+// pinned to it (max_cache_depth is 0), otherwise the cache starts at the
+// default depth and adapts it to the signatures it sees, up to
+// NGRAPH_TF_FUNCTION_CACHE_MAX_ITEM_DEPTH
+static void GetCacheDepthFromEnv(int& cache_depth, int& max_cache_depth) {
+  cache_depth = 16;
+  max_cache_depth = 0;
+  const char* cache_depth_specified =
+      std::getenv("NGRAPH_TF_FUNCTION_CACHE_ITEM_DEPTH");
+  if (cache_depth_specified != nullptr) {
+    cache_depth = atoi(cache_depth_specified);
+    return;
+  }
+  max_cache_depth = 64;
+  const char* max_cache_depth_specified =
+      std::getenv("NGRAPH_TF_FUNCTION_CACHE_MAX_ITEM_DEPTH");
+  if (max_cache_depth_specified != nullptr) {
+    max_cache_depth = atoi(max_cache_depth_specified);
+  }
 }
 
 //---------------------------------------------------------------------------
@@ -148,19 +261,21 @@ void NGraphEncapsulateOp::CreateParallelExecutor(OpKernelConstruction* ctx,
   int graph_id{-1};
   OP_REQUIRES_OK(ctx, ctx->GetAttr("ngraph_graph_id", &graph_id));
 
-  const int cache_depth = 16;
-  int my_function_cache_depth_in_items = cache_depth;
-  const char* cache_depth_specified =
-      std::getenv("NGRAPH_TF_FUNCTION_CACHE_ITEM_DEPTH");
-  if (cache_depth_specified != nullptr) {
-    my_function_cache_depth_in_items = atoi(cache_depth_specified);
-  }
+  int my_function_cache_depth_in_items;
+  int my_max_cache_depth_in_items;
+  GetCacheDepthFromEnv(my_function_cache_depth_in_items,
+                       my_max_cache_depth_in_items);
 
   // Create the Executor object
   m_parallel_executor = move(unique_ptr<NGraphExecutor>(
       new NGraphExecutor(s_instance_id, cluster_id, graph_id, encap_subgraph,
                          backend_name, my_function_cache_depth_in_items)));
 
+  if (my_max_cache_depth_in_items > 0) {
+    m_parallel_executor->EnableAdaptiveCacheDepth(
+        my_max_cache_depth_in_items);
+  }
+
   auto tensor_manager = m_parallel_executor->GetTensorManager();
   OP_REQUIRES(ctx, tensor_manager->GetNumberOfInputs() == ctx->num_inputs(),
               errors::Internal(
@@ -234,6 +349,15 @@ void NGraphEncapsulateOp::CreateLegacyExecutor(OpKernelConstruction* ctx,
   int graph_id{-1};
   OP_REQUIRES_OK(ctx, ctx->GetAttr("ngraph_graph_id", &graph_id));
   ng_encap_impl_.SetGraphId(graph_id);
+
+  // The executable cache is accounted like the one of the parallel executor
+  int my_function_cache_depth_in_items;
+  int my_max_cache_depth_in_items;
+  GetCacheDepthFromEnv(my_function_cache_depth_in_items,
+                       my_max_cache_depth_in_items);
+  ng_encap_impl_.SetCacheDepth(s_instance_id, my_function_cache_depth_in_items,
+                               my_max_cache_depth_in_items);
+  s_instance_id++;
   //
   // Initialize the "m_input_is_static" vector as follows:
   // (1) create m_input_is_static with n+1 elements, where n is the max arg
@@ -306,6 +430,24 @@ void NGraphEncapsulateOp::CreateLegacyExecutor(OpKernelConstruction* ctx,
   NGRAPH_VLOG(5) << "Executable can " << (exec_can_create_tensor ? "" : "not")
                  << " create tensors";
 
+// Variables are bound to fixed shape tensors, so only use dynamic shapes
+// when the variable capture is off
+#if !defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+  // Opt-in: compile one executable per family of input shapes (the batch
+  // dimension left dynamic), if the backend can run such executables.
+  // Executables that create their own (pipelined) tensors need static shapes
+  if (std::getenv("NGRAPH_TF_DYNAMIC_SHAPES") != nullptr) {
+    bool supports_dynamic =
+        BackendManager::GetBackend(ng_encap_impl_.GetOpBackend())
+            ->supports_dynamic_tensors();
+    ng_encap_impl_.SetDynamicShapes(supports_dynamic &&
+                                    !exec_can_create_tensor);
+    NGRAPH_VLOG(3) << "Dynamic shapes requested for " << name() << ", "
+                   << (ng_encap_impl_.GetDynamicShapes() ? "enabled"
+                                                         : "not supported");
+  }
+#endif
+
   event.Stop();
   ngraph::Event::write_trace(event);
 }
@@ -320,6 +462,19 @@ NGraphEncapsulateOp::~NGraphEncapsulateOp() {
   ngraph::Event event(oss.str(), name(), "");
   NGRAPH_VLOG(2) << "~NGraphEncapsulateOp::" << name();
 
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+  for (NGraphVar* var : m_input_vars_) {
+    if (var != nullptr) {
+      var->Unref();
+    }
+  }
+  for (NGraphVar* var : m_output_vars_) {
+    if (var != nullptr) {
+      var->Unref();
+    }
+  }
+#endif
+
   if (m_use_parallel_executor) {
     NGRAPH_VLOG(2)
         << "~NGraphEncapsulateOp():: ParallelExecutor: ReleaseBackend";
@@ -335,51 +490,30 @@ NGraphEncapsulateOp::~NGraphEncapsulateOp() {
     // So - we reset the executor (which holds backend tensors and
     // other items) - that reduces the ref count and possibly delete if
     // 0. Then we release the backend
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+    auto tensor_manager = m_parallel_executor->GetTensorManager();
+    RemoveFromCatalog(m_parallel_executor->GetGraphId(), name(),
+                      tensor_manager->GetNumberOfInputs(),
+                      tensor_manager->GetNumberOfOutputs());
+#endif
     string backend = m_parallel_executor->GetOpBackendName();
     m_parallel_executor.reset();
     BackendManager::ReleaseBackend(backend);
     return;
   }
 
-  // If the kernel goes away, we must de-register all of its cached
-  // functions
-  // from the freshness tracker.
+  // The cached functions are de-registered from the freshness tracker (and
+  // removed from the backend) when ClearExecMaps drops them below.
   if (ng_encap_impl_.GetNgraphFreshnessTracker() != nullptr) {
-    for (auto kv : ng_encap_impl_.GetNgExecMap()) {
-      ng_encap_impl_.GetNgraphFreshnessTracker()->RemoveUser(kv.second);
-    }
-
     // TODO(amprocte): We should be able to unref the tracker here, but it
     // seems to screw things up in the C++ unit tests.
     // m_freshness_tracker->Unref();
   }
 
 #if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
-  // Remove Entries from Catalog
-  // Remove entries related to outputs
-  for (int i = 0; i < ng_encap_impl_.GetNumberOfOutputs(); i++) {
-    string key =
-        NGraphCatalog::CreateNodeKey(ng_encap_impl_.GetGraphId(), name(), i);
-    if (NGraphCatalog::ExistsInEncapOutputInfoMap(key)) {
-      NGraphCatalog::DeleteFromEncapOutputInfoMap(key);
-      NGRAPH_VLOG(2) << "Deleting from output info map " << key;
-    }
-  }
-
-  NGRAPH_VLOG(2) << "Deleting from Output Copy Index map " << name();
-  NGraphCatalog::DeleteFromEncapOutputCopyIndexesMap(
-      ng_encap_impl_.GetGraphId(), name());
-
-  // Remove entries related to inputs
-  for (int i = 0; i < ng_encap_impl_.GetNumberOfOutputs(); i++) {
-    string key =
-        NGraphCatalog::CreateNodeKey(ng_encap_impl_.GetGraphId(), name(), i);
-    if (NGraphCatalog::ExistsInInputVariableSharedNameMap(key)) {
-      NGraphCatalog::DeleteFromInputVariableSharedNameMap(key);
-      NGRAPH_VLOG(2) << "Deleting from input variable shared name map " << key;
-    }
-  }
-
+  RemoveFromCatalog(ng_encap_impl_.GetGraphId(), name(),
+                    ng_encap_impl_.GetNumberOfInputs(),
+                    ng_encap_impl_.GetNumberOfOutputs());
 #endif
 
   ng_encap_impl_.ClearExecMaps();
@@ -446,8 +580,9 @@ void NGraphEncapsulateOp::ComputeUsingParallelExecutor(OpKernelContext* ctx) {
   ngraph::Event::write_trace(event_get_ng_item);
 
   // Error check for pipelined tensors and pipeline depth
-  OP_REQUIRES(ctx, m_parallel_executor->GetTensorPipelineDepth() == 2,
-              errors::Internal("Pipeline Depth is not 2, got ",
+  // (the executors with prefetched inputs use a deeper pipeline)
+  OP_REQUIRES(ctx, m_parallel_executor->GetTensorPipelineDepth() >= 2,
+              errors::Internal("Pipeline Depth is less than 2, got ",
                                m_parallel_executor->GetTensorPipelineDepth()));
 
   std::tuple<int, PipelinedTensorVector, PipelinedTensorVector> io_tensors;
@@ -484,26 +619,41 @@ void NGraphEncapsulateOp::ComputeUsingParallelExecutor(OpKernelContext* ctx) {
 
   // create inputs, outputs, pipelineId
   int num_of_inputs = tensor_manager->GetNumberOfInputs();
-  int num_of_outputs = tensor_manager->GetNumberOfInputs();
+  int num_of_outputs = tensor_manager->GetNumberOfOutputs();
   int current_iter_pipeline_depth = get<0>(io_tensors);
   vector<shared_ptr<ng::runtime::Tensor>> ng_inputs(num_of_inputs);
   vector<shared_ptr<ng::runtime::Tensor>> ng_outputs(num_of_outputs);
 
-  // Assume All inputs and outputs are pipelined
-  // TODO: Fit in variables
+  // The pipelined tensor store has no tensors for the inputs fed by and the
+  // outputs assigning variables, those are bound to the NGraphVar tensors
+  // below
   ng_inputs = get<1>(io_tensors);
   ng_outputs = get<2>(io_tensors);
 
   bool skip_tf2ng_copy = false;
-  if (std::getenv(NGraphPrefetchSharedResouce::NGRAPH_TF_USE_PREFETCH) !=
-      nullptr) {
+  // Holds a reference to the prefetch shared obj when we execute on the
+  // tensors staged by the prefetcher, to report the execution time
+  NGraphPrefetchSharedResouce* staging_shared_data = nullptr;
+  auto unref_staging_shared_data = gtl::MakeCleanup([&staging_shared_data] {
+    if (staging_shared_data != nullptr) {
+      staging_shared_data->Unref();
+    }
+  });
+  int64 staging_stall_us = 0;
+  int released_pipeline_depth = -1;
+  if (!tensor_manager->GetPrefetchedInputIndexes().empty()) {
     NGraphPrefetchSharedResouce::InputTensorBundle prefetch_input_tensor_bundle{
-        current_iter_pipeline_depth, ng_inputs};
+        current_iter_pipeline_depth, ng_inputs, pipelined_tensor_store, false};
     // Set the prefetch shared obj if applicable
+    // Every encapsulate fed by an iterator has its own shared obj
+    const string shared_data_name = NGraphPrefetchSharedResouce::ResourceName(
+        m_parallel_executor->GetGraphId(),
+        m_parallel_executor->GetNgraphClusterId(),
+        tensor_manager->GetPrefetchedInputIndexes());
     NGraphPrefetchSharedResouce* shared_data = nullptr;
     Status s = ctx->resource_manager()->Lookup(
-        NGraphPrefetchSharedResouce::CONTAINER_NAME,
-        NGraphPrefetchSharedResouce::RESOURCE_NAME, &shared_data);
+        NGraphPrefetchSharedResouce::CONTAINER_NAME, shared_data_name,
+        &shared_data);
 
     if (!s.ok()) {
       // We are using this for the first time i.e., we need to do the following
@@ -514,35 +664,68 @@ void NGraphEncapsulateOp::ComputeUsingParallelExecutor(OpKernelContext* ctx) {
       //    for this iteration.
       shared_data = new NGraphPrefetchSharedResouce(
           name(), m_parallel_executor->GetOpBackendName(),
+          m_parallel_executor->GetNgraphClusterId(),
           m_parallel_executor->GetGraphId(),
-          m_parallel_executor->GetNgraphClusterId());
+          tensor_manager->GetPrefetchedInputIndexes(),
+          tensor_manager->GetPrefetchedInputComponents(),
+          m_parallel_executor->GetTensorPipelineDepth() - 1);
+      // Nobody else sees the shared object until it is created below, and
+      // the depth is at least one, so the first slot is always free
+      OP_REQUIRES(ctx, shared_data->TryAddStagingSlot(
+                           shared_data->GetAutotuner().GetDepth()),
+                  errors::Internal("No staging slot for the first input "
+                                   "tensor bundle"));
       // Get the set of IO tensors for the next iteration
       std::tuple<int, PipelinedTensorVector, PipelinedTensorVector>
           io_tensors_next_iter;
       io_tensors_next_iter = pipelined_tensor_store->get_tensors();
       // Save the ngTensors for the next iteration
       NGraphPrefetchSharedResouce::InputTensorBundle next_input_tensor_bundle{
-          get<0>(io_tensors_next_iter), get<1>(io_tensors_next_iter)};
+          get<0>(io_tensors_next_iter), get<1>(io_tensors_next_iter),
+          pipelined_tensor_store, false};
 
       OP_REQUIRES(ctx,
-                  current_iter_pipeline_depth == (!next_input_tensor_bundle.Id),
+                  next_input_tensor_bundle.Id >= 0 &&
+                      current_iter_pipeline_depth !=
+                          next_input_tensor_bundle.Id,
                   errors::Internal("Current Pipeline Depth is ",
                                    current_iter_pipeline_depth,
-                                   " and next iter pipeline depth is also  ",
+                                   " and next iter pipeline depth is ",
                                    next_input_tensor_bundle.Id));
 
-      shared_data->AddNextInputTensorBundleForDeviceTransfer(
-          next_input_tensor_bundle);
-
-      ctx->SetStatus(ctx->resource_manager()->Create(
-          NGraphPrefetchSharedResouce::CONTAINER_NAME,
-          NGraphPrefetchSharedResouce::RESOURCE_NAME, shared_data));
+      OP_REQUIRES_OK(ctx,
+                     shared_data->AddNextInputTensorBundleForDeviceTransfer(
+                         next_input_tensor_bundle));
+
+      OP_REQUIRES_OK(ctx, ctx->resource_manager()->Create(
+                              NGraphPrefetchSharedResouce::CONTAINER_NAME,
+                              shared_data_name, shared_data));
+
+      // Register with the NGraphPrefetchDataset of our iterator, which
+      // stages the next elements for all of its consumers
+      NGraphPrefetchConsumers* consumers = nullptr;
+      OP_REQUIRES_OK(
+          ctx, ctx->resource_manager()->LookupOrCreate<NGraphPrefetchConsumers>(
+                   NGraphPrefetchSharedResouce::CONTAINER_NAME,
+                   NGraphPrefetchConsumers::ResourceName(
+                       tensor_manager->GetPrefetchIteratorGraphId(),
+                       tensor_manager->GetPrefetchIteratorName()),
+                   &consumers, [](NGraphPrefetchConsumers** consumers) {
+                     *consumers = new NGraphPrefetchConsumers();
+                     return Status::OK();
+                   }));
+      consumers->AddConsumer(shared_data_name);
+      consumers->Unref();
       // Continue the execution with the currently supplied TF tensor for the
       // last time
       NGRAPH_VLOG(2) << "[PREFETCH] COMPUTE: Creating the shared object to "
                         "signal prefetching";
     } else {
-      int prefetch_buffer_depth = shared_data->GetBufferDepth();
+      // Held until the end of the Compute if we use the staged tensors
+      auto unref_shared_data =
+          gtl::MakeCleanup([&shared_data] { shared_data->Unref(); });
+      int prefetch_buffer_depth;
+      OP_REQUIRES_OK(ctx, shared_data->GetBufferDepth(&prefetch_buffer_depth));
       int skip_count = shared_data->GetSkipCount();
       NGRAPH_VLOG(2) << "[PREFETCH] COMPUTE: DEPTH: " << prefetch_buffer_depth
                      << " skip count; " << skip_count;
@@ -555,50 +738,136 @@ void NGraphEncapsulateOp::ComputeUsingParallelExecutor(OpKernelContext* ctx) {
         //    device
         // 3. Execute the nGraph call for this iteration using the
         //    nG tensors we got from the shared data
-        auto ng_input_tensor_bundle_ready =
-            shared_data->GetNextInputTensorBundleReadyForDeviceExecution();
-        // Add the next set of tensors for the next iteration
-        shared_data->AddNextInputTensorBundleForDeviceTransfer(
-            prefetch_input_tensor_bundle);
-        // Update the input_tensors with the one ready for exdcution
-        current_iter_pipeline_depth = ng_input_tensor_bundle_ready.Id;
-        ng_inputs = ng_input_tensor_bundle_ready.Inputs;
-        OP_REQUIRES(ctx, current_iter_pipeline_depth ==
-                             (!prefetch_input_tensor_bundle.Id),
-                    errors::Internal("Current Pipeline Depth is ",
-                                     current_iter_pipeline_depth,
-                                     " and next iter pipeline depth is ",
-                                     "also ", prefetch_input_tensor_bundle.Id));
-        skip_tf2ng_copy = true;
-        NGRAPH_VLOG(2) << "[PREFETCH] COMPUTE: Using device tensors";
+        // The number of sets lent to the prefetcher follows the device
+        // depth picked by the autotuner, one set is added or taken back
+        // per iteration
+        Timer staging_stall;
+        NGraphPrefetchSharedResouce::InputTensorBundle
+            ng_input_tensor_bundle_ready;
+        OP_REQUIRES_OK(
+            ctx, shared_data->GetNextInputTensorBundleReadyForDeviceExecution(
+                     &ng_input_tensor_bundle_ready));
+        staging_stall_us = staging_stall.ElapsedInMicroSec();
+
+        // The staged tensors were allocated for the executable of the input
+        // shapes at the time they were lent. If the shapes changed since then
+        // (e.g. the last batch of an epoch is smaller) we copy this element
+        // from the TF tensors and lend a set of the current executable in
+        // place of the stale one
+        bool use_staged_tensors = NGraphPrefetchSharedResouce::UseStagedBundle(
+            ng_input_tensor_bundle_ready, pipelined_tensor_store);
+        NGraphPrefetchSharedResouce::InputTensorBundle next_input_tensor_bundle;
+        if (use_staged_tensors) {
+          next_input_tensor_bundle = prefetch_input_tensor_bundle;
+        } else {
+          NGRAPH_VLOG(2) << "[PREFETCH] COMPUTE: Staged tensors do not match "
+                            "the input shapes, re-staging";
+          auto io_tensors_restage = pipelined_tensor_store->get_tensors();
+          next_input_tensor_bundle = {get<0>(io_tensors_restage),
+                                      get<1>(io_tensors_restage),
+                                      pipelined_tensor_store, false};
+        }
+
+        // The slot counts are shared by the NGraphEncapsulates of this
+        // cluster running concurrently, so they are only changed through the
+        // atomic Try{Add,Remove}StagingSlot
+        int device_depth = shared_data->GetAutotuner().GetDepth();
+        if (next_input_tensor_bundle.Id < 0) {
+          // No set to lend in place of the one we use, take back its slot
+          shared_data->RemoveStagingSlot();
+        } else if (shared_data->TryRemoveStagingSlot(device_depth)) {
+          // Take back the slot, the set goes back to the pipelined store
+          // once its output tensors are no longer used
+          released_pipeline_depth = next_input_tensor_bundle.Id;
+        } else {
+          // Add the next set of tensors for the next iteration
+          OP_REQUIRES_OK(
+              ctx, shared_data->AddNextInputTensorBundleForDeviceTransfer(
+                       next_input_tensor_bundle));
+          if (shared_data->TryAddStagingSlot(device_depth)) {
+            auto io_tensors_extra_slot = pipelined_tensor_store->get_tensors();
+            if (get<0>(io_tensors_extra_slot) >= 0) {
+              OP_REQUIRES_OK(
+                  ctx,
+                  shared_data->AddNextInputTensorBundleForDeviceTransfer(
+                      NGraphPrefetchSharedResouce::InputTensorBundle{
+                          get<0>(io_tensors_extra_slot),
+                          get<1>(io_tensors_extra_slot),
+                          pipelined_tensor_store, false}));
+            } else {
+              // No free set for the slot we took
+              shared_data->RemoveStagingSlot();
+            }
+          }
+        }
+        if (use_staged_tensors) {
+          // Update the input_tensors with the one ready for exdcution
+          current_iter_pipeline_depth = ng_input_tensor_bundle_ready.Id;
+          ng_inputs = ng_input_tensor_bundle_ready.Inputs;
+          OP_REQUIRES(ctx, current_iter_pipeline_depth !=
+                               prefetch_input_tensor_bundle.Id,
+                      errors::Internal("Current Pipeline Depth is ",
+                                       current_iter_pipeline_depth,
+                                       " and next iter pipeline depth is ",
+                                       "also ",
+                                       prefetch_input_tensor_bundle.Id));
+          skip_tf2ng_copy = true;
+        }
+        NGRAPH_VLOG(2) << "[PREFETCH] COMPUTE: Using device tensors: "
+                       << PrintBool(use_staged_tensors) << ", "
+                       << shared_data->GetNumStagingSlots() << " staged";
       }
       shared_data->IncrSkipCount();
+      if (skip_tf2ng_copy) {
+        staging_shared_data = shared_data;
+        unref_shared_data.release();
+      }
     }
   }
 
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+  ngraph::Event event_bind_variables("Bind Variable Tensors", "", "");
+  OP_REQUIRES_OK(ctx, LookUpVariables(ctx));
+  for (int input_index : tensor_manager->GetInputIndexesFedByVariables()) {
+    ng_inputs[input_index] = m_input_vars_[input_index]->ng_tensor();
+  }
+  // nGraph writes the result directly into the variable tensor, no snapshot
+  // may start until this step is done
+  NGraphVarWriteLock var_write_lock;
+  for (int output_index :
+       tensor_manager->GetOutputIndexesAssigningVariables()) {
+    var_write_lock.Add(m_output_vars_[output_index]);
+    ng_outputs[output_index] = m_output_vars_[output_index]->ng_tensor();
+  }
+  event_bind_variables.Stop();
+  ngraph::Event::write_trace(event_bind_variables);
+#endif
+
   // Allocate the input/
   ngraph::Event event_copy_input_tensor("Copy Input Tensor", "", "");
 
-  if (!skip_tf2ng_copy) {
-    for (auto i = 0; i < tf_input_tensors.size(); i++) {
-      ng::element::Type ng_element_type;
-      OP_REQUIRES_OK(ctx, TFDataTypeToNGraphElementType(
-                              tf_input_tensors[i].dtype(), &ng_element_type));
-
-      void* current_src_ptr = (void*)DMAHelper::base(&tf_input_tensors[i]);
-      try {
-        ng_inputs[i]->write(current_src_ptr, ng_inputs[i]->get_element_count() *
-                                                 ng_element_type.size());
-      } catch (const std::exception& exp) {
-        OP_REQUIRES(
-            ctx, false,
-            errors::Internal("Error copying TF tensor to device tensor: ",
-                             exp.what()));
-      } catch (...) {
-        OP_REQUIRES(
-            ctx, false,
-            errors::Internal("Error copying TF tensor to device tensor"));
-      }
+  // The variable tensors are already on the device and so are the
+  // prefetched inputs, if we are using the prefetched tensors
+  const vector<int>& input_indexes_to_copy =
+      skip_tf2ng_copy
+          ? tensor_manager->GetPipelinedButNotPrefetchedInputIndexes()
+          : tensor_manager->GetPipelinedInputIndexes();
+  for (int i : input_indexes_to_copy) {
+    ng::element::Type ng_element_type;
+    OP_REQUIRES_OK(ctx, TFDataTypeToNGraphElementType(
+                            tf_input_tensors[i].dtype(), &ng_element_type));
+
+    void* current_src_ptr = (void*)DMAHelper::base(&tf_input_tensors[i]);
+    try {
+      ng_inputs[i]->write(current_src_ptr, ng_inputs[i]->get_element_count() *
+                                               ng_element_type.size());
+    } catch (const std::exception& exp) {
+      OP_REQUIRES(ctx, false,
+                  errors::Internal("Error copying TF tensor to device tensor: ",
+                                   exp.what()));
+    } catch (...) {
+      OP_REQUIRES(ctx, false,
+                  errors::Internal("Error copying TF tensor to device tensor"));
     }
   }
   event_copy_input_tensor.Stop();
@@ -607,6 +876,7 @@ void NGraphEncapsulateOp::ComputeUsingParallelExecutor(OpKernelContext* ctx) {
   // And execute
   ngraph::Event event_execute_graph("Execute Graph", "", "");
 
+  Timer execute_time;
   BackendManager::LockBackend(m_parallel_executor->GetOpBackendName());
   NGRAPH_VLOG(4) << "NGraphEncapsulateOp::Compute call starting for cluster "
                  << m_parallel_executor->GetNgraphClusterId();
@@ -635,6 +905,10 @@ void NGraphEncapsulateOp::ComputeUsingParallelExecutor(OpKernelContext* ctx) {
     OP_REQUIRES(ctx, false, errors::Internal(status_string));
   }
   BackendManager::UnlockBackend(m_parallel_executor->GetOpBackendName());
+  if (staging_shared_data != nullptr) {
+    staging_shared_data->GetAutotuner().RecordCompute(
+        execute_time.ElapsedInMicroSec(), staging_stall_us);
+  }
   event_execute_graph.Stop();
   ngraph::Event::write_trace(event_execute_graph);
 
@@ -671,6 +945,16 @@ void NGraphEncapsulateOp::ComputeUsingParallelExecutor(OpKernelContext* ctx) {
     event_copy_prep->Stop();
     output_copy_events.push_back(std::move(event_copy_prep));
 
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+    // Only copy the outputs that are consumed by TF ops, the ones only
+    // assigned to variables stay on the device
+    const auto& copy_indexes = tensor_manager->GetOutputIndexesThatNeedCopy();
+    if (std::find(copy_indexes.begin(), copy_indexes.end(), i) ==
+        copy_indexes.end()) {
+      continue;
+    }
+#endif
+
     // Now copy the nGraph Tensor to Host Tensor
     std::unique_ptr<ngraph::Event> event_copy_d2h(
         new ngraph::Event("Device to Host Copy", "", ""));
@@ -686,12 +970,31 @@ void NGraphEncapsulateOp::ComputeUsingParallelExecutor(OpKernelContext* ctx) {
     ngraph::Event::write_trace(*next.get());
   }
 
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+  // The assigned variables now have a newer value on the device. Their TF
+  // tensors are only synced here if TF ops read them right after this op,
+  // otherwise the sync is left to the reader
+  const auto& catalog_entries = ng_encap_impl_.GetCatalogEntries();
+  for (int output_index :
+       tensor_manager->GetOutputIndexesAssigningVariables()) {
+    NGraphVar* var = m_output_vars_[output_index];
+    var->mark_ng_tensor_dirty();
+    if (catalog_entries.output_copy_to_tf[output_index]) {
+      NGRAPH_VLOG(4) << "Syncing the output var tensor " << output_index;
+      var->copy_ng_to_tf();
+    }
+  }
+#endif
+
   event_copy_output_tensor.Stop();
   ngraph::Event::write_trace(event_copy_output_tensor);
 
   // Now return them to the cache
   ngraph::Event event_return_tensor("Return Tensor", "", "");
   pipelined_tensor_store->return_tensors(current_iter_pipeline_depth);
+  if (released_pipeline_depth >= 0) {
+    pipelined_tensor_store->return_tensors(released_pipeline_depth);
+  }
 
   event_return_tensor.Stop();
   ngraph::Event::write_trace(event_return_tensor);
@@ -709,7 +1012,6 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
   ngraph::Event event(oss.str(), name(), "");
 
   Timer compute_time;
-  std::lock_guard<std::mutex> lock(m_compute_lock_);
   NGRAPH_VLOG(4) << "NGraphEncapsulateOp::Compute starting for cluster "
                  << ng_encap_impl_.GetNgraphCluster();
 
@@ -759,23 +1061,31 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
         tmp_tpl;
   }
 
-  if (ng_encap_impl_.GetNgraphFreshnessTracker() == nullptr) {
-    auto creator = [](NGraphFreshnessTracker** tracker) {
-      *tracker = new NGraphFreshnessTracker();
-      return Status::OK();
-    };
-    NGraphFreshnessTracker* set_tracker = nullptr;
-    OP_REQUIRES_OK(
-        ctx, ctx->resource_manager()->LookupOrCreate<NGraphFreshnessTracker>(
-                 ctx->resource_manager()->default_container(),
-                 "ngraph_freshness_tracker", &set_tracker, creator));
-    ng_encap_impl_.SetNgraphFreshnessTracker(set_tracker);
+  {
+    std::lock_guard<std::mutex> lock(m_freshness_tracker_mutex_);
+    if (ng_encap_impl_.GetNgraphFreshnessTracker() == nullptr) {
+      auto creator = [](NGraphFreshnessTracker** tracker) {
+        *tracker = new NGraphFreshnessTracker();
+        return Status::OK();
+      };
+      NGraphFreshnessTracker* set_tracker = nullptr;
+      OP_REQUIRES_OK(
+          ctx, ctx->resource_manager()->LookupOrCreate<NGraphFreshnessTracker>(
+                   ctx->resource_manager()->default_container(),
+                   "ngraph_freshness_tracker", &set_tracker, creator));
+      ng_encap_impl_.SetNgraphFreshnessTracker(set_tracker);
+    }
   }
 
   NGRAPH_VLOG(4)
       << "NGraphEncapsulateOp::Compute got freshness tracker for cluster "
       << ng_encap_impl_.GetNgraphCluster();
 
+  // Check out the cached I/O tensors of the executable for this step; they
+  // go back to the cache when this function returns, even on errors
+  auto io_cache_slot = ng_encap_impl_.AcquireIOCacheSlot(ng_exec);
+  IOCacheSlotReleaser io_cache_slot_releaser(ng_encap_impl_, io_cache_slot);
+
   // Allocate tensors for input arguments.
   ngraph::Event event_alloc_input("Input: maybe create", name(), "");
 
@@ -784,7 +1094,7 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
 
   OP_REQUIRES_OK(ctx, ng_encap_impl_.AllocateNGInputTensors(
                           tf_input_tensors, ng_exec, inp_group_from_pipeline,
-                          op_backend, ng_inputs));
+                          io_cache_slot, op_backend, ng_inputs));
 
   event_alloc_input.Stop();
 
@@ -797,21 +1107,14 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
   int ng_output_tensor_size_in_bytes = 0;
   std::vector<Tensor*> tf_output_tensors;
 
+  // The output shapes of an executable compiled for a family of input shapes
+  // are only known after the call, the TF outputs are allocated then
+  bool is_dynamic_exec = ng_encap_impl_.IsDynamicExecutable(ng_exec);
+
   for (auto i = 0; i < ng_exec->get_results().size(); i++) {
     auto ng_element = ng_exec->get_results()[i];
-    auto ng_shape = ng_element->get_shape();
     auto ng_element_type = ng_element->get_element_type();
 
-    // Create the TF output tensor
-    vector<int64> dims;
-    for (auto dim : ng_shape) {
-      dims.push_back(dim);
-    }
-    TensorShape tf_shape(dims);
-    Tensor* output_tensor = nullptr;
-    OP_REQUIRES_OK(ctx, ctx->allocate_output(i, tf_shape, &output_tensor));
-    tf_output_tensors.push_back(output_tensor);
-
     // Make sure the nGraph-inferred element type agrees with what TensorFlow
     // expected.
     ng::element::Type expected_elem_type;
@@ -822,12 +1125,32 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
         ctx, ng_element_type == expected_elem_type,
         errors::Internal("Element type inferred by nGraph does not match "
                          "the element type expected by TensorFlow"));
+
+    if (is_dynamic_exec) {
+      continue;
+    }
+
+    // Create the TF output tensor
+    auto ng_shape = ng_element->get_shape();
+    vector<int64> dims;
+    for (auto dim : ng_shape) {
+      dims.push_back(dim);
+    }
+    TensorShape tf_shape(dims);
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(i, tf_shape, &output_tensor));
+    tf_output_tensors.push_back(output_tensor);
   }
 
-  OP_REQUIRES_OK(ctx, ng_encap_impl_.AllocateNGOutputTensors(
-                          tf_output_tensors, ng_exec, out_group_from_pipeline,
-                          op_backend, ng_outputs));
-  auto output_caches = ng_encap_impl_.GetNgExecOutputCacheMap(ng_exec);
+  if (is_dynamic_exec) {
+    OP_REQUIRES_OK(ctx, ng_encap_impl_.AllocateNGDynamicOutputTensors(
+                            ng_exec, op_backend, ng_outputs));
+  } else {
+    OP_REQUIRES_OK(ctx, ng_encap_impl_.AllocateNGOutputTensors(
+                            tf_output_tensors, ng_exec, out_group_from_pipeline,
+                            io_cache_slot, op_backend, ng_outputs));
+  }
+  auto output_caches = io_cache_slot->outputs;
 
   event_alloc_output.Stop();
   NGRAPH_VLOG(4)
@@ -843,28 +1166,25 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
   ngraph::Event event_output_check_in_catalog(
       "Get Variable Outputs from Resource Manager", name(), "");
 
+  OP_REQUIRES_OK(ctx, LookUpVariables(ctx));
+  const auto& catalog_entries = ng_encap_impl_.GetCatalogEntries();
+  // Held until this step is done, no snapshot of the variables written may
+  // start meanwhile
+  NGraphVarWriteLock var_write_lock;
   for (auto i = 0; i < ng_exec->get_results().size(); i++) {
     void* current_dst_ptr = DMAHelper::base(tf_output_tensors[i]);
     std::shared_ptr<ng::runtime::Tensor> current_ng_tensor = nullptr;
     // if the output tensor is going to be assigned to a variable
     // we ask nGraph to provide the output directly in the variable tensor
-    bool ref_exists = NGraphCatalog::ExistsInEncapOutputInfoMap(
-        ng_encap_impl_.GetGraphId(), name(), i);
+    bool ref_exists = catalog_entries.IsOutputToVariable(i);
     if (!ref_exists) {
       OP_REQUIRES(ctx, ng_outputs[i] != nullptr,
                   errors::Internal("Output ", i,
                                    " is not in Catalog nor was set from TF"));
       continue;
     }
-    string output_key =
-        NGraphCatalog::CreateNodeKey(ng_encap_impl_.GetGraphId(), name(), i);
-    string ref_var_name =
-        NGraphCatalog::GetVariableSharedNameFromEncapOutputInfoMap(output_key);
-    NGraphVar* var;
-    OP_REQUIRES_OK(ctx, ctx->resource_manager()->Lookup<NGraphVar>(
-                            ctx->resource_manager()->default_container(),
-                            ref_var_name, &var));
-    current_ng_tensor = var->ng_tensor();
+    var_write_lock.Add(m_output_vars_[i]);
+    current_ng_tensor = m_output_vars_[i]->ng_tensor();
 
     // There might be scenarios where the input and output tensors are the
     // same.The staleness determined for the input tensor should be the
@@ -873,7 +1193,6 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
     // overwritten with the computed value.
     // So not setting staleness here.
     output_caches[i] = std::make_pair(current_dst_ptr, current_ng_tensor);
-    var->Unref();
     ng_outputs[i] = current_ng_tensor;
   }
   event_output_check_in_catalog.Stop();
@@ -888,8 +1207,7 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
 
   // Dealing with the input from Variable nodes here
   for (int input_index = 0; input_index < input_shapes.size(); input_index++) {
-    bool ref_exists = NGraphCatalog::ExistsInInputVariableSharedNameMap(
-        ng_encap_impl_.GetGraphId(), def().name(), input_index);
+    bool ref_exists = catalog_entries.IsInputFromVariable(input_index);
 
     if (!ref_exists) {
       OP_REQUIRES(ctx, ng_inputs[input_index] != nullptr,
@@ -898,20 +1216,13 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
       continue;
     }
 
-    string ref_var_name = NGraphCatalog::GetInputVariableSharedName(
-        ng_encap_impl_.GetGraphId(), def().name(), input_index);
-    NGraphVar* var;
-    OP_REQUIRES_OK(ctx, ctx->resource_manager()->Lookup<NGraphVar>(
-                            ctx->resource_manager()->default_container(),
-                            ref_var_name, &var));
+    NGraphVar* var = m_input_vars_[input_index];
 
     void* current_tf_ptr = (void*)DMAHelper::base(&ctx->input(input_index));
     bool is_stale = !ng_encap_impl_.GetNgraphFreshnessTracker()->IsFresh(
-        current_tf_ptr, ng_exec);
+        current_tf_ptr, io_cache_slot->freshness_user_id);
     var->ng_tensor()->set_stale(is_stale);
     ng_inputs[input_index] = var->ng_tensor();
-
-    var->Unref();
   }
 
   event_input_check_in_catalog.Stop();
@@ -971,6 +1282,30 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
   ngraph::Event event_copy_output("Output - copy back", name(), "");
   Timer copy_output_tensors_to_host;
 
+  // The dynamic output tensors now have their shapes, allocate the TF outputs
+  // and copy the results over
+  if (is_dynamic_exec) {
+    for (auto i = 0; i < ng_outputs.size(); i++) {
+      vector<int64> dims;
+      for (auto dim : ng_outputs[i]->get_shape()) {
+        dims.push_back(dim);
+      }
+      Tensor* output_tensor = nullptr;
+      OP_REQUIRES_OK(
+          ctx, ctx->allocate_output(i, TensorShape(dims), &output_tensor));
+      try {
+        ng_outputs[i]->read(DMAHelper::base(output_tensor),
+                            ng_outputs[i]->get_size_in_bytes());
+      } catch (const std::exception& exp) {
+        OP_REQUIRES(
+            ctx, false,
+            errors::Internal(
+                "Caught exception while transferring tensor data to host: ",
+                exp.what(), "\n"));
+      }
+    }
+  }
+
   try {
     size_t output_tensor_count = output_caches.size();
     std::vector<std::unique_ptr<ngraph::Event>> output_copy_events;
@@ -983,30 +1318,19 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
     }
     for (size_t i = 0; i < output_tensor_count; ++i) {
       // Sync the Var Tensor if required
-      string output_key = NGraphCatalog::CreateNodeKey(
-          ng_encap_impl_.GetGraphId(), def().name(), i);
-      bool ref_exists = NGraphCatalog::ExistsInEncapOutputInfoMap(output_key);
-
-      if (ref_exists) {
-        NGRAPH_VLOG(4) << "Syncing the output var tensor " << output_key;
-
-        // Get var
-        string ref_var_name =
-            NGraphCatalog::GetVariableSharedNameFromEncapOutputInfoMap(
-                output_key);
-        NGraphVar* var;
-        OP_REQUIRES_OK(ctx, ctx->resource_manager()->Lookup<NGraphVar>(
-                                ctx->resource_manager()->default_container(),
-                                ref_var_name, &var));
-
-        if (NGraphCatalog::GetCopyToTFFromEncapOutputInfoMap(output_key)) {
+      if (catalog_entries.IsOutputToVariable(i)) {
+        NGRAPH_VLOG(4) << "Syncing the output var tensor " << i;
+        NGraphVar* var = m_output_vars_[i];
+
+        // The device copy is now newer, the TF tensor is synced lazily
+        // unless TF ops read it right after this op
+        var->mark_ng_tensor_dirty();
+        if (catalog_entries.output_copy_to_tf[i]) {
           if (var->copy_ng_to_tf()) {
-            int copies = ng_encap_impl_.GetNumberOfCopies();
-            ng_encap_impl_.SetNumberOfCopies(copies++);
-            ng_encap_impl_.AppendCopyLog(" COPY_TO_TF ");
+            io_cache_slot->number_of_copies++;
+            io_cache_slot->copy_log << " COPY_TO_TF ";
           }
         }
-        var->Unref();
       }
 
       std::shared_ptr<ng::runtime::Tensor> dst_ng_tensor;
@@ -1014,13 +1338,9 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
       std::tie(dst_ptr, dst_ng_tensor) = output_caches[i];
 
       if (ng_encap_impl_.GetOpBackend() != "CPU" &&
-          NGraphCatalog::EncapOutputIndexNeedsCopy(ng_encap_impl_.GetGraphId(),
-                                                   def().name(), i)) {
-        int copies = ng_encap_impl_.GetNumberOfCopies();
-        ng_encap_impl_.SetNumberOfCopies(copies++);
-        stringstream log;
-        log << " COPY_OP_VAL[" << i << "]";
-        ng_encap_impl_.AppendCopyLog(log.str());
+          catalog_entries.output_needs_copy[i]) {
+        io_cache_slot->number_of_copies++;
+        io_cache_slot->copy_log << " COPY_OP_VAL[" << i << "]";
 
         NGRAPH_VLOG(4) << "Copying Output " << def().name() << " ,index: " << i;
         auto ng_element_type = dst_ng_tensor->get_element_type();
@@ -1071,20 +1391,23 @@ void NGraphEncapsulateOp::ComputeUsingLegacyExecutor(OpKernelContext* ctx) {
   event_copy_output.Stop();
 
 #if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
-  std::stringstream str;
-  str << " Number of copies " << ng_encap_impl_.GetNumberOfCopies() << "\n";
-  ng_encap_impl_.AppendCopyLog(str.str());
-  if (ng_encap_impl_.GetLogCopies()) {
-    cout << ng_encap_impl_.GetCopyLog();
+  io_cache_slot->copy_log << " Number of copies "
+                          << io_cache_slot->number_of_copies << "\n";
+  if (io_cache_slot->log_copies) {
+    cout << io_cache_slot->copy_log.str();
   }
 #endif
 
   // Mark input tensors as fresh for the next time around.
   // Note: these ng_tensors are being marked fresh so that in the next
-  // iteration if this encapsulate finds the tensor fresh, then it will use it
-  for (int i = 0; i < input_shapes.size(); i++) {
-    void* src_ptr = (void*)DMAHelper::base(&ctx->input(i));
-    ng_encap_impl_.GetNgraphFreshnessTracker()->MarkFresh(src_ptr, ng_exec);
+  // iteration if this encapsulate finds the tensor fresh, then it will use it.
+  // Only the primary I/O cache slot checks freshness, the others always copy.
+  if (io_cache_slot->primary) {
+    for (int i = 0; i < input_shapes.size(); i++) {
+      void* src_ptr = (void*)DMAHelper::base(&ctx->input(i));
+      ng_encap_impl_.GetNgraphFreshnessTracker()->MarkFresh(
+          src_ptr, io_cache_slot->freshness_user_id);
+    }
   }
   int time_copy_output_tensors_to_host =
       copy_output_tensors_to_host.ElapsedInMS();
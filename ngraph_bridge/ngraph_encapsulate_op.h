@@ -18,6 +18,8 @@
 #define NGRAPH_TF_ENCAPSULATE_OP_H_
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <ostream>
 #include <vector>
 
@@ -34,6 +36,10 @@ namespace tensorflow {
 
 namespace ngraph_bridge {
 
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+class NGraphVar;
+#endif
+
 class NGraphEncapsulateOp : public OpKernel {
  public:
   explicit NGraphEncapsulateOp(OpKernelConstruction* ctx);
@@ -47,12 +53,25 @@ class NGraphEncapsulateOp : public OpKernel {
                             const string& backend_name);
   void ComputeUsingLegacyExecutor(OpKernelContext* ctx);
   void ComputeUsingParallelExecutor(OpKernelContext* ctx);
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+  Status LookUpVariables(OpKernelContext* ctx);
+#endif
 
   static int s_instance_id;
   NGraphEncapsulateImpl ng_encap_impl_;
   bool m_use_parallel_executor;
-  std::mutex m_compute_lock_;
+  // Steps of the legacy executor run concurrently, this only guards the
+  // lazy lookup of the freshness tracker
+  std::mutex m_freshness_tracker_mutex_;
   unique_ptr<NGraphExecutor> m_parallel_executor;
+#if defined(NGRAPH_TF_ENABLE_VARIABLES_AND_OPTIMIZERS)
+  // The variables feeding the inputs and assigned by the outputs of this
+  // op, indexed like them (nullptr for the others)
+  std::vector<NGraphVar*> m_input_vars_;
+  std::vector<NGraphVar*> m_output_vars_;
+  std::atomic<bool> m_variables_looked_up_{false};
+  std::mutex m_variables_mutex_;
+#endif
 };
 
 }  // namespace ngraph_bridge
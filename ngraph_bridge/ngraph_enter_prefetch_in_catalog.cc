@@ -32,7 +32,7 @@ namespace tensorflow {
 
 namespace ngraph_bridge {
 
-// Populate the PrefetchedInputIndexMap
+// Populate the PrefetchedInputIndexMap and the PrefetchIteratorMap
 
 // We collect the below information for the catalog
 // 1. If the input to "NGraphEncapsulate" node
@@ -41,6 +41,17 @@ namespace ngraph_bridge {
 // "NGraphEncapsulate" node to the PrefetchedInputIndexMap
 // We add mapping of {graphId_nodename : (input_indexs)} to the
 // PrefetchedInputIndexMap
+// 2. The IteratorGetNext output feeding each of those inputs
+// We add mapping of {graphId_nodename:input_index : output_index} to the
+// PrefetchedInputComponentMap
+// 3. The iterator feeding those IteratorGetNext, so that the
+// NGraphEncapsulate can find the NGraphPrefetchDataset staging its inputs
+// We add mapping of {graphId_nodename : iterator_name} to the
+// PrefetchIteratorMap
+//
+// An encapsulate fed by more than one iterator, or by an iterator whose
+// PrefetchDataset was not replaced by a NGraphPrefetchDataset when the
+// variables were captured, is not prefetched
 //
 
 Status EnterPrefetchInCatalog(Graph* graph, int graph_id) {
@@ -49,6 +60,8 @@ Status EnterPrefetchInCatalog(Graph* graph, int graph_id) {
     // If the node is a NGraphEncapsulate, go over all it's
     // inputs
     unordered_set<int> in_indexes_for_encap;
+    unordered_map<int, int> components_for_encap;
+    unordered_set<Node*> iterators_for_encap;
     if (node->type_string() == "NGraphEncapsulate") {
       for (auto edge : node->in_edges()) {
         // If any input is coming from "IteratorGetNext" then
@@ -58,13 +71,49 @@ Status EnterPrefetchInCatalog(Graph* graph, int graph_id) {
           NGRAPH_VLOG(4) << "Key: " << node->name();
           NGRAPH_VLOG(4) << "Input index: " << edge->dst_input();
           in_indexes_for_encap.insert(edge->dst_input());
+          components_for_encap[edge->dst_input()] = edge->src_output();
+
+          Node* iterator;
+          TF_RETURN_IF_ERROR(edge->src()->input_node(0, &iterator));
+          iterators_for_encap.insert(iterator);
         }
       }  // end loop over input edges
 
+      if (iterators_for_encap.size() > 1) {
+        NGRAPH_VLOG(4) << "Not prefetching " << node->name()
+                       << ", it is fed by " << iterators_for_encap.size()
+                       << " iterators";
+        continue;
+      }
+
+      // The iterator was recorded under the id of the graph whose variables
+      // were captured, which is not necessarily this one
+      string iterator_name;
+      int capture_graph_id = 0;
+      if (iterators_for_encap.size() == 1) {
+        Node* iterator = *iterators_for_encap.begin();
+        iterator_name = iterator->name();
+        if (GetNodeAttr(iterator->attrs(), "_ngraph_prefetch_graph_id",
+                        &capture_graph_id) != Status::OK() ||
+            !NGraphCatalog::ExistsInPrefetchDatasetIterators(capture_graph_id,
+                                                             iterator_name)) {
+          NGRAPH_VLOG(4) << "Not prefetching " << node->name()
+                         << ", iterator " << iterator_name
+                         << " is not fed by a NGraphPrefetchDataset";
+          continue;
+        }
+      }
+
       if (in_indexes_for_encap.size() > 0) {
         try {
           NGraphCatalog::AddToPrefetchedInputIndexMap(graph_id, node->name(),
                                                       in_indexes_for_encap);
+          for (const auto& itr : components_for_encap) {
+            NGraphCatalog::AddToPrefetchedInputComponentMap(
+                graph_id, node->name(), itr.first, itr.second);
+          }
+          NGraphCatalog::AddToPrefetchIteratorMap(
+              graph_id, node->name(), capture_graph_id, iterator_name);
         } catch (const std::exception& exp) {
           return errors::Internal(
               "Caught exception while entering in catalog: ", exp.what(), "\n");
@@ -37,10 +37,12 @@
 #include "logging/ngraph_log.h"
 #include "ngraph_bridge/ngraph_backend_manager.h"
 #include "ngraph_bridge/ngraph_builder.h"
+#include "ngraph_bridge/ngraph_cache_budget.h"
 #include "ngraph_bridge/ngraph_cluster_manager.h"
 #include "ngraph_bridge/ngraph_data_cache.h"
 #include "ngraph_bridge/ngraph_executor.h"
 #include "ngraph_bridge/ngraph_mark_for_clustering.h"
+#include "ngraph_bridge/ngraph_prefetch_shared_data.h"
 #include "ngraph_bridge/ngraph_timer.h"
 #include "ngraph_bridge/ngraph_utils.h"
 
@@ -56,6 +58,37 @@ namespace tensorflow {
 
 namespace ngraph_bridge {
 
+// Rough size of a cached item: the serialized function and, if the
+// executable created them, the pipelined I/O tensors
+static int64 EstimateCachedItemBytes(
+    const std::tuple<std::shared_ptr<ngraph::runtime::Executable>,
+                     std::string, shared_ptr<PipelinedTensorsStore>>& ng_item,
+    const int pipeline_depth, NGraphTensorManager& tensor_manager) {
+  std::shared_ptr<ngraph::runtime::Executable> ng_exec;
+  std::string serialized_ng_func;
+  shared_ptr<PipelinedTensorsStore> pts;
+  std::tie(ng_exec, serialized_ng_func, pts) = ng_item;
+
+  int64 bytes = serialized_ng_func.size();
+  if (ng_exec != nullptr && pts != nullptr) {
+    // Only the pipelined inputs and outputs have tensors in the store, see
+    // InitializeIOTensorPipeline
+    int64 io_bytes = 0;
+    const auto& params = ng_exec->get_parameters();
+    for (int i : tensor_manager.GetPipelinedInputIndexes()) {
+      io_bytes += ng::shape_size(params[i]->get_shape()) *
+                  params[i]->get_element_type().size();
+    }
+    const auto& results = ng_exec->get_results();
+    for (int i : tensor_manager.GetPipelinedOutputIndexes()) {
+      io_bytes += ng::shape_size(results[i]->get_shape()) *
+                  results[i]->get_element_type().size();
+    }
+    bytes += io_bytes * pipeline_depth;
+  }
+  return bytes;
+}
+
 //---------------------------------------------------------------------------
 //  NGraphExecutor::ctor
 //---------------------------------------------------------------------------
@@ -68,7 +101,9 @@ NGraphExecutor::NGraphExecutor(int instance_id, int cluster_id, int graph_id,
       m_graph_id(graph_id),
       m_graph(std::move(graph)),
       m_op_backend_name(backend_name),
-      m_ng_data_cache(cache_depth) {
+      m_node_name("ngraph_cluster_" + to_string(cluster_id)),
+      m_ng_data_cache(cache_depth),
+      m_cache_depth(instance_id, cluster_id, cache_depth) {
   // Sanity checks
   if (m_graph == nullptr) {
     throw std::runtime_error("Graph is nullptr!");
@@ -161,6 +196,12 @@ NGraphExecutor::NGraphExecutor(int instance_id, int cluster_id, int graph_id,
   m_tensor_manager = make_shared<NGraphTensorManager>(
       GetNgraphClusterName(), GetNgraphClusterId(), GetGraphId(),
       number_of_inputs, number_of_outputs);
+
+  // The prefetched inputs are staged on the device in pipelined tensors lent
+  // to the prefetcher, keep one more set for the running execution
+  if (!m_tensor_manager->GetPrefetchedInputIndexes().empty()) {
+    m_depth = 1 + NGraphDevicePrefetchAutotuner::GetMaxDepthFromEnv();
+  }
 }
 
 //---------------------------------------------------------------------------
@@ -252,6 +293,10 @@ Status NGraphExecutor::GetExecutableFunctionAndTensors(
 
   if (status_ng_item_pair.first == Status::OK()) {
     std::tie(ng_exec, serialized_ng_func, pts) = status_ng_item_pair.second;
+    m_cache_depth.RecordLookup(
+        signature, cache_hit, [this, &destroy_ng_items_callback](int depth) {
+          return m_ng_data_cache.SetDepth(depth, destroy_ng_items_callback);
+        });
   }
   return status_ng_item_pair.first;
 }
@@ -320,8 +365,12 @@ NGraphExecutor::CreateCallback(const std::string signature,
     ng_exec = status_ng_exec_pair.second;
     auto status_ng_pts_pair = InitializeIOTensorPipeline(ng_exec);
     pts = status_ng_pts_pair.second;
-    return std::make_pair(status_ng_pts_pair.first,
-                          std::make_tuple(ng_exec, serialized_ng_func, pts));
+    auto ng_item = std::make_tuple(ng_exec, serialized_ng_func, pts);
+    if (status_ng_pts_pair.first == Status::OK()) {
+      NGraphCacheBudget::AddBytes(
+          EstimateCachedItemBytes(ng_item, m_depth, *m_tensor_manager));
+    }
+    return std::make_pair(status_ng_pts_pair.first, ng_item);
   } else {
     Status st = StringToFile("tf_function_error_" + m_node_name + ".json",
                              serialized_ng_func);
@@ -377,7 +426,9 @@ NGraphExecutor::GetNgExecutable(std::string signature,
   event_compile.Stop();
   ngraph::Event::write_trace(event_compile);
 
-  return std::make_pair(Status::OK(), ng_exec);
+  // Removed from the backend once evicted and no step runs it anymore
+  return std::make_pair(Status::OK(),
+                        MakeRemovableExecutable(op_backend, ng_exec));
 }
 
 //---------------------------------------------------------------------------
@@ -388,11 +439,10 @@ void NGraphExecutor::DestroyCallback(
                shared_ptr<PipelinedTensorsStore>>
         evicted_ng_item,
     ng::runtime::Backend*& op_backend) {
-  std::shared_ptr<ngraph::runtime::Executable> evicted_ng_exec;
-  std::tie(evicted_ng_exec, std::ignore, std::ignore) = evicted_ng_item;
-  // Call delete function here for the erased func
-  op_backend->remove_compiled_function(evicted_ng_exec);
-  evicted_ng_exec.reset();
+  NGraphCacheBudget::RemoveBytes(
+      EstimateCachedItemBytes(evicted_ng_item, m_depth, *m_tensor_manager));
+  // The executable is removed from the backend when the last step running it
+  // drops it, see GetNgExecutable
 }
 
 //---------------------------------------------------------------------------
@@ -485,12 +535,16 @@ NGraphExecutor::InitializeIOTensorPipeline(
   // If the input or the output size if 0 then???
   NGRAPH_VLOG(5) << "InitializeIOTensorPipeline: In: " << num_inputs
                  << " Out: " << num_outputs;
-  PipelinedTensorMatrix pipelined_input_tensors(num_inputs);
-  PipelinedTensorMatrix pipelined_output_tensors(num_outputs);
-  for (size_t i = 0; i < num_inputs; i++) {
+  // The inputs fed by and the outputs assigning variables use the NGraphVar
+  // tensors, leave their slots empty
+  PipelinedTensorMatrix pipelined_input_tensors(
+      num_inputs, PipelinedTensorVector(m_depth, nullptr));
+  PipelinedTensorMatrix pipelined_output_tensors(
+      num_outputs, PipelinedTensorVector(m_depth, nullptr));
+  for (int i : m_tensor_manager->GetPipelinedInputIndexes()) {
     pipelined_input_tensors[i] = ng_exec->create_input_tensor(i, m_depth);
   }
-  for (size_t i = 0; i < num_outputs; i++) {
+  for (int i : m_tensor_manager->GetPipelinedOutputIndexes()) {
     pipelined_output_tensors[i] = ng_exec->create_output_tensor(i, m_depth);
   }
   shared_ptr<PipelinedTensorsStore> pts(new PipelinedTensorsStore(
@@ -20,6 +20,7 @@
 
 #include <mutex>
 #include <ostream>
+#include <unordered_map>
 #include <vector>
 
 #include "tensorflow/core/framework/tensor_shape.h"
@@ -28,6 +29,7 @@
 #include "ngraph/ngraph.hpp"
 
 #include "logging/ngraph_log.h"
+#include "ngraph_bridge/ngraph_cache_budget.h"
 #include "ngraph_bridge/ngraph_data_cache.h"
 #include "ngraph_bridge/ngraph_freshness_tracker.h"
 #include "ngraph_bridge/ngraph_pipelined_tensors.h"
@@ -92,6 +94,17 @@ class NGraphExecutor {
     return m_tensor_manager;
   }
 
+  // Lets the executable cache grow and shrink with the number of distinct
+  // signatures seen over the recent lookups, up to max_cache_depth items and
+  // within the global NGraphCacheBudget
+  void EnableAdaptiveCacheDepth(const int max_cache_depth) {
+    m_cache_depth.EnableAdaptive(max_cache_depth);
+  }
+
+  bool IsCacheDepthAdaptive() { return m_cache_depth.IsAdaptive(); }
+
+  int GetCacheDepth() { return m_ng_data_cache.GetDepth(); }
+
  private:
   // This method is called from CreateCallback(), It compiles ngraph
   // Or load ng_executable from backend in case of AOT
@@ -137,7 +150,11 @@ class NGraphExecutor {
   bool m_executable_can_create_tensor;
 
   mutex m_mutex;
-  int m_depth{2};  // TODO make this settable
+  // Raised for the executors with prefetched inputs, see the constructor
+  int m_depth{2};
+
+  // Depth (possibly adaptive) of m_ng_data_cache
+  NGraphCacheDepth m_cache_depth;
 
   // NGraphTensorManager
   shared_ptr<NGraphTensorManager> m_tensor_manager;
@@ -24,56 +24,176 @@ namespace ngraph_bridge {
 // ngraph backend api change returns executable, so changing function to
 // executable
 
+static const int kBitsPerWord = 64;
+
+NGraphFreshnessTracker::Shard& NGraphFreshnessTracker::GetShard(
+    const void* base_pointer) {
+  // Tensor buffers are aligned, drop the low bits before picking the shard
+  size_t hash = std::hash<const void*>()(base_pointer) >> 6;
+  return shards_[hash % kNumShards];
+}
+
+int NGraphFreshnessTracker::LookUpUserId(
+    const std::shared_ptr<ngraph::runtime::Executable>& user) {
+  auto it = user_ids_.find(user.get());
+  if (it == user_ids_.end() || it->second.user.expired()) {
+    return -1;
+  }
+  return it->second.id;
+}
+
+int NGraphFreshnessTracker::GetOrCreateUserId(
+    const std::shared_ptr<ngraph::runtime::Executable>& user) {
+  auto it = user_ids_.find(user.get());
+  if (it != user_ids_.end()) {
+    if (!it->second.user.expired()) {
+      return it->second.id;
+    }
+    // The previous user at this address is gone, forget what was fresh for
+    // it
+    ReleaseUserId(it->second.id);
+    user_ids_.erase(it);
+  }
+
+  int id;
+  if (free_user_ids_.empty()) {
+    id = next_user_id_++;
+  } else {
+    id = free_user_ids_.back();
+    free_user_ids_.pop_back();
+  }
+  user_ids_[user.get()] = UserInfo{id, user};
+  return id;
+}
+
+void NGraphFreshnessTracker::ReleaseUserId(int id) {
+  size_t word = id / kBitsPerWord;
+  uint64 mask = ~(uint64(1) << (id % kBitsPerWord));
+  for (auto& shard : shards_) {
+    mutex_lock l(shard.mu);
+    for (auto& kv : shard.freshness_map) {
+      if (word < kv.second.size()) {
+        kv.second[word] &= mask;
+      }
+    }
+  }
+  free_user_ids_.push_back(id);
+}
+
+int NGraphFreshnessTracker::AddUser(
+    const std::shared_ptr<ngraph::runtime::Executable>& user) {
+  // Registered users only need the shared lock
+  {
+    tf_shared_lock l(users_mu_);
+    int id = LookUpUserId(user);
+    if (id >= 0) {
+      return id;
+    }
+  }
+
+  mutex_lock l(users_mu_);
+  return GetOrCreateUserId(user);
+}
+
 void NGraphFreshnessTracker::MarkFresh(
     const void* base_pointer,
     const std::shared_ptr<ngraph::runtime::Executable>& user) {
-  mutex_lock l(mu_);
-  auto it = freshness_map_.find(base_pointer);
-  if (it != freshness_map_.end()) {
-    it->second.insert(user);
+  MarkFresh(base_pointer, AddUser(user));
+}
+
+void NGraphFreshnessTracker::MarkFresh(const void* base_pointer, int user_id) {
+  if (user_id < 0) {
+    return;
+  }
+  size_t word = user_id / kBitsPerWord;
+  Shard& shard = GetShard(base_pointer);
+  mutex_lock l(shard.mu);
+  auto it = shard.freshness_map.find(base_pointer);
+  if (it != shard.freshness_map.end()) {
+    if (it->second.size() <= word) {
+      it->second.resize(word + 1, 0);
+    }
+    it->second[word] |= uint64(1) << (user_id % kBitsPerWord);
   }
 }
 
 bool NGraphFreshnessTracker::IsFresh(
     const void* base_pointer,
     const std::shared_ptr<ngraph::runtime::Executable>& user) {
-  mutex_lock l(mu_);
-  auto it = freshness_map_.find(base_pointer);
-  if (it == freshness_map_.end()) {
+  int id;
+  {
+    tf_shared_lock l(users_mu_);
+    id = LookUpUserId(user);
+  }
+  return IsFresh(base_pointer, id);
+}
+
+bool NGraphFreshnessTracker::IsFresh(const void* base_pointer, int user_id) {
+  if (user_id < 0) {
     return false;
-  } else {
-    return (it->second.count(user) > 0);
   }
+  size_t word = user_id / kBitsPerWord;
+
+  Shard& shard = GetShard(base_pointer);
+  mutex_lock l(shard.mu);
+  auto it = shard.freshness_map.find(base_pointer);
+  if (it == shard.freshness_map.end() || it->second.size() <= word) {
+    return false;
+  }
+  return (it->second[word] >> (user_id % kBitsPerWord)) & 1;
 }
 
 void NGraphFreshnessTracker::MarkStale(const void* base_pointer) {
-  mutex_lock l(mu_);
-  auto it = freshness_map_.find(base_pointer);
-  if (it != freshness_map_.end()) {
-    it->second.clear();
+  Shard& shard = GetShard(base_pointer);
+  mutex_lock l(shard.mu);
+  auto it = shard.freshness_map.find(base_pointer);
+  if (it != shard.freshness_map.end()) {
+    std::fill(it->second.begin(), it->second.end(), 0);
   }
 }
 
-void NGraphFreshnessTracker::AddTensor(const void* base_pointer) {
-  mutex_lock l(mu_);
-  auto it = freshness_map_.find(base_pointer);
-  if (it == freshness_map_.end()) {
-    freshness_map_[base_pointer] =
-        std::set<std::shared_ptr<ngraph::runtime::Executable>>{};
+void NGraphFreshnessTracker::MarkStale(
+    const std::vector<const void*>& base_pointers) {
+  std::vector<const void*> shard_pointers[kNumShards];
+  for (auto base_pointer : base_pointers) {
+    shard_pointers[&GetShard(base_pointer) - shards_].push_back(base_pointer);
   }
+  for (int i = 0; i < kNumShards; i++) {
+    if (shard_pointers[i].empty()) {
+      continue;
+    }
+    mutex_lock l(shards_[i].mu);
+    for (auto base_pointer : shard_pointers[i]) {
+      auto it = shards_[i].freshness_map.find(base_pointer);
+      if (it != shards_[i].freshness_map.end()) {
+        std::fill(it->second.begin(), it->second.end(), 0);
+      }
+    }
+  }
+}
+
+void NGraphFreshnessTracker::AddTensor(const void* base_pointer) {
+  Shard& shard = GetShard(base_pointer);
+  mutex_lock l(shard.mu);
+  // Does not reset the freshness of an already registered tensor
+  shard.freshness_map.emplace(base_pointer, std::vector<uint64>());
 }
 
 void NGraphFreshnessTracker::RemoveTensor(const void* base_pointer) {
-  mutex_lock l(mu_);
-  freshness_map_.erase(base_pointer);
+  Shard& shard = GetShard(base_pointer);
+  mutex_lock l(shard.mu);
+  shard.freshness_map.erase(base_pointer);
 }
 
 void NGraphFreshnessTracker::RemoveUser(
     const std::shared_ptr<ngraph::runtime::Executable>& user) {
-  mutex_lock l(mu_);
-  for (auto& kv : freshness_map_) {
-    kv.second.erase(user);
+  mutex_lock l(users_mu_);
+  auto it = user_ids_.find(user.get());
+  if (it == user_ids_.end()) {
+    return;
   }
+  ReleaseUserId(it->second.id);
+  user_ids_.erase(it);
 }
 
 }  // namespace ngraph_bridge
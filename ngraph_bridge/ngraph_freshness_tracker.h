@@ -16,9 +16,11 @@
 #ifndef NGRAPH_FRESHNESS_TRACKER_H_
 #define NGRAPH_FRESHNESS_TRACKER_H_
 
-#include <set>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/platform/mutex.h"
 
 #include "ngraph_bridge/ngraph_utils.h"
 
@@ -83,6 +85,18 @@ namespace ngraph_bridge {
 // the ResourceMgr's default container, with the resource name
 // "ngraph_freshness_tracker".
 //
+// IsFresh/MarkFresh run for every input of every encapsulate call, so the
+// tensors are spread over kNumShards independently locked hash maps, and
+// each user executable is given a small integer id: the users a tensor is
+// fresh for are kept as a bitset indexed by that id. The executables are
+// only referenced weakly.
+//
+// On the hot path the caller resolves the id once with AddUser and passes it
+// to IsFresh/MarkFresh, which then only lock the shard of the tensor. The id
+// stays valid until RemoveUser is called for the executable, which the
+// encapsulate only does once the executable is destroyed, i.e. when no step
+// can use the id any more.
+//
 class NGraphFreshnessTracker : public ResourceBase {
  public:
   explicit NGraphFreshnessTracker() {}
@@ -92,20 +106,34 @@ class NGraphFreshnessTracker : public ResourceBase {
 
   std::string DebugString() const override { return "FreshnessTracker"; }
 
+  // Registers the user if it is not yet, and returns its id
+  int AddUser(const std::shared_ptr<ngraph::runtime::Executable>& user);
+
   // If freshness_map_ has the base_pointer, then inserts the user function into
   // its set of user functions
   void MarkFresh(const void* base_pointer,
                  const std::shared_ptr<ngraph::runtime::Executable>& user);
 
+  // MarkFresh for the user of the id returned by AddUser. Does nothing if the
+  // id is negative
+  void MarkFresh(const void* base_pointer, int user_id);
+
   // Checks if the freshness_map_ has the user function for base_pointer, else
   // returns false
   bool IsFresh(const void* base_pointer,
                const std::shared_ptr<ngraph::runtime::Executable>& user);
 
+  // IsFresh for the user of the id returned by AddUser. Returns false if the
+  // id is negative
+  bool IsFresh(const void* base_pointer, int user_id);
+
   // Removes all the functions for the base_pointer in the freshness_map_, i.e.
   // sets the set<ng::Function> for base_pointer to empty
   void MarkStale(const void* base_pointer);
 
+  // MarkStale for a batch of base_pointers, locking each shard once
+  void MarkStale(const std::vector<const void*>& base_pointers);
+
   // Inserts the base_pointer in the map, initialises the set of functions as
   // empty set
   void AddTensor(const void* base_pointer);
@@ -117,13 +145,43 @@ class NGraphFreshnessTracker : public ResourceBase {
   void RemoveUser(const std::shared_ptr<ngraph::runtime::Executable>& user);
 
  private:
-  // mutex protecting the freshness_map_
-  mutex mu_;
-  // for each base pointer (of tensor), maintains a set of ng::Functions that
-  // use it
-  // Each ng function in the set is then a user of the base_pointer
-  std::map<const void*, std::set<std::shared_ptr<ngraph::runtime::Executable>>>
-      freshness_map_;
+  static const int kNumShards = 16;
+
+  // for each base pointer (of tensor), maintains the bitset of the ids of
+  // the executables it is fresh for
+  struct Shard {
+    mutex mu;
+    std::unordered_map<const void*, std::vector<uint64>> freshness_map;
+  };
+
+  struct UserInfo {
+    int id;
+    // Detects an executable allocated where a destroyed user used to be
+    std::weak_ptr<ngraph::runtime::Executable> user;
+  };
+
+  Shard& GetShard(const void* base_pointer);
+
+  // Returns the id of the user, or -1 if the user is not registered. Called
+  // with users_mu_ held, shared or exclusively
+  int LookUpUserId(const std::shared_ptr<ngraph::runtime::Executable>& user);
+
+  // Called with users_mu_ held exclusively
+  int GetOrCreateUserId(
+      const std::shared_ptr<ngraph::runtime::Executable>& user);
+
+  // Clears the bit of the user id in all the tensors and recycles the id.
+  // Called with users_mu_ held exclusively
+  void ReleaseUserId(int id);
+
+  Shard shards_[kNumShards];
+
+  // mutex protecting user_ids_, free_user_ids_ and next_user_id_. Taken
+  // before the shard mutexes
+  mutex users_mu_;
+  std::unordered_map<const ngraph::runtime::Executable*, UserInfo> user_ids_;
+  std::vector<int> free_user_ids_;
+  int next_user_id_ = 0;
 
   ~NGraphFreshnessTracker() override {}
 };
@@ -15,6 +15,10 @@
  *******************************************************************************/
 
 #include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
 
 #include "ngraph/runtime/backend.hpp"
 #include "ngraph/runtime/backend_manager.hpp"
@@ -75,10 +79,14 @@ static Status CheckIfOutputNode(const Node* node,
 
 // Checks if the node's inputs meet all the type constraints
 static Status TypeConstraintOk(Node* node,
-                               TypeConstraintMap& type_constraint_map,
+                               const TypeConstraintMap& type_constraint_map,
                                bool& type_constraints_ok) {
   type_constraints_ok = true;
-  for (auto& name_and_set : type_constraint_map[node->type_string()]) {
+  auto itr = type_constraint_map.find(node->type_string());
+  if (itr == type_constraint_map.end()) {
+    return Status::OK();
+  }
+  for (auto& name_and_set : itr->second) {
     auto& type_attr_name = name_and_set.first;
     auto& allowed_types = name_and_set.second;
 
@@ -97,7 +105,8 @@ static Status TypeConstraintOk(Node* node,
 // Checks if the node meets the confirmation constraints
 static Status ConfirmationOk(
     Node* node,
-    std::map<std::string, ConfirmationFunction>& confirmation_function_map,
+    const std::map<std::string, ConfirmationFunction>&
+        confirmation_function_map,
     bool& confirmation_ok) {
   auto it = confirmation_function_map.find(node->type_string());
   if (it != confirmation_function_map.end()) {
@@ -163,6 +172,60 @@ Status IsSupportedByBackend(
   return Status::OK();
 }
 
+// Answers of IsSupportedByBackend for the whole process, by backend and TF op
+// type. The query only depends on the op type (TFtoNgraphOpMap holds fixed
+// nGraph nodes for each TF op), not on the dtypes of the node. The backends
+// queried are created once and held from then on, so that the following
+// passes do not create and destroy them again. Lookups share the lock, only
+// a miss takes it exclusively.
+static mutex backend_support_mu;
+static std::map<std::pair<string, string>, bool> backend_support_cache;
+static std::set<string> backends_held_for_support;
+
+static Status IsSupportedByBackendCached(
+    const Node* node, const string& backend_name,
+    std::map<std::string, std::set<shared_ptr<ng::Node>>>& TFtoNgraphOpMap,
+    bool& is_supported) {
+  auto key = std::make_pair(backend_name, node->type_string());
+  {
+    tf_shared_lock l(backend_support_mu);
+    auto itr = backend_support_cache.find(key);
+    if (itr != backend_support_cache.end()) {
+      is_supported = itr->second;
+      return Status::OK();
+    }
+  }
+
+  mutex_lock l(backend_support_mu);
+  // Another thread may have answered it since the lookup
+  auto itr = backend_support_cache.find(key);
+  if (itr != backend_support_cache.end()) {
+    is_supported = itr->second;
+    return Status::OK();
+  }
+
+  if (backends_held_for_support.count(backend_name) == 0) {
+    TF_RETURN_IF_ERROR(BackendManager::CreateBackend(backend_name));
+    backends_held_for_support.insert(backend_name);
+  }
+  ng::runtime::Backend* op_backend = BackendManager::GetBackend(backend_name);
+  TF_RETURN_IF_ERROR(
+      IsSupportedByBackend(node, op_backend, TFtoNgraphOpMap, is_supported));
+  backend_support_cache[key] = is_supported;
+  return Status::OK();
+}
+
+// Estimated cost (in cycles) of checking a node, used to shard the nodes
+static const int64 kNodeCheckCost = 10000;
+
+// Thread pool the nodes of a graph are checked on, shared by all the calls
+// of the pass. Small graphs are checked inline by ParallelFor
+static thread::ThreadPool* GetMarkingThreadPool() {
+  static thread::ThreadPool* pool = new thread::ThreadPool(
+      Env::Default(), "ngraph_mark_for_clustering", port::MaxParallelism());
+  return pool;
+}
+
 //
 // Main entry point for the marking pass.
 //
@@ -554,7 +617,9 @@ Status MarkForClustering(Graph* graph, const std::set<string> skip_these_nodes,
       {"NoOp", {}},
   };
 
-  mutex init_mu;
+  // Held exclusively while the maps are (re)built, and shared while the nodes
+  // are checked against them, so that concurrent passes never see them change
+  static mutex init_mu;
   static bool initialized = false;
 
   // If the type constraint and confirmation function maps have not been
@@ -573,12 +638,12 @@ Status MarkForClustering(Graph* graph, const std::set<string> skip_these_nodes,
 
   std::set<string> disabled_ops_set_current = config::GetDisabledOps();
 
-  bool op_set_support_has_changed =
-      disabled_ops_set_current != disabled_ops_set;
-
   {
     mutex_lock l(init_mu);
 
+    bool op_set_support_has_changed =
+        disabled_ops_set_current != disabled_ops_set;
+
     if (!initialized || op_set_support_has_changed) {
       //
       // Initialize confirmation function map.
@@ -1029,39 +1094,40 @@ Status MarkForClustering(Graph* graph, const std::set<string> skip_these_nodes,
       set_attributes_map["UnsortedSegmentSum"] = SetStaticInputs({2});
       initialized = true;
     }
-  }
 
-  // Right now it cannot be inside the if(!initialized) block, because it is
-  // backend dependent, which might change with different sess.run()s
-  confirmation_function_map["NonMaxSuppressionV4"] = [&current_backend](
-      Node*, bool* result) {
-    auto config_map =
-        BackendManager::GetBackendAttributeValues(current_backend);
-    *result = (config_map.at("ngraph_backend") == "NNPI");
-    return Status::OK();
-  };
+    // Right now it cannot be inside the if(!initialized) block, because it is
+    // backend dependent, which might change with different sess.run()s
+    confirmation_function_map["NonMaxSuppressionV4"] = [current_backend](
+        Node*, bool* result) {
+      auto config_map =
+          BackendManager::GetBackendAttributeValues(current_backend);
+      *result = (config_map.at("ngraph_backend") == "NNPI");
+      return Status::OK();
+    };
 
-  confirmation_function_map["CombinedNonMaxSuppression"] = [&current_backend](
-      Node*, bool* result) {
-    auto config_map =
-        BackendManager::GetBackendAttributeValues(current_backend);
-    *result = (config_map.at("ngraph_backend") == "NNPI");
-    return Status::OK();
-  };
+    confirmation_function_map["CombinedNonMaxSuppression"] =
+        [current_backend](Node*, bool* result) {
+          auto config_map =
+              BackendManager::GetBackendAttributeValues(current_backend);
+          *result = (config_map.at("ngraph_backend") == "NNPI");
+          return Status::OK();
+        };
 
-  if (op_set_support_has_changed) {
-    NGRAPH_VLOG(5) << "Changing op support";
-    disabled_ops_set = disabled_ops_set_current;
-    for (auto itr : disabled_ops_set) {
-      auto conf_itr = confirmation_function_map.find(itr);
-      if (conf_itr == confirmation_function_map.end()) {
-        // Note: This error means, we cannot disable NGraphEncapsulate and other
-        // ng ops, because they are expected to never appear in
-        // confirmation_function_map
-        return errors::Internal("Tried to disable ngraph unsupported op ", itr);
-      } else {
-        NGRAPH_VLOG(5) << "Disabling op: " << itr;
-        confirmation_function_map.erase(conf_itr);
+    if (op_set_support_has_changed) {
+      NGRAPH_VLOG(5) << "Changing op support";
+      disabled_ops_set = disabled_ops_set_current;
+      for (auto itr : disabled_ops_set) {
+        auto conf_itr = confirmation_function_map.find(itr);
+        if (conf_itr == confirmation_function_map.end()) {
+          // Note: This error means, we cannot disable NGraphEncapsulate and
+          // other ng ops, because they are expected to never appear in
+          // confirmation_function_map
+          return errors::Internal("Tried to disable ngraph unsupported op ",
+                                  itr);
+        } else {
+          NGRAPH_VLOG(5) << "Disabling op: " << itr;
+          confirmation_function_map.erase(conf_itr);
+        }
       }
     }
   }
@@ -1072,87 +1138,126 @@ Status MarkForClustering(Graph* graph, const std::set<string> skip_these_nodes,
   vector<Node*> nodes_marked_for_clustering;
   vector<Node*> variable_type_nodes;
   string ng_backend_type;
-  // Create nGraph backend
   BackendManager::GetCurrentlySetBackendName(&ng_backend_type);
-  // Create backend to query is_supported
-  TF_RETURN_IF_ERROR(BackendManager::CreateBackend(ng_backend_type));
-  ng::runtime::Backend* op_backend =
-      BackendManager::GetBackend(ng_backend_type);
 
+  vector<Node*> candidate_nodes;
   for (auto node : graph->op_nodes()) {
-    bool mark_for_clustering = false;
-
     if (IsNGVariableType(node->type_string())) {
       variable_type_nodes.push_back(node);
-      continue;
+    } else {
+      candidate_nodes.push_back(node);
     }
+  }
 
-    do {
-      // check if output node
-      bool skip_it = false;
-      TF_RETURN_IF_ERROR(CheckIfOutputNode(node, skip_these_nodes, skip_it));
-      if (skip_it) {
-        NGRAPH_VLOG(5) << "NGTF_OPTIMIZER: Found Output Node: " << node->name()
-                       << " - skip marking it for clustering";
-        break;
-      }
+  // Outcome of the checks for a node, the histograms are filled from these
+  enum NodeVerdict {
+    ACCEPTED,
+    REJECTED,
+    NOT_SUPPORTED,
+    FAILED_CONFIRMATION,
+    FAILED_CONSTRAINT
+  };
 
-      // check placement
-      bool placement_ok = false;
-      TF_RETURN_IF_ERROR(NGraphPlacementRequested(node, placement_ok));
-      if (!placement_ok) {
-        NGRAPH_VLOG(5) << "Placement not requested: " << node->name();
-        break;
-      }
+  // Only reads the maps above and the node, so that the nodes can be checked
+  // in parallel
+  auto check_node = [&](Node* node, NodeVerdict* verdict) -> Status {
+    *verdict = REJECTED;
 
-      // check node's confirmation constraints
-      bool confirmation_constraint_ok = false;
-      TF_RETURN_IF_ERROR(ConfirmationOk(node, confirmation_function_map,
-                                        confirmation_constraint_ok));
-      if (!confirmation_constraint_ok) {
-        NGRAPH_VLOG(5) << "Node does not meet confirmation constraints: "
-                       << node->name();
-        if (confirmation_function_map.find(node->type_string()) ==
-            confirmation_function_map.end()) {
-          // not found
-          no_support_histogram[node->type_string()]++;
-        } else {
-          // found
-          fail_confirmation_histogram[node->type_string()]++;
-        }
-        break;
-      }
+    // check if output node
+    bool skip_it = false;
+    TF_RETURN_IF_ERROR(CheckIfOutputNode(node, skip_these_nodes, skip_it));
+    if (skip_it) {
+      NGRAPH_VLOG(5) << "NGTF_OPTIMIZER: Found Output Node: " << node->name()
+                     << " - skip marking it for clustering";
+      return Status::OK();
+    }
 
-      // check input type constraints
-      bool type_constraint_ok = false;
-      TF_RETURN_IF_ERROR(
-          TypeConstraintOk(node, type_constraint_map, type_constraint_ok));
-      if (!type_constraint_ok) {
-        NGRAPH_VLOG(5) << "Inputs do not meet type constraints: "
-                       << node->name();
-        fail_constraint_histogram[node->type_string()]++;
-        break;
+    // check placement
+    bool placement_ok = false;
+    TF_RETURN_IF_ERROR(NGraphPlacementRequested(node, placement_ok));
+    if (!placement_ok) {
+      NGRAPH_VLOG(5) << "Placement not requested: " << node->name();
+      return Status::OK();
+    }
+
+    // check node's confirmation constraints
+    bool confirmation_constraint_ok = false;
+    TF_RETURN_IF_ERROR(ConfirmationOk(node, confirmation_function_map,
+                                      confirmation_constraint_ok));
+    if (!confirmation_constraint_ok) {
+      NGRAPH_VLOG(5) << "Node does not meet confirmation constraints: "
+                     << node->name();
+      if (confirmation_function_map.find(node->type_string()) ==
+          confirmation_function_map.end()) {
+        // not found
+        *verdict = NOT_SUPPORTED;
+      } else {
+        // found
+        *verdict = FAILED_CONFIRMATION;
       }
+      return Status::OK();
+    }
 
-      // Check if op is supported by backend
-      bool is_supported = false;
-      TF_RETURN_IF_ERROR(IsSupportedByBackend(node, op_backend, TFtoNgraphOpMap,
-                                              is_supported));
+    // check input type constraints
+    bool type_constraint_ok = false;
+    TF_RETURN_IF_ERROR(
+        TypeConstraintOk(node, type_constraint_map, type_constraint_ok));
+    if (!type_constraint_ok) {
+      NGRAPH_VLOG(5) << "Inputs do not meet type constraints: "
+                     << node->name();
+      *verdict = FAILED_CONSTRAINT;
+      return Status::OK();
+    }
 
-      if (!is_supported) {
-        NGRAPH_VLOG(5) << "TF Op " << node->name() << " of type "
-                       << node->type_string()
-                       << " is not supported by backend: " << ng_backend_type;
-        break;
-      }
+    // Check if op is supported by backend
+    bool is_supported = false;
+    TF_RETURN_IF_ERROR(IsSupportedByBackendCached(
+        node, ng_backend_type, TFtoNgraphOpMap, is_supported));
+
+    if (!is_supported) {
+      NGRAPH_VLOG(5) << "TF Op " << node->name() << " of type "
+                     << node->type_string()
+                     << " is not supported by backend: " << ng_backend_type;
+      return Status::OK();
+    }
+
+    // if all constraints are met, mark for clustering
+    *verdict = ACCEPTED;
+    return Status::OK();
+  };
+
+  vector<NodeVerdict> verdicts(candidate_nodes.size(), REJECTED);
+  vector<Status> statuses(candidate_nodes.size());
+  {
+    tf_shared_lock l(init_mu);
+    GetMarkingThreadPool()->ParallelFor(
+        candidate_nodes.size(), kNodeCheckCost, [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            statuses[i] = check_node(candidate_nodes[i], &verdicts[i]);
+          }
+        });
+  }
 
-      // if all constraints are met, mark for clustering
-      mark_for_clustering = true;
-    } while (false);
+  for (size_t i = 0; i < candidate_nodes.size(); i++) {
+    TF_RETURN_IF_ERROR(statuses[i]);
+    Node* node = candidate_nodes[i];
+    switch (verdicts[i]) {
+      case NOT_SUPPORTED:
+        no_support_histogram[node->type_string()]++;
+        break;
+      case FAILED_CONFIRMATION:
+        fail_confirmation_histogram[node->type_string()]++;
+        break;
+      case FAILED_CONSTRAINT:
+        fail_constraint_histogram[node->type_string()]++;
+        break;
+      default:
+        break;
+    }
 
     // Set the _ngraph_marked_for_clustering attribute if all constraints
     // are satisfied
-    if (mark_for_clustering) {
+    if (verdicts[i] == ACCEPTED) {
       NGRAPH_VLOG(4) << "Accepting: " << node->name() << "["
                      << node->type_string() << "]";
       nodes_marked_for_clustering.push_back(node);
@@ -1162,9 +1267,6 @@ Status MarkForClustering(Graph* graph, const std::set<string> skip_these_nodes,
     }
   }
 
-  // Release backend created to query is_supported
-  BackendManager::ReleaseBackend(ng_backend_type);
-
   if (config::IsLoggingPlacement()) {
     std::cout << "\n=============New sub-graph logs=============\n";
     // print summary for nodes failed to be marked
@@ -1183,6 +1285,7 @@ Status MarkForClustering(Graph* graph, const std::set<string> skip_these_nodes,
     // TODO(amprocte): move attr name to a constant
     node->AddAttr("_ngraph_marked_for_clustering", true);
     SetNodeBackend(node, current_backend);
+    tf_shared_lock l(init_mu);
     auto it = set_attributes_map.find(node->type_string());
     if (it != set_attributes_map.end()) {
       TF_RETURN_IF_ERROR(it->second(node));
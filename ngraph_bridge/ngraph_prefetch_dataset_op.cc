@@ -39,19 +39,26 @@ File: tensorflow/core/kernels/data/prefetch_dataset_op.cc
 
 #include "ngraph_bridge/ngraph_prefetch_dataset_op.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <deque>
+#include <map>
 
 #include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/stats_aggregator.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/error_codes.pb.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 
+#include "absl/time/time.h"
 #include "ngraph/event_tracing.hpp"
 
+#include "ngraph_bridge/ngraph_backend_manager.h"
 #include "ngraph_bridge/ngraph_prefetch_shared_data.h"
 #include "ngraph_bridge/ngraph_utils.h"
 #include "ngraph_bridge/stats_utils.h"
@@ -65,15 +72,30 @@ namespace data {
 // Determines the fraction of slack time by which to delay prefetching of data.
 constexpr double kSleepFactor = 0.2;
 constexpr char kDatasetName[] = "NGraphPrefetch";
+// Default number of threads copying the prefetched elements to the device
+constexpr int kDefaultNumCopyThreads = 2;
+// How often the staging thread checks for cancellation while it waits for
+// free device input tensors
+constexpr int64 kStagingPollIntervalMs = 100;
+
+static int GetNumCopyThreads() {
+  const char* value = std::getenv("NGRAPH_TF_PREFETCH_COPY_THREADS");
+  if (value == nullptr) {
+    return kDefaultNumCopyThreads;
+  }
+  return std::max(1, atoi(value));
+}
 
 class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
  public:
   Dataset(OpKernelContext* ctx, const DatasetBase* input, int64 buffer_size,
-          int64 slack_period)
+          int64 slack_period, const string& iterator_name, int graph_id)
       : DatasetBase(DatasetContext(ctx)),
         input_(input),
         buffer_size_(buffer_size),
-        slack_period_(slack_period) {
+        slack_period_(slack_period),
+        iterator_name_(iterator_name),
+        graph_id_(graph_id) {
     input_->Ref();
     m_resource_mgr = ctx->resource_manager();
   }
@@ -111,9 +133,16 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(buffer_size_, &buffer_size));
     AttrValue slack_period_attr;
     b->BuildAttrValue(slack_period_, &slack_period_attr);
-    TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {input_graph_node, buffer_size},
-        {std::make_pair("slack_period", slack_period_attr)}, output));
+    AttrValue iterator_name_attr;
+    b->BuildAttrValue(iterator_name_, &iterator_name_attr);
+    AttrValue graph_id_attr;
+    b->BuildAttrValue(graph_id_, &graph_id_attr);
+    TF_RETURN_IF_ERROR(
+        b->AddDataset(this, {input_graph_node, buffer_size},
+                      {std::make_pair("slack_period", slack_period_attr),
+                       std::make_pair("iterator_name", iterator_name_attr),
+                       std::make_pair("graph_id", graph_id_attr)},
+                      output));
     return Status::OK();
   }
 
@@ -123,14 +152,14 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
     explicit Iterator(const Params& params, ResourceMgr* rm)
         : DatasetIterator<Dataset>(params),
           auto_tuner_(params.dataset->buffer_size_),
-          m_resource_mgr(rm),
-          m_buffer_size(params.dataset->buffer_size_) {
+          m_resource_mgr(rm) {
       slack_us_ = 0;
     }
 
     ~Iterator() override {
-      // Signal the prefetch thread to terminate it. We will then
-      // join that thread when we delete `this->prefetch_thread_`.
+      // Signal the prefetch and staging threads to terminate them. We will
+      // then join these threads when we delete `this->prefetch_thread_` and
+      // `this->staging_thread_`.
       //
       // TODO(mrry): Replace this cancellation logic with a
       // CancellationManager. The syntax would be more heavyweight,
@@ -141,6 +170,16 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
         mutex_lock l(mu_);
         cancelled_ = true;
         cond_var_.notify_all();
+        staging_cond_var_.notify_all();
+      }
+      // The staging thread uses the consumers, join it before releasing them.
+      // It notices the cancellation while it waits for device input tensors
+      staging_thread_.reset();
+      if (consumers_ != nullptr) {
+        consumers_->Unref();
+      }
+      if (cached_elements_ != nullptr) {
+        cached_elements_->Unref();
       }
     }
 
@@ -179,6 +218,10 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
               "NGraphPrefetchDatasetOp::Dataset::Iterator::GetNext");
         }
 
+        // The encapsulates expect the staged elements in order, we cannot go
+        // on once staging failed
+        TF_RETURN_IF_ERROR(staging_status_);
+
         if (!buffer_.empty()) {
           return Consume(ctx, out_tensors, end_of_sequence);
         }
@@ -284,6 +327,15 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
       int64 created_us;
     };
 
+    // An element read from the input that still has to be staged on the
+    // device for the NGraphEncapsulates
+    struct StagingElement {
+      // Position of the element in the input, starting from 0
+      int64 id;
+      // Shares the buffers of the tensors in the host buffer
+      std::vector<Tensor> value;
+    };
+
     Status Consume(IteratorContext* ctx, std::vector<Tensor>* out_tensors,
                    bool* end_of_sequence) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       ngraph::Event evt_consume("Prefetch_Consume", "Prefetch_Consume", "");
@@ -330,6 +382,8 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
       auto_tuner_.RecordConsumption(buffer_.size());
       buffer_.pop_front();
       *end_of_sequence = false;
+      ++num_consumed_;
+      consumers_->SetNumConsumed(num_consumed_);
 
       // Wake the prefetch thread, in case it has been waiting for space
       // in the buffer. Also wake up threads from other calls to GetNext.
@@ -347,10 +401,43 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
     Status EnsurePrefetchThreadStarted(IteratorContext* ctx)
         EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (!prefetch_thread_) {
+        TF_RETURN_IF_ERROR(
+            m_resource_mgr->LookupOrCreate<
+                ngraph_bridge::NGraphPrefetchConsumers>(
+                ngraph_bridge::NGraphPrefetchSharedResouce::CONTAINER_NAME,
+                ngraph_bridge::NGraphPrefetchConsumers::ResourceName(
+                    dataset()->graph_id_, dataset()->iterator_name_),
+                &consumers_,
+                [](ngraph_bridge::NGraphPrefetchConsumers** consumers) {
+                  *consumers = new ngraph_bridge::NGraphPrefetchConsumers();
+                  return Status::OK();
+                }));
+        consumers_->SetNumConsumed(num_consumed_);
+        TF_RETURN_IF_ERROR(
+            m_resource_mgr
+                ->LookupOrCreate<ngraph_bridge::NGraphCachedElements>(
+                    ngraph_bridge::NGraphPrefetchSharedResouce::CONTAINER_NAME,
+                    ngraph_bridge::NGraphCachedElements::ResourceName(
+                        dataset()->graph_id_, dataset()->iterator_name_),
+                    &cached_elements_,
+                    [](ngraph_bridge::NGraphCachedElements** cached_elements) {
+                      *cached_elements =
+                          new ngraph_bridge::NGraphCachedElements();
+                      return Status::OK();
+                    }));
+        const int num_copy_threads = GetNumCopyThreads();
+        NGRAPH_VLOG(2) << "[PREFETCH] Staging with " << num_copy_threads
+                       << " copy threads";
+        copy_pool_.reset(new thread::ThreadPool(
+            ctx->env(), "ngraph_prefetch_copy", num_copy_threads));
+
         std::shared_ptr<IteratorContext> new_ctx =
             std::make_shared<IteratorContext>(*ctx);
         prefetch_thread_ = ctx->StartThread(
             "tf_data_prefetch", [this, new_ctx]() { PrefetchThread(new_ctx); });
+        staging_thread_ =
+            ctx->StartThread("tf_data_ngraph_staging",
+                             [this, new_ctx]() { StagingThread(new_ctx); });
       }
       return Status::OK();
     }
@@ -363,14 +450,16 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
       RecordStart(ctx.get());
       auto cleanup = gtl::MakeCleanup([this, ctx] { RecordStop(ctx.get()); });
       // Keep track of where we are in an iteration "burst"
-      int num_produced = 0;
+      int64 num_produced = 0;
       while (true) {
         ngraph::Event evt_prefetch("Prefetch_Produce", "Prefetch_Produce", "");
 
         // 1. Wait for a slot in the buffer.
         {
           mutex_lock l(mu_);
-          while (!cancelled_ && buffer_.size() >= auto_tuner_.buffer_limit()) {
+          while (!cancelled_ &&
+                 (buffer_.size() >= auto_tuner_.buffer_limit() ||
+                  staging_queue_.size() >= auto_tuner_.buffer_limit())) {
             RecordStop(ctx.get());
             cond_var_.wait(l);
             RecordStart(ctx.get());
@@ -405,56 +494,18 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
           prefetch_thread_finished_ = true;
           NGRAPH_VLOG(2) << "[PREFETCH] Prefetch thread finished";
           cond_var_.notify_all();
+          staging_cond_var_.notify_all();
           return;
         }
 
-        // Check if the shared data exist
-        ngraph_bridge::NGraphPrefetchSharedResouce* shared_data = nullptr;
-        Status s = m_resource_mgr->Lookup(
-            ngraph_bridge::NGraphPrefetchSharedResouce::CONTAINER_NAME,
-            ngraph_bridge::NGraphPrefetchSharedResouce::RESOURCE_NAME,
-            &shared_data);
-        if (s.ok()) {
-          ngraph::Event evt_dev_cp("Prf Dev Copy", "Copy", "");
-          shared_data->SetBufferDepth(m_buffer_size);
-          auto ng_input_tensor_bundle =
-              shared_data->GetNextInputTensorBundleForDeviceTransfer();
-
-          // Write to these tensors
-          for (auto i = 0; i < buffer_element.value.size(); i++) {
-            ng::element::Type ng_element_type;
-            auto status = ngraph_bridge::TFDataTypeToNGraphElementType(
-                buffer_element.value[i].dtype(), &ng_element_type);
-
-            void* current_src_ptr =
-                (void*)DMAHelper::base(&buffer_element.value[i]);
-            try {
-              NGRAPH_VLOG(2)
-                  << "[PREFETCH] INPUT tensor being written by Prefetch: "
-                  << " Value: " << buffer_element.value[i].DebugString();
-              ng_input_tensor_bundle.Inputs[i]->write(
-                  current_src_ptr,
-                  ng_input_tensor_bundle.Inputs[i]->get_element_count() *
-                      ng_element_type.size());
-            } catch (const std::exception& exp) {
-              throw exp;
-            } catch (...) {
-              throw std::runtime_error(
-                  "Error copying TF tensor to device tensor");
-            }
-          }
-
-          // Now add them back to the other queue
-          shared_data->AddNextInputTensorBundleReadyForDeviceExecution(
-              ng_input_tensor_bundle);
-          shared_data->Unref();
-          evt_dev_cp.Stop();
-          ngraph::Event::write_trace(evt_dev_cp);
-        }
-
-        // 3. Signal that the element has been produced.
+        // 3. Signal that the element has been produced, and hand it to the
+        // staging thread. The host buffer does not wait for the device copies
         {
           mutex_lock l(mu_);
+          if (buffer_element.status.ok()) {
+            staging_queue_.push_back({num_produced, buffer_element.value});
+            staging_cond_var_.notify_all();
+          }
           RecordBufferEnqueue(ctx.get(), buffer_element.value);
           buffer_element.created_us = ctx->env()->NowMicros();
           buffer_.push_back(std::move(buffer_element));
@@ -466,6 +517,369 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
       }
     }
 
+    // Stages the elements read by the prefetch thread on the device, in the
+    // order they were read, for every NGraphEncapsulate fed by our iterator.
+    //
+    // It owns the iterator context passed to it.
+    void StagingThread(const std::shared_ptr<IteratorContext>& ctx) {
+      while (true) {
+        StagingElement staging_element;
+        size_t staging_queue_size;
+        {
+          mutex_lock l(mu_);
+          while (!cancelled_ && staging_queue_.empty() &&
+                 !prefetch_thread_finished_) {
+            staging_cond_var_.wait(l);
+          }
+          if (cancelled_ || staging_queue_.empty()) {
+            return;
+          }
+          staging_element = std::move(staging_queue_.front());
+          staging_queue_.pop_front();
+          staging_queue_size = staging_queue_.size();
+          // Wake the prefetch thread, in case it has been waiting for space
+          // in the staging queue
+          cond_var_.notify_all();
+        }
+
+        Status s = StageElement(ctx.get(), staging_element);
+        const auto& stats_aggregator = ctx->stats_aggregator();
+        if (stats_aggregator) {
+          stats_aggregator->AddScalar(
+              stats_utils::StagingQueueSizeScalarName(dataset()->node_name()),
+              static_cast<float>(staging_queue_size), staging_element.id);
+        }
+        if (!s.ok()) {
+          NGRAPH_VLOG(2) << "[PREFETCH] Staging failed: " << s;
+          mutex_lock l(mu_);
+          if (cancelled_) {
+            return;
+          }
+          // The encapsulates would otherwise wait for the element forever
+          TerminateConsumers(s);
+          staging_status_ = s;
+          cond_var_.notify_all();
+          return;
+        }
+      }
+    }
+
+    void TerminateConsumers(const Status& status) {
+      for (const auto& consumer : consumers_->GetConsumers()) {
+        ngraph_bridge::NGraphPrefetchSharedResouce* shared_data = nullptr;
+        if (m_resource_mgr
+                ->Lookup(
+                    ngraph_bridge::NGraphPrefetchSharedResouce::CONTAINER_NAME,
+                    consumer.shared_resource_name, &shared_data)
+                .ok()) {
+          shared_data->Terminate(status);
+          shared_data->Unref();
+        }
+      }
+    }
+
+    // Writes the element to the next free device input tensors of every
+    // NGraphEncapsulate that expects it. The copies of all the encapsulates
+    // and components run in parallel on the copy threads.
+    Status StageElement(IteratorContext* ctx,
+                        const StagingElement& staging_element) {
+      // Position of the element in the first epoch of the NGraphCacheDataset
+      // feeding us, if any
+      const int64 cached_element = cached_elements_->Pop();
+      std::vector<ngraph_bridge::NGraphPrefetchSharedResouce*> shared_datas;
+      auto unref_shared_datas = gtl::MakeCleanup([&shared_datas] {
+        for (auto shared_data : shared_datas) {
+          shared_data->Unref();
+        }
+      });
+      for (const auto& consumer : consumers_->GetConsumers()) {
+        // The NGraphEncapsulate copies the elements returned before it
+        // registered from the TF tensors
+        if (staging_element.id < consumer.first_element) {
+          continue;
+        }
+        ngraph_bridge::NGraphPrefetchSharedResouce* shared_data = nullptr;
+        Status s = m_resource_mgr->Lookup(
+            ngraph_bridge::NGraphPrefetchSharedResouce::CONTAINER_NAME,
+            consumer.shared_resource_name, &shared_data);
+        if (!s.ok()) {
+          continue;
+        }
+        shared_datas.push_back(shared_data);
+        // The elements it was not fed yet were not staged either, the
+        // NGraphEncapsulate copies them itself
+        shared_data->SetBufferDepth(
+            static_cast<int>(staging_element.id - consumer.first_element));
+      }
+      if (shared_datas.empty()) {
+        return Status::OK();
+      }
+
+      ngraph::Event evt_dev_cp("Prf Dev Copy", "Copy", "");
+      // 1. Wait for free device input tensors of every consumer
+      std::vector<ngraph_bridge::NGraphPrefetchSharedResouce::InputTensorBundle>
+          ng_input_tensor_bundles;
+      // On an early return, the bundles not handed over to their
+      // NGraphEncapsulate yet go back to the stores they were lent from
+      size_t num_handed_over = 0;
+      auto return_bundles = gtl::MakeCleanup(
+          [&ng_input_tensor_bundles, &num_handed_over]() -> void {
+            for (size_t i = num_handed_over;
+                 i < ng_input_tensor_bundles.size(); i++) {
+              ng_input_tensor_bundles[i].Store->return_tensors(
+                  ng_input_tensor_bundles[i].Id);
+            }
+          });
+      std::vector<uint64> stall_us;
+      for (auto shared_data : shared_datas) {
+        uint64 stall_start_us = ctx->env()->NowMicros();
+        ngraph_bridge::NGraphPrefetchSharedResouce::InputTensorBundle
+            ng_input_tensor_bundle;
+        while (true) {
+          Status s = shared_data->GetNextInputTensorBundleForDeviceTransfer(
+              &ng_input_tensor_bundle,
+              absl::Milliseconds(kStagingPollIntervalMs));
+          if (s.ok()) {
+            ng_input_tensor_bundles.push_back(ng_input_tensor_bundle);
+            break;
+          }
+          if (!errors::IsDeadlineExceeded(s)) {
+            return s;
+          }
+          mutex_lock l(mu_);
+          if (cancelled_) {
+            return errors::Cancelled(
+                "NGraphPrefetchDatasetOp::Dataset::Iterator::StageElement");
+          }
+        }
+        stall_us.push_back(ctx->env()->NowMicros() - stall_start_us);
+      }
+
+      // 2. Write the components to the input tensors they feed, the
+      // encapsulates copy their other inputs themselves
+      struct CopyTask {
+        const Tensor* tf_tensor;
+        std::shared_ptr<ng::runtime::Tensor> ng_tensor;
+        Status status;
+      };
+      std::vector<CopyTask> copy_tasks;
+      // Device tensors allocated to keep the element, by consumer
+      std::map<int, std::vector<std::shared_ptr<ng::runtime::Tensor>>>
+          inputs_to_cache;
+      for (auto i = 0; i < shared_datas.size(); i++) {
+        auto& ng_input_tensor_bundle = ng_input_tensor_bundles[i];
+        const auto& input_indexes =
+            shared_datas[i]->GetPrefetchedInputIndexes();
+        const auto& components =
+            shared_datas[i]->GetPrefetchedInputComponents();
+        std::vector<CopyTask> bundle_copy_tasks;
+        ng_input_tensor_bundle.Staged = true;
+        for (auto j = 0; j < input_indexes.size(); j++) {
+          const int input_index = input_indexes[j];
+          const int component = components[j];
+          if (component >= staging_element.value.size()) {
+            return errors::Internal("Dataset component ", component,
+                                    " not found for input ", input_index,
+                                    " of ", shared_datas[i]->DebugString());
+          }
+          const Tensor& tf_tensor = staging_element.value[component];
+          const auto& ng_tensor = ng_input_tensor_bundle.Inputs[input_index];
+          // The tensors were allocated for the shapes of an earlier element,
+          // the NGraphEncapsulate copies this one itself
+          if (!ShapesMatch(tf_tensor, *ng_tensor)) {
+            NGRAPH_VLOG(2) << "[PREFETCH] Shape of element "
+                           << staging_element.id << " changed for input "
+                           << input_index << " of "
+                           << shared_datas[i]->DebugString();
+            ng_input_tensor_bundle.Staged = false;
+            break;
+          }
+          bundle_copy_tasks.push_back({&tf_tensor, ng_tensor, Status::OK()});
+        }
+        if (!ng_input_tensor_bundle.Staged) {
+          continue;
+        }
+
+        if (cached_element >= 0) {
+          std::vector<std::shared_ptr<ng::runtime::Tensor>> cached_inputs;
+          if (shared_datas[i]->GetCachedInputs(cached_element,
+                                               &cached_inputs)) {
+            // Later epoch, run on the tensors kept on the device if they
+            // still fit the tensors of the executable
+            if (CachedInputsFit(cached_inputs, ng_input_tensor_bundle,
+                                input_indexes)) {
+              for (auto j = 0; j < input_indexes.size(); j++) {
+                ng_input_tensor_bundle.Inputs[input_indexes[j]] =
+                    cached_inputs[j];
+              }
+              continue;
+            }
+          } else if (AllocateCachedInputs(shared_datas[i],
+                                          ng_input_tensor_bundle,
+                                          input_indexes, &cached_inputs)) {
+            // First epoch, the element is written to tensors of its own
+            // that are kept on the device
+            for (auto j = 0; j < input_indexes.size(); j++) {
+              ng_input_tensor_bundle.Inputs[input_indexes[j]] =
+                  cached_inputs[j];
+              bundle_copy_tasks[j].ng_tensor = cached_inputs[j];
+            }
+            inputs_to_cache[i] = cached_inputs;
+          }
+        }
+        copy_tasks.insert(copy_tasks.end(), bundle_copy_tasks.begin(),
+                          bundle_copy_tasks.end());
+      }
+
+      uint64 copy_start_us = ctx->env()->NowMicros();
+      BlockingCounter counter(copy_tasks.size());
+      for (auto& copy_task : copy_tasks) {
+        copy_pool_->Schedule([&copy_task, &counter]() {
+          copy_task.status = CopyToDevice(*copy_task.tf_tensor,
+                                          copy_task.ng_tensor.get());
+          counter.DecrementCount();
+        });
+      }
+      counter.Wait();
+      uint64 copy_us = ctx->env()->NowMicros() - copy_start_us;
+      int64 copied_bytes = 0;
+      for (const auto& copy_task : copy_tasks) {
+        TF_RETURN_IF_ERROR(copy_task.status);
+        copied_bytes += copy_task.tf_tensor->TotalBytes();
+      }
+      for (auto& kv : inputs_to_cache) {
+        int64 bytes = 0;
+        for (const auto& ng_tensor : kv.second) {
+          bytes += ng_tensor->get_size_in_bytes();
+        }
+        shared_datas[kv.first]->AddCachedInputs(cached_element,
+                                                std::move(kv.second), bytes);
+      }
+
+      // 3. Now add them back to the other queues
+      const auto& stats_aggregator = ctx->stats_aggregator();
+      for (auto i = 0; i < shared_datas.size(); i++) {
+        TF_RETURN_IF_ERROR(
+            shared_datas[i]->AddNextInputTensorBundleReadyForDeviceExecution(
+                ng_input_tensor_bundles[i]));
+        num_handed_over++;
+
+        auto& device_autotuner = shared_datas[i]->GetAutotuner();
+        device_autotuner.RecordCopy(copy_us, stall_us[i]);
+        if (stats_aggregator) {
+          string prefix = strings::StrCat(dataset()->node_name(), "::",
+                                          shared_datas[i]->GetName());
+          stats_aggregator->AddScalar(
+              stats_utils::DeviceBufferDepthScalarName(prefix),
+              static_cast<float>(device_autotuner.GetDepth()),
+              staging_element.id);
+          stats_aggregator->AddScalar(
+              stats_utils::ProducerStallTimeScalarName(prefix),
+              static_cast<float>(device_autotuner.GetProducerStallUs()),
+              staging_element.id);
+          stats_aggregator->AddScalar(
+              stats_utils::ConsumerStallTimeScalarName(prefix),
+              static_cast<float>(device_autotuner.GetConsumerStallUs()),
+              staging_element.id);
+        }
+      }
+      if (stats_aggregator && copy_us > 0) {
+        stats_aggregator->AddScalar(
+            stats_utils::StagingThroughputScalarName(dataset()->node_name()),
+            static_cast<float>(copied_bytes) * 1e6 / copy_us,
+            staging_element.id);
+      }
+      evt_dev_cp.Stop();
+      ngraph::Event::write_trace(evt_dev_cp);
+      return Status::OK();
+    }
+
+    static bool CachedInputsFit(
+        const std::vector<std::shared_ptr<ng::runtime::Tensor>>& cached_inputs,
+        const ngraph_bridge::NGraphPrefetchSharedResouce::InputTensorBundle&
+            ng_input_tensor_bundle,
+        const std::vector<int>& input_indexes) {
+      for (auto j = 0; j < input_indexes.size(); j++) {
+        const auto& ng_tensor = ng_input_tensor_bundle.Inputs[input_indexes[j]];
+        if (cached_inputs[j]->get_shape() != ng_tensor->get_shape() ||
+            cached_inputs[j]->get_element_type() !=
+                ng_tensor->get_element_type()) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Allocates device tensors like the ones of the bundle to keep the
+    // element, within the memory budget of the NGraphCacheDataset
+    bool AllocateCachedInputs(
+        ngraph_bridge::NGraphPrefetchSharedResouce* shared_data,
+        const ngraph_bridge::NGraphPrefetchSharedResouce::InputTensorBundle&
+            ng_input_tensor_bundle,
+        const std::vector<int>& input_indexes,
+        std::vector<std::shared_ptr<ng::runtime::Tensor>>* cached_inputs) {
+      int64 bytes = 0;
+      for (int input_index : input_indexes) {
+        const auto& ng_tensor = ng_input_tensor_bundle.Inputs[input_index];
+        bytes += ng_tensor->get_size_in_bytes();
+      }
+      const int64 max_bytes = cached_elements_->GetMaxBytes();
+      if (max_bytes > 0 && shared_data->GetCachedBytes() + bytes > max_bytes) {
+        return false;
+      }
+      ng::runtime::Backend* op_backend =
+          ngraph_bridge::BackendManager::GetBackend(
+              shared_data->GetBackendName());
+      try {
+        for (int input_index : input_indexes) {
+          const auto& ng_tensor = ng_input_tensor_bundle.Inputs[input_index];
+          cached_inputs->push_back(op_backend->create_tensor(
+              ng_tensor->get_element_type(), ng_tensor->get_shape()));
+        }
+      } catch (const std::exception& exp) {
+        NGRAPH_VLOG(2) << "[PREFETCH] Cannot allocate device tensors to cache "
+                       << "the element: " << exp.what();
+        cached_inputs->clear();
+        return false;
+      }
+      return true;
+    }
+
+    static bool ShapesMatch(const Tensor& tf_tensor,
+                            const ng::runtime::Tensor& ng_tensor) {
+      const ng::Shape& ng_shape = ng_tensor.get_shape();
+      if (tf_tensor.dims() != static_cast<int>(ng_shape.size())) {
+        return false;
+      }
+      for (int i = 0; i < tf_tensor.dims(); i++) {
+        if (static_cast<size_t>(tf_tensor.dim_size(i)) != ng_shape[i]) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Runs on the copy threads
+    static Status CopyToDevice(const Tensor& tf_tensor,
+                               ng::runtime::Tensor* ng_tensor) {
+      ng::element::Type ng_element_type;
+      TF_RETURN_IF_ERROR(ngraph_bridge::TFDataTypeToNGraphElementType(
+          tf_tensor.dtype(), &ng_element_type));
+      NGRAPH_VLOG(2) << "[PREFETCH] INPUT tensor being written by Prefetch: "
+                     << tf_tensor.DebugString();
+      void* current_src_ptr = (void*)DMAHelper::base(&tf_tensor);
+      try {
+        ng_tensor->write(current_src_ptr, ng_tensor->get_element_count() *
+                                              ng_element_type.size());
+      } catch (const std::exception& exp) {
+        return errors::Internal("Error copying TF tensor to device tensor: ",
+                                exp.what());
+      } catch (...) {
+        return errors::Internal("Error copying TF tensor to device tensor");
+      }
+      return Status::OK();
+    }
+
     Status WriteStatus(IteratorStateWriter* writer, size_t index,
                        const Status& status) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       TF_RETURN_IF_ERROR(writer->WriteScalar(
@@ -517,9 +931,23 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
     bool cancelled_ GUARDED_BY(mu_) = false;
     bool prefetch_thread_finished_ GUARDED_BY(mu_) = false;
 
+    // Elements waiting for the staging thread, in the order they were read
+    std::deque<StagingElement> staging_queue_ GUARDED_BY(mu_);
+    condition_variable staging_cond_var_;
+    std::unique_ptr<Thread> staging_thread_;
+    // Set if staging an element failed, returned by the next GetNext
+    Status staging_status_ GUARDED_BY(mu_);
+    // Number of elements returned by GetNext
+    int64 num_consumed_ GUARDED_BY(mu_) = 0;
+    // Copies the components of the staged elements to the device
+    std::unique_ptr<thread::ThreadPool> copy_pool_;
+
     std::atomic<int64> slack_us_;
     ResourceMgr* m_resource_mgr{nullptr};
-    const int m_buffer_size{0};
+    // The NGraphEncapsulates fed by our iterator
+    ngraph_bridge::NGraphPrefetchConsumers* consumers_{nullptr};
+    // Elements of the NGraphCacheDataset feeding us, if any
+    ngraph_bridge::NGraphCachedElements* cached_elements_{nullptr};
   };
   const DatasetBase* const input_;
   const int64 buffer_size_;
@@ -528,6 +956,14 @@ class NGraphPrefetchDatasetOp::Dataset : public DatasetBase {
   // execution.
   const int64 slack_period_;
 
+  // Name of the iterator made from this dataset, used to find the
+  // NGraphEncapsulates consuming the prefetched elements
+  const string iterator_name_;
+
+  // Id of the graph the iterator was captured in, iterators of different
+  // graphs may have the same name
+  const int graph_id_;
+
   // Store the resource manager
   ResourceMgr* m_resource_mgr{nullptr};
 };
@@ -549,7 +985,8 @@ void NGraphPrefetchDatasetOp::MakeDataset(OpKernelContext* ctx,
     metrics::RecordTFDataAutotune(kDatasetName);
   }
 
-  *output = new Dataset(ctx, input, buffer_size, slack_period_);
+  *output = new Dataset(ctx, input, buffer_size, slack_period_,
+                        iterator_name_, graph_id_);
 }
 
 namespace {
@@ -54,6 +54,12 @@ class NGraphPrefetchDatasetOp : public UnaryDatasetOpKernel {
     if (ctx->HasAttr("slack_period")) {
       OP_REQUIRES_OK(ctx, ctx->GetAttr("slack_period", &slack_period_));
     }
+    if (ctx->HasAttr("iterator_name")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("iterator_name", &iterator_name_));
+    }
+    if (ctx->HasAttr("graph_id")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("graph_id", &graph_id_));
+    }
   }
 
  protected:
@@ -63,6 +69,11 @@ class NGraphPrefetchDatasetOp : public UnaryDatasetOpKernel {
  private:
   class Dataset;
   int64 slack_period_ = 0;
+  // Iterator made from this dataset, the NGraphEncapsulates fed by it are
+  // the consumers of the prefetched elements
+  string iterator_name_;
+  // Id of the graph the iterator was captured in
+  int graph_id_ = 0;
 };
 
 }  // namespace data
@@ -18,6 +18,9 @@
 #define NGRAPH_PREFETCH_SHARED_DATA_H_
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <map>
 #include <mutex>
 #include <ostream>
 #include <string>
@@ -27,6 +30,8 @@
 
 #include "ngraph/runtime/tensor.hpp"
 
+#include "ngraph_bridge/ngraph_device_prefetch_autotuner.h"
+#include "ngraph_bridge/ngraph_pipelined_tensors.h"
 #include "ngraph_bridge/thread_safe_queue.h"
 
 namespace ng = ngraph;
@@ -38,16 +43,32 @@ namespace ngraph_bridge {
 
 class NGraphPrefetchSharedResouce : public ResourceBase {
  public:
-  explicit NGraphPrefetchSharedResouce(const std::string& ng_enc_op_name,
-                                       const std::string& backend_name,
-                                       int cluster_id, int graph_id)
+  // The prefetcher writes the dataset component prefetched_input_components[i]
+  // to the input tensor prefetched_input_indexes[i] of the NGraphEncapsulate.
+  // At most max_device_depth input tensor bundles are staged at a time, which
+  // bounds both queues
+  explicit NGraphPrefetchSharedResouce(
+      const std::string& ng_enc_op_name, const std::string& backend_name,
+      int cluster_id, int graph_id,
+      const std::vector<int>& prefetched_input_indexes,
+      const std::vector<int>& prefetched_input_components,
+      int max_device_depth)
       : m_ng_enc_op_name(ng_enc_op_name),
         m_backend_name(backend_name),
         m_graph_id(graph_id),
-        m_cluster_id(cluster_id) {}
+        m_cluster_id(cluster_id),
+        m_prefetched_input_indexes(prefetched_input_indexes),
+        m_prefetched_input_components(prefetched_input_components),
+        m_tf_2_ng(max_device_depth),
+        m_ng_2_tf(max_device_depth),
+        m_autotuner(max_device_depth) {}
 
   // Returns a debug string for *this.
-  string DebugString() const override { return "NGraphPrefetchSharedResouce"; }
+  string DebugString() const override {
+    return "NGraphPrefetchSharedResouce of " + m_ng_enc_op_name + " (graph " +
+           std::to_string(m_graph_id) + ", cluster " +
+           std::to_string(m_cluster_id) + ")";
+  }
 
   // Returns memory used by this resource.
   int64 MemoryUsed() const override { return 0; }
@@ -55,71 +76,190 @@ class NGraphPrefetchSharedResouce : public ResourceBase {
   std::string GetBackendName() const { return m_backend_name; }
   int GetGraphId() const { return m_graph_id; }
   int GetClusterId() const { return m_cluster_id; }
+  const std::vector<int>& GetPrefetchedInputIndexes() const {
+    return m_prefetched_input_indexes;
+  }
+  const std::vector<int>& GetPrefetchedInputComponents() const {
+    return m_prefetched_input_components;
+  }
+
+  // Every NGraphEncapsulate that is fed by a prefetched iterator owns one
+  // shared resource, named after the graph, the cluster and the prefetched
+  // input indexes of the encapsulate
+  static std::string ResourceName(int graph_id, int cluster_id,
+                                  const std::vector<int>& input_indexes) {
+    std::string name = "NG_PREFETCH_DATA_" + std::to_string(graph_id) + "_" +
+                       std::to_string(cluster_id);
+    for (int index : input_indexes) {
+      name += "_" + std::to_string(index);
+    }
+    return name;
+  }
 
-  static constexpr const char* RESOURCE_NAME = "NG_PREFETCH_DATA";
   static constexpr const char* CONTAINER_NAME = "NG_PREFETCH_DATA_CONTAINER";
-  static constexpr const char* NGRAPH_TF_USE_PREFETCH =
-      "NGRAPH_TF_USE_PREFETCH";
 
   struct InputTensorBundle {
     int Id;
     std::vector<shared_ptr<ng::runtime::Tensor>> Inputs;
+    // Store of the executable the tensors were allocated for, the Id is
+    // returned to it. The tensors only fit the input shapes of that executable
+    shared_ptr<PipelinedTensorsStore> Store;
+    // Set by the prefetcher once it wrote the element to the Inputs. It does
+    // not if the shapes of the element do not match the tensors
+    bool Staged;
   };
 
+  // Whether the NGraphEncapsulate can run on the tensors of the "ready"
+  // bundle, i.e. the prefetcher wrote the element to them and they were lent
+  // from "store", the store of the executable for the current input shapes.
+  // If not, the set of the bundle goes back to its own store and the element
+  // is to be copied from the TF tensors
+  static bool UseStagedBundle(const InputTensorBundle& ready,
+                              const shared_ptr<PipelinedTensorsStore>& store) {
+    if (ready.Staged && ready.Store == store) {
+      return true;
+    }
+    ready.Store->return_tensors(ready.Id);
+    return false;
+  }
+
   // Adds the given nGraph input tensors to write to
   // This is called by the NGraphEncapOp
-  void AddNextInputTensorBundleForDeviceTransfer(InputTensorBundle next) {
-    m_tf_2_ng.Add(std::move(next));
+  Status AddNextInputTensorBundleForDeviceTransfer(InputTensorBundle next) {
+    return m_tf_2_ng.Add(std::move(next));
   }
 
   // Returns the Input tensors to be used to copy TF tensors to NG device
-  // This will be called by the prefetcher
-  InputTensorBundle GetNextInputTensorBundleForDeviceTransfer() {
-    return std::move(m_tf_2_ng.GetNextAvailable());
+  // This will be called by the prefetcher, which waits at most timeout so
+  // that it can notice when it is cancelled
+  Status GetNextInputTensorBundleForDeviceTransfer(InputTensorBundle* next,
+                                                   absl::Duration timeout) {
+    return m_tf_2_ng.GetNextAvailable(next, timeout);
   }
 
   // Adds the given nGraph input tensors to write to
   // This is called by the prefetcher to add Tensors that are copied
   // from TF tensor and are now ready for the next iteration
-  void AddNextInputTensorBundleReadyForDeviceExecution(InputTensorBundle next) {
-    m_ng_2_tf.Add(std::move(next));
+  Status AddNextInputTensorBundleReadyForDeviceExecution(
+      InputTensorBundle next) {
+    return m_ng_2_tf.Add(std::move(next));
   }
 
   // Returns the Input tensors to be ready to be executed by NG device
   // This will be called by the NGEncOp
-  InputTensorBundle GetNextInputTensorBundleReadyForDeviceExecution() {
-    return std::move(m_ng_2_tf.GetNextAvailable());
+  Status GetNextInputTensorBundleReadyForDeviceExecution(
+      InputTensorBundle* next) {
+    return m_ng_2_tf.GetNextAvailable(next);
   }
 
-  void SetBufferDepth(int depth) {
+  // Called by the prefetcher when it cannot stage anymore, so that the
+  // NGraphEncapsulate waiting for staged tensors gets the error
+  void Terminate(const Status& status) {
+    m_tf_2_ng.Terminate(status);
+    m_ng_2_tf.Terminate(status);
     m_mutex.Lock();
-    // TODO assert m_prefetch_buffer_depth == -1 || m_prefetch_buffer_depth ==
-    // depth
-    // To make sure we never try to set a different depth once it is set
-    m_prefetch_buffer_depth = depth;
+    if (m_status.ok()) {
+      m_status = status;
+    }
     m_cv.SignalAll();
     m_mutex.Unlock();
   }
-  int GetBufferDepth() {
+
+  // The buffer depth is the number of elements the NGraphEncapsulate still
+  // copies from the TF tensors after it registered, because they were read
+  // before the prefetcher saw it. Only the first call sets it
+  void SetBufferDepth(int depth) {
+    m_mutex.Lock();
+    if (m_prefetch_buffer_depth == -1) {
+      m_prefetch_buffer_depth = depth;
+      m_cv.SignalAll();
+    }
+    m_mutex.Unlock();
+  }
+  Status GetBufferDepth(int* depth) {
     // Locking GetBufferDepth till SetBufferDepth is called
     // In case of races where Get is called before Set,
     // We want to ensure Set finishes before Get returns
     m_mutex.ReaderLock();
-    while (m_prefetch_buffer_depth == -1) {
+    while (m_prefetch_buffer_depth == -1 && m_status.ok()) {
       m_cv.Wait(&m_mutex);
     }
+    *depth = m_prefetch_buffer_depth;
+    Status status = m_status;
     m_mutex.ReaderUnlock();
-    return m_prefetch_buffer_depth;
+    return status;
   }
 
   void IncrSkipCount() { m_skip_count++; }
   int GetSkipCount() { return m_skip_count; }
 
+  // Picks the number of input tensor bundles staged on the device
+  NGraphDevicePrefetchAutotuner& GetAutotuner() { return m_autotuner; }
+
+  // Number of input tensor bundles the NGraphEncapsulate has lent to the
+  // prefetcher, i.e. staged or being staged
+  int GetNumStagingSlots() { return m_num_staging_slots; }
+  // Takes a slot if fewer than "depth" are taken, and returns whether it did.
+  // The check and the add are one atomic step, so that concurrent
+  // NGraphEncapsulates never lend more than "depth" bundles
+  bool TryAddStagingSlot(int depth) {
+    int num_slots = m_num_staging_slots.load();
+    while (num_slots < depth) {
+      if (m_num_staging_slots.compare_exchange_weak(num_slots,
+                                                    num_slots + 1)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  // Gives a slot back if more than "depth" are taken, and returns whether it
+  // did
+  bool TryRemoveStagingSlot(int depth) {
+    int num_slots = m_num_staging_slots.load();
+    while (num_slots > depth) {
+      if (m_num_staging_slots.compare_exchange_weak(num_slots,
+                                                    num_slots - 1)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  void RemoveStagingSlot() { m_num_staging_slots--; }
+
+  // Device tensors the prefetcher kept for the elements of an
+  // NGraphCacheDataset, by position of the element in the first epoch. The
+  // i-th tensor is the input prefetched_input_indexes[i]. Later epochs run on
+  // these tensors instead of copying the elements again
+  bool GetCachedInputs(int64 element,
+                       std::vector<shared_ptr<ng::runtime::Tensor>>* inputs) {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    auto itr = m_cached_inputs.find(element);
+    if (itr == m_cached_inputs.end()) {
+      return false;
+    }
+    *inputs = itr->second;
+    return true;
+  }
+  void AddCachedInputs(int64 element,
+                       std::vector<shared_ptr<ng::runtime::Tensor>> inputs,
+                       int64 bytes) {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    if (m_cached_inputs.emplace(element, std::move(inputs)).second) {
+      m_cached_bytes += bytes;
+    }
+  }
+  int64 GetCachedBytes() {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    return m_cached_bytes;
+  }
+
  private:
   const std::string m_ng_enc_op_name;
   const std::string m_backend_name;
   const int m_graph_id;
   const int m_cluster_id;
+  const std::vector<int> m_prefetched_input_indexes;
+  const std::vector<int> m_prefetched_input_components;
 
   // We need to maintain two queues as follows:
   // ----------+------------+------------+------------------------------------+
@@ -147,13 +287,125 @@ class NGraphPrefetchSharedResouce : public ResourceBase {
   ThreadSafeQueue<InputTensorBundle> m_ng_2_tf;
 
   int m_prefetch_buffer_depth{-1};
+  // Set once the prefetcher terminated the queues
+  Status m_status;
   int m_skip_count{0};
 
-  // Mutex and cond var to control m_prefetch_buffer_depth
+  NGraphDevicePrefetchAutotuner m_autotuner;
+  std::atomic<int> m_num_staging_slots{0};
+
+  std::map<int64, std::vector<shared_ptr<ng::runtime::Tensor>>>
+      m_cached_inputs;
+  int64 m_cached_bytes{0};
+  std::mutex m_cache_mutex;
+
+  // Mutex and cond var to control m_prefetch_buffer_depth and m_status
   absl::CondVar m_cv;
   absl::Mutex m_mutex;
 };
 
+// Names of the NGraphPrefetchSharedResouce objects of all the
+// NGraphEncapsulates fed by one iterator. The encapsulates register here when
+// they create their shared resource and the NGraphPrefetchDataset feeding the
+// iterator stages every dataset element for each one of them.
+//
+// The NGraphPrefetchDataset also counts the elements it returned here. An
+// NGraphEncapsulate registers while it runs on the last element it copies
+// from the TF tensors, so it is fed the staged elements from that count on.
+class NGraphPrefetchConsumers : public ResourceBase {
+ public:
+  struct Consumer {
+    std::string shared_resource_name;
+    // Id of the first element to stage, elements are numbered from 0 in the
+    // order they are read from the input
+    int64 first_element;
+  };
+
+  // Returns a debug string for *this.
+  string DebugString() const override { return "NGraphPrefetchConsumers"; }
+
+  // Returns memory used by this resource.
+  int64 MemoryUsed() const override { return 0; }
+
+  // Iterators of different graphs may have the same name
+  static std::string ResourceName(int graph_id,
+                                  const std::string& iterator_name) {
+    return "NG_PREFETCH_CONSUMERS_" + std::to_string(graph_id) + "_" +
+           iterator_name;
+  }
+
+  void AddConsumer(const std::string& shared_resource_name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_consumers.push_back({shared_resource_name, m_num_consumed});
+  }
+
+  std::vector<Consumer> GetConsumers() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_consumers;
+  }
+
+  void SetNumConsumed(int64 num_consumed) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_num_consumed = num_consumed;
+  }
+
+ private:
+  std::vector<Consumer> m_consumers;
+  int64 m_num_consumed{0};
+  std::mutex m_mutex;
+};
+
+// Position in the first epoch of the elements an NGraphCacheDataset returned
+// to the NGraphPrefetchDataset of one iterator, in the same order. The
+// prefetcher takes them one by one as it stages the elements, to find the
+// device tensors kept for each of them. -1 means the element is not cached.
+class NGraphCachedElements : public ResourceBase {
+ public:
+  // Returns a debug string for *this.
+  string DebugString() const override { return "NGraphCachedElements"; }
+
+  // Returns memory used by this resource.
+  int64 MemoryUsed() const override { return 0; }
+
+  // Iterators of different graphs may have the same name
+  static std::string ResourceName(int graph_id,
+                                  const std::string& iterator_name) {
+    return "NG_CACHED_ELEMENTS_" + std::to_string(graph_id) + "_" +
+           iterator_name;
+  }
+
+  void Push(int64 element) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_elements.push_back(element);
+  }
+
+  // Returns -1 if no NGraphCacheDataset feeds the iterator
+  int64 Pop() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_elements.empty()) {
+      return -1;
+    }
+    int64 element = m_elements.front();
+    m_elements.pop_front();
+    return element;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_elements.clear();
+  }
+
+  // Memory budget of the device tensors kept for each NGraphEncapsulate,
+  // 0 means unlimited
+  void SetMaxBytes(int64 max_bytes) { m_max_bytes = max_bytes; }
+  int64 GetMaxBytes() { return m_max_bytes; }
+
+ private:
+  std::deque<int64> m_elements;
+  std::atomic<int64> m_max_bytes{0};
+  std::mutex m_mutex;
+};
+
 }  // namespace ngraph_bridge
 
 }  // namespace tensorflow
@@ -0,0 +1,134 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+
+#include "logging/ngraph_log.h"
+#include "ngraph_bridge/ngraph_replace_cache_dataset.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// Returns the input "index" of "node" if it is a "type" node that feeds
+// nothing else, nullptr otherwise
+static Node* GetSoleInputOfType(Node* node, int index, const string& type) {
+  Node* input;
+  if (!node->input_node(index, &input).ok() || input->type_string() != type) {
+    return nullptr;
+  }
+  for (auto edge : input->out_edges()) {
+    if (!edge->IsControlEdge() && edge->dst() != node) {
+      return nullptr;
+    }
+  }
+  return input;
+}
+
+Status ReplaceCacheDataset(Graph* graph, Node* prefetch_node,
+                           const string& iterator_name, int graph_id) {
+  if (std::getenv("NGRAPH_TF_USE_DEVICE_CACHE") == nullptr) {
+    return Status::OK();
+  }
+
+  Node* repeat_node = GetSoleInputOfType(prefetch_node, 0, "RepeatDataset");
+  if (repeat_node == nullptr) {
+    return Status::OK();
+  }
+  Node* cache_node = GetSoleInputOfType(repeat_node, 0, "CacheDataset");
+  if (cache_node == nullptr) {
+    return Status::OK();
+  }
+
+  // Only the in-memory cache, the file cache is left to TF
+  Node* filename_node;
+  TF_RETURN_IF_ERROR(cache_node->input_node(1, &filename_node));
+  if (filename_node->type_string() != "Const") {
+    return Status::OK();
+  }
+  Tensor filename;
+  TF_RETURN_IF_ERROR(GetNodeAttr(filename_node->attrs(), "value", &filename));
+  if (filename.dtype() != DT_STRING || filename.NumElements() != 1 ||
+      !filename.flat<string>()(0).empty()) {
+    return Status::OK();
+  }
+
+  const Edge* input_edge;
+  TF_RETURN_IF_ERROR(cache_node->input_edge(0, &input_edge));
+  const Edge* count_edge;
+  TF_RETURN_IF_ERROR(repeat_node->input_edge(1, &count_edge));
+
+  std::vector<DataType> output_types;
+  TF_RETURN_IF_ERROR(
+      GetNodeAttr(repeat_node->attrs(), "output_types", &output_types));
+  std::vector<PartialTensorShape> output_shapes;
+  TF_RETURN_IF_ERROR(
+      GetNodeAttr(repeat_node->attrs(), "output_shapes", &output_shapes));
+
+  int64 max_bytes = 0;
+  const char* max_bytes_env = std::getenv("NGRAPH_TF_DEVICE_CACHE_MAX_BYTES");
+  if (max_bytes_env != nullptr) {
+    max_bytes = std::max<int64>(0, atoll(max_bytes_env));
+  }
+  bool shuffle = std::getenv("NGRAPH_TF_DEVICE_CACHE_SHUFFLE") != nullptr;
+
+  Node* replacement;
+  TF_RETURN_IF_ERROR(
+      NodeBuilder(graph->NewName("NGraph" + cache_node->name()),
+                  "NGraphCacheDataset")
+          .Input(input_edge->src(), input_edge->src_output())
+          .Input(count_edge->src(), count_edge->src_output())
+          .Attr("output_types", output_types)
+          .Attr("output_shapes", output_shapes)
+          .Attr("max_bytes", max_bytes)
+          .Attr("shuffle", shuffle)
+          .Attr("iterator_name", iterator_name)
+          .Attr("graph_id", graph_id)
+          .Device(repeat_node->assigned_device_name())
+          .Finalize(graph, &replacement));
+  replacement->set_assigned_device_name(repeat_node->assigned_device_name());
+
+  // Keep the control dependencies of the replaced nodes
+  for (auto node : {cache_node, repeat_node}) {
+    for (auto edge : node->in_edges()) {
+      if (edge->IsControlEdge()) {
+        graph->AddControlEdge(edge->src(), replacement);
+      }
+    }
+  }
+
+  const Edge* prefetch_input_edge;
+  TF_RETURN_IF_ERROR(prefetch_node->input_edge(0, &prefetch_input_edge));
+  graph->RemoveEdge(prefetch_input_edge);
+  graph->AddEdge(replacement, 0, prefetch_node, 0);
+
+  NGRAPH_VLOG(4) << "Replaced " << cache_node->name() << " and "
+                 << repeat_node->name() << " with " << replacement->name();
+  graph->RemoveNode(repeat_node);
+  graph->RemoveNode(cache_node);
+  return Status::OK();
+}
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
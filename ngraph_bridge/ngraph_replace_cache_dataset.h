@@ -0,0 +1,42 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#ifndef NGRAPH_TF_BRIDGE_REPLACE_CACHE_DATASET_H_
+#define NGRAPH_TF_BRIDGE_REPLACE_CACHE_DATASET_H_
+#pragma once
+
+#include "tensorflow/core/graph/graph.h"
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+// If NGRAPH_TF_USE_DEVICE_CACHE is set and the input of prefetch_node is
+// RepeatDataset(CacheDataset(input, filename="")), replaces these two nodes
+// with an NGraphCacheDataset so that the elements stay on the device across
+// the epochs.
+//
+// NGRAPH_TF_DEVICE_CACHE_MAX_BYTES sets the memory budget (default 0, i.e.
+// unlimited) and NGRAPH_TF_DEVICE_CACHE_SHUFFLE shuffles the replayed epochs.
+// The iterator of the prefetch_node, captured in the graph graph_id, names
+// the positions the NGraphCacheDataset shares with the NGraphPrefetchDataset
+Status ReplaceCacheDataset(Graph* graph, Node* prefetch_node,
+                           const string& iterator_name, int graph_id);
+
+}  // namespace ngraph_bridge
+}  // namespace tensorflow
+
+#endif  // NGRAPH_TF_BRIDGE_REPLACE_CACHE_DATASET_H_
@@ -27,6 +27,7 @@
 #include "ngraph_bridge/ngraph_backend_manager.h"
 #include "ngraph_bridge/ngraph_capture_variables.h"
 #include "ngraph_bridge/ngraph_cluster_manager.h"
+#include "ngraph_bridge/ngraph_clustering_cache.h"
 #include "ngraph_bridge/ngraph_deassign_clusters.h"
 #include "ngraph_bridge/ngraph_encapsulate_clusters.h"
 #include "ngraph_bridge/ngraph_enter_prefetch_in_catalog.h"
@@ -151,9 +152,15 @@ class NGraphVariableCapturePass : public NGraphRewritePass {
     }
 
     // Do variable capture then, if requested, dump the graphs.
+    // The input pipelines are prefetched on the device if the session asks
+    // for it
     std::set<string> skip_these_nodes = {};
-    TF_RETURN_IF_ERROR(
-        CaptureVariables(options.graph->get(), skip_these_nodes));
+    bool replace_prefetch =
+        options.session_options != nullptr
+            ? config::IsPrefetchEnabled(options.session_options->config)
+            : config::IsPrefetchEnabled();
+    TF_RETURN_IF_ERROR(CaptureVariables(options.graph->get(), skip_these_nodes,
+                                        replace_prefetch, idx));
     if (DumpCapturedGraphs()) {
       DumpGraphs(options, idx, "captured", "Graph With Variables Captured");
     }
@@ -242,36 +249,54 @@ class NGraphEncapsulationPass : public NGraphRewritePass {
 
     // Now Process the Graph
 
-    // 1. Mark for clustering then, if requested, dump the graphs.
+    // Steps 1. to 4. are skipped if the clustering of this graph is cached
     std::set<string> skip_these_nodes = {};
-    TF_RETURN_IF_ERROR(MarkForClustering(options.graph->get(), skip_these_nodes,
-                                         backend_creation_string));
-    if (DumpMarkedGraphs()) {
-      DumpGraphs(options, idx, "marked", "Graph Marked for Clustering");
+    uint64 clustering_key = 0;
+    bool clustering_cached = false;
+    if (NGraphClusteringCache::IsEnabled()) {
+      clustering_key = NGraphClusteringCache::ComputeKey(
+          *options.graph->get(), backend_creation_string, config_map,
+          skip_these_nodes);
+      TF_RETURN_IF_ERROR(NGraphClusteringCache::Lookup(
+          clustering_key, idx, options.graph, &clustering_cached));
     }
 
-    // 2. Assign clusters then, if requested, dump the graphs.
-    TF_RETURN_IF_ERROR(AssignClusters(options.graph->get()));
-    if (DumpClusteredGraphs()) {
-      DumpGraphs(options, idx, "clustered", "Graph with Clusters Assigned");
-    }
+    if (!clustering_cached) {
+      // 1. Mark for clustering then, if requested, dump the graphs.
+      TF_RETURN_IF_ERROR(MarkForClustering(
+          options.graph->get(), skip_these_nodes, backend_creation_string));
+      if (DumpMarkedGraphs()) {
+        DumpGraphs(options, idx, "marked", "Graph Marked for Clustering");
+      }
 
-    // 3. Deassign trivial clusters then, if requested, dump the graphs.
-    TF_RETURN_IF_ERROR(DeassignClusters(options.graph->get()));
-    if (DumpDeclusteredGraphs()) {
-      DumpGraphs(options, idx, "declustered",
-                 "Graph with Trivial Clusters De-Assigned");
-    }
+      // 2. Assign clusters then, if requested, dump the graphs.
+      TF_RETURN_IF_ERROR(AssignClusters(options.graph->get()));
+      if (DumpClusteredGraphs()) {
+        DumpGraphs(options, idx, "clustered", "Graph with Clusters Assigned");
+      }
 
-    // 4. Encapsulate clusters then, if requested, dump the graphs.
-    FunctionDefLibrary* fdeflib_new = new FunctionDefLibrary();
-    TF_RETURN_IF_ERROR(EncapsulateClusters(options.graph->get(), idx,
-                                           fdeflib_new, config_map, {0, {}}));
-    // TODO: not using fdeflib_new in this path. Only grappler path uses it
-    delete (fdeflib_new);
-    if (DumpEncapsulatedGraphs()) {
-      DumpGraphs(options, idx, "encapsulated",
-                 "Graph with Clusters Encapsulated");
+      // 3. Deassign trivial clusters then, if requested, dump the graphs.
+      TF_RETURN_IF_ERROR(DeassignClusters(options.graph->get()));
+      if (DumpDeclusteredGraphs()) {
+        DumpGraphs(options, idx, "declustered",
+                   "Graph with Trivial Clusters De-Assigned");
+      }
+
+      // 4. Encapsulate clusters then, if requested, dump the graphs.
+      FunctionDefLibrary* fdeflib_new = new FunctionDefLibrary();
+      TF_RETURN_IF_ERROR(EncapsulateClusters(options.graph->get(), idx,
+                                             fdeflib_new, config_map, {0, {}}));
+      // TODO: not using fdeflib_new in this path. Only grappler path uses it
+      delete (fdeflib_new);
+      if (DumpEncapsulatedGraphs()) {
+        DumpGraphs(options, idx, "encapsulated",
+                   "Graph with Clusters Encapsulated");
+      }
+
+      if (NGraphClusteringCache::IsEnabled()) {
+        TF_RETURN_IF_ERROR(NGraphClusteringCache::Insert(
+            clustering_key, *options.graph->get()));
+      }
     }
 
     // 5. Rewrite for tracking then, if requested, dump the graphs.
@@ -14,6 +14,9 @@
  * limitations under the License.
  *******************************************************************************/
 
+#include <algorithm>
+#include <iterator>
+
 #include "ngraph_bridge/ngraph_tensor_manager.h"
 #include "ngraph_bridge/ngraph_catalog.h"
 #include "ngraph_bridge/ngraph_utils.h"
@@ -76,6 +79,14 @@ void NGraphTensorManager::Initialize() {
     sort(m_prefetched_input_indexes.begin(), m_prefetched_input_indexes.end());
   }
 
+  if (NGraphCatalog::ExistsInPrefetchIteratorMap(m_ng_encap_graph_id,
+                                                 m_ng_encap_node_name)) {
+    m_prefetch_iterator_name = NGraphCatalog::GetPrefetchIterator(
+        m_ng_encap_graph_id, m_ng_encap_node_name);
+    m_prefetch_iterator_graph_id = NGraphCatalog::GetPrefetchIteratorGraphId(
+        m_ng_encap_graph_id, m_ng_encap_node_name);
+  }
+
   // the prefetched input indexes will also be pipelined
   for (int pref_index : m_prefetched_input_indexes) {
     auto position = std::find(m_pipelined_input_indexes.begin(),
@@ -87,7 +98,23 @@ void NGraphTensorManager::Initialize() {
     }
     m_pipelined_input_indexes_prefetched.push_back(
         position - m_pipelined_input_indexes.begin());
+
+    if (!NGraphCatalog::ExistsInPrefetchedInputComponentMap(
+            m_ng_encap_graph_id, m_ng_encap_node_name, pref_index)) {
+      throw std::runtime_error("Dataset component of prefetched input index " +
+                               to_string(pref_index) + " not found.");
+    }
+    m_prefetched_input_components.push_back(
+        NGraphCatalog::GetPrefetchedInputComponent(
+            m_ng_encap_graph_id, m_ng_encap_node_name, pref_index));
   }
+
+  // both are sorted
+  set_difference(m_pipelined_input_indexes.begin(),
+                 m_pipelined_input_indexes.end(),
+                 m_prefetched_input_indexes.begin(),
+                 m_prefetched_input_indexes.end(),
+                 back_inserter(m_pipelined_not_prefetched_input_indexes));
 }
 
 //---------------------------------------------------------------------------
@@ -71,6 +71,25 @@ class NGraphTensorManager {
     return m_pipelined_input_indexes_prefetched;
   }
 
+  // The dataset component (IteratorGetNext output) feeding each of the
+  // prefetched inputs, in the order of GetPrefetchedInputIndexes()
+  const vector<int>& GetPrefetchedInputComponents() {
+    return m_prefetched_input_components;
+  }
+
+  // Pipelined inputs that still need to be copied from the TF tensors when
+  // the prefetched inputs were already written to the device
+  const vector<int>& GetPipelinedButNotPrefetchedInputIndexes() {
+    return m_pipelined_not_prefetched_input_indexes;
+  }
+
+  // Name of the iterator feeding the prefetched inputs, empty if there are
+  // none
+  const string& GetPrefetchIteratorName() { return m_prefetch_iterator_name; }
+
+  // Id of the graph the iterator was captured in, which scopes its name
+  int GetPrefetchIteratorGraphId() { return m_prefetch_iterator_graph_id; }
+
  private:
   void Initialize();
   string m_ng_encap_node_name;
@@ -89,8 +108,12 @@ class NGraphTensorManager {
   vector<int> m_pipelined_output_indexes;
   vector<int> m_pipelined_input_indexes_prefetched;
 
-  //[TODO] Book-keeping for prefetched inputs
+  // Book-keeping for prefetched inputs
   vector<int> m_prefetched_input_indexes;
+  vector<int> m_prefetched_input_components;
+  vector<int> m_pipelined_not_prefetched_input_indexes;
+  string m_prefetch_iterator_name;
+  int m_prefetch_iterator_graph_id = 0;
 };
 
 }  // namespace ngraph_bridge
@@ -288,6 +288,27 @@ Status TFTensorShapeToNGraphShape(const TensorShape& tf_shape,
   return Status::OK();
 }
 
+std::shared_ptr<ngraph::runtime::Executable> MakeRemovableExecutable(
+    ngraph::runtime::Backend* op_backend,
+    const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
+    std::function<void(const std::shared_ptr<ngraph::runtime::Executable>&)>
+        on_remove) {
+  if (ng_exec == nullptr) {
+    return nullptr;
+  }
+  // The deleter holds the executable returned by the backend, the wrapper
+  // only shares its address
+  std::shared_ptr<ngraph::runtime::Executable> compiled_ng_exec = ng_exec;
+  return std::shared_ptr<ngraph::runtime::Executable>(
+      ng_exec.get(),
+      [op_backend, compiled_ng_exec, on_remove](ngraph::runtime::Executable*) {
+        if (on_remove != nullptr) {
+          on_remove(compiled_ng_exec);
+        }
+        op_backend->remove_compiled_function(compiled_ng_exec);
+      });
+}
+
 void print_node_histogram(const std::unordered_map<string, int>& histogram,
                           bool sorted) {
   int histogram_size = histogram.size();
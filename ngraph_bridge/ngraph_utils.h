@@ -17,6 +17,7 @@
 #define NGRAPH_TF_BRIDGE_UTILS_H_
 
 #include <fstream>
+#include <functional>
 #include <ostream>
 #include <sstream>
 
@@ -28,6 +29,7 @@
 
 #include "ngraph/event_tracing.hpp"
 #include "ngraph/ngraph.hpp"
+#include "ngraph/runtime/backend.hpp"
 #include "ngraph/serializer.hpp"
 
 #include "logging/ngraph_log.h"
@@ -272,6 +274,17 @@ Status TFDataTypeToNGraphElementType(DataType tf_dt,
 Status TFTensorShapeToNGraphShape(const TensorShape& tf_shape,
                                   ngraph::Shape* ng_shape);
 
+// Wraps an executable compiled on "op_backend" so that it is removed from the
+// backend (remove_compiled_function) only once the last copy of the returned
+// pointer is dropped. Executable caches hand out copies to the steps running
+// them, so that evicting an executable does not remove it under a running
+// step. "on_remove" (if set) is called just before the removal.
+std::shared_ptr<ngraph::runtime::Executable> MakeRemovableExecutable(
+    ngraph::runtime::Backend* op_backend,
+    const std::shared_ptr<ngraph::runtime::Executable>& ng_exec,
+    std::function<void(const std::shared_ptr<ngraph::runtime::Executable>&)>
+        on_remove = nullptr);
+
 // Returns an ArraySlice containing all TensorFlow dtypes supported by the
 // nGraph bridge.
 const gtl::ArraySlice<DataType>& NGraphDTypes();
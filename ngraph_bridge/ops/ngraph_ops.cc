@@ -56,6 +56,8 @@ REGISTER_OP("NGraphPrefetchDataset")
     .Attr("output_types: list(type) >= 1")
     .Attr("output_shapes: list(shape) >= 1")
     .Attr("slack_period: int = 0")
+    .Attr("iterator_name: string = ''")
+    .Attr("graph_id: int = 0")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
       shape_inference::ShapeHandle unused;
       // buffer_size should be a scalar.
@@ -63,5 +65,26 @@ REGISTER_OP("NGraphPrefetchDataset")
       return shape_inference::ScalarShape(c);
     });
 
+// Fuses an in-memory CacheDataset and the RepeatDataset after it, so that
+// the NGraphPrefetchDataset reading from it can keep the elements on the
+// device for the later epochs
+REGISTER_OP("NGraphCacheDataset")
+    .Input("input_dataset: variant")
+    .Input("count: int64")
+    .Output("handle: variant")
+    .Attr("output_types: list(type) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .Attr("max_bytes: int = 0")
+    .Attr("shuffle: bool = false")
+    .Attr("seed: int = 0")
+    .Attr("iterator_name: string = ''")
+    .Attr("graph_id: int = 0")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // count should be a scalar.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      return shape_inference::ScalarShape(c);
+    });
+
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
\ No newline at end of file
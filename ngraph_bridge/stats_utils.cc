@@ -57,6 +57,11 @@ ABSL_CONST_INIT const char kDroppedElements[] = "dropped_elements";
 ABSL_CONST_INIT const char kFeaturesCount[] = "features_count";
 ABSL_CONST_INIT const char kFeatureValuesCount[] = "feature_values_count";
 ABSL_CONST_INIT const char kExamplesCount[] = "examples_count";
+ABSL_CONST_INIT const char kDeviceBufferDepth[] = "device_buffer_depth";
+ABSL_CONST_INIT const char kProducerStallTime[] = "producer_stall_time";
+ABSL_CONST_INIT const char kConsumerStallTime[] = "consumer_stall_time";
+ABSL_CONST_INIT const char kStagingThroughput[] = "staging_throughput";
+ABSL_CONST_INIT const char kStagingQueueSize[] = "staging_queue_size";
 
 string ExecutionTimeHistogramName(const string& prefix) {
   return strings::StrCat(prefix, kDelimiter, kExecutionTime);
@@ -94,6 +99,26 @@ string FeatureValueHistogramName(const string& prefix) {
   return strings::StrCat(prefix, kDelimiter, kFeatureValuesCount);
 }
 
+string DeviceBufferDepthScalarName(const string& prefix) {
+  return strings::StrCat(prefix, kDelimiter, kDeviceBufferDepth);
+}
+
+string ProducerStallTimeScalarName(const string& prefix) {
+  return strings::StrCat(prefix, kDelimiter, kProducerStallTime);
+}
+
+string ConsumerStallTimeScalarName(const string& prefix) {
+  return strings::StrCat(prefix, kDelimiter, kConsumerStallTime);
+}
+
+string StagingThroughputScalarName(const string& prefix) {
+  return strings::StrCat(prefix, kDelimiter, kStagingThroughput);
+}
+
+string StagingQueueSizeScalarName(const string& prefix) {
+  return strings::StrCat(prefix, kDelimiter, kStagingQueueSize);
+}
+
 }  // namespace stats_utils
 }  // namespace data
 }  // namespace tensorflow
@@ -57,6 +57,11 @@ extern const char kDroppedElements[];
 extern const char kFeaturesCount[];
 extern const char kFeatureValuesCount[];
 extern const char kExamplesCount[];
+extern const char kDeviceBufferDepth[];
+extern const char kProducerStallTime[];
+extern const char kConsumerStallTime[];
+extern const char kStagingThroughput[];
+extern const char kStagingQueueSize[];
 
 // Name for tf.data function execution time (in ns) histogram metrics.
 string ExecutionTimeHistogramName(const string& prefix);
@@ -87,6 +92,26 @@ string FeatureHistogramName(const string& prefix);
 // Name for feature-values count histogram metrics.
 string FeatureValueHistogramName(const string& prefix);
 
+// Name for device buffer depth (number of elements staged on the device ahead
+// of an NGraphEncapsulate) scalar metrics.
+string DeviceBufferDepthScalarName(const string& prefix);
+
+// Name for the total time (in us) the prefetcher waited for a free device
+// buffer scalar metrics.
+string ProducerStallTimeScalarName(const string& prefix);
+
+// Name for the total time (in us) the NGraphEncapsulate waited for a staged
+// element scalar metrics.
+string ConsumerStallTimeScalarName(const string& prefix);
+
+// Name for device staging throughput (bytes copied to the device per second)
+// scalar metrics.
+string StagingThroughputScalarName(const string& prefix);
+
+// Name for staging queue size (number of elements read from the input and
+// waiting to be staged on the device) scalar metrics.
+string StagingQueueSizeScalarName(const string& prefix);
+
 }  // namespace stats_utils
 }  // namespace data
 }  // namespace tensorflow
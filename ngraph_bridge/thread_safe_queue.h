@@ -18,47 +18,126 @@
 #define THREAD_SAFE_QUEUE_H_
 #pragma once
 
-#include <queue>
+#include <algorithm>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
 
 using namespace std;
 namespace tensorflow {
 namespace ngraph_bridge {
 
+// Queue passing items between threads, kept in a ring buffer.
+//
+// With a capacity, Add blocks while the queue is full so that the producer
+// cannot run ahead of the consumers. A capacity of 0 makes the queue
+// unbounded, the ring buffer then grows as needed.
+//
+// Add and GetNextAvailable wake a single waiter, as every item (or free slot)
+// can only be taken by one of them. Terminate wakes all the waiters, they and
+// all later calls return the status passed to Terminate.
 template <typename T>
 class ThreadSafeQueue {
  public:
-  // Return T and a status thing so that in case or termination,
-  // caller can check
-  // TODO
-  T GetNextAvailable() {
-    m_mutex.Lock();
-    while (m_queue.empty()) {
-      m_cv.Wait(&m_mutex);
+  explicit ThreadSafeQueue(size_t capacity = 0) : m_capacity(capacity) {
+    m_ring.resize(std::max<size_t>(capacity, 1));
+  }
+
+  // Waits for an item
+  Status GetNextAvailable(T* item) {
+    absl::MutexLock lock(&m_mutex);
+    while (m_size == 0 && m_status.ok()) {
+      m_not_empty.Wait(&m_mutex);
     }
+    return PopLocked(item);
+  }
 
-    T next = std::move(m_queue.front());
-    m_queue.pop();
-    m_mutex.Unlock();
-    return next;
+  // Waits for an item for at most timeout, returns DeadlineExceeded if there
+  // is none by then
+  Status GetNextAvailable(T* item, absl::Duration timeout) {
+    absl::MutexLock lock(&m_mutex);
+    absl::Time deadline = absl::Now() + timeout;
+    while (m_size == 0 && m_status.ok()) {
+      if (m_not_empty.WaitWithDeadline(&m_mutex, deadline) && m_size == 0 &&
+          m_status.ok()) {
+        return errors::DeadlineExceeded("No item available in the queue");
+      }
+    }
+    return PopLocked(item);
   }
 
-  void Add(T item) {
-    m_mutex.Lock();
-    m_queue.push(std::move(item));
-    m_cv.SignalAll();
-    m_mutex.Unlock();
+  // Waits for a free slot if the queue is bounded
+  Status Add(T item) {
+    absl::MutexLock lock(&m_mutex);
+    while (m_capacity > 0 && m_size == m_capacity && m_status.ok()) {
+      m_not_full.Wait(&m_mutex);
+    }
+    if (!m_status.ok()) {
+      return m_status;
+    }
+    if (m_size == m_ring.size()) {
+      GrowLocked();
+    }
+    m_ring[(m_head + m_size) % m_ring.size()] = std::move(item);
+    m_size++;
+    m_not_empty.Signal();
+    return Status::OK();
   }
 
-  void Terminate() {
-    // TODO
-    //
+  // Unblocks all the waiters, the items left in the queue are dropped
+  void Terminate(const Status& status = errors::Cancelled(
+                     "ThreadSafeQueue terminated")) {
+    absl::MutexLock lock(&m_mutex);
+    if (!m_status.ok()) {
+      return;
+    }
+    m_status = status.ok() ? errors::Cancelled("ThreadSafeQueue terminated")
+                           : status;
+    m_not_empty.SignalAll();
+    m_not_full.SignalAll();
   }
 
+  size_t Size() {
+    absl::MutexLock lock(&m_mutex);
+    return m_size;
+  }
+
+  size_t Capacity() const { return m_capacity; }
+
  private:
-  queue<T> m_queue;
-  absl::CondVar m_cv;
+  // The *Locked functions are called with m_mutex held
+  Status PopLocked(T* item) {
+    if (!m_status.ok()) {
+      return m_status;
+    }
+    *item = std::move(m_ring[m_head]);
+    m_head = (m_head + 1) % m_ring.size();
+    m_size--;
+    m_not_full.Signal();
+    return Status::OK();
+  }
+
+  // Only unbounded queues grow
+  void GrowLocked() {
+    vector<T> ring(m_ring.size() * 2);
+    for (size_t i = 0; i < m_size; i++) {
+      ring[i] = std::move(m_ring[(m_head + i) % m_ring.size()]);
+    }
+    m_ring.swap(ring);
+    m_head = 0;
+  }
+
+  const size_t m_capacity;
+  vector<T> m_ring;
+  // Index of the oldest item in m_ring and number of items
+  size_t m_head{0};
+  size_t m_size{0};
+  Status m_status;
+  absl::CondVar m_not_empty;
+  absl::CondVar m_not_full;
   absl::Mutex m_mutex;
 };
 
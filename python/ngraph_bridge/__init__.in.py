@@ -48,6 +48,8 @@ __all__ = [
     'is_logging_placement', '__version__', 'cxx11_abi_flag'
     'is_grappler_enabled', 'update_config', 'are_variables_enabled',
     'set_disabled_ops', 'get_disabled_ops', 'is_distributed_enabled',
+    'get_executable_cache_stats', 'enable_prefetch', 'disable_prefetch',
+    'is_prefetch_enabled',
 ]
 
 ext = 'dylib' if system() == 'Darwin' else 'so'
@@ -134,6 +136,8 @@ if ngraph_classic_loaded:
     ngraph_bridge_lib.ngraph_tf_are_variables_enabled.restype = ctypes.c_bool
     ngraph_bridge_lib.ngraph_set_disabled_ops.argtypes = [ctypes.c_char_p]
     ngraph_bridge_lib.ngraph_get_disabled_ops.restype = ctypes.c_char_p
+    ngraph_bridge_lib.ngraph_get_executable_cache_stats.restype = ctypes.c_char_p
+    ngraph_bridge_lib.ngraph_is_prefetch_enabled.restype = ctypes.c_bool
 
     try:
         importlib.import_module('plaidml.settings')
@@ -246,6 +250,18 @@ if ngraph_classic_loaded:
     def get_disabled_ops():
         return ngraph_bridge_lib.ngraph_get_disabled_ops()
 
+    def get_executable_cache_stats():
+        return ngraph_bridge_lib.ngraph_get_executable_cache_stats().decode("utf-8")
+
+    def enable_prefetch():
+        ngraph_bridge_lib.ngraph_enable_prefetch()
+
+    def disable_prefetch():
+        ngraph_bridge_lib.ngraph_disable_prefetch()
+
+    def is_prefetch_enabled():
+        return ngraph_bridge_lib.ngraph_is_prefetch_enabled()
+
     def is_distributed_enabled():
         return ngraph_bridge_lib.ngraph_tf_is_distributed_enabled()
 
@@ -14,7 +14,13 @@
  * limitations under the License.
  *******************************************************************************/
 
+#include <atomic>
+#include <cmath>
+#include <thread>
+
 #include "gtest/gtest.h"
+#include "tensorflow/cc/client/client_session.h"
+#include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/graph/node_builder.h"
 
 #include "ngraph_bridge/ngraph_backend_manager.h"
@@ -145,8 +151,10 @@ TEST(EncapsulateOp, AllocateNGInputTensors) {
 
   std::vector<shared_ptr<ng::runtime::Tensor>> ng_inputs;
 
-  ASSERT_OK(ng_encap_impl.AllocateNGInputTensors(input_tensors, ng_exec, {},
-                                                 op_backend, ng_inputs));
+  auto io_cache_slot = ng_encap_impl.AcquireIOCacheSlot(ng_exec);
+  ASSERT_OK(ng_encap_impl.AllocateNGInputTensors(
+      input_tensors, ng_exec, {}, io_cache_slot, op_backend, ng_inputs));
+  ng_encap_impl.ReleaseIOCacheSlot(io_cache_slot);
   BackendManager::ReleaseBackend("CPU");
 }
 
@@ -186,11 +194,292 @@ TEST(EncapsulateOp, AllocateNGOutputTensors) {
   }
   std::vector<shared_ptr<ng::runtime::Tensor>> ng_outputs;
 
-  ASSERT_OK(ng_encap_impl.AllocateNGOutputTensors(output_tensors, ng_exec, {},
-                                                  op_backend, ng_outputs));
+  auto io_cache_slot = ng_encap_impl.AcquireIOCacheSlot(ng_exec);
+  ASSERT_OK(ng_encap_impl.AllocateNGOutputTensors(
+      output_tensors, ng_exec, {}, io_cache_slot, op_backend, ng_outputs));
+  ng_encap_impl.ReleaseIOCacheSlot(io_cache_slot);
+
+  BackendManager::ReleaseBackend("CPU");
+}
+
+// Gets an executable of the (empty) cluster graph, cached by ng_encap_impl
+static void GetCachedNgExecutable(
+    NGraphEncapsulateImpl& ng_encap_impl, const TensorShape& shape,
+    ng::runtime::Backend* op_backend,
+    std::shared_ptr<ngraph::runtime::Executable>& ng_exec) {
+  std::vector<tensorflow::TensorShape> input_shapes;
+  std::vector<tensorflow::Tensor> input_tensors{Tensor(DT_FLOAT, shape)};
+  std::vector<const Tensor*> static_input_map;
+  ng_encap_impl.ResizeStaticInputVector(1);
+  ng_encap_impl.SetStaticInputVector(0, false);
+  ASSERT_OK(ng_encap_impl.GetNgExecutable(
+      input_tensors, input_shapes, static_input_map, op_backend, ng_exec));
+}
+
+// Test: Concurrent steps of the same executable get their own I/O cache slots
+TEST(EncapsulateOp, AcquireIOCacheSlot) {
+  NGraphEncapsulateImpl ng_encap_impl;
+  ng_encap_impl.SetOpBackend("CPU");
+  ASSERT_OK(BackendManager::CreateBackend(ng_encap_impl.GetOpBackend()));
+  ng::runtime::Backend* op_backend;
+  op_backend = BackendManager::GetBackend(ng_encap_impl.GetOpBackend());
+  std::shared_ptr<ngraph::runtime::Executable> ng_exec;
+  GetCachedNgExecutable(ng_encap_impl, TensorShape({2}), op_backend, ng_exec);
+
+  auto first_slot = ng_encap_impl.AcquireIOCacheSlot(ng_exec);
+  auto second_slot = ng_encap_impl.AcquireIOCacheSlot(ng_exec);
+  ASSERT_NE(first_slot, second_slot);
+  ASSERT_TRUE(first_slot->primary);
+  ASSERT_FALSE(second_slot->primary);
+
+  // A released slot is handed out again, the primary one first
+  ng_encap_impl.ReleaseIOCacheSlot(first_slot);
+  ASSERT_EQ(ng_encap_impl.AcquireIOCacheSlot(ng_exec), first_slot);
+  ng_encap_impl.ReleaseIOCacheSlot(second_slot);
+  ng_encap_impl.ReleaseIOCacheSlot(first_slot);
+  ASSERT_EQ(ng_encap_impl.AcquireIOCacheSlot(ng_exec), first_slot);
+  ng_encap_impl.ReleaseIOCacheSlot(first_slot);
+
+  ng_encap_impl.ClearExecMaps();
+  BackendManager::ReleaseBackend("CPU");
+}
 
+// Test: A step still running an evicted executable keeps it (and its slot)
+// alive, without re-creating cache entries for it
+TEST(EncapsulateOp, AcquireIOCacheSlotEvicted) {
+  NGraphEncapsulateImpl ng_encap_impl;
+  ng_encap_impl.SetCacheDepth(ng_encap_impl.GetInstanceId(), 1, 0);
+  ng_encap_impl.SetOpBackend("CPU");
+  ASSERT_OK(BackendManager::CreateBackend(ng_encap_impl.GetOpBackend()));
+  ng::runtime::Backend* op_backend;
+  op_backend = BackendManager::GetBackend(ng_encap_impl.GetOpBackend());
+  std::shared_ptr<ngraph::runtime::Executable> ng_exec;
+  GetCachedNgExecutable(ng_encap_impl, TensorShape({2}), op_backend, ng_exec);
+  auto running_slot = ng_encap_impl.AcquireIOCacheSlot(ng_exec);
+  ASSERT_TRUE(running_slot->primary);
+
+  // Compiling another shape evicts the running executable
+  std::shared_ptr<ngraph::runtime::Executable> other_ng_exec;
+  GetCachedNgExecutable(ng_encap_impl, TensorShape({3}), op_backend,
+                        other_ng_exec);
+  ASSERT_EQ(ng_encap_impl.GetNgExecMap().size(), 1);
+  ASSERT_EQ(ng_encap_impl.GetNgExecMap().begin()->second, other_ng_exec);
+  std::weak_ptr<ngraph::runtime::Executable> evicted_ng_exec = ng_exec;
+  ASSERT_FALSE(evicted_ng_exec.expired());
+
+  // Further steps of the evicted executable get slots that are not cached
+  auto evicted_slot = ng_encap_impl.AcquireIOCacheSlot(ng_exec);
+  ASSERT_FALSE(evicted_slot->primary);
+  ng_encap_impl.ReleaseIOCacheSlot(evicted_slot);
+  ASSERT_NE(ng_encap_impl.AcquireIOCacheSlot(ng_exec), evicted_slot);
+
+  // The executable goes away with the last step running it
+  ng_encap_impl.ReleaseIOCacheSlot(running_slot);
+  running_slot.reset();
+  ng_exec.reset();
+  ASSERT_TRUE(evicted_ng_exec.expired());
+
+  ng_encap_impl.ClearExecMaps();
   BackendManager::ReleaseBackend("CPU");
 }
+
+// Test: Steps of several threads run a cluster whose executables are evicted
+// (and compiled again) while other steps may still be running them
+TEST(EncapsulateOp, ConcurrentComputeWithEviction) {
+  list<string> env_vars{"NGRAPH_TF_USE_LEGACY_EXECUTOR",
+                        "NGRAPH_TF_FUNCTION_CACHE_ITEM_DEPTH"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_USE_LEGACY_EXECUTOR", "1");
+  SetEnvVariable("NGRAPH_TF_FUNCTION_CACHE_ITEM_DEPTH", "2");
+
+  Scope root = Scope::NewRootScope();
+  auto x = ops::Placeholder(root.WithOpName("x"), DT_FLOAT);
+  auto y = ops::Placeholder(root.WithOpName("y"), DT_FLOAT);
+  auto add = ops::Add(root.WithOpName("Add"), x, y);
+  auto mul = ops::Mul(root.WithOpName("Mul"), add, y);
+  auto abs = ops::Abs(root.WithOpName("Abs"), mul);
+
+  ActivateNGraph();
+  ClientSession session(root);
+
+  const int num_threads = 4;
+  const int num_steps = 50;
+  std::atomic<int> failures{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int step = 0; step < num_steps; step++) {
+        // Five shapes for a cache of two executables
+        int rows = 1 + (t + step) % 5;
+        Tensor x_val(DT_FLOAT, TensorShape({rows, 3}));
+        Tensor y_val(DT_FLOAT, TensorShape({rows, 3}));
+        auto x_flat = x_val.flat<float>();
+        auto y_flat = y_val.flat<float>();
+        for (int i = 0; i < x_flat.size(); i++) {
+          x_flat(i) = static_cast<float>(t + i);
+          y_flat(i) = -static_cast<float>(step + 1);
+        }
+
+        std::vector<Tensor> outputs;
+        Status status = session.Run({{x, x_val}, {y, y_val}}, {abs}, &outputs);
+        if (!status.ok() || outputs.size() != 1 ||
+            outputs[0].shape() != x_val.shape()) {
+          failures++;
+          continue;
+        }
+        auto out_flat = outputs[0].flat<float>();
+        for (int i = 0; i < out_flat.size(); i++) {
+          float expected = std::abs((x_flat(i) + y_flat(i)) * y_flat(i));
+          if (out_flat(i) != expected) {
+            failures++;
+            break;
+          }
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(failures, 0);
+
+  UnsetEnvVariable("NGRAPH_TF_USE_LEGACY_EXECUTOR");
+  UnsetEnvVariable("NGRAPH_TF_FUNCTION_CACHE_ITEM_DEPTH");
+  RestoreEnv(env_map);
+}
+
+// Builds the cluster graph _Arg -> Abs -> _Retval or, if "binary",
+// (_Arg, _Arg) -> Add -> _Retval
+static void BuildClusterGraph(bool binary, Graph* graph) {
+  Node* x;
+  TF_CHECK_OK(NodeBuilder("x", "_Arg")
+                  .Attr("T", DT_FLOAT)
+                  .Attr("index", 0)
+                  .Finalize(graph, &x));
+  Node* result;
+  if (binary) {
+    Node* y;
+    TF_CHECK_OK(NodeBuilder("y", "_Arg")
+                    .Attr("T", DT_FLOAT)
+                    .Attr("index", 1)
+                    .Finalize(graph, &y));
+    TF_CHECK_OK(NodeBuilder("add", "Add")
+                    .Input(x)
+                    .Input(y)
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(graph, &result));
+  } else {
+    TF_CHECK_OK(NodeBuilder("abs", "Abs")
+                    .Input(x)
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(graph, &result));
+  }
+  Node* retval;
+  TF_CHECK_OK(NodeBuilder("retval", "_Retval")
+                  .Input(result)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("index", 0)
+                  .Finalize(graph, &retval));
+}
+
+// Test: One executable with a dynamic batch dimension runs every batch size
+TEST(EncapsulateOp, DynamicShapes) {
+  NGraphEncapsulateImpl ng_encap_impl;
+  BuildClusterGraph(false, &ng_encap_impl.m_graph);
+  ng_encap_impl.SetName("abs_cluster");
+  ng_encap_impl.ResizeStaticInputVector(1);
+  ng_encap_impl.SetStaticInputVector(0, false);
+  ng_encap_impl.SetOpBackend("INTERPRETER");
+  ASSERT_OK(BackendManager::CreateBackend(ng_encap_impl.GetOpBackend()));
+  ng_encap_impl.SetDynamicShapes(true);
+
+  // A backend that can run executables compiled with dynamic shapes
+  auto dynamic_backend = ng::runtime::Backend::create("INTERPRETER", true);
+  ASSERT_TRUE(dynamic_backend->supports_dynamic_tensors());
+
+  std::shared_ptr<ngraph::runtime::Executable> first_exec;
+  for (int rows : {2, 5}) {
+    Tensor x(DT_FLOAT, TensorShape({rows, 3}));
+    auto x_flat = x.flat<float>();
+    for (int i = 0; i < x_flat.size(); i++) {
+      x_flat(i) = -static_cast<float>(i);
+    }
+    std::vector<Tensor> input_tensors{x};
+    std::vector<const Tensor*> static_input_map;
+    std::shared_ptr<ngraph::runtime::Executable> ng_exec;
+    ASSERT_OK(ng_encap_impl.GetDynamicNgExecutable(
+        input_tensors, static_input_map, dynamic_backend.get(), ng_exec));
+    ASSERT_TRUE(ng_encap_impl.IsDynamicExecutable(ng_exec));
+    if (first_exec == nullptr) {
+      first_exec = ng_exec;
+    }
+    ASSERT_EQ(ng_exec, first_exec);
+
+    auto ng_input =
+        dynamic_backend->create_tensor(ng::element::f32, ng::Shape{rows, 3});
+    ng_input->write(DMAHelper::base(&x), x.TotalBytes());
+    std::vector<shared_ptr<ng::runtime::Tensor>> ng_outputs;
+    ASSERT_OK(ng_encap_impl.AllocateNGDynamicOutputTensors(
+        ng_exec, dynamic_backend.get(), ng_outputs));
+    ASSERT_EQ(ng_outputs.size(), 1);
+    ng_exec->call(ng_outputs, {ng_input});
+    ASSERT_EQ(ng_outputs[0]->get_shape(), ng::Shape({rows, 3}));
+
+    Tensor result(DT_FLOAT, x.shape());
+    ng_outputs[0]->read(DMAHelper::base(&result), result.TotalBytes());
+    auto result_flat = result.flat<float>();
+    for (int i = 0; i < result_flat.size(); i++) {
+      ASSERT_EQ(result_flat(i), static_cast<float>(i));
+    }
+  }
+
+  auto ng_exec_map = ng_encap_impl.GetNgExecMap();
+  ASSERT_EQ(ng_exec_map.size(), 1);
+  ASSERT_NE(ng_exec_map.find("dynamic/?,3,;/"), ng_exec_map.end());
+
+  ng_encap_impl.ClearExecMaps();
+  BackendManager::ReleaseBackend("INTERPRETER");
+}
+
+// Test: A cluster that cannot be translated with dynamic shapes falls back
+// to one executable per input shape for good. The builder broadcasts the
+// inputs of the binary ops, which needs their static shapes
+TEST(EncapsulateOp, DynamicShapesFallback) {
+  NGraphEncapsulateImpl ng_encap_impl;
+  BuildClusterGraph(true, &ng_encap_impl.m_graph);
+  ng_encap_impl.SetName("add_cluster");
+  ng_encap_impl.ResizeStaticInputVector(2);
+  for (int i = 0; i < 2; i++) {
+    ng_encap_impl.SetStaticInputVector(i, false);
+  }
+  ng_encap_impl.SetOpBackend("CPU");
+  ASSERT_OK(BackendManager::CreateBackend(ng_encap_impl.GetOpBackend()));
+  ng_encap_impl.SetDynamicShapes(true);
+
+  std::vector<Tensor> input_tensors;
+  for (int i = 0; i < 2; i++) {
+    Tensor input_data(DT_FLOAT, TensorShape({2, 3}));
+    AssignInputValuesRandom<float>(input_data, -10.0, 20.0f);
+    input_tensors.push_back(input_data);
+  }
+  std::vector<TensorShape> input_shapes;
+  std::vector<const Tensor*> static_input_map;
+  ng::runtime::Backend* op_backend;
+  std::shared_ptr<ngraph::runtime::Executable> ng_exec;
+  ASSERT_OK(ng_encap_impl.GetNgExecutable(
+      input_tensors, input_shapes, static_input_map, op_backend, ng_exec));
+
+  ASSERT_FALSE(ng_encap_impl.GetDynamicShapes());
+  ASSERT_FALSE(ng_encap_impl.IsDynamicExecutable(ng_exec));
+  ASSERT_EQ(input_shapes.size(), 2);
+  auto ng_exec_map = ng_encap_impl.GetNgExecMap();
+  ASSERT_EQ(ng_exec_map.size(), 1);
+  ASSERT_NE(ng_exec_map.find("2,3,;2,3,;/"), ng_exec_map.end());
+
+  ng_encap_impl.ClearExecMaps();
+  BackendManager::ReleaseBackend("CPU");
+}
+
 }
 }
 }
@@ -13,6 +13,8 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  *******************************************************************************/
+#include <random>
+
 #include "gtest/gtest.h"
 
 #include "tensorflow/core/graph/graph.h"
@@ -20,6 +22,7 @@
 
 #include "logging/tf_graph_writer.h"
 #include "ngraph_bridge/ngraph_assign_clusters.h"
+#include "ngraph_bridge/ngraph_timer.h"
 #include "ngraph_bridge/ngraph_utils.h"
 #include "test/test_utilities.h"
 
@@ -154,6 +157,268 @@ TEST(AssignClusters, Cone) {
   ASSERT_NE(node2_cluster, node3_cluster);
 }
 
+// Builds a synthetic graph of about "num_nodes" nodes: segments of
+// "segment_length" marked Add nodes, each reading the previous two nodes (so
+// every node is reachable from its grandparent by a longer path too),
+// separated by unmarked Abs nodes. The Add nodes of each segment are returned
+// in "segments"
+static Status BuildSyntheticGraph(Graph* g, int num_nodes, int segment_length,
+                                  vector<vector<Node*>>* segments) {
+  Tensor t(DT_FLOAT, TensorShape{2, 3});
+  Node* prev;
+  TF_RETURN_IF_ERROR(NodeBuilder("const", "Const")
+                         .Attr("dtype", DT_FLOAT)
+                         .Attr("value", t)
+                         .Attr("_ngraph_marked_for_clustering", true)
+                         .Finalize(g, &prev));
+  Node* prev_prev = prev;
+
+  int num_segments = num_nodes / (segment_length + 1);
+  for (int i = 0; i < num_segments; i++) {
+    segments->emplace_back();
+    for (int j = 0; j < segment_length; j++) {
+      Node* add;
+      TF_RETURN_IF_ERROR(
+          NodeBuilder("add_" + to_string(i) + "_" + to_string(j), "Add")
+              .Input(prev, 0)
+              .Input(prev_prev, 0)
+              .Attr("T", DT_FLOAT)
+              .Attr("_ngraph_marked_for_clustering", true)
+              .Finalize(g, &add));
+      segments->back().push_back(add);
+      prev_prev = prev;
+      prev = add;
+    }
+    Node* abs;
+    TF_RETURN_IF_ERROR(NodeBuilder("abs_" + to_string(i), "Abs")
+                           .Input(prev, 0)
+                           .Attr("T", DT_FLOAT)
+                           .Finalize(g, &abs));
+    prev_prev = abs;
+    prev = abs;
+  }
+  return Status::OK();
+}
+
+// Clusters a synthetic graph, checks that every segment became exactly one
+// cluster and sets "elapsed_ms" to the time taken by AssignClusters
+static void AssignSyntheticGraph(int num_nodes, int* elapsed_ms) {
+  const int segment_length = 100;
+  Graph g(OpRegistry::Global());
+  vector<vector<Node*>> segments;
+  ASSERT_OK(BuildSyntheticGraph(&g, num_nodes, segment_length, &segments));
+
+  Timer timer;
+  ASSERT_OK(AssignClusters(&g));
+  *elapsed_ms = timer.ElapsedInMS();
+
+  std::set<int> seen_clusters;
+  for (const auto& segment : segments) {
+    int segment_cluster;
+    ASSERT_OK(GetNodeCluster(segment.front(), &segment_cluster));
+    for (auto node : segment) {
+      int node_cluster;
+      ASSERT_OK(GetNodeCluster(node, &node_cluster));
+      EXPECT_EQ(node_cluster, segment_cluster) << node->name();
+    }
+    EXPECT_TRUE(seen_clusters.insert(segment_cluster).second)
+        << "Segments were merged across an unmarked node";
+  }
+}
+
+// Each segment of a 10k node graph becomes one cluster
+TEST(AssignClusters, SyntheticGraph) {
+  int elapsed_ms = 0;
+  AssignSyntheticGraph(10000, &elapsed_ms);
+}
+
+// Prints the time taken by AssignClusters on 100k and 1M node graphs. Takes a
+// while, run with --gtest_also_run_disabled_tests
+TEST(AssignClusters, DISABLED_LargeBenchmark) {
+  for (int num_nodes : {100000, 1000000}) {
+    int elapsed_ms = 0;
+    AssignSyntheticGraph(num_nodes, &elapsed_ms);
+    cout << num_nodes << " nodes: AssignClusters " << elapsed_ms << " ms"
+         << endl;
+  }
+}
+
+// With NGRAPH_TF_MAX_CLUSTER_SIZE, a chain of 20 Adds (and the Const feeding
+// it) is contracted into clusters of at most 4 nodes
+TEST(AssignClusters, MaxClusterSize) {
+  list<string> env_vars{"NGRAPH_TF_MAX_CLUSTER_SIZE"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_MAX_CLUSTER_SIZE", "4");
+
+  Graph g(OpRegistry::Global());
+  vector<vector<Node*>> segments;
+  ASSERT_OK(BuildSyntheticGraph(&g, 21, 20, &segments));
+  ASSERT_OK(AssignClusters(&g));
+
+  std::map<int, int> cluster_sizes;
+  for (auto node : g.op_nodes()) {
+    int cluster;
+    if (GetNodeCluster(node, &cluster).ok()) {
+      cluster_sizes[cluster]++;
+    }
+  }
+  for (auto node : segments[0]) {
+    int cluster;
+    ASSERT_OK(GetNodeCluster(node, &cluster));
+  }
+  ASSERT_GE(cluster_sizes.size(), 6);
+  for (auto kv : cluster_sizes) {
+    ASSERT_LE(kv.second, 4);
+  }
+
+  RestoreEnv(env_map);
+}
+
+// With NGRAPH_TF_MAX_CLUSTER_FLOPS allowing two of the MatMuls, a chain of six
+// [64, 64] MatMuls is split into three clusters of two MatMuls
+TEST(AssignClusters, MaxClusterFlops) {
+  const int n = 64;
+  list<string> env_vars{"NGRAPH_TF_MAX_CLUSTER_FLOPS"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_MAX_CLUSTER_FLOPS", to_string(2 * 2 * n * n * n));
+
+  Graph g(OpRegistry::Global());
+  Node* prev;
+  ASSERT_OK(NodeBuilder("placeholder", "Placeholder")
+                .Attr("dtype", DT_FLOAT)
+                .Attr("shape", TensorShape({n, n}))
+                .Finalize(&g, &prev));
+  vector<Node*> matmuls;
+  for (int i = 0; i < 6; i++) {
+    Node* weights;
+    ASSERT_OK(NodeBuilder("weights_" + to_string(i), "Const")
+                  .Attr("dtype", DT_FLOAT)
+                  .Attr("value", Tensor(DT_FLOAT, TensorShape({n, n})))
+                  .Attr("_ngraph_marked_for_clustering", true)
+                  .Finalize(&g, &weights));
+    Node* matmul;
+    ASSERT_OK(NodeBuilder("matmul_" + to_string(i), "MatMul")
+                  .Input(prev, 0)
+                  .Input(weights, 0)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("_ngraph_marked_for_clustering", true)
+                  .Finalize(&g, &matmul));
+    matmuls.push_back(matmul);
+    prev = matmul;
+  }
+
+  ASSERT_OK(AssignClusters(&g));
+
+  std::map<int, int> matmuls_per_cluster;
+  for (auto matmul : matmuls) {
+    int cluster;
+    ASSERT_OK(GetNodeCluster(matmul, &cluster));
+    matmuls_per_cluster[cluster]++;
+  }
+  ASSERT_EQ(matmuls_per_cluster.size(), 3);
+  for (auto kv : matmuls_per_cluster) {
+    ASSERT_EQ(kv.second, 2);
+  }
+
+  RestoreEnv(env_map);
+}
+
+// Builds a random DAG of "num_nodes" Adds. Each Add reads two earlier
+// outputs, which may be a marked Const or the outputs of two Switches (so
+// that the Adds get a mix of predicates). One in five Adds is not marked for
+// clustering
+static Status BuildRandomGraph(Graph* g, int num_nodes, unsigned int seed) {
+  std::mt19937 rng(seed);
+  vector<pair<Node*, int>> outputs;
+
+  Node* const_node;
+  TF_RETURN_IF_ERROR(NodeBuilder("const", "Const")
+                         .Attr("dtype", DT_FLOAT)
+                         .Attr("value", Tensor(DT_FLOAT, TensorShape{2, 3}))
+                         .Attr("_ngraph_marked_for_clustering", true)
+                         .Finalize(g, &const_node));
+  outputs.emplace_back(const_node, 0);
+
+  for (int i = 0; i < 2; i++) {
+    Node* data;
+    TF_RETURN_IF_ERROR(NodeBuilder("data_" + to_string(i), "Placeholder")
+                           .Attr("dtype", DT_FLOAT)
+                           .Finalize(g, &data));
+    Node* pred;
+    TF_RETURN_IF_ERROR(NodeBuilder("pred_" + to_string(i), "Placeholder")
+                           .Attr("dtype", DT_BOOL)
+                           .Finalize(g, &pred));
+    Node* switch_node;
+    TF_RETURN_IF_ERROR(NodeBuilder("switch_" + to_string(i), "Switch")
+                           .Input(data, 0)
+                           .Input(pred, 0)
+                           .Attr("T", DT_FLOAT)
+                           .Finalize(g, &switch_node));
+    outputs.emplace_back(switch_node, 0);
+    outputs.emplace_back(switch_node, 1);
+  }
+
+  for (int i = 0; i < num_nodes; i++) {
+    std::uniform_int_distribution<int> pick_input(0, outputs.size() - 1);
+    pair<Node*, int> lhs = outputs[pick_input(rng)];
+    pair<Node*, int> rhs = outputs[pick_input(rng)];
+    bool marked = std::uniform_int_distribution<int>(0, 4)(rng) != 0;
+    Node* add;
+    NodeBuilder builder("add_" + to_string(i), "Add");
+    builder.Input(lhs.first, lhs.second)
+        .Input(rhs.first, rhs.second)
+        .Attr("T", DT_FLOAT);
+    if (marked) {
+      builder.Attr("_ngraph_marked_for_clustering", true);
+    }
+    TF_RETURN_IF_ERROR(builder.Finalize(g, &add));
+    outputs.emplace_back(add, 0);
+  }
+  return Status::OK();
+}
+
+// Clusters the random graph built from "seed" and sets "partition" to the
+// cluster of each op node, numbered in the order the clusters are first seen
+// (-1 for nodes that are not clustered)
+static void AssignRandomGraph(unsigned int seed, vector<int>* partition) {
+  Graph g(OpRegistry::Global());
+  ASSERT_OK(BuildRandomGraph(&g, 200, seed));
+  ASSERT_OK(AssignClusters(&g));
+
+  std::map<int, int> cluster_numbers;
+  for (auto node : g.op_nodes()) {
+    int cluster;
+    if (!GetNodeCluster(node, &cluster).ok()) {
+      partition->push_back(-1);
+      continue;
+    }
+    auto inserted = cluster_numbers.insert(
+        std::make_pair(cluster, static_cast<int>(cluster_numbers.size())));
+    partition->push_back(inserted.first->second);
+  }
+}
+
+// The worklist contraction makes the same decisions as the sweeps over all the
+// edges (NGRAPH_TF_ASSIGN_CLUSTERS_SWEEP), so both give the same clusters
+TEST(AssignClusters, WorklistMatchesSweep) {
+  list<string> env_vars{"NGRAPH_TF_ASSIGN_CLUSTERS_SWEEP"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+
+  for (unsigned int seed = 0; seed < 20; seed++) {
+    vector<int> worklist_partition;
+    AssignRandomGraph(seed, &worklist_partition);
+
+    SetEnvVariable("NGRAPH_TF_ASSIGN_CLUSTERS_SWEEP", "1");
+    vector<int> sweep_partition;
+    AssignRandomGraph(seed, &sweep_partition);
+    UnsetEnvVariable("NGRAPH_TF_ASSIGN_CLUSTERS_SWEEP");
+
+    ASSERT_EQ(worklist_partition, sweep_partition) << "seed " << seed;
+  }
+
+  RestoreEnv(env_map);
+}
+
 }  // namespace testing
 
 }  // namespace ngraph_bridge
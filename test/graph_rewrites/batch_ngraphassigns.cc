@@ -0,0 +1,181 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include "gtest/gtest.h"
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/graph/graph.h"
+
+#include "ngraph_bridge/enable_variable_ops/ngraph_batch_ngraphassigns.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_enter_in_catalog.h"
+#include "ngraph_bridge/ngraph_capture_variables.h"
+#include "ngraph_bridge/ngraph_catalog.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+// Returns true if the op nodes of the graph can be topologically sorted
+static bool IsAcyclic(const Graph& graph) {
+  map<Node*, int> num_pending;
+  vector<Node*> ready;
+  int num_nodes = 0;
+  for (auto node : graph.op_nodes()) {
+    num_nodes++;
+    int count = 0;
+    for (auto edge : node->in_edges()) {
+      if (edge->src()->IsOp()) {
+        count++;
+      }
+    }
+    num_pending[node] = count;
+    if (count == 0) {
+      ready.push_back(node);
+    }
+  }
+  int num_visited = 0;
+  while (!ready.empty()) {
+    Node* node = ready.back();
+    ready.pop_back();
+    num_visited++;
+    for (auto edge : node->out_edges()) {
+      if (edge->dst()->IsOp() && --num_pending[edge->dst()] == 0) {
+        ready.push_back(edge->dst());
+      }
+    }
+  }
+  return num_visited == num_nodes;
+}
+
+// Var1   Var2   Var3   Val
+//   \      \      \    /
+//  Assign1  Assign2  Assign3
+//     |
+//  Assign4 (assigns to Var1 again, depends on Assign1)
+//
+// Assign1, Assign2 and Assign3 are independent and end up in one
+// NGraphBatchedAssign, Assign4 depends on Assign1 and stays an NGraphAssign
+TEST(BatchNGraphAssigns, IndependentAssigns) {
+  Scope root = Scope::NewRootScope();
+
+  PartialTensorShape varShape({2, 2});
+  auto var1 = ops::Variable(root.WithOpName("Var1"), varShape, DT_FLOAT);
+  auto var2 = ops::Variable(root.WithOpName("Var2"), varShape, DT_FLOAT);
+  auto var3 = ops::Variable(root.WithOpName("Var3"), varShape, DT_FLOAT);
+  auto val = ops::Const(root.WithOpName("Val"), {{1.f, 1.f}, {1.f, 1.f}});
+  auto assign1 = ops::Assign(root.WithOpName("Assign1"), var1, val);
+  auto assign2 = ops::Assign(root.WithOpName("Assign2"), var2, val);
+  auto assign3 = ops::Assign(root.WithOpName("Assign3"), var3, val);
+  auto assign4 = ops::Assign(root.WithOpName("Assign4"), assign1, val);
+
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+
+  std::set<string> skip_these_nodes = {};
+  ASSERT_OK(CaptureVariables(&graph, skip_these_nodes));
+  ASSERT_OK(EnterInCatalog(&graph, 0));
+  ASSERT_OK(BatchNGraphAssigns(&graph, 0));
+
+  map<string, Node*> node_map;
+  vector<Node*> batched_assigns;
+  for (auto node : graph.op_nodes()) {
+    node_map[node->name()] = node;
+    if (node->type_string() == "NGraphBatchedAssign") {
+      batched_assigns.push_back(node);
+    }
+  }
+
+  ASSERT_EQ(batched_assigns.size(), 1);
+  Node* batched = batched_assigns[0];
+  ASSERT_EQ(batched->num_inputs(), 6);
+  ASSERT_EQ(node_map.find("Assign1"), node_map.end());
+  ASSERT_EQ(node_map.find("Assign2"), node_map.end());
+  ASSERT_EQ(node_map.find("Assign3"), node_map.end());
+  ASSERT_NE(node_map.find("Assign4"), node_map.end());
+  ASSERT_EQ(node_map.at("Assign4")->type_string(), "NGraphAssign");
+
+  // The catalog entries moved to the batched op, in input order
+  for (int i = 0; i < 3; i++) {
+    Node* var;
+    ASSERT_OK(batched->input_node(i, &var));
+    ASSERT_TRUE(NGraphCatalog::ExistsInInputVariableSharedNameMap(
+        0, batched->name(), i));
+    ASSERT_EQ(
+        NGraphCatalog::GetInputVariableSharedName(0, batched->name(), i),
+        var->name());
+  }
+  ASSERT_FALSE(
+      NGraphCatalog::ExistsInInputVariableSharedNameMap(0, "Assign1", 0));
+
+  // Assign4 reads the ref forwarded for Var1
+  const Edge* ref_edge;
+  ASSERT_OK(node_map.at("Assign4")->input_edge(0, &ref_edge));
+  ASSERT_EQ(ref_edge->src(), batched);
+  Node* var1_input;
+  ASSERT_OK(batched->input_node(ref_edge->src_output(), &var1_input));
+  ASSERT_EQ(var1_input->name(), "Var1");
+
+  ASSERT_TRUE(IsAcyclic(graph));
+  NGraphCatalog::ClearCatalog();
+}
+
+// Assign2 has a control dependency on Assign1 and Assign3 on Assign4. Any
+// batching must keep the graph acyclic
+TEST(BatchNGraphAssigns, ControlDependencies) {
+  Scope root = Scope::NewRootScope();
+
+  PartialTensorShape varShape({2, 2});
+  auto var1 = ops::Variable(root.WithOpName("Var1"), varShape, DT_FLOAT);
+  auto var2 = ops::Variable(root.WithOpName("Var2"), varShape, DT_FLOAT);
+  auto var3 = ops::Variable(root.WithOpName("Var3"), varShape, DT_FLOAT);
+  auto var4 = ops::Variable(root.WithOpName("Var4"), varShape, DT_FLOAT);
+  auto val = ops::Const(root.WithOpName("Val"), {{1.f, 1.f}, {1.f, 1.f}});
+  auto assign1 = ops::Assign(root.WithOpName("Assign1"), var1, val);
+  auto assign4 = ops::Assign(root.WithOpName("Assign4"), var4, val);
+  auto assign2 = ops::Assign(
+      root.WithOpName("Assign2").WithControlDependencies(assign1), var2, val);
+  auto assign3 = ops::Assign(
+      root.WithOpName("Assign3").WithControlDependencies(assign4), var3, val);
+
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+
+  std::set<string> skip_these_nodes = {};
+  ASSERT_OK(CaptureVariables(&graph, skip_these_nodes));
+  ASSERT_OK(EnterInCatalog(&graph, 0));
+  ASSERT_OK(BatchNGraphAssigns(&graph, 0));
+
+  int num_batched = 0;
+  for (auto node : graph.op_nodes()) {
+    ASSERT_NE(node->type_string(), "NGraphAssign");
+    if (node->type_string() == "NGraphBatchedAssign") {
+      num_batched++;
+    }
+  }
+  ASSERT_EQ(num_batched, 2);
+  ASSERT_TRUE(IsAcyclic(graph));
+  NGraphCatalog::ClearCatalog();
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
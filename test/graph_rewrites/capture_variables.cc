@@ -16,14 +16,18 @@
 #include "gtest/gtest.h"
 
 #include "tensorflow/cc/client/client_session.h"
+#include "tensorflow/cc/ops/resource_variable_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/public/session.h"
 
 #include "logging/tf_graph_writer.h"
 #include "ngraph_bridge/enable_variable_ops/ngraph_replace_op_utilities.h"
+#include "ngraph_bridge/ngraph_api.h"
 #include "ngraph_bridge/ngraph_capture_variables.h"
+#include "ngraph_bridge/ngraph_catalog.h"
 #include "ngraph_bridge/ngraph_utils.h"
 #include "test/test_utilities.h"
 
@@ -284,6 +288,274 @@ TEST(CaptureVariables, SingleVariable3) {
   }
 }
 
+// Resource variables are captured when NGRAPH_TF_CAPTURE_RESOURCE_VARIABLES
+// is set and all their consumers can be captured
+//     Var1 ----------------      Var2
+//    /    \         \      \      |
+// Assign  Read  Apply(GD)  IsInit  ResourceGather
+// Var1 and its consumers are captured, Var2 is not
+TEST(CaptureVariables, ResourceVariables) {
+  Scope root = Scope::NewRootScope();
+
+  auto init_value = ops::Const(root, {{2.f, 3.f}, {4.f, 5.f}});
+  auto alpha = ops::Const(root, 0.1f);
+  auto indices = ops::Const(root, {0});
+
+  auto var1 = ops::VarHandleOp(root.WithOpName("Var1"), DT_FLOAT,
+                               PartialTensorShape({2, 2}));
+  auto assign = ops::AssignVariableOp(root.WithOpName("Assign"), var1,
+                                      init_value);
+  auto read = ops::ReadVariableOp(root.WithOpName("Read"), var1, DT_FLOAT);
+  auto apply = ops::ResourceApplyGradientDescent(root.WithOpName("Apply"),
+                                                 var1, alpha, init_value);
+  auto is_init = ops::VarIsInitializedOp(root.WithOpName("IsInit"), var1);
+
+  auto var2 = ops::VarHandleOp(root.WithOpName("Var2"), DT_FLOAT,
+                               PartialTensorShape({2, 2}));
+  auto gather =
+      ops::ResourceGather(root.WithOpName("Gather"), var2, indices, DT_FLOAT);
+
+  std::set<string> skip_these_nodes = {};
+
+  // Not captured by default
+  {
+    Graph graph(OpRegistry::Global());
+    TF_CHECK_OK(root.ToGraph(&graph));
+    ASSERT_OK(CaptureVariables(&graph, skip_these_nodes));
+    for (auto node : graph.op_nodes()) {
+      ASSERT_NE("NGraphVariable", node->type_string());
+    }
+  }
+
+  SetEnvVariable("NGRAPH_TF_CAPTURE_RESOURCE_VARIABLES", "1");
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+  ASSERT_OK(CaptureVariables(&graph, skip_these_nodes));
+  UnsetEnvVariable("NGRAPH_TF_CAPTURE_RESOURCE_VARIABLES");
+
+  map<string, Node*> node_map;
+  for (auto node : graph.op_nodes()) {
+    node_map[node->name()] = node;
+  }
+  ASSERT_EQ(node_map.at("Var1")->type_string(), "NGraphVariable");
+  ASSERT_EQ(node_map.at("Assign")->type_string(), "NGraphAssign");
+  ASSERT_EQ(node_map.at("Read")->type_string(), "Snapshot");
+  ASSERT_EQ(node_map.at("Apply")->type_string(), "NGraphApplyGradientDescent");
+  ASSERT_EQ(node_map.at("IsInit")->type_string(), "IsVariableInitialized");
+  ASSERT_EQ(node_map.at("Var2")->type_string(), "VarHandleOp");
+  ASSERT_EQ(node_map.at("Gather")->type_string(), "ResourceGather");
+
+  // The consumers read the reference of the NGraphVariable
+  for (string name : {"Assign", "Read", "Apply", "IsInit"}) {
+    Node* input_0;
+    ASSERT_OK(node_map.at(name)->input_node(0, &input_0));
+    ASSERT_EQ(input_0, node_map.at("Var1"));
+  }
+}
+
+// A captured read of a resource variable returns the value it had when it
+// ran, even if the variable is assigned after it in the same step
+TEST(CaptureVariables, ReadBeforeAssign) {
+  list<string> env_vars{"NGRAPH_TF_CAPTURE_RESOURCE_VARIABLES"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_CAPTURE_RESOURCE_VARIABLES", "1");
+  ActivateNGraph();
+
+  Scope root = Scope::NewRootScope();
+  auto var = ops::VarHandleOp(root.WithOpName("Var"), DT_FLOAT,
+                              PartialTensorShape({2}));
+  auto init = ops::AssignVariableOp(root.WithOpName("Init"), var,
+                                    ops::Const(root, {1.f, 2.f}));
+  auto read = ops::ReadVariableOp(root.WithOpName("Read"), var, DT_FLOAT);
+  auto assign = ops::AssignVariableOp(
+      root.WithOpName("Assign").WithControlDependencies(read.operation), var,
+      ops::Const(root, {5.f, 6.f}));
+
+  ClientSession session(root);
+  ASSERT_OK(session.Run({}, {}, {init}, nullptr));
+  for (auto expected : {vector<float>{1, 2}, vector<float>{5, 6}}) {
+    vector<Tensor> outputs;
+    ASSERT_OK(session.Run({}, {read}, {assign}, &outputs));
+    ASSERT_EQ(outputs[0].NumElements(), 2);
+    ASSERT_EQ(outputs[0].flat<float>()(0), expected[0]);
+    ASSERT_EQ(outputs[0].flat<float>()(1), expected[1]);
+  }
+
+  UnsetEnvVariable("NGRAPH_TF_CAPTURE_RESOURCE_VARIABLES");
+  RestoreEnv(env_map);
+}
+
+// Builds input -> PrefetchDataset -> <wrapper_type> -> MakeIterator, with an
+// IteratorGetNext reading the iterator. No wrapper if wrapper_type is empty
+static void BuildPrefetchPipeline(Graph* graph, const string& wrapper_type) {
+  DataTypeVector output_types{DT_FLOAT};
+  std::vector<PartialTensorShape> output_shapes{PartialTensorShape({2})};
+
+  Node* input;
+  TF_CHECK_OK(NodeBuilder("input", "Placeholder")
+                  .Attr("dtype", DT_VARIANT)
+                  .Finalize(graph, &input));
+  Tensor size_value(DT_INT64, TensorShape({}));
+  size_value.scalar<int64>()() = 2;
+  Node* size;
+  TF_CHECK_OK(NodeBuilder("size", "Const")
+                  .Attr("dtype", DT_INT64)
+                  .Attr("value", size_value)
+                  .Finalize(graph, &size));
+
+  Node* dataset;
+  TF_CHECK_OK(NodeBuilder("prefetch", "PrefetchDataset")
+                  .Input(input)
+                  .Input(size)
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &dataset));
+  if (wrapper_type == "BatchDataset") {
+    TF_CHECK_OK(NodeBuilder("batch", "BatchDataset")
+                    .Input(dataset)
+                    .Input(size)
+                    .Attr("output_types", output_types)
+                    .Attr("output_shapes", output_shapes)
+                    .Finalize(graph, &dataset));
+  } else if (wrapper_type == "Identity") {
+    TF_CHECK_OK(NodeBuilder("identity", "Identity")
+                    .Input(dataset)
+                    .Finalize(graph, &dataset));
+  }
+
+  Node* iterator;
+  TF_CHECK_OK(NodeBuilder("iterator", "Iterator")
+                  .Attr("shared_name", "")
+                  .Attr("container", "")
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &iterator));
+  Node* make_iterator;
+  TF_CHECK_OK(NodeBuilder("make_iterator", "MakeIterator")
+                  .Input(dataset)
+                  .Input(iterator)
+                  .Finalize(graph, &make_iterator));
+  Node* get_next;
+  TF_CHECK_OK(NodeBuilder("get_next", "IteratorGetNext")
+                  .Input(iterator)
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &get_next));
+}
+
+static string GetDatasetOfIterator(Graph* graph) {
+  for (auto node : graph->op_nodes()) {
+    if (node->type_string() == "PrefetchDataset" ||
+        node->type_string() == "NGraphPrefetchDataset") {
+      return node->type_string();
+    }
+  }
+  return "";
+}
+
+// Test that the PrefetchDataset is replaced by the NGraphPrefetchDataset
+// only when requested, and that its iterator is remembered for the catalog
+// under the id of the captured graph
+TEST(CaptureVariables, Prefetch) {
+  std::set<string> skip_these_nodes = {};
+  NGraphCatalog::ClearCatalog();
+
+  // Not replaced by default
+  {
+    Graph graph(OpRegistry::Global());
+    BuildPrefetchPipeline(&graph, "");
+    ASSERT_OK(CaptureVariables(&graph, skip_these_nodes));
+    ASSERT_EQ(GetDatasetOfIterator(&graph), "PrefetchDataset");
+    ASSERT_FALSE(
+        NGraphCatalog::ExistsInPrefetchDatasetIterators(0, "iterator"));
+  }
+
+  for (string wrapper_type : {"", "Identity"}) {
+    Graph graph(OpRegistry::Global());
+    BuildPrefetchPipeline(&graph, wrapper_type);
+    ASSERT_OK(CaptureVariables(&graph, skip_these_nodes, true, 3));
+    ASSERT_EQ(GetDatasetOfIterator(&graph), "NGraphPrefetchDataset");
+    for (auto node : graph.op_nodes()) {
+      if (node->type_string() == "NGraphPrefetchDataset") {
+        string iterator_name;
+        ASSERT_OK(
+            GetNodeAttr(node->attrs(), "iterator_name", &iterator_name));
+        ASSERT_EQ(iterator_name, "iterator");
+        int graph_id;
+        ASSERT_OK(GetNodeAttr(node->attrs(), "graph_id", &graph_id));
+        ASSERT_EQ(graph_id, 3);
+      }
+      if (node->name() == "iterator") {
+        int graph_id;
+        ASSERT_OK(
+            GetNodeAttr(node->attrs(), "_ngraph_prefetch_graph_id", &graph_id));
+        ASSERT_EQ(graph_id, 3);
+      }
+    }
+    ASSERT_TRUE(NGraphCatalog::ExistsInPrefetchDatasetIterators(3, "iterator"));
+    ASSERT_FALSE(
+        NGraphCatalog::ExistsInPrefetchDatasetIterators(0, "iterator"));
+    NGraphCatalog::ClearCatalog();
+  }
+}
+
+// Test that capturing a graph forgets only the iterators of its own
+// previous capture
+TEST(CaptureVariables, PrefetchClearedPerGraph) {
+  std::set<string> skip_these_nodes = {};
+  NGraphCatalog::ClearCatalog();
+
+  NGraphCatalog::AddToPrefetchDatasetIterators(1, "stale");
+  NGraphCatalog::AddToPrefetchDatasetIterators(2, "other");
+  Graph graph(OpRegistry::Global());
+  BuildPrefetchPipeline(&graph, "");
+  ASSERT_OK(CaptureVariables(&graph, skip_these_nodes, true, 1));
+  ASSERT_TRUE(NGraphCatalog::ExistsInPrefetchDatasetIterators(1, "iterator"));
+  ASSERT_FALSE(NGraphCatalog::ExistsInPrefetchDatasetIterators(1, "stale"));
+  ASSERT_TRUE(NGraphCatalog::ExistsInPrefetchDatasetIterators(2, "other"));
+
+  NGraphCatalog::ClearPrefetchDatasetIterators(1);
+  ASSERT_FALSE(NGraphCatalog::ExistsInPrefetchDatasetIterators(1, "iterator"));
+  ASSERT_TRUE(NGraphCatalog::ExistsInPrefetchDatasetIterators(2, "other"));
+  NGraphCatalog::ClearCatalog();
+}
+
+// Test that the PrefetchDataset is not replaced when the IteratorGetNext
+// does not return its elements as is
+TEST(CaptureVariables, PrefetchNotSafe) {
+  std::set<string> skip_these_nodes = {};
+  NGraphCatalog::ClearCatalog();
+
+  Graph graph(OpRegistry::Global());
+  BuildPrefetchPipeline(&graph, "BatchDataset");
+  ASSERT_OK(CaptureVariables(&graph, skip_these_nodes, true));
+  ASSERT_EQ(GetDatasetOfIterator(&graph), "PrefetchDataset");
+  ASSERT_FALSE(NGraphCatalog::ExistsInPrefetchDatasetIterators(0, "iterator"));
+}
+
+// Test that a session turns prefetching on or off through the
+// ngraph-optimizer of its RewriterConfig
+TEST(CaptureVariables, PrefetchSessionConfig) {
+  config::DisablePrefetch();
+  ConfigProto session_config;
+  ASSERT_FALSE(config::IsPrefetchEnabled(session_config));
+
+  auto optimizer = session_config.mutable_graph_options()
+                       ->mutable_rewrite_options()
+                       ->add_custom_optimizers();
+  optimizer->set_name("ngraph-optimizer");
+  ASSERT_FALSE(config::IsPrefetchEnabled(session_config));
+  (*optimizer->mutable_parameter_map())["use_prefetch"].set_s("1");
+  ASSERT_TRUE(config::IsPrefetchEnabled(session_config));
+
+  config::EnablePrefetch();
+  (*optimizer->mutable_parameter_map())["use_prefetch"].set_s("0");
+  ASSERT_FALSE(config::IsPrefetchEnabled(session_config));
+  optimizer->mutable_parameter_map()->erase("use_prefetch");
+  ASSERT_TRUE(config::IsPrefetchEnabled(session_config));
+  config::DisablePrefetch();
+}
+
 }  // namespace testing
 
 }  // namespace ngraph_bridge
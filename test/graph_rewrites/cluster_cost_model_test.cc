@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+
+#include "ngraph_bridge/ngraph_assign_clusters.h"
+#include "ngraph_bridge/ngraph_cluster_cost_model.h"
+#include "ngraph_bridge/ngraph_deassign_clusters.h"
+#include "ngraph_bridge/ngraph_mark_for_clustering.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+static Node* AddConst(Graph* g, const string& name, const TensorShape& shape) {
+  Node* node;
+  Tensor t(DT_FLOAT, shape);
+  TF_CHECK_OK(NodeBuilder(name, "Const")
+                  .Attr("dtype", DT_FLOAT)
+                  .Attr("value", t)
+                  .Finalize(g, &node));
+  return node;
+}
+
+// Builds Placeholder[n, n] -> Abs -> Neg -> Identity, with Abs and Neg in
+// cluster 0, and Placeholder[n, n] x Placeholder[n, n] -> MatMul -> Relu ->
+// Identity, with MatMul and Relu in cluster 1
+static void BuildClusters(Graph* g, int n, Node** abs, Node** matmul) {
+  Node* placeholders[2];
+  for (int i = 0; i < 2; i++) {
+    TF_CHECK_OK(NodeBuilder("placeholder" + to_string(i), "Placeholder")
+                    .Attr("dtype", DT_FLOAT)
+                    .Attr("shape", TensorShape({n, n}))
+                    .Finalize(g, &placeholders[i]));
+  }
+
+  Node* neg;
+  TF_CHECK_OK(NodeBuilder("abs", "Abs")
+                  .Input(placeholders[0], 0)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("_ngraph_marked_for_clustering", true)
+                  .Attr("_ngraph_cluster", 0)
+                  .Finalize(g, abs));
+  TF_CHECK_OK(NodeBuilder("neg", "Neg")
+                  .Input(*abs, 0)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("_ngraph_marked_for_clustering", true)
+                  .Attr("_ngraph_cluster", 0)
+                  .Finalize(g, &neg));
+
+  TF_CHECK_OK(NodeBuilder("matmul", "MatMul")
+                  .Input(placeholders[0], 0)
+                  .Input(placeholders[1], 0)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("_ngraph_marked_for_clustering", true)
+                  .Attr("_ngraph_cluster", 1)
+                  .Finalize(g, matmul));
+  Node* relu;
+  TF_CHECK_OK(NodeBuilder("relu", "Relu")
+                  .Input(*matmul, 0)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("_ngraph_marked_for_clustering", true)
+                  .Attr("_ngraph_cluster", 1)
+                  .Finalize(g, &relu));
+
+  Node* identity;
+  for (auto node : {neg, relu}) {
+    TF_CHECK_OK(NodeBuilder(node->name() + "_identity", "Identity")
+                    .Input(node, 0)
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(g, &identity));
+  }
+}
+
+TEST(ClusterCostModel, EstimateNode) {
+  Graph g(OpRegistry::Global());
+  Node* a = AddConst(&g, "a", TensorShape({64, 32}));
+  Node* b = AddConst(&g, "b", TensorShape({32, 16}));
+  Node* matmul;
+  ASSERT_OK(NodeBuilder("matmul", "MatMul")
+                .Input(a, 0)
+                .Input(b, 0)
+                .Attr("T", DT_FLOAT)
+                .Finalize(&g, &matmul));
+
+  OutputShapes shapes;
+  ClusterCostModel::InferOutputShapes(g, &shapes);
+  ASSERT_TRUE(shapes[matmul->id()][0].IsIdenticalTo(
+      PartialTensorShape({64, 16})));
+
+  ClusterCostModel model;
+  int64 flops, bytes;
+  ASSERT_TRUE(model.EstimateNode(matmul, shapes, &flops, &bytes));
+  ASSERT_EQ(flops, 2 * 64 * 16 * 32);
+  ASSERT_EQ(bytes, 64 * 16 * 4);
+
+  ClusterCost cost = model.Estimate({matmul}, shapes);
+  ASSERT_TRUE(cost.complete);
+  ASSERT_EQ(cost.flops, flops);
+  ASSERT_EQ(cost.boundary_edges, 2);
+  ASSERT_EQ(cost.boundary_bytes, (64 * 32 + 32 * 16) * 4);
+}
+
+// The elementwise cluster costs more to copy in and out than it computes and
+// is deassigned, the MatMul cluster is kept
+TEST(ClusterCostModel, DeassignClusters) {
+  list<string> env_vars{"NGRAPH_TF_DISABLE_DEASSIGN_CLUSTERS",
+                        "NGRAPH_TF_CLUSTER_COST_MODEL"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+
+  Graph g(OpRegistry::Global());
+  Node *abs, *matmul;
+  BuildClusters(&g, 512, &abs, &matmul);
+
+  // Without the cost model both clusters are kept
+  ASSERT_OK(DeassignClusters(&g));
+  int cluster;
+  ASSERT_OK(GetNodeCluster(abs, &cluster));
+  ASSERT_OK(GetNodeCluster(matmul, &cluster));
+
+  SetEnvVariable("NGRAPH_TF_CLUSTER_COST_MODEL", "1");
+  ASSERT_OK(DeassignClusters(&g));
+  ASSERT_NOT_OK(GetNodeCluster(abs, &cluster));
+  ASSERT_FALSE(NodeIsMarkedForClustering(abs));
+  ASSERT_OK(GetNodeCluster(matmul, &cluster));
+  ASSERT_EQ(cluster, 1);
+
+  RestoreEnv(env_map);
+}
+
+// A model that never sees a gain deassigns everything it can estimate
+class NoGainModel : public ClusterCostModel {
+ public:
+  double Gain(const ClusterCost& cost) const override { return -1; }
+};
+
+TEST(ClusterCostModel, SetModel) {
+  list<string> env_vars{"NGRAPH_TF_DISABLE_DEASSIGN_CLUSTERS",
+                        "NGRAPH_TF_CLUSTER_COST_MODEL"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_CLUSTER_COST_MODEL", "1");
+
+  Graph g(OpRegistry::Global());
+  Node *abs, *matmul;
+  BuildClusters(&g, 512, &abs, &matmul);
+
+  ClusterCostModel::SetModel(
+      std::unique_ptr<ClusterCostModel>(new NoGainModel()));
+  ASSERT_OK(DeassignClusters(&g));
+  ClusterCostModel::SetModel(nullptr);
+
+  int cluster;
+  ASSERT_NOT_OK(GetNodeCluster(abs, &cluster));
+  ASSERT_NOT_OK(GetNodeCluster(matmul, &cluster));
+
+  RestoreEnv(env_map);
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -0,0 +1,158 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include <map>
+
+#include "gtest/gtest.h"
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/meta_optimizer.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+#include "ngraph_bridge/ngraph_cluster_manager.h"
+#include "ngraph_bridge/ngraph_clustering_cache.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+// Runs the ngraph-optimizer on A + B * C
+static void RunOptimizer(GraphDef* output) {
+  Scope root = Scope::NewRootScope();
+  auto A = ops::Const(root.WithOpName("A"), {3.f, 2.f});
+  auto B = ops::Const(root.WithOpName("B"), {3.f, 2.f});
+  auto C = ops::Const(root.WithOpName("C"), {3.f, 2.f});
+  auto Mul = ops::Mul(root.WithOpName("Mul"), B, C);
+  auto Add = ops::Add(root.WithOpName("Add"), A, Mul);
+
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+  for (auto node : graph.op_nodes()) {
+    node->set_requested_device("CPU");
+  }
+
+  grappler::GrapplerItem item;
+  graph.ToGraphDef(&item.graph);
+  ConfigProto config_proto;
+  auto backend_name = AttrValue();
+  backend_name.set_s("CPU");
+  auto device_id = AttrValue();
+  device_id.set_s("0");
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_optimizers("ngraph-optimizer");
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_meta_optimizer_iterations(RewriterConfig::ONE);
+  auto* custom_config = rewriter_config.add_custom_optimizers();
+  custom_config->set_name("ngraph-optimizer");
+  (*custom_config->mutable_parameter_map())["ngraph_backend"] = backend_name;
+  (*custom_config->mutable_parameter_map())["device_id"] = device_id;
+
+  tensorflow::grappler::MetaOptimizer optimizer(nullptr, config_proto);
+  ASSERT_OK(optimizer.Optimize(nullptr, item, output));
+}
+
+// The second run of the pass on the same graph hits in the cache, and gives
+// the graph, cluster graphs and cluster functions of the first run under new
+// cluster ids
+TEST(ClusteringCache, OptimizerHit) {
+  list<string> env_vars{"NGRAPH_TF_CLUSTERING_CACHE"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_CLUSTERING_CACHE", "1");
+  NGraphClusteringCache::Clear();
+
+  GraphDef first;
+  RunOptimizer(&first);
+  GraphDef second;
+  RunOptimizer(&second);
+
+  // The nodes may come in another order
+  ASSERT_EQ(first.node_size(), second.node_size());
+  map<string, NodeDef> second_nodes;
+  for (const auto& node : second.node()) {
+    second_nodes[node.name()] = node;
+  }
+  int num_encaps = 0;
+  for (const auto& node : first.node()) {
+    NodeDef first_node = node;
+    ASSERT_NE(second_nodes.find(node.name()), second_nodes.end());
+    NodeDef second_node = second_nodes[node.name()];
+    if (first_node.op() != "NGraphEncapsulate") {
+      ASSERT_EQ(first_node.DebugString(), second_node.DebugString());
+      continue;
+    }
+    num_encaps++;
+
+    // The cached graph keeps the node names of the first run, a clustered
+    // one would be named after the new cluster
+    int first_cluster = first_node.attr().at("ngraph_cluster").i();
+    int second_cluster = second_node.attr().at("ngraph_cluster").i();
+    ASSERT_NE(first_cluster, second_cluster);
+    ASSERT_EQ(second_node.name(), "ngraph_cluster_" + to_string(first_cluster));
+    ASSERT_EQ(
+        NGraphClusterManager::GetClusterGraph(first_cluster)->DebugString(),
+        NGraphClusterManager::GetClusterGraph(second_cluster)->DebugString());
+
+    // Only the cluster and graph ids differ
+    for (auto node : {&first_node, &second_node}) {
+      node->mutable_attr()->erase("ngraph_cluster");
+      node->mutable_attr()->erase("ngraph_graph_id");
+    }
+    ASSERT_EQ(first_node.DebugString(), second_node.DebugString());
+
+    // The functions of the clusters are the same, named after the cluster
+    // ids of their graph
+    const FunctionDef* first_fdef = nullptr;
+    for (const auto& fdef : first.library().function()) {
+      if (fdef.signature().name() ==
+          "ngraph_cluster_" + to_string(first_cluster)) {
+        first_fdef = &fdef;
+      }
+    }
+    const FunctionDef* second_fdef = nullptr;
+    for (const auto& fdef : second.library().function()) {
+      if (fdef.signature().name() ==
+          "ngraph_cluster_" + to_string(second_cluster)) {
+        second_fdef = &fdef;
+      }
+    }
+    ASSERT_NE(first_fdef, nullptr);
+    ASSERT_NE(second_fdef, nullptr);
+    FunctionDef renamed = *first_fdef;
+    renamed.mutable_signature()->set_name(second_fdef->signature().name());
+    ASSERT_EQ(renamed.DebugString(), second_fdef->DebugString());
+  }
+  ASSERT_EQ(num_encaps, 1);
+  ASSERT_EQ(first.library().function_size(),
+            second.library().function_size());
+
+  NGraphClusteringCache::Clear();
+  UnsetEnvVariable("NGRAPH_TF_CLUSTERING_CACHE");
+  RestoreEnv(env_map);
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
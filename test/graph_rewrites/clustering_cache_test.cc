@@ -0,0 +1,231 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/platform/env.h"
+
+#include "ngraph_bridge/ngraph_api.h"
+#include "ngraph_bridge/ngraph_cluster_cost_model.h"
+#include "ngraph_bridge/ngraph_cluster_manager.h"
+#include "ngraph_bridge/ngraph_clustering_cache.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+// Builds a graph with an NGraphEncapsulate of a new cluster (holding a single
+// Const) feeding an Identity, and the function library of the cluster
+static int BuildEncapsulatedGraph(int graph_id, GraphDef* graph_def,
+                                  FunctionDefLibrary* fdeflib) {
+  int cluster_id = NGraphClusterManager::NewCluster();
+  NodeDef* cluster_node =
+      NGraphClusterManager::GetClusterGraph(cluster_id)->add_node();
+  cluster_node->set_name("const");
+  cluster_node->set_op("Const");
+
+  NodeDef* encap = graph_def->add_node();
+  encap->set_name("ngraph_cluster_" + to_string(cluster_id));
+  encap->set_op("NGraphEncapsulate");
+  AddNodeAttr("ngraph_cluster", cluster_id, encap);
+  AddNodeAttr("ngraph_graph_id", graph_id, encap);
+
+  NodeDef* identity = graph_def->add_node();
+  identity->set_name("identity");
+  identity->set_op("Identity");
+  identity->add_input(encap->name());
+  identity->add_input("^" + encap->name());
+
+  fdeflib->add_function()->mutable_signature()->set_name(
+      "ngraph_cluster_" + to_string(cluster_id));
+  return cluster_id;
+}
+
+// A model with a setting that changes its decisions
+class ThresholdModel : public ClusterCostModel {
+ public:
+  explicit ThresholdModel(double threshold) : threshold_(threshold) {}
+  double Gain(const ClusterCost& cost) const override {
+    return ClusterCostModel::Gain(cost) - threshold_;
+  }
+  std::string Signature() const override { return to_string(threshold_); }
+
+ private:
+  double threshold_;
+};
+
+TEST(ClusteringCache, Key) {
+  NGraphClusterManager::EvictAllClusters();
+  GraphDef graph_def;
+  FunctionDefLibrary fdeflib;
+  BuildEncapsulatedGraph(0, &graph_def, &fdeflib);
+  std::unordered_map<string, string> config_map{{"ngraph_device_id", ""}};
+  uint64 key =
+      NGraphClusteringCache::ComputeKey(graph_def, "CPU", config_map, {});
+
+  // Neither the order of the nodes nor the graph ids matter
+  GraphDef reordered;
+  for (int i = graph_def.node_size() - 1; i >= 0; i--) {
+    *reordered.add_node() = graph_def.node(i);
+  }
+  (*reordered.mutable_node(1)->mutable_attr())["ngraph_graph_id"].set_i(5);
+  ASSERT_EQ(
+      NGraphClusteringCache::ComputeKey(reordered, "CPU", config_map, {}),
+      key);
+
+  // Nor the order of the functions in the library
+  GraphDef with_library = graph_def;
+  auto library = with_library.mutable_library();
+  library->add_function()->mutable_signature()->set_name("f");
+  library->add_function()->mutable_signature()->set_name("g");
+  uint64 library_key =
+      NGraphClusteringCache::ComputeKey(with_library, "CPU", config_map, {});
+  ASSERT_NE(library_key, key);
+  library->mutable_function()->SwapElements(0, 1);
+  ASSERT_EQ(
+      NGraphClusteringCache::ComputeKey(with_library, "CPU", config_map, {}),
+      library_key);
+
+  // The backend, config, skipped nodes and disabled ops do
+  ASSERT_NE(
+      NGraphClusteringCache::ComputeKey(graph_def, "INTERPRETER", config_map,
+                                        {}),
+      key);
+  config_map["ngraph_device_id"] = "1";
+  ASSERT_NE(
+      NGraphClusteringCache::ComputeKey(graph_def, "CPU", config_map, {}),
+      key);
+  config_map["ngraph_device_id"] = "";
+  ASSERT_NE(NGraphClusteringCache::ComputeKey(graph_def, "CPU", config_map,
+                                              {"identity"}),
+            key);
+  config::SetDisabledOps("Identity");
+  ASSERT_NE(
+      NGraphClusteringCache::ComputeKey(graph_def, "CPU", config_map, {}),
+      key);
+  config::SetDisabledOps("");
+
+  // And so does the cost model in use, when it is enabled
+  list<string> env_vars{"NGRAPH_TF_CLUSTER_COST_MODEL"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_CLUSTER_COST_MODEL", "1");
+  uint64 model_key =
+      NGraphClusteringCache::ComputeKey(graph_def, "CPU", config_map, {});
+  ClusterCostModel::SetModel(
+      std::unique_ptr<ClusterCostModel>(new ThresholdModel(1)));
+  uint64 threshold1_key =
+      NGraphClusteringCache::ComputeKey(graph_def, "CPU", config_map, {});
+  ClusterCostModel::SetModel(
+      std::unique_ptr<ClusterCostModel>(new ThresholdModel(2)));
+  uint64 threshold2_key =
+      NGraphClusteringCache::ComputeKey(graph_def, "CPU", config_map, {});
+  ClusterCostModel::SetModel(nullptr);
+  ASSERT_NE(threshold1_key, model_key);
+  ASSERT_NE(threshold2_key, threshold1_key);
+  ASSERT_EQ(
+      NGraphClusteringCache::ComputeKey(graph_def, "CPU", config_map, {}),
+      model_key);
+  UnsetEnvVariable("NGRAPH_TF_CLUSTER_COST_MODEL");
+  RestoreEnv(env_map);
+}
+
+TEST(ClusteringCache, Lookup) {
+  NGraphClusteringCache::Clear();
+  NGraphClusterManager::EvictAllClusters();
+  GraphDef graph_def;
+  FunctionDefLibrary fdeflib;
+  int cluster_id = BuildEncapsulatedGraph(3, &graph_def, &fdeflib);
+  ASSERT_OK(NGraphClusteringCache::Insert(42, graph_def, &fdeflib));
+
+  GraphDef cached;
+  FunctionDefLibrary cached_fdeflib;
+  ASSERT_FALSE(NGraphClusteringCache::Lookup(43, 7, &cached, &cached_fdeflib));
+  ASSERT_TRUE(NGraphClusteringCache::Lookup(42, 7, &cached, &cached_fdeflib));
+
+  // The cached graph runs a copy of the cluster under a new id
+  ASSERT_EQ(cached.node_size(), 2);
+  const NodeDef& encap = cached.node(0);
+  int new_cluster_id = encap.attr().at("ngraph_cluster").i();
+  ASSERT_NE(new_cluster_id, cluster_id);
+  ASSERT_EQ(encap.attr().at("ngraph_graph_id").i(), 7);
+  ASSERT_EQ(
+      NGraphClusterManager::GetClusterGraph(new_cluster_id)->DebugString(),
+      NGraphClusterManager::GetClusterGraph(cluster_id)->DebugString());
+  ASSERT_EQ(cached_fdeflib.function_size(), 1);
+  ASSERT_EQ(cached_fdeflib.function(0).signature().name(),
+            "ngraph_cluster_" + to_string(new_cluster_id));
+
+  // The cluster graphs are copied when inserting, so that evicting the
+  // clusters does not invalidate the cache
+  NGraphClusterManager::EvictAllClusters();
+  ASSERT_TRUE(NGraphClusteringCache::Lookup(42, 8, &cached, nullptr));
+  new_cluster_id = cached.node(0).attr().at("ngraph_cluster").i();
+  ASSERT_NE(NGraphClusterManager::GetClusterGraph(new_cluster_id), nullptr);
+  ASSERT_EQ(
+      NGraphClusterManager::GetClusterGraph(new_cluster_id)->node(0).op(),
+      "Const");
+
+  NGraphClusteringCache::Clear();
+  ASSERT_FALSE(NGraphClusteringCache::Lookup(42, 9, &cached, nullptr));
+}
+
+TEST(ClusteringCache, Directory) {
+  string dir = "/tmp/ngraph_clustering_cache_test_" + to_string(getpid());
+  ASSERT_OK(Env::Default()->RecursivelyCreateDir(dir));
+  SetEnvVariable("NGRAPH_TF_CLUSTERING_CACHE_DIR", dir);
+
+  NGraphClusteringCache::Clear();
+  NGraphClusterManager::EvictAllClusters();
+  GraphDef graph_def;
+  FunctionDefLibrary fdeflib;
+  BuildEncapsulatedGraph(3, &graph_def, &fdeflib);
+  ASSERT_OK(NGraphClusteringCache::Insert(42, graph_def, &fdeflib));
+
+  // Read back from the directory, as another process would
+  NGraphClusteringCache::Clear();
+  NGraphClusterManager::EvictAllClusters();
+  GraphDef cached;
+  FunctionDefLibrary cached_fdeflib;
+  ASSERT_TRUE(NGraphClusteringCache::Lookup(42, 7, &cached, &cached_fdeflib));
+  ASSERT_EQ(cached.node_size(), 2);
+  int new_cluster_id = cached.node(0).attr().at("ngraph_cluster").i();
+  ASSERT_EQ(
+      NGraphClusterManager::GetClusterGraph(new_cluster_id)->node(0).name(),
+      "const");
+  ASSERT_EQ(cached_fdeflib.function_size(), 1);
+  ASSERT_FALSE(NGraphClusteringCache::Lookup(43, 7, &cached, nullptr));
+
+  UnsetEnvVariable("NGRAPH_TF_CLUSTERING_CACHE_DIR");
+  NGraphClusteringCache::Clear();
+  NGraphClusterManager::EvictAllClusters();
+  int64 undeleted_files, undeleted_dirs;
+  ASSERT_OK(Env::Default()->DeleteRecursively(dir, &undeleted_files,
+                                              &undeleted_dirs));
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -494,6 +494,70 @@ TEST(DeadnessCheck, DTestG5) {
   ASSERT_NE(A_cluster, N5_Add_cluster);
 }
 
+// Graph 6
+//
+//               A(#True)[Const]    B(#True)[Const]
+//              /    \                 /
+//             /      \               /
+//            /        \             /
+//       N4(#P1)[Add]   N1(#True)[Mul]
+// N4 is created before N1, so the edge A->N4 is tried first. Contracting it
+// would make the output of A to N1 dead along with P1, so A must not be
+// clustered with N4, even though N1 has the True predicate
+// There should be 2 clusters
+// Cluster 1 : A, B and N1
+// Cluster 2 : N4
+TEST(DeadnessCheck, DTestG6) {
+  Scope root = Scope::NewRootScope();
+
+  auto dataX = ops::Placeholder(root.WithOpName("dataX"), DataType::DT_FLOAT);
+  auto predX = ops::Placeholder(root.WithOpName("PredX"), DataType::DT_BOOL);
+  auto SX = ops::Switch(root.WithOpName("SwitchX"), dataX, predX);
+
+  auto A = ops::Const(root.WithOpName("A"), {3.f, 2.f});
+  auto N4_Add = ops::Add(root.WithOpName("N4_Add"), A, SX.output_false);
+  auto B = ops::Const(root.WithOpName("B"), {3.f, 2.f});
+  auto N1_Mul = ops::Mul(root.WithOpName("N1_Mul"), A, B);
+
+  std::set<string> skip_these_nodes = {};
+
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+
+  std::map<std::string, Node*> node_map;
+  for (auto node : graph.op_nodes()) {
+    node_map[node->name()] = node;
+  }
+
+  // Check the edge order the test relies on
+  int a_to_n4_id = -1;
+  int a_to_n1_id = -1;
+  for (auto edge : node_map["A"]->out_edges()) {
+    if (edge->dst() == node_map["N4_Add"]) {
+      a_to_n4_id = edge->id();
+    } else if (edge->dst() == node_map["N1_Mul"]) {
+      a_to_n1_id = edge->id();
+    }
+  }
+  ASSERT_GE(a_to_n4_id, 0);
+  ASSERT_LT(a_to_n4_id, a_to_n1_id);
+
+  ASSERT_OK(MarkForClustering(&graph, skip_these_nodes, "CPU"));
+  ASSERT_OK(AssignClusters(&graph));
+
+  int A_cluster, B_cluster, N1_Mul_cluster, N4_Add_cluster;
+  ASSERT_OK(GetNodeCluster(node_map["A"], &A_cluster));
+  ASSERT_OK(GetNodeCluster(node_map["B"], &B_cluster));
+  ASSERT_OK(GetNodeCluster(node_map["N1_Mul"], &N1_Mul_cluster));
+  ASSERT_OK(GetNodeCluster(node_map["N4_Add"], &N4_Add_cluster));
+
+  // A, B and N1 are in the same cluster
+  ASSERT_EQ(A_cluster, N1_Mul_cluster);
+  ASSERT_EQ(B_cluster, N1_Mul_cluster);
+  // A and N4 are in different clusters
+  ASSERT_NE(A_cluster, N4_Add_cluster);
+}
+
 }  // namespace testing
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
@@ -294,6 +294,88 @@ TEST(CatalogTest, SmallGraph4) {
   NGraphCatalog::ClearCatalog();
 }
 
+// Test to check that the entries an NGraphEncapsulate kernel resolves at
+// construction agree with the key based lookups
+TEST(CatalogTest, EncapsulateEntries) {
+  Scope root = Scope::NewRootScope();
+
+  PartialTensorShape varShape({2, 2});
+  auto var = ops::Variable(root.WithOpName("Var"), varShape, DT_FLOAT);
+  auto init_value = ops::Const(root, {{1.f, 1.f}, {1.f, 1.f}});
+  auto var_assign = ops::Assign(root.WithOpName("Var_Assign"), var, init_value);
+
+  auto c = ops::Const(root, {{1.f, 1.f}, {1.f, 1.f}});
+
+  auto add = ops::Add(root.WithOpName("Add"), var, c);
+
+  auto assign = ops::Assign(root.WithOpName("Assign"), var, add);
+
+  std::set<string> skip_these_nodes = {};
+
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+
+  // Execute all the passes one by one
+  ASSERT_OK(CaptureVariables(&graph, skip_these_nodes));
+  ASSERT_OK(ReplaceModifiers(&graph, 0));
+  ASSERT_OK(MarkForClustering(&graph, skip_these_nodes, "CPU"));
+  ASSERT_OK(AssignClusters(&graph));
+  FunctionDefLibrary* fdeflib_new = new FunctionDefLibrary();
+  std::unordered_map<std::string, std::string> config_map;
+  config_map["ngraph_device_id"] = "";
+  ASSERT_OK(EncapsulateClusters(&graph, 0, fdeflib_new, config_map, {0, {}}));
+  ASSERT_OK(EnterInCatalog(&graph, 0));
+
+  int num_encaps = 0;
+  int num_variable_outputs = 0;
+  for (auto node : graph.op_nodes()) {
+    if (node->type_string() != "NGraphEncapsulate") {
+      continue;
+    }
+    num_encaps++;
+    int graph_id;
+    ASSERT_OK(GetNodeAttr(node->attrs(), "ngraph_graph_id", &graph_id));
+    auto entries = NGraphCatalog::GetEncapsulateEntries(
+        graph_id, node->name(), node->num_inputs(), node->num_outputs());
+    ASSERT_EQ(entries.input_variable_shared_names.size(), node->num_inputs());
+    ASSERT_EQ(entries.output_variable_shared_names.size(),
+              node->num_outputs());
+
+    for (int i = 0; i < node->num_inputs(); i++) {
+      ASSERT_EQ(entries.IsInputFromVariable(i),
+                NGraphCatalog::ExistsInInputVariableSharedNameMap(
+                    graph_id, node->name(), i));
+      if (entries.IsInputFromVariable(i)) {
+        ASSERT_EQ(entries.input_variable_shared_names[i],
+                  NGraphCatalog::GetInputVariableSharedName(
+                      graph_id, node->name(), i));
+      }
+    }
+    for (int i = 0; i < node->num_outputs(); i++) {
+      string key = NGraphCatalog::CreateNodeKey(graph_id, node->name(), i);
+      ASSERT_EQ(entries.IsOutputToVariable(i),
+                NGraphCatalog::ExistsInEncapOutputInfoMap(key));
+      if (entries.IsOutputToVariable(i)) {
+        num_variable_outputs++;
+        ASSERT_EQ(entries.output_variable_shared_names[i],
+                  NGraphCatalog::GetVariableSharedNameFromEncapOutputInfoMap(
+                      key));
+        ASSERT_EQ(entries.output_copy_to_tf[i],
+                  NGraphCatalog::GetCopyToTFFromEncapOutputInfoMap(key));
+      }
+      ASSERT_EQ(entries.output_needs_copy[i],
+                NGraphCatalog::EncapOutputIndexNeedsCopy(graph_id,
+                                                         node->name(), i));
+    }
+  }
+  ASSERT_GT(num_encaps, 0);
+  // Both Assign and Var_Assign are fed by the encapsulate
+  ASSERT_EQ(num_variable_outputs, 2);
+
+  // Clean up
+  NGraphCatalog::ClearCatalog();
+}
+
 }  // namespace testing
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
\ No newline at end of file
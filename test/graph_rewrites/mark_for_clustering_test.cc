@@ -14,12 +14,16 @@
  * limitations under the License.
  *******************************************************************************/
 
+#include <thread>
+
 #include "gtest/gtest.h"
 
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/node_builder.h"
 
 #include "logging/tf_graph_writer.h"
+#include "ngraph_bridge/ngraph_api.h"
+#include "ngraph_bridge/ngraph_backend_manager.h"
 #include "ngraph_bridge/ngraph_mark_for_clustering.h"
 #include "ngraph_bridge/ngraph_utils.h"
 #include "test/test_utilities.h"
@@ -80,6 +84,118 @@ TEST(MarkForClustering, SimpleTest) {
     ASSERT_EQ(backend, expected_backend);
   }
 }
+
+// Checks enough nodes for them to be spread over the thread pool, twice (the
+// second time the backend support answers are memoized), and makes sure that
+// the backend queried is kept alive in between
+TEST(MarkForClustering, ManyNodes) {
+  const int num_adds = 5000;
+  string backend_name;
+  ASSERT_OK(BackendManager::GetCurrentlySetBackendName(&backend_name));
+
+  for (int run = 0; run < 2; run++) {
+    Graph g(OpRegistry::Global());
+    Tensor t(DT_FLOAT, TensorShape{2, 3});
+    Node* prev;
+    ASSERT_OK(NodeBuilder("const", "Const")
+                  .Attr("dtype", DT_FLOAT)
+                  .Attr("value", t)
+                  .Finalize(&g, &prev));
+    vector<Node*> adds;
+    for (int i = 0; i < num_adds; i++) {
+      ASSERT_OK(NodeBuilder("add_" + to_string(i), "Add")
+                    .Input(prev, 0)
+                    .Input(prev, 0)
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(&g, &prev));
+      adds.push_back(prev);
+    }
+
+    // Not supported by the bridge
+    Tensor t_perm(DT_INT32, TensorShape{3});
+    Node* perm;
+    ASSERT_OK(NodeBuilder("perm", "Const")
+                  .Attr("dtype", DT_INT32)
+                  .Attr("value", t_perm)
+                  .Finalize(&g, &perm));
+    Node* invert;
+    ASSERT_OK(NodeBuilder("invert", "InvertPermutation")
+                  .Input(perm, 0)
+                  .Attr("T", DT_INT32)
+                  .Finalize(&g, &invert));
+
+    ASSERT_OK(MarkForClustering(&g, {}, backend_name));
+    for (auto add : adds) {
+      ASSERT_TRUE(NodeIsMarkedForClustering(add)) << add->name();
+    }
+    ASSERT_FALSE(NodeIsMarkedForClustering(invert));
+
+    ASSERT_NE(BackendManager::GetBackend(backend_name), nullptr);
+  }
 }
+
+// Runs passes on several threads right after the disabled ops changed: the
+// first one rebuilds the maps while the others wait to check their nodes,
+// and every pass sees the same op support
+TEST(MarkForClustering, ConcurrentPasses) {
+  const int num_threads = 4;
+  const int num_runs = 10;
+  string backend_name;
+  ASSERT_OK(BackendManager::GetCurrentlySetBackendName(&backend_name));
+  config::SetDisabledOps("Sub");
+
+  vector<Status> statuses(num_threads);
+  vector<int> num_wrong(num_threads, 0);
+  vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() -> void {
+      for (int run = 0; run < num_runs && statuses[t].ok(); run++) {
+        Graph g(OpRegistry::Global());
+        Tensor t_in(DT_FLOAT, TensorShape{2, 3});
+        Node* in;
+        Node* add;
+        Node* sub;
+        statuses[t] = NodeBuilder("const", "Const")
+                          .Attr("dtype", DT_FLOAT)
+                          .Attr("value", t_in)
+                          .Finalize(&g, &in);
+        if (statuses[t].ok()) {
+          statuses[t] = NodeBuilder("add", "Add")
+                            .Input(in, 0)
+                            .Input(in, 0)
+                            .Attr("T", DT_FLOAT)
+                            .Finalize(&g, &add);
+        }
+        if (statuses[t].ok()) {
+          statuses[t] = NodeBuilder("sub", "Sub")
+                            .Input(add, 0)
+                            .Input(in, 0)
+                            .Attr("T", DT_FLOAT)
+                            .Finalize(&g, &sub);
+        }
+        if (statuses[t].ok()) {
+          statuses[t] = MarkForClustering(&g, {}, backend_name);
+        }
+        if (statuses[t].ok() && (!NodeIsMarkedForClustering(add) ||
+                                 NodeIsMarkedForClustering(sub))) {
+          num_wrong[t]++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  config::SetDisabledOps("");
+  for (int t = 0; t < num_threads; t++) {
+    ASSERT_OK(statuses[t]);
+    ASSERT_EQ(num_wrong[t], 0) << "thread " << t;
+  }
 }
-}
\ No newline at end of file
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include "gtest/gtest.h"
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+
+#include "ngraph_bridge/ngraph_replace_cache_dataset.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+// Builds input -> CacheDataset(filename) -> RepeatDataset(3) ->
+// PrefetchDataset(2) and returns the prefetch node
+static Node* BuildCacheRepeatPrefetch(Graph* graph, const string& filename) {
+  DataTypeVector output_types{DT_FLOAT};
+  std::vector<PartialTensorShape> output_shapes{PartialTensorShape({2})};
+
+  Node* input;
+  TF_CHECK_OK(NodeBuilder("input", "Placeholder")
+                  .Attr("dtype", DT_VARIANT)
+                  .Finalize(graph, &input));
+  Tensor filename_value(DT_STRING, TensorShape({}));
+  filename_value.scalar<string>()() = filename;
+  Node* filename_node;
+  TF_CHECK_OK(NodeBuilder("filename", "Const")
+                  .Attr("dtype", DT_STRING)
+                  .Attr("value", filename_value)
+                  .Finalize(graph, &filename_node));
+  Tensor count_value(DT_INT64, TensorShape({}));
+  count_value.scalar<int64>()() = 3;
+  Node* count;
+  TF_CHECK_OK(NodeBuilder("count", "Const")
+                  .Attr("dtype", DT_INT64)
+                  .Attr("value", count_value)
+                  .Finalize(graph, &count));
+  Tensor buffer_size_value(DT_INT64, TensorShape({}));
+  buffer_size_value.scalar<int64>()() = 2;
+  Node* buffer_size;
+  TF_CHECK_OK(NodeBuilder("buffer_size", "Const")
+                  .Attr("dtype", DT_INT64)
+                  .Attr("value", buffer_size_value)
+                  .Finalize(graph, &buffer_size));
+
+  Node* cache;
+  TF_CHECK_OK(NodeBuilder("cache", "CacheDataset")
+                  .Input(input)
+                  .Input(filename_node)
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &cache));
+  Node* repeat;
+  TF_CHECK_OK(NodeBuilder("repeat", "RepeatDataset")
+                  .Input(cache)
+                  .Input(count)
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &repeat));
+  Node* prefetch;
+  TF_CHECK_OK(NodeBuilder("prefetch", "PrefetchDataset")
+                  .Input(repeat)
+                  .Input(buffer_size)
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &prefetch));
+  return prefetch;
+}
+
+static int CountNodes(Graph* graph, const string& type) {
+  int count = 0;
+  for (auto node : graph->op_nodes()) {
+    if (node->type_string() == type) {
+      count++;
+    }
+  }
+  return count;
+}
+
+TEST(ReplaceCacheDataset, InMemoryCache) {
+  setenv("NGRAPH_TF_USE_DEVICE_CACHE", "1", 1);
+  setenv("NGRAPH_TF_DEVICE_CACHE_MAX_BYTES", "1024", 1);
+  Graph graph(OpRegistry::Global());
+  Node* prefetch = BuildCacheRepeatPrefetch(&graph, "");
+  ASSERT_OK(ReplaceCacheDataset(&graph, prefetch, "iterator", 2));
+  unsetenv("NGRAPH_TF_USE_DEVICE_CACHE");
+  unsetenv("NGRAPH_TF_DEVICE_CACHE_MAX_BYTES");
+
+  ASSERT_EQ(CountNodes(&graph, "CacheDataset"), 0);
+  ASSERT_EQ(CountNodes(&graph, "RepeatDataset"), 0);
+
+  Node* replacement;
+  ASSERT_OK(prefetch->input_node(0, &replacement));
+  ASSERT_EQ(replacement->type_string(), "NGraphCacheDataset");
+  Node* input;
+  ASSERT_OK(replacement->input_node(0, &input));
+  ASSERT_EQ(input->name(), "input");
+  Node* count;
+  ASSERT_OK(replacement->input_node(1, &count));
+  ASSERT_EQ(count->name(), "count");
+
+  string iterator_name;
+  ASSERT_OK(
+      GetNodeAttr(replacement->attrs(), "iterator_name", &iterator_name));
+  ASSERT_EQ(iterator_name, "iterator");
+  int graph_id;
+  ASSERT_OK(GetNodeAttr(replacement->attrs(), "graph_id", &graph_id));
+  ASSERT_EQ(graph_id, 2);
+  int64 max_bytes;
+  ASSERT_OK(GetNodeAttr(replacement->attrs(), "max_bytes", &max_bytes));
+  ASSERT_EQ(max_bytes, 1024);
+  bool shuffle;
+  ASSERT_OK(GetNodeAttr(replacement->attrs(), "shuffle", &shuffle));
+  ASSERT_FALSE(shuffle);
+}
+
+TEST(ReplaceCacheDataset, NotReplaced) {
+  // Disabled
+  {
+    Graph graph(OpRegistry::Global());
+    Node* prefetch = BuildCacheRepeatPrefetch(&graph, "");
+    ASSERT_OK(ReplaceCacheDataset(&graph, prefetch, "iterator", 2));
+    ASSERT_EQ(CountNodes(&graph, "CacheDataset"), 1);
+    ASSERT_EQ(CountNodes(&graph, "NGraphCacheDataset"), 0);
+  }
+
+  // The file cache is left to TF
+  setenv("NGRAPH_TF_USE_DEVICE_CACHE", "1", 1);
+  {
+    Graph graph(OpRegistry::Global());
+    Node* prefetch = BuildCacheRepeatPrefetch(&graph, "/tmp/cache");
+    ASSERT_OK(ReplaceCacheDataset(&graph, prefetch, "iterator", 2));
+    ASSERT_EQ(CountNodes(&graph, "CacheDataset"), 1);
+    ASSERT_EQ(CountNodes(&graph, "NGraphCacheDataset"), 0);
+  }
+  unsetenv("NGRAPH_TF_USE_DEVICE_CACHE");
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * Copyright 2017-2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include "gtest/gtest.h"
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/graph/graph.h"
+
+#include "ngraph_bridge/enable_variable_ops/ngraph_replace_save_ops.h"
+#include "ngraph_bridge/ngraph_capture_variables.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+// Var1    Var2    Const
+//   \      |       /
+//    \     |      /
+//        SaveV2
+//
+// SaveV2 becomes an NGraphSaveV2 reading the variables itself, only the
+// Const stays a data input
+TEST(ReplaceSaveOps, VariablesAndTensor) {
+  Scope root = Scope::NewRootScope();
+
+  PartialTensorShape varShape({2, 2});
+  auto var1 = ops::Variable(root.WithOpName("Var1"), varShape, DT_FLOAT);
+  auto var2 = ops::Variable(root.WithOpName("Var2"), varShape, DT_FLOAT);
+  auto val = ops::Const(root.WithOpName("Val"), {{1.f, 1.f}, {1.f, 1.f}});
+  auto prefix = ops::Const(root.WithOpName("Prefix"), string("model"));
+  auto names = ops::Const(root.WithOpName("Names"),
+                          {string("var1"), string("val"), string("var2")});
+  auto slices = ops::Const(root.WithOpName("Slices"),
+                           {string(""), string(""), string("")});
+  auto save = ops::SaveV2(root.WithOpName("Save"), prefix, names, slices,
+                          {Output(var1), Output(val), Output(var2)});
+
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+
+  std::set<string> skip_these_nodes = {};
+  ASSERT_OK(CaptureVariables(&graph, skip_these_nodes));
+  ASSERT_OK(ReplaceSaveOps(&graph));
+
+  map<string, Node*> node_map;
+  Node* ng_save = nullptr;
+  for (auto node : graph.op_nodes()) {
+    node_map[node->name()] = node;
+    ASSERT_NE(node->type_string(), "SaveV2");
+    if (node->type_string() == "NGraphSaveV2") {
+      ng_save = node;
+    }
+  }
+  ASSERT_NE(ng_save, nullptr);
+
+  std::vector<string> variable_shared_names;
+  ASSERT_OK(GetNodeAttr(ng_save->attrs(), "variable_shared_names",
+                        &variable_shared_names));
+  ASSERT_EQ(variable_shared_names, std::vector<string>({"Var1", "", "Var2"}));
+
+  // prefix, tensor_names, shape_and_slices and Val
+  ASSERT_EQ(ng_save->num_inputs(), 4);
+  Node* input_3;
+  ASSERT_OK(ng_save->input_node(3, &input_3));
+  ASSERT_EQ(input_3->name(), "Val");
+
+  // The variables are only control inputs
+  std::set<string> control_inputs;
+  for (auto edge : ng_save->in_edges()) {
+    if (edge->IsControlEdge()) {
+      control_inputs.insert(edge->src()->name());
+    }
+  }
+  ASSERT_EQ(control_inputs.count("Var1"), 1);
+  ASSERT_EQ(control_inputs.count("Var2"), 1);
+  for (auto edge : node_map.at("Var1")->out_edges()) {
+    ASSERT_TRUE(edge->IsControlEdge() || edge->dst() != ng_save);
+  }
+}
+
+// A SaveV2 without NGraphVariable inputs is left alone
+TEST(ReplaceSaveOps, NoVariables) {
+  Scope root = Scope::NewRootScope();
+
+  auto val = ops::Const(root.WithOpName("Val"), {{1.f, 1.f}, {1.f, 1.f}});
+  auto prefix = ops::Const(root.WithOpName("Prefix"), string("model"));
+  auto names = ops::Const(root.WithOpName("Names"), {string("val")});
+  auto slices = ops::Const(root.WithOpName("Slices"), {string("")});
+  auto save = ops::SaveV2(root.WithOpName("Save"), prefix, names, slices,
+                          {Output(val)});
+
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+
+  ASSERT_OK(ReplaceSaveOps(&graph));
+
+  int num_save = 0;
+  for (auto node : graph.op_nodes()) {
+    ASSERT_NE(node->type_string(), "NGraphSaveV2");
+    if (node->type_string() == "SaveV2") {
+      num_save++;
+    }
+  }
+  ASSERT_EQ(num_save, 1);
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -119,6 +119,90 @@ TEST(NGVarUpdateNGTensorOpTest, SimpleGraph1) {
   node_map.clear();
 }  // end SimpleGraph1
 
+// TF ops only reading the variable get it through a sync node that copies the
+// device value lazily, instead of the variable copying it every step
+TEST(NGVarUpdateNGTensorOpTest, SimpleGraph2) {
+  Graph g(OpRegistry::Global());
+  PartialTensorShape varShape({2, 2});
+
+  Node* var_node;
+  ASSERT_OK(NodeBuilder("var_node", "NGraphVariable")
+                .Attr("shape", varShape)
+                .Attr("dtype", DT_FLOAT)
+                .Attr("just_looking", false)
+                .Attr("copy_to_tf", false)
+                .Attr("container", "")
+                .Attr("shared_name", "node1")
+                .Attr("ngraph_graph_id", 1)
+                .Attr("_ngraph_backend", "CPU")
+                .Finalize(&g, &var_node));
+
+  std::vector<DataType> input_types;
+  input_types.push_back(DT_FLOAT);
+  std::vector<DataType> output_types;
+  output_types.push_back(DT_FLOAT);
+  std::vector<NodeBuilder::NodeOut> inputs;
+  inputs.push_back(NodeBuilder::NodeOut(var_node, 0));
+  Node* encap_node;
+  ASSERT_OK(NodeBuilder("encap_node", "NGraphEncapsulate")
+                .Attr("Targuments", input_types)
+                .Attr("Tresults", output_types)
+                .Attr("ngraph_cluster", 1)
+                .Attr("ngraph_graph_id", 1)
+                .Attr("ngraph_backend", "CPU")
+                .Attr("ngraph_device_id", "1")
+                .Input(inputs)
+                .Finalize(&g, &encap_node));
+
+  Node* identity;
+  ASSERT_OK(NodeBuilder("identity", "Identity")
+                .Input(var_node)
+                .Attr("T", DT_FLOAT)
+                .Finalize(&g, &identity));
+  g.AddEdge(encap_node, Graph::kControlSlot, identity, Graph::kControlSlot);
+
+  Node* source = g.source_node();
+  Node* sink = g.sink_node();
+  g.AddEdge(source, Graph::kControlSlot, var_node, Graph::kControlSlot);
+  g.AddEdge(identity, Graph::kControlSlot, sink, Graph::kControlSlot);
+
+  ASSERT_OK(RewriteForTracking(&g, 0));
+
+  map<string, Node*> node_map;
+  for (auto node : g.op_nodes()) {
+    node_map[node->name()] = node;
+  }
+
+  // The variable does not copy to TF on its own
+  Node* new_var_node = node_map.at("var_node/peek/non_ng_outputs/gid_0");
+  bool copy_to_tf;
+  ASSERT_OK(GetNodeAttr(new_var_node->attrs(), "copy_to_tf", &copy_to_tf));
+  ASSERT_FALSE(copy_to_tf);
+
+  ASSERT_NE(
+      node_map.find("var_node/peek/non_ng_outputs/gid_0/sync_to_tf/identity"),
+      node_map.end());
+  Node* sync_node =
+      node_map.at("var_node/peek/non_ng_outputs/gid_0/sync_to_tf/identity");
+  ASSERT_EQ(sync_node->type_string(), "NGraphVariableSyncTFTensor");
+
+  Node *in_0 = nullptr, *in_ctrl = nullptr;
+  for (auto edge : sync_node->in_edges()) {
+    if (edge->dst_input() == 0) {
+      in_0 = edge->src();
+    } else if (edge->IsControlEdge()) {
+      in_ctrl = edge->src();
+    }
+  }
+  ASSERT_EQ(in_0, new_var_node);
+  // Inherits the control dependency of the reader
+  ASSERT_EQ(in_ctrl, encap_node);
+
+  Node* identity_in_0;
+  ASSERT_OK(identity->input_node(0, &identity_in_0));
+  ASSERT_EQ(identity_in_0, sync_node);
+}  // end SimpleGraph2
+
 }  // testing
 }  // ngraph_bridge
 }  // tensorflow
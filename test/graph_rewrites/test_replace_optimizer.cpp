@@ -98,9 +98,13 @@ TEST(ReplaceModifierTest, Momentum2) {
   ASSERT_NE(node_map.find("Momentum_Add_1"), node_map.end());
   ASSERT_NE(node_map.find("Momentum_Sub"), node_map.end());
   ASSERT_NE(node_map.find("Momentum_NGraphAssign"), node_map.end());
+  // The var update reads the new accumulator value, not the NGraphAssign
+  const Edge* mul1_input;
+  ASSERT_OK(node_map["Momentum_Mul1"]->input_edge(0, &mul1_input));
+  ASSERT_EQ(mul1_input->src()->name(), "Momentum_Add");
   for (auto edge : graph.edges()) {
     if (edge->src()->name() == "Momentum_AccumAssign") {
-      ASSERT_EQ(edge->dst()->name(), "Momentum_Mul1");
+      ASSERT_TRUE(edge->IsControlEdge());
     } else if (edge->src()->name() == "Momentum_NGraphAssign") {
       ASSERT_EQ(edge->dst()->name(), "_SINK");
     } else if (edge->src()->name() == "Momentum_Mul1") {
@@ -108,6 +112,154 @@ TEST(ReplaceModifierTest, Momentum2) {
     }
   }
 }
+
+// ReplaceModifier
+TEST(ReplaceModifierTest, Adam) {
+  Scope root = Scope::NewRootScope();
+
+  PartialTensorShape varShape({2, 2});
+  auto var = ops::Variable(root.WithOpName("Var"), varShape, DT_FLOAT);
+  auto init_value = ops::Const(root, {{1.f, 1.f}, {1.f, 1.f}});
+  auto var_assign = ops::Assign(root.WithOpName("Assign1"), var, init_value);
+
+  auto m = ops::Variable(root.WithOpName("m"), varShape, DT_FLOAT);
+  auto init_value_m = ops::Const(root, {{0.f, 0.f}, {0.f, 0.f}});
+  auto m_assign = ops::Assign(root.WithOpName("Assign2"), m, init_value_m);
+
+  auto v = ops::Variable(root.WithOpName("v"), varShape, DT_FLOAT);
+  auto init_value_v = ops::Const(root, {{0.f, 0.f}, {0.f, 0.f}});
+  auto v_assign = ops::Assign(root.WithOpName("Assign3"), v, init_value_v);
+
+  auto grad = ops::Const(root, {{2.f, 2.f}, {2.f, 2.f}});
+  auto beta1_power = ops::Const(root, 0.9f);
+  auto beta2_power = ops::Const(root, 0.999f);
+  auto lr = ops::Const(root, 0.01f);
+  auto beta1 = ops::Const(root, 0.9f);
+  auto beta2 = ops::Const(root, 0.999f);
+  auto epsilon = ops::Const(root, 1e-8f);
+
+  auto applyadam =
+      ops::ApplyAdam(root.WithOpName("Adam"), var, m, v, beta1_power,
+                     beta2_power, lr, beta1, beta2, epsilon, grad);
+
+  std::set<string> skip_these_nodes = {};
+
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(&graph));
+
+  ASSERT_OK(CaptureVariables(&graph, skip_these_nodes));
+  map<string, Node*> node_map;
+  for (auto node : graph.op_nodes()) {
+    node_map[node->name()] = node;
+  }
+  ASSERT_EQ(node_map.find("Adam")->second->type_string(), "NGraphApplyAdam");
+  node_map.clear();
+
+  ASSERT_OK(ReplaceModifiers(&graph, 0));
+  for (auto node : graph.op_nodes()) {
+    node_map[node->name()] = node;
+  }
+  ASSERT_EQ(node_map.find("Adam"), node_map.end());
+  ASSERT_NE(node_map.find("Adam_One"), node_map.end());
+  ASSERT_NE(node_map.find("Adam_Lr_t"), node_map.end());
+  ASSERT_NE(node_map.find("Adam_M_t"), node_map.end());
+  ASSERT_NE(node_map.find("Adam_V_t"), node_map.end());
+  ASSERT_NE(node_map.find("Adam_Sub"), node_map.end());
+  ASSERT_EQ(node_map.find("Adam_Add_Nesterov"), node_map.end());
+
+  // Each of var, m and v is updated by an NGraphAssign, whose value does not
+  // depend on any other NGraphAssign
+  map<string, pair<string, string>> assigns = {
+      {"Adam_NGraphAssign", {"Var", "Adam_Sub"}},
+      {"Adam_MAssign", {"m", "Adam_M_t"}},
+      {"Adam_VAssign", {"v", "Adam_V_t"}}};
+  for (const auto& assign : assigns) {
+    ASSERT_NE(node_map.find(assign.first), node_map.end());
+    Node* assign_node = node_map[assign.first];
+    ASSERT_EQ(assign_node->type_string(), "NGraphAssign");
+    Node* input;
+    ASSERT_OK(assign_node->input_node(0, &input));
+    ASSERT_EQ(input->name(), assign.second.first);
+    ASSERT_EQ(input->type_string(), "NGraphVariable");
+    ASSERT_OK(assign_node->input_node(1, &input));
+    ASSERT_EQ(input->name(), assign.second.second);
+  }
+  for (auto edge : graph.edges()) {
+    if (edge->IsControlEdge()) {
+      continue;
+    }
+    if (edge->dst()->type_string() != "NGraphAssign") {
+      ASSERT_NE(edge->src()->type_string(), "NGraphAssign")
+          << edge->DebugString();
+    }
+  }
+}
+
+// Builds var -= ApplyAdam(...) for variables of type dtype
+static void BuildAdamGraph(DataType dtype, Graph* graph) {
+  Scope root = Scope::NewRootScope();
+  auto cast = [&root, dtype](Input value) -> Output {
+    return ops::Cast(root, value, dtype);
+  };
+
+  PartialTensorShape varShape({2, 2});
+  auto var = ops::Variable(root.WithOpName("Var"), varShape, dtype);
+  auto var_assign = ops::Assign(root.WithOpName("Assign1"), var,
+                                cast(ops::Const(root, 1.f, {2, 2})));
+  auto m = ops::Variable(root.WithOpName("m"), varShape, dtype);
+  auto m_assign = ops::Assign(root.WithOpName("Assign2"), m,
+                              cast(ops::Const(root, 0.f, {2, 2})));
+  auto v = ops::Variable(root.WithOpName("v"), varShape, dtype);
+  auto v_assign = ops::Assign(root.WithOpName("Assign3"), v,
+                              cast(ops::Const(root, 0.f, {2, 2})));
+
+  auto applyadam = ops::ApplyAdam(
+      root.WithOpName("Adam"), var, m, v, cast(ops::Const(root, 0.9f)),
+      cast(ops::Const(root, 0.999f)), cast(ops::Const(root, 0.01f)),
+      cast(ops::Const(root, 0.9f)), cast(ops::Const(root, 0.999f)),
+      cast(ops::Const(root, 1e-8f)), cast(ops::Const(root, 2.f, {2, 2})));
+  TF_CHECK_OK(root.ToGraph(graph));
+}
+
+// ReplaceModifier: ApplyAdam of half precision variables is decomposed too
+TEST(ReplaceModifierTest, AdamHalf) {
+  Graph graph(OpRegistry::Global());
+  BuildAdamGraph(DT_HALF, &graph);
+
+  ASSERT_OK(CaptureVariables(&graph, {}));
+  ASSERT_OK(ReplaceModifiers(&graph, 0));
+  map<string, Node*> node_map;
+  for (auto node : graph.op_nodes()) {
+    node_map[node->name()] = node;
+  }
+  ASSERT_EQ(node_map.find("Adam"), node_map.end());
+  ASSERT_NE(node_map.find("Adam_One"), node_map.end());
+  DataType dtype;
+  ASSERT_OK(GetNodeAttr(node_map["Adam_One"]->attrs(), "dtype", &dtype));
+  ASSERT_EQ(dtype, DT_HALF);
+  Tensor one;
+  ASSERT_OK(GetNodeAttr(node_map["Adam_One"]->attrs(), "value", &one));
+  ASSERT_EQ(static_cast<float>(one.scalar<Eigen::half>()()), 1.f);
+  ASSERT_NE(node_map.find("Adam_NGraphAssign"), node_map.end());
+}
+
+// ReplaceModifier: ApplyAdam of a type the decomposition does not support
+// is left to TF, on the captured variables
+TEST(ReplaceModifierTest, AdamUnsupportedType) {
+  Graph graph(OpRegistry::Global());
+  BuildAdamGraph(DT_INT32, &graph);
+
+  ASSERT_OK(CaptureVariables(&graph, {}));
+  ASSERT_OK(ReplaceModifiers(&graph, 0));
+  map<string, Node*> node_map;
+  for (auto node : graph.op_nodes()) {
+    node_map[node->name()] = node;
+  }
+  ASSERT_NE(node_map.find("Adam"), node_map.end());
+  ASSERT_EQ(node_map["Adam"]->type_string(), "ApplyAdam");
+  ASSERT_EQ(node_map["Var"]->type_string(), "NGraphVariable");
+  ASSERT_EQ(node_map.find("Adam_One"), node_map.end());
+}
 }  // namespace testing
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include "ngraph_bridge/ngraph_device_prefetch_autotuner.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+// Runs one tuning interval with the given per element times
+static void RunInterval(NGraphDevicePrefetchAutotuner& autotuner,
+                        int64 copy_us, int64 producer_stall_us,
+                        int64 compute_us, int64 consumer_stall_us) {
+  for (int i = 0; i < NGraphDevicePrefetchAutotuner::kTuneInterval; i++) {
+    autotuner.RecordCopy(copy_us, producer_stall_us);
+    autotuner.RecordCompute(compute_us, consumer_stall_us);
+  }
+}
+
+TEST(DevicePrefetchAutotuner, StartsWithOneSlot) {
+  NGraphDevicePrefetchAutotuner autotuner(4);
+  ASSERT_EQ(autotuner.GetDepth(), 1);
+  ASSERT_EQ(autotuner.GetMaxDepth(), 4);
+
+  // Fast copies and no waiting, nothing to tune
+  RunInterval(autotuner, 10, 0, 100, 0);
+  ASSERT_EQ(autotuner.GetDepth(), 1);
+  ASSERT_EQ(autotuner.GetProducerStallUs(), 0);
+  ASSERT_EQ(autotuner.GetConsumerStallUs(), 0);
+}
+
+// The copies take 3 times as long as the executions, keep 3 slots
+TEST(DevicePrefetchAutotuner, CopyBound) {
+  NGraphDevicePrefetchAutotuner autotuner(4);
+  RunInterval(autotuner, 300, 0, 100, 200);
+  ASSERT_EQ(autotuner.GetDepth(), 3);
+  ASSERT_NEAR(autotuner.GetCopyTimeUs(), 300, 1e-6);
+  ASSERT_NEAR(autotuner.GetComputeTimeUs(), 100, 1e-6);
+  ASSERT_EQ(autotuner.GetConsumerStallUs(),
+            200 * NGraphDevicePrefetchAutotuner::kTuneInterval);
+}
+
+// Both sides wait on each other, add a slot per interval up to the maximum
+TEST(DevicePrefetchAutotuner, BurstyCopies) {
+  NGraphDevicePrefetchAutotuner autotuner(3);
+  RunInterval(autotuner, 50, 50, 100, 50);
+  ASSERT_EQ(autotuner.GetDepth(), 2);
+  RunInterval(autotuner, 50, 50, 100, 50);
+  ASSERT_EQ(autotuner.GetDepth(), 3);
+  RunInterval(autotuner, 50, 50, 100, 50);
+  ASSERT_EQ(autotuner.GetDepth(), 3);
+}
+
+// Once the executions stop waiting, drop the slots that are not needed
+TEST(DevicePrefetchAutotuner, Shrinks) {
+  NGraphDevicePrefetchAutotuner autotuner(4);
+  RunInterval(autotuner, 50, 50, 100, 50);
+  RunInterval(autotuner, 50, 50, 100, 50);
+  RunInterval(autotuner, 50, 50, 100, 50);
+  ASSERT_EQ(autotuner.GetDepth(), 4);
+
+  RunInterval(autotuner, 50, 0, 100, 0);
+  ASSERT_EQ(autotuner.GetDepth(), 3);
+  RunInterval(autotuner, 50, 0, 100, 0);
+  RunInterval(autotuner, 50, 0, 100, 0);
+  RunInterval(autotuner, 50, 0, 100, 0);
+  ASSERT_EQ(autotuner.GetDepth(), 1);
+}
+
+TEST(DevicePrefetchAutotuner, MaxDepthFromEnv) {
+  unsetenv("NGRAPH_TF_PREFETCH_MAX_DEVICE_DEPTH");
+  ASSERT_EQ(NGraphDevicePrefetchAutotuner::GetMaxDepthFromEnv(), 4);
+  setenv("NGRAPH_TF_PREFETCH_MAX_DEVICE_DEPTH", "2", 1);
+  ASSERT_EQ(NGraphDevicePrefetchAutotuner::GetMaxDepthFromEnv(), 2);
+  setenv("NGRAPH_TF_PREFETCH_MAX_DEVICE_DEPTH", "0", 1);
+  ASSERT_EQ(NGraphDevicePrefetchAutotuner::GetMaxDepthFromEnv(), 1);
+  unsetenv("NGRAPH_TF_PREFETCH_MAX_DEVICE_DEPTH");
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
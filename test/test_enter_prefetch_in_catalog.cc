@@ -32,6 +32,7 @@
 #include "ngraph_bridge/ngraph_encapsulate_clusters.h"
 #include "ngraph_bridge/ngraph_enter_prefetch_in_catalog.h"
 #include "ngraph_bridge/ngraph_mark_for_clustering.h"
+#include "ngraph_bridge/ngraph_prefetch_shared_data.h"
 #include "ngraph_bridge/ngraph_rewrite_for_tracking.h"
 #include "ngraph_bridge/ngraph_utils.h"
 #include "ngraph_bridge/version.h"
@@ -59,6 +60,19 @@ Status LoadGraphFromPbTxt(const string& pb_file, Graph* input_graph) {
   return status;
 }
 
+// Marks the iterator as fed by a NGraphPrefetchDataset when the variables of
+// the graph capture_graph_id were captured
+static void MarkIteratorPrefetched(Graph* graph, const string& iterator_name,
+                                   int capture_graph_id) {
+  for (auto node : graph->op_nodes()) {
+    if (node->name() == iterator_name) {
+      node->AddAttr("_ngraph_prefetch_graph_id", capture_graph_id);
+    }
+  }
+  NGraphCatalog::AddToPrefetchDatasetIterators(capture_graph_id,
+                                               iterator_name);
+}
+
 TEST(PrefetchCatalogTest, SmallGraph1) {
   GraphConstructorOptions opts;
   opts.allow_internal_ops = true;
@@ -71,6 +85,7 @@ TEST(PrefetchCatalogTest, SmallGraph1) {
   // and using the encapsulated_0003.pbtxt
   ASSERT_OK(
       LoadGraphFromPbTxt("test_catalog_for_prefetch.pbtxt", &input_graph));
+  MarkIteratorPrefetched(&input_graph, "IteratorV2", 0);
 
   ASSERT_OK(EnterPrefetchInCatalog(&input_graph, 0));
   ASSERT_TRUE(
@@ -83,6 +98,12 @@ TEST(PrefetchCatalogTest, SmallGraph1) {
   indexes = NGraphCatalog::GetIndexesFromPrefetchedInputIndexMap(
       0, "ngraph_cluster_4");
   ASSERT_EQ(indexes, expected);
+  ASSERT_EQ(
+      NGraphCatalog::GetPrefetchedInputComponent(0, "ngraph_cluster_4", 0), 0);
+  ASSERT_TRUE(
+      NGraphCatalog::ExistsInPrefetchIteratorMap(0, "ngraph_cluster_4"));
+  ASSERT_EQ(NGraphCatalog::GetPrefetchIterator(0, "ngraph_cluster_4"),
+            "IteratorV2");
 
   // Clean up
   NGraphCatalog::ClearCatalog();
@@ -96,6 +117,8 @@ TEST(PrefetchCatalogTest, SmallGraph2) {
   // Now read the graph
   ASSERT_OK(
       LoadGraphFromPbTxt("test_catalog_for_prefetch_1.pbtxt", &input_graph));
+  MarkIteratorPrefetched(&input_graph,
+                         "input_processing/batch_processing/IteratorV2", 0);
 
   ASSERT_OK(EnterPrefetchInCatalog(&input_graph, 0));
   ASSERT_TRUE(
@@ -109,11 +132,119 @@ TEST(PrefetchCatalogTest, SmallGraph2) {
   indexes = NGraphCatalog::GetIndexesFromPrefetchedInputIndexMap(
       0, "ngraph_cluster_340");
   ASSERT_EQ(indexes, expected);
+  // The dataset components feed the encapsulate in the reverse order
+  ASSERT_EQ(
+      NGraphCatalog::GetPrefetchedInputComponent(0, "ngraph_cluster_340", 2),
+      1);
+  ASSERT_EQ(
+      NGraphCatalog::GetPrefetchedInputComponent(0, "ngraph_cluster_340", 3),
+      0);
+  ASSERT_EQ(NGraphCatalog::GetPrefetchIterator(0, "ngraph_cluster_340"),
+            "input_processing/batch_processing/IteratorV2");
 
   // Clean up
   NGraphCatalog::ClearCatalog();
 }
 
+// The iterator is looked up under the id of the graph it was captured in,
+// which differs from the id of the encapsulated (pruned) graph
+TEST(PrefetchCatalogTest, IteratorOfCapturedGraph) {
+  NGraphCatalog::ClearCatalog();
+
+  // Not fed by a NGraphPrefetchDataset
+  {
+    Graph input_graph(OpRegistry::Global());
+    ASSERT_OK(
+        LoadGraphFromPbTxt("test_catalog_for_prefetch.pbtxt", &input_graph));
+    ASSERT_OK(EnterPrefetchInCatalog(&input_graph, 5));
+    ASSERT_FALSE(
+        NGraphCatalog::ExistsInPrefetchedInputIndexMap(5, "ngraph_cluster_4"));
+  }
+
+  // An iterator of the same name captured in another graph
+  {
+    Graph input_graph(OpRegistry::Global());
+    ASSERT_OK(
+        LoadGraphFromPbTxt("test_catalog_for_prefetch.pbtxt", &input_graph));
+    MarkIteratorPrefetched(&input_graph, "IteratorV2", 2);
+    NGraphCatalog::ClearPrefetchDatasetIterators(2);
+    NGraphCatalog::AddToPrefetchDatasetIterators(3, "IteratorV2");
+    ASSERT_OK(EnterPrefetchInCatalog(&input_graph, 5));
+    ASSERT_FALSE(
+        NGraphCatalog::ExistsInPrefetchedInputIndexMap(5, "ngraph_cluster_4"));
+  }
+
+  {
+    Graph input_graph(OpRegistry::Global());
+    ASSERT_OK(
+        LoadGraphFromPbTxt("test_catalog_for_prefetch.pbtxt", &input_graph));
+    MarkIteratorPrefetched(&input_graph, "IteratorV2", 3);
+    ASSERT_OK(EnterPrefetchInCatalog(&input_graph, 5));
+    ASSERT_TRUE(
+        NGraphCatalog::ExistsInPrefetchedInputIndexMap(5, "ngraph_cluster_4"));
+    ASSERT_EQ(NGraphCatalog::GetPrefetchIterator(5, "ngraph_cluster_4"),
+              "IteratorV2");
+    ASSERT_EQ(NGraphCatalog::GetPrefetchIteratorGraphId(5, "ngraph_cluster_4"),
+              3);
+  }
+
+  NGraphCatalog::ClearCatalog();
+}
+
+// Every encapsulate fed by an iterator gets its own shared resource, and
+// registers it with the consumers of that iterator
+TEST(PrefetchCatalogTest, SharedResourcePerEncapsulate) {
+  ResourceMgr rm;
+  const string container = NGraphPrefetchSharedResouce::CONTAINER_NAME;
+  const string name_0 =
+      NGraphPrefetchSharedResouce::ResourceName(0, 4, {0, 1});
+  const string name_1 = NGraphPrefetchSharedResouce::ResourceName(0, 7, {2});
+  ASSERT_NE(name_0, name_1);
+  ASSERT_NE(name_0, NGraphPrefetchSharedResouce::ResourceName(1, 4, {0, 1}));
+  ASSERT_NE(name_0, NGraphPrefetchSharedResouce::ResourceName(0, 4, {0}));
+  // The iterators of different graphs may have the same name
+  ASSERT_NE(NGraphPrefetchConsumers::ResourceName(0, "IteratorV2"),
+            NGraphPrefetchConsumers::ResourceName(1, "IteratorV2"));
+
+  ASSERT_OK(rm.Create(container, name_0, new NGraphPrefetchSharedResouce(
+                                             "enc_0", "CPU", 4, 0, {0, 1},
+                                             {1, 0}, 1)));
+  ASSERT_OK(rm.Create(container, name_1, new NGraphPrefetchSharedResouce(
+                                             "enc_1", "CPU", 7, 0, {2}, {0},
+                                             1)));
+
+  for (const auto& name : {name_0, name_1}) {
+    NGraphPrefetchConsumers* consumers = nullptr;
+    ASSERT_OK(rm.LookupOrCreate<NGraphPrefetchConsumers>(
+        container, NGraphPrefetchConsumers::ResourceName(0, "IteratorV2"),
+        &consumers, [](NGraphPrefetchConsumers** consumers) {
+          *consumers = new NGraphPrefetchConsumers();
+          return Status::OK();
+        }));
+    consumers->AddConsumer(name);
+    consumers->Unref();
+  }
+
+  NGraphPrefetchConsumers* consumers = nullptr;
+  ASSERT_OK(rm.Lookup(container,
+                      NGraphPrefetchConsumers::ResourceName(0, "IteratorV2"),
+                      &consumers));
+  std::vector<string> expected{name_0, name_1};
+  auto registered = consumers->GetConsumers();
+  ASSERT_EQ(registered.size(), expected.size());
+  for (int i = 0; i < expected.size(); i++) {
+    ASSERT_EQ(registered[i].shared_resource_name, expected[i]);
+    ASSERT_EQ(registered[i].first_element, 0);
+  }
+  consumers->Unref();
+
+  for (const auto& name : expected) {
+    NGraphPrefetchSharedResouce* shared_data = nullptr;
+    ASSERT_OK(rm.Lookup(container, name, &shared_data));
+    shared_data->Unref();
+  }
+}
+
 }  // namespace testing
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
\ No newline at end of file
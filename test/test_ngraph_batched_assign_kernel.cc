@@ -0,0 +1,215 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/platform/test.h"
+
+#include "ngraph/ngraph.hpp"
+
+#include "ngraph_bridge/enable_variable_ops/ngraph_var.h"
+#include "ngraph_bridge/enable_variable_ops/ngraph_var_arena.h"
+#include "ngraph_bridge/ngraph_backend_manager.h"
+#include "ngraph_bridge/ngraph_catalog.h"
+#include "ngraph_bridge/ngraph_freshness_tracker.h"
+#include "ngraph_bridge/ngraph_utils.h"
+#include "test/test_utilities.h"
+#include "test/tf_fake_input.h"
+
+namespace tensorflow {
+namespace ngraph_bridge {
+namespace testing {
+
+class NGraphBatchedAssignKernelTest : public tensorflow::OpsTestBase {};
+
+// Assigns two variables in one NGraphBatchedAssign, the first one is copied
+// back to TF, and checks the NG and TF tensors and their freshness
+TEST_F(NGraphBatchedAssignKernelTest, KernelTest) {
+  list<string> env_vars{"NGRAPH_TF_NGVARIABLE_BUFFER_SHARING"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_NGVARIABLE_BUFFER_SHARING", "0");
+
+  const int graph_id = 1;
+  const string node_name = "batched_assign";
+  const vector<string> var_names{"var1", "var2"};
+  for (int i = 0; i < var_names.size(); i++) {
+    NGraphCatalog::AddToInputVariableSharedNameMap(
+        NGraphCatalog::CreateNodeKey(graph_id, node_name, i), var_names[i]);
+  }
+
+  // Both variables start at 1
+  vector<NGraphVar*> vars;
+  for (const auto& var_name : var_names) {
+    NGraphVar* var = new NGraphVar(DT_FLOAT, TensorShape{2}, "CPU");
+    Tensor init(DT_FLOAT, TensorShape({2}));
+    test::FillValues<float>(&init, {1, 1});
+    var->update_ng_tensor(&init);
+    var->copy_ng_to_tf();
+    vars.push_back(var);
+  }
+
+  ASSERT_OK(NodeDefBuilder(node_name, "NGraphBatchedAssign")
+                .Input(FakeInput(2, DT_FLOAT_REF))
+                .Input(FakeInput(2, DT_FLOAT))
+                .Attr("N", 2)
+                .Attr("T", DT_FLOAT)
+                .Attr("copy_to_tf", {true, false})
+                .Attr("ngraph_graph_id", graph_id)
+                .Finalize(node_def()));
+  ASSERT_OK(InitOp());
+
+  // The Create function does not Ref the resource, so we do not Unref it
+  ResourceMgr* rm = device_->resource_manager();
+  for (int i = 0; i < vars.size(); i++) {
+    ASSERT_OK(rm->Create<NGraphVar>(rm->default_container(), var_names[i],
+                                    vars[i]));
+  }
+
+  // Both TF tensors are fresh for some executable before the assign
+  NGraphFreshnessTracker* tracker;
+  ASSERT_OK(rm->Lookup<NGraphFreshnessTracker>(
+      rm->default_container(), "ngraph_freshness_tracker", &tracker));
+  ASSERT_OK(BackendManager::CreateBackend("CPU"));
+  ng::runtime::Backend* backend = BackendManager::GetBackend("CPU");
+  auto param = make_shared<ng::op::Parameter>(ng::element::f32, ng::Shape{2});
+  auto exec = backend->compile(make_shared<ng::Function>(
+      make_shared<ng::op::Negative>(param), ng::ParameterVector{param}));
+  for (auto var : vars) {
+    tracker->AddTensor(DMAHelper::base(var->tensor()));
+    tracker->MarkFresh(DMAHelper::base(var->tensor()), exec);
+  }
+
+  for (auto var : vars) {
+    inputs_.push_back({&lock_for_refs_, var->tensor()});
+  }
+  AddInputFromArray<float>(TensorShape({2}), {2, 3});
+  AddInputFromArray<float>(TensorShape({2}), {4, 5});
+  ASSERT_OK(RunOpKernel());
+
+  // Both NG tensors hold the new values
+  Tensor expected1(DT_FLOAT, TensorShape({2}));
+  test::FillValues<float>(&expected1, {2, 3});
+  Tensor expected2(DT_FLOAT, TensorShape({2}));
+  test::FillValues<float>(&expected2, {4, 5});
+  Tensor initial(DT_FLOAT, TensorShape({2}));
+  test::FillValues<float>(&initial, {1, 1});
+  for (int i = 0; i < vars.size(); i++) {
+    Tensor ng_value(DT_FLOAT, TensorShape({2}));
+    vars[i]->ng_tensor()->read(DMAHelper::base(&ng_value),
+                               ng_value.TotalBytes());
+    test::ExpectTensorEqual<float>(ng_value, i == 0 ? expected1 : expected2);
+  }
+
+  // Only the first one is copied to TF, and only its TF tensor is stale
+  test::ExpectTensorEqual<float>(*vars[0]->tensor(), expected1);
+  ASSERT_FALSE(vars[0]->is_ng_tensor_dirty());
+  test::ExpectTensorEqual<float>(*vars[1]->tensor(), initial);
+  ASSERT_TRUE(vars[1]->is_ng_tensor_dirty());
+  ASSERT_FALSE(tracker->IsFresh(DMAHelper::base(vars[0]->tensor()), exec));
+  ASSERT_TRUE(tracker->IsFresh(DMAHelper::base(vars[1]->tensor()), exec));
+
+  // The refs are forwarded
+  ASSERT_EQ(DMAHelper::base(mutable_output(0)),
+            DMAHelper::base(vars[0]->tensor()));
+  ASSERT_EQ(DMAHelper::base(mutable_output(1)),
+            DMAHelper::base(vars[1]->tensor()));
+
+  tracker->Unref();
+  backend->remove_compiled_function(exec);
+  BackendManager::ReleaseBackend("CPU");
+  UnsetEnvVariable("NGRAPH_TF_NGVARIABLE_BUFFER_SHARING");
+  RestoreEnv(env_map);
+}
+
+// Assigns two variables of an NGraphVarArena given in the reverse of their
+// order in it, and checks that both end up with their own value in the arena
+TEST_F(NGraphBatchedAssignKernelTest, ArenaVariables) {
+  list<string> env_vars{"NGRAPH_TF_NGVARIABLE_BUFFER_SHARING"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_NGVARIABLE_BUFFER_SHARING", "0");
+
+  const int graph_id = 2;
+  const string node_name = "batched_assign_arena";
+  const vector<string> var_names{"arena_var2", "arena_var1"};
+  for (int i = 0; i < var_names.size(); i++) {
+    NGraphCatalog::AddToInputVariableSharedNameMap(
+        NGraphCatalog::CreateNodeKey(graph_id, node_name, i), var_names[i]);
+  }
+
+  ResourceMgr* rm = device_->resource_manager();
+  size_t var_size = NGraphVarArena::AlignedSize(DT_FLOAT, TensorShape{2});
+  NGraphVarArena* arena = new NGraphVarArena(2 * var_size);
+  ASSERT_OK(rm->Create<NGraphVarArena>(
+      rm->default_container(), NGraphVarArena::ResourceName(graph_id, "CPU"),
+      arena));
+
+  // arena_var1 is carved out of the arena first
+  vector<NGraphVar*> vars(2);
+  for (int i = var_names.size() - 1; i >= 0; i--) {
+    vars[i] = new NGraphVar(DT_FLOAT, TensorShape{2}, "CPU", arena);
+    ASSERT_TRUE(arena->Contains(DMAHelper::base(vars[i]->tensor())));
+  }
+  ASSERT_EQ(arena->size(), 2 * var_size);
+
+  ASSERT_OK(NodeDefBuilder(node_name, "NGraphBatchedAssign")
+                .Input(FakeInput(2, DT_FLOAT_REF))
+                .Input(FakeInput(2, DT_FLOAT))
+                .Attr("N", 2)
+                .Attr("T", DT_FLOAT)
+                .Attr("copy_to_tf", {true, true})
+                .Attr("ngraph_graph_id", graph_id)
+                .Finalize(node_def()));
+  ASSERT_OK(InitOp());
+
+  for (int i = 0; i < vars.size(); i++) {
+    ASSERT_OK(rm->Create<NGraphVar>(rm->default_container(), var_names[i],
+                                    vars[i]));
+  }
+  for (auto var : vars) {
+    inputs_.push_back({&lock_for_refs_, var->tensor()});
+  }
+  AddInputFromArray<float>(TensorShape({2}), {2, 3});
+  AddInputFromArray<float>(TensorShape({2}), {4, 5});
+  ASSERT_OK(RunOpKernel());
+
+  // The arena holds arena_var1 then arena_var2
+  const float* values = reinterpret_cast<const float*>(arena->data());
+  ASSERT_EQ(values[0], 4);
+  ASSERT_EQ(values[1], 5);
+  const float* values2 =
+      reinterpret_cast<const float*>(arena->data() + var_size);
+  ASSERT_EQ(values2[0], 2);
+  ASSERT_EQ(values2[1], 3);
+  for (int i = 0; i < vars.size(); i++) {
+    Tensor ng_value(DT_FLOAT, TensorShape({2}));
+    vars[i]->ng_tensor()->read(DMAHelper::base(&ng_value),
+                               ng_value.TotalBytes());
+    test::ExpectTensorEqual<float>(ng_value, *vars[i]->tensor());
+  }
+
+  UnsetEnvVariable("NGRAPH_TF_NGVARIABLE_BUFFER_SHARING");
+  RestoreEnv(env_map);
+}
+
+}  // namespace testing
+}  // namespace ngraph_bridge
+}  // namespace tensorflow
@@ -0,0 +1,200 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/public/session.h"
+
+#include "ngraph_bridge/ngraph_prefetch_shared_data.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+static const int kNumElements = 4;
+static const int kNumEpochs = 3;
+static const int kGraphId = 7;
+
+// Builds RangeDataset(0, kNumElements) -> NGraphCacheDataset(kNumEpochs)
+// -> Iterator "iterator", made by "make_iterator" and read by "get_next"
+static void BuildCachePipeline(Graph* graph, int64 max_bytes, bool shuffle) {
+  DataTypeVector output_types{DT_INT64};
+  std::vector<PartialTensorShape> output_shapes{PartialTensorShape({})};
+
+  auto scalar = [graph](const string& name, int64 value) -> Node* {
+    Tensor tensor(DT_INT64, TensorShape({}));
+    tensor.scalar<int64>()() = value;
+    Node* node;
+    TF_CHECK_OK(NodeBuilder(name, "Const")
+                    .Attr("dtype", DT_INT64)
+                    .Attr("value", tensor)
+                    .Finalize(graph, &node));
+    return node;
+  };
+
+  Node* range;
+  TF_CHECK_OK(NodeBuilder("range", "RangeDataset")
+                  .Input(scalar("start", 0))
+                  .Input(scalar("stop", kNumElements))
+                  .Input(scalar("step", 1))
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &range));
+  Node* cache;
+  TF_CHECK_OK(NodeBuilder("cache", "NGraphCacheDataset")
+                  .Input(range)
+                  .Input(scalar("count", kNumEpochs))
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Attr("max_bytes", max_bytes)
+                  .Attr("shuffle", shuffle)
+                  .Attr("seed", 1)
+                  .Attr("iterator_name", "iterator")
+                  .Attr("graph_id", kGraphId)
+                  .Finalize(graph, &cache));
+  Node* iterator;
+  TF_CHECK_OK(NodeBuilder("iterator", "Iterator")
+                  .Attr("shared_name", "")
+                  .Attr("container", "")
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &iterator));
+  Node* make_iterator;
+  TF_CHECK_OK(NodeBuilder("make_iterator", "MakeIterator")
+                  .Input(cache)
+                  .Input(iterator)
+                  .Finalize(graph, &make_iterator));
+  Node* get_next;
+  TF_CHECK_OK(NodeBuilder("get_next", "IteratorGetNext")
+                  .Input(iterator)
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &get_next));
+}
+
+// Reads all the elements of the pipeline, and the positions the
+// NGraphCacheDataset recorded for them
+static void RunCachePipeline(int64 max_bytes, bool shuffle,
+                             vector<int64>* values, vector<int64>* positions) {
+  Graph graph(OpRegistry::Global());
+  BuildCachePipeline(&graph, max_bytes, shuffle);
+  GraphDef gdef;
+  graph.ToGraphDef(&gdef);
+
+  DeactivateNGraph();
+  std::unique_ptr<Session> session(NewSession(SessionOptions()));
+  ASSERT_OK(session->Create(gdef));
+  ASSERT_OK(session->Run({}, {}, {"make_iterator"}, nullptr));
+  while (true) {
+    vector<Tensor> outputs;
+    Status status = session->Run({}, {"get_next:0"}, {}, &outputs);
+    if (errors::IsOutOfRange(status)) {
+      break;
+    }
+    ASSERT_OK(status);
+    values->push_back(outputs[0].scalar<int64>()());
+  }
+  ActivateNGraph();
+
+  const DeviceMgr* device_mgr;
+  ASSERT_OK(session->LocalDeviceManager(&device_mgr));
+  Device* device;
+  ASSERT_OK(device_mgr->LookupDevice("CPU:0", &device));
+  ResourceMgr* rm = device->resource_manager();
+
+  // The positions are shared under the graph id of the iterator only
+  NGraphCachedElements* cached_elements = nullptr;
+  ASSERT_NOT_OK(rm->Lookup(NGraphPrefetchSharedResouce::CONTAINER_NAME,
+                           NGraphCachedElements::ResourceName(0, "iterator"),
+                           &cached_elements));
+  ASSERT_OK(rm->Lookup(NGraphPrefetchSharedResouce::CONTAINER_NAME,
+                       NGraphCachedElements::ResourceName(kGraphId, "iterator"),
+                       &cached_elements));
+  // Every element returned pushed its position
+  for (int i = 0; i < values->size(); i++) {
+    positions->push_back(cached_elements->Pop());
+  }
+  cached_elements->Unref();
+}
+
+// The later epochs replay the elements of the first one in order
+TEST(NGraphCacheDataset, Replay) {
+  vector<int64> values;
+  vector<int64> positions;
+  RunCachePipeline(0, false, &values, &positions);
+
+  ASSERT_EQ(values.size(), kNumElements * kNumEpochs);
+  for (int i = 0; i < values.size(); i++) {
+    ASSERT_EQ(values[i], i % kNumElements);
+    ASSERT_EQ(positions[i], i % kNumElements);
+  }
+}
+
+// The later epochs replay a permutation of the elements of the first one,
+// each with the position it was cached at
+TEST(NGraphCacheDataset, Shuffle) {
+  vector<int64> values;
+  vector<int64> positions;
+  RunCachePipeline(0, true, &values, &positions);
+
+  ASSERT_EQ(values.size(), kNumElements * kNumEpochs);
+  for (int i = 0; i < kNumElements; i++) {
+    ASSERT_EQ(values[i], i);
+  }
+  for (int epoch = 1; epoch < kNumEpochs; epoch++) {
+    vector<int64> epoch_values(values.begin() + epoch * kNumElements,
+                               values.begin() + (epoch + 1) * kNumElements);
+    std::sort(epoch_values.begin(), epoch_values.end());
+    for (int i = 0; i < kNumElements; i++) {
+      ASSERT_EQ(epoch_values[i], i);
+    }
+  }
+  ASSERT_EQ(positions, values);
+}
+
+// An input that does not fit in the budget is read again every epoch, and
+// none of the elements after the budget was exceeded has a position
+TEST(NGraphCacheDataset, Budget) {
+  vector<int64> values;
+  vector<int64> positions;
+  // Two of the int64 elements fit
+  RunCachePipeline(2 * sizeof(int64), false, &values, &positions);
+
+  ASSERT_EQ(values.size(), kNumElements * kNumEpochs);
+  for (int i = 0; i < values.size(); i++) {
+    ASSERT_EQ(values[i], i % kNumElements);
+    if (i < 2) {
+      ASSERT_EQ(positions[i], i);
+    } else {
+      ASSERT_EQ(positions[i], -1);
+    }
+  }
+}
+
+}  // namespace testing
+}  // namespace ngraph_bridge
+}  // namespace tensorflow
@@ -25,6 +25,7 @@
 
 #include "ngraph_bridge/ngraph_backend_manager.h"
 #include "ngraph_bridge/ngraph_builder.h"
+#include "ngraph_bridge/ngraph_cache_budget.h"
 #include "ngraph_bridge/ngraph_data_cache.h"
 #include "ngraph_bridge/version.h"
 
@@ -160,6 +161,139 @@ TEST_F(NGraphDataCacheTest, RemoveItemTest) {
   ASSERT_EQ(destroy_count, 1);
   ASSERT_EQ(m_ng_data_cache.m_ng_items_map.size(), 0);
 }
+
+// Testing that SetDepth() evicts the least recently used items on shrink
+TEST_F(NGraphDataCacheTest, SetDepthTest) {
+  auto create_item =
+      std::bind(&NGraphDataCacheTest_SetDepthTest_Test::CreateItemNoBarrier,
+                this, std::placeholders::_1);
+  auto destroy_item =
+      std::bind(&NGraphDataCacheTest_SetDepthTest_Test::DestroyItem, this,
+                std::placeholders::_1);
+  bool cache_hit;
+  ASSERT_OK(m_ng_data_cache
+                .LookUpOrCreate("abc", create_item, destroy_item, cache_hit)
+                .first);
+  ASSERT_OK(m_ng_data_cache
+                .LookUpOrCreate("def", create_item, destroy_item, cache_hit)
+                .first);
+  ASSERT_OK(m_ng_data_cache
+                .LookUpOrCreate("efg", create_item, destroy_item, cache_hit)
+                .first);
+  // "abc" becomes the most recently used item
+  ASSERT_OK(m_ng_data_cache
+                .LookUpOrCreate("abc", create_item, destroy_item, cache_hit)
+                .first);
+  ASSERT_TRUE(cache_hit);
+
+  ASSERT_OK(m_ng_data_cache.SetDepth(1, destroy_item));
+  ASSERT_EQ(m_ng_data_cache.GetDepth(), 1);
+  ASSERT_EQ(m_ng_data_cache.GetSize(), 1);
+  ASSERT_EQ(destroy_count, 2);
+  ASSERT_OK(m_ng_data_cache
+                .LookUpOrCreate("abc", create_item, destroy_item, cache_hit)
+                .first);
+  ASSERT_TRUE(cache_hit);
+
+  // Growing does not evict anything
+  ASSERT_OK(m_ng_data_cache.SetDepth(4, destroy_item));
+  for (auto key : {"def", "efg", "hij"}) {
+    ASSERT_OK(m_ng_data_cache
+                  .LookUpOrCreate(key, create_item, destroy_item, cache_hit)
+                  .first);
+    ASSERT_FALSE(cache_hit);
+  }
+  ASSERT_EQ(m_ng_data_cache.GetSize(), 4);
+  ASSERT_EQ(destroy_count, 2);
+}
+
+// Testing the global item budget shared by the executable caches
+TEST(NGraphCacheBudget, ItemAndByteLimits) {
+  int64 max_items = NGraphCacheBudget::GetMaxItems();
+  int64 max_bytes = NGraphCacheBudget::GetMaxBytes();
+  int64 reserved_items = NGraphCacheBudget::GetReservedItems();
+
+  NGraphCacheBudget::SetLimits(reserved_items + 10, 100);
+  ASSERT_EQ(NGraphCacheBudget::TryReserveItems(4), 4);
+  ASSERT_EQ(NGraphCacheBudget::TryReserveItems(8), 6);
+  ASSERT_EQ(NGraphCacheBudget::TryReserveItems(1), 0);
+  NGraphCacheBudget::ReleaseItems(10);
+  ASSERT_EQ(NGraphCacheBudget::GetReservedItems(), reserved_items);
+
+  int64 cached_bytes = NGraphCacheBudget::GetCachedBytes();
+  NGraphCacheBudget::SetLimits(max_items, cached_bytes + 100);
+  NGraphCacheBudget::AddBytes(60);
+  ASSERT_FALSE(NGraphCacheBudget::IsByteBudgetExceeded());
+  NGraphCacheBudget::AddBytes(60);
+  ASSERT_TRUE(NGraphCacheBudget::IsByteBudgetExceeded());
+  NGraphCacheBudget::RemoveBytes(120);
+  ASSERT_FALSE(NGraphCacheBudget::IsByteBudgetExceeded());
+
+  NGraphCacheBudget::ExecutorStats stats;
+  stats.cluster_id = 7;
+  stats.hits = 3;
+  stats.misses = 1;
+  NGraphCacheBudget::UpdateStats(-1, stats);
+  NGraphCacheBudget::RecordResize(-1, 7, 16, 4, 2, 0.75);
+  NGraphCacheBudget::ExecutorStats stats_out;
+  ASSERT_TRUE(NGraphCacheBudget::GetStats(-1, &stats_out));
+  ASSERT_EQ(stats_out.hits, 3);
+  string stats_string = NGraphCacheBudget::StatsToString();
+  ASSERT_NE(stats_string.find("depth 16 -> 4"), string::npos);
+  NGraphCacheBudget::RemoveStats(-1);
+  ASSERT_FALSE(NGraphCacheBudget::GetStats(-1, &stats_out));
+
+  NGraphCacheBudget::SetLimits(max_items, max_bytes);
+}
+
+// Testing the lazily accounted, adaptive depth of an executable cache
+TEST(NGraphCacheBudget, AdaptiveCacheDepth) {
+  int64 max_items = NGraphCacheBudget::GetMaxItems();
+  int64 max_bytes = NGraphCacheBudget::GetMaxBytes();
+  int64 reserved_items = NGraphCacheBudget::GetReservedItems();
+  NGraphCacheBudget::SetLimits(reserved_items + 100, 0);
+
+  int resized_depth = -1;
+  auto resize = [&resized_depth](int depth) {
+    resized_depth = depth;
+    return Status::OK();
+  };
+  {
+    NGraphCacheDepth cache_depth(-2, 7, 2);
+    cache_depth.EnableAdaptive(8);
+    ASSERT_TRUE(cache_depth.IsAdaptive());
+    // Nothing is accounted until the first compilation
+    ASSERT_EQ(NGraphCacheBudget::GetReservedItems(), reserved_items);
+    cache_depth.RecordLookup("s0", false, resize);
+    ASSERT_EQ(NGraphCacheBudget::GetReservedItems(), reserved_items + 2);
+
+    // Many distinct signatures grow the cache up to its max depth
+    for (int i = 1; i < 16; i++) {
+      cache_depth.RecordLookup("s" + to_string(i), false, resize);
+    }
+    ASSERT_EQ(resized_depth, 8);
+    ASSERT_EQ(cache_depth.GetDepth(), 8);
+    ASSERT_EQ(NGraphCacheBudget::GetReservedItems(), reserved_items + 8);
+
+    // A window of one signature shrinks it back
+    for (int i = 0; i < 64; i++) {
+      cache_depth.RecordLookup("s0", true, resize);
+    }
+    ASSERT_EQ(resized_depth, 2);
+    ASSERT_EQ(cache_depth.GetDepth(), 2);
+    ASSERT_EQ(NGraphCacheBudget::GetReservedItems(), reserved_items + 2);
+
+    NGraphCacheBudget::ExecutorStats stats;
+    ASSERT_TRUE(NGraphCacheBudget::GetStats(-2, &stats));
+    ASSERT_EQ(stats.misses, 16);
+    ASSERT_EQ(stats.hits, 64);
+    ASSERT_EQ(stats.grows, 1);
+    ASSERT_EQ(stats.shrinks, 1);
+  }
+  ASSERT_EQ(NGraphCacheBudget::GetReservedItems(), reserved_items);
+
+  NGraphCacheBudget::SetLimits(max_items, max_bytes);
+}
 }
 }
 }
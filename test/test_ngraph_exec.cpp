@@ -230,6 +230,37 @@ TEST_F(NGraphExecTest, Axpy) {
   // TODO
 }
 
+// Translating with static partial shapes must produce the same function as
+// translating with TensorShapes, translating with a dynamic batch dimension
+// either succeeds with dynamic parameters or fails with an error status
+TEST_F(NGraphExecTest, AxpyPartialShapes) {
+  Graph input_graph(OpRegistry::Global());
+  ASSERT_OK(LoadGraph("test_axpy_launchop.pbtxt", &input_graph));
+  std::vector<const Tensor*> static_input_map(2, nullptr);
+
+  std::vector<ng::PartialShape> static_shapes(2, ng::PartialShape({2, 3}));
+  shared_ptr<ng::Function> ng_function;
+  ASSERT_OK(ngraph_bridge::Builder::TranslateGraph(
+      static_shapes, static_input_map, &input_graph, ng_function));
+  ASSERT_EQ(ng_function->get_parameters().size(), 2);
+  for (const auto& param : ng_function->get_parameters()) {
+    ASSERT_EQ(param->get_shape(), ng::Shape({2, 3}));
+  }
+  ASSERT_EQ(ng_function->get_output_shape(0), ng::Shape({2, 3}));
+
+  // The Mul and Add are broadcast with their static shapes, so the graph
+  // cannot be translated with a dynamic batch dimension. The error is
+  // returned, not thrown
+  std::vector<ng::PartialShape> dynamic_shapes(
+      2, ng::PartialShape({ng::Dimension::dynamic(), 3}));
+  shared_ptr<ng::Function> ng_dynamic_function;
+  Status status;
+  ASSERT_NO_THROW(status = ngraph_bridge::Builder::TranslateGraph(
+                      dynamic_shapes, static_input_map, &input_graph,
+                      ng_dynamic_function));
+  ASSERT_NOT_OK(status);
+}
+
 TEST_F(NGraphExecTest, Axpy8bit) {
   Graph input_graph(OpRegistry::Global());
   ASSERT_OK(LoadGraph("test_axpy_int8_launchop.pbtxt", &input_graph));
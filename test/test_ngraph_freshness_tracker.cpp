@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ngraph/ngraph.hpp"
+
+#include "ngraph_bridge/ngraph_backend_manager.h"
+#include "ngraph_bridge/ngraph_freshness_tracker.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+namespace ng = ngraph;
+
+namespace tensorflow {
+namespace ngraph_bridge {
+namespace testing {
+
+// Compiles "count" distinct executables on the CPU backend
+static vector<shared_ptr<ng::runtime::Executable>> CompileExecutables(
+    ng::runtime::Backend* backend, int count) {
+  vector<shared_ptr<ng::runtime::Executable>> execs;
+  for (int i = 0; i < count; i++) {
+    ng::Shape shape{static_cast<size_t>(i + 1)};
+    auto A = make_shared<ng::op::Parameter>(ng::element::f32, shape);
+    auto B = make_shared<ng::op::Parameter>(ng::element::f32, shape);
+    auto f = make_shared<ng::Function>(make_shared<ng::op::Add>(A, B),
+                                       ng::ParameterVector{A, B});
+    execs.push_back(backend->compile(f));
+  }
+  return execs;
+}
+
+TEST(FreshnessTracker, Simple) {
+  ASSERT_OK(BackendManager::CreateBackend("CPU"));
+  ng::runtime::Backend* backend = BackendManager::GetBackend("CPU");
+  auto execs = CompileExecutables(backend, 2);
+
+  NGraphFreshnessTracker* tracker = new NGraphFreshnessTracker();
+  int buffer[2];
+  const void* t1 = &buffer[0];
+  const void* t2 = &buffer[1];
+
+  // Unregistered tensors are never fresh
+  tracker->MarkFresh(t1, execs[0]);
+  ASSERT_FALSE(tracker->IsFresh(t1, execs[0]));
+
+  tracker->AddTensor(t1);
+  tracker->AddTensor(t2);
+  ASSERT_FALSE(tracker->IsFresh(t1, execs[0]));
+
+  tracker->MarkFresh(t1, execs[0]);
+  tracker->MarkFresh(t2, execs[1]);
+  ASSERT_TRUE(tracker->IsFresh(t1, execs[0]));
+  ASSERT_FALSE(tracker->IsFresh(t1, execs[1]));
+  ASSERT_FALSE(tracker->IsFresh(t2, execs[0]));
+  ASSERT_TRUE(tracker->IsFresh(t2, execs[1]));
+
+  // AddTensor on a tracked tensor keeps its freshness
+  tracker->AddTensor(t1);
+  ASSERT_TRUE(tracker->IsFresh(t1, execs[0]));
+
+  tracker->MarkStale(t1);
+  ASSERT_FALSE(tracker->IsFresh(t1, execs[0]));
+  ASSERT_TRUE(tracker->IsFresh(t2, execs[1]));
+
+  tracker->MarkFresh(t1, execs[0]);
+  tracker->MarkFresh(t1, execs[1]);
+  tracker->RemoveUser(execs[1]);
+  ASSERT_TRUE(tracker->IsFresh(t1, execs[0]));
+  ASSERT_FALSE(tracker->IsFresh(t1, execs[1]));
+  ASSERT_FALSE(tracker->IsFresh(t2, execs[1]));
+
+  // A user registered again starts from scratch
+  tracker->MarkFresh(t2, execs[1]);
+  ASSERT_FALSE(tracker->IsFresh(t1, execs[1]));
+  ASSERT_TRUE(tracker->IsFresh(t2, execs[1]));
+
+  tracker->RemoveTensor(t1);
+  ASSERT_FALSE(tracker->IsFresh(t1, execs[0]));
+  tracker->AddTensor(t1);
+  ASSERT_FALSE(tracker->IsFresh(t1, execs[0]));
+
+  tracker->Unref();
+  for (auto& exec : execs) {
+    backend->remove_compiled_function(exec);
+  }
+  BackendManager::ReleaseBackend("CPU");
+}
+
+// The user ids are spread over several words of the bitset once there are
+// more than 64 users
+TEST(FreshnessTracker, ManyUsers) {
+  ASSERT_OK(BackendManager::CreateBackend("CPU"));
+  ng::runtime::Backend* backend = BackendManager::GetBackend("CPU");
+  auto execs = CompileExecutables(backend, 130);
+
+  NGraphFreshnessTracker* tracker = new NGraphFreshnessTracker();
+  int buffer;
+  const void* t = &buffer;
+  tracker->AddTensor(t);
+
+  for (size_t i = 0; i < execs.size(); i += 2) {
+    tracker->MarkFresh(t, execs[i]);
+  }
+  for (size_t i = 0; i < execs.size(); i++) {
+    ASSERT_EQ(tracker->IsFresh(t, execs[i]), i % 2 == 0) << "user " << i;
+  }
+
+  tracker->RemoveUser(execs[128]);
+  ASSERT_FALSE(tracker->IsFresh(t, execs[128]));
+  ASSERT_TRUE(tracker->IsFresh(t, execs[126]));
+
+  tracker->MarkStale(t);
+  for (size_t i = 0; i < execs.size(); i++) {
+    ASSERT_FALSE(tracker->IsFresh(t, execs[i])) << "user " << i;
+  }
+
+  tracker->Unref();
+  for (auto& exec : execs) {
+    backend->remove_compiled_function(exec);
+  }
+  BackendManager::ReleaseBackend("CPU");
+}
+
+// The id of a user is resolved once and used in place of the executable
+// until the user is removed. A released id given to another user does not
+// carry the freshness of the removed one
+TEST(FreshnessTracker, UserIds) {
+  ASSERT_OK(BackendManager::CreateBackend("CPU"));
+  ng::runtime::Backend* backend = BackendManager::GetBackend("CPU");
+  auto execs = CompileExecutables(backend, 2);
+
+  NGraphFreshnessTracker* tracker = new NGraphFreshnessTracker();
+  int buffer;
+  const void* t = &buffer;
+  tracker->AddTensor(t);
+
+  int id = tracker->AddUser(execs[0]);
+  ASSERT_GE(id, 0);
+  ASSERT_EQ(tracker->AddUser(execs[0]), id);
+  ASSERT_FALSE(tracker->IsFresh(t, id));
+  tracker->MarkFresh(t, id);
+  ASSERT_TRUE(tracker->IsFresh(t, id));
+  ASSERT_TRUE(tracker->IsFresh(t, execs[0]));
+
+  // Negative ids are never fresh
+  tracker->MarkFresh(t, -1);
+  ASSERT_FALSE(tracker->IsFresh(t, -1));
+
+  tracker->RemoveUser(execs[0]);
+  ASSERT_FALSE(tracker->IsFresh(t, execs[0]));
+  int other_id = tracker->AddUser(execs[1]);
+  ASSERT_EQ(other_id, id);
+  ASSERT_FALSE(tracker->IsFresh(t, other_id));
+
+  tracker->Unref();
+  for (auto& exec : execs) {
+    backend->remove_compiled_function(exec);
+  }
+  BackendManager::ReleaseBackend("CPU");
+}
+
+// One thread keeps marking a tensor fresh for a user and removing that user,
+// while another keeps registering a second user (which may be given the
+// released id) and checks that the tensor is never fresh for it. Both use
+// the ids like the encapsulate does
+TEST(FreshnessTracker, ConcurrentRemoveUser) {
+  ASSERT_OK(BackendManager::CreateBackend("CPU"));
+  ng::runtime::Backend* backend = BackendManager::GetBackend("CPU");
+  auto execs = CompileExecutables(backend, 2);
+
+  NGraphFreshnessTracker* tracker = new NGraphFreshnessTracker();
+  int buffers[2];
+  const void* t = &buffers[0];
+  const void* u = &buffers[1];
+  tracker->AddTensor(t);
+  tracker->AddTensor(u);
+
+  const int num_iterations = 20000;
+  atomic<bool> done{false};
+  thread remover([&]() {
+    for (int j = 0; j < num_iterations; j++) {
+      tracker->MarkFresh(t, tracker->AddUser(execs[0]));
+      tracker->RemoveUser(execs[0]);
+    }
+    done = true;
+  });
+  int wrongly_fresh = 0;
+  while (!done) {
+    int id = tracker->AddUser(execs[1]);
+    tracker->MarkFresh(u, id);
+    if (tracker->IsFresh(t, id)) {
+      wrongly_fresh++;
+    }
+    tracker->RemoveUser(execs[1]);
+  }
+  remover.join();
+  ASSERT_EQ(wrongly_fresh, 0);
+
+  tracker->Unref();
+  for (auto& exec : execs) {
+    backend->remove_compiled_function(exec);
+  }
+  BackendManager::ReleaseBackend("CPU");
+}
+
+}  // namespace testing
+}  // namespace ngraph_bridge
+}  // namespace tensorflow
@@ -0,0 +1,383 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/public/session.h"
+
+#include "ngraph_bridge/ngraph_api.h"
+#include "ngraph_bridge/ngraph_pipelined_tensors.h"
+#include "ngraph_bridge/ngraph_prefetch_shared_data.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+// A store of one input and no output, "depth" sets deep
+static shared_ptr<PipelinedTensorsStore> MakeStore(int depth) {
+  PipelinedTensorMatrix inputs(1, PipelinedTensorVector(depth));
+  return make_shared<PipelinedTensorsStore>(inputs, PipelinedTensorMatrix());
+}
+
+// The NGraphEncapsulate runs on a staged bundle only if it was written by the
+// prefetcher and lent from the store of the current executable. Otherwise
+// the set goes back to the store it was lent from
+TEST(NGraphPrefetchDataset, UseStagedBundle) {
+  auto store = MakeStore(2);
+  auto other_store = MakeStore(2);
+  for (auto s : {store, other_store}) {
+    ASSERT_EQ(get<0>(s->get_tensors()), 0);
+    ASSERT_EQ(get<0>(s->get_tensors()), 1);
+    ASSERT_EQ(get<0>(s->get_tensors()), -1);
+  }
+
+  // Staged for the current executable, the set stays checked out
+  NGraphPrefetchSharedResouce::InputTensorBundle staged{0, {}, store, true};
+  ASSERT_TRUE(NGraphPrefetchSharedResouce::UseStagedBundle(staged, store));
+  ASSERT_EQ(get<0>(store->get_tensors()), -1);
+
+  // Not staged, the shapes of the element did not match the tensors
+  NGraphPrefetchSharedResouce::InputTensorBundle not_staged{1, {}, store,
+                                                            false};
+  ASSERT_FALSE(
+      NGraphPrefetchSharedResouce::UseStagedBundle(not_staged, store));
+  ASSERT_EQ(get<0>(store->get_tensors()), 1);
+
+  // Staged in the tensors of the executable of earlier input shapes, the set
+  // goes back to that store and not to the current one
+  NGraphPrefetchSharedResouce::InputTensorBundle stale{0, {}, other_store,
+                                                       true};
+  ASSERT_FALSE(NGraphPrefetchSharedResouce::UseStagedBundle(stale, store));
+  ASSERT_EQ(get<0>(store->get_tensors()), -1);
+  ASSERT_EQ(get<0>(other_store->get_tensors()), 0);
+}
+
+// The shared resource of an NGraphEncapsulate is named after its graph and
+// cluster, which it reports back
+TEST(NGraphPrefetchDataset, SharedResourceIds) {
+  const int cluster_id = 4;
+  const int graph_id = 7;
+  NGraphPrefetchSharedResouce* shared_data = new NGraphPrefetchSharedResouce(
+      "encapsulate", "CPU", cluster_id, graph_id, {0}, {0}, 1);
+  ASSERT_EQ(shared_data->GetClusterId(), cluster_id);
+  ASSERT_EQ(shared_data->GetGraphId(), graph_id);
+  ASSERT_EQ(NGraphPrefetchSharedResouce::ResourceName(
+                shared_data->GetGraphId(), shared_data->GetClusterId(),
+                shared_data->GetPrefetchedInputIndexes()),
+            "NG_PREFETCH_DATA_7_4_0");
+  ASSERT_EQ(shared_data->DebugString(),
+            "NGraphPrefetchSharedResouce of encapsulate (graph 7, cluster 4)");
+  shared_data->Unref();
+}
+
+// Concurrent NGraphEncapsulates of a cluster never take more staging slots
+// than the depth, nor give back more than are above it
+TEST(NGraphPrefetchDataset, StagingSlots) {
+  const int num_threads = 8;
+  const int max_depth = 3;
+  NGraphPrefetchSharedResouce* shared_data = new NGraphPrefetchSharedResouce(
+      "encapsulate", "CPU", 0, 0, {0}, {0}, max_depth);
+
+  auto run_threads = [num_threads](std::function<bool()> try_slot) -> int {
+    std::atomic<int> num_done{0};
+    vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&try_slot, &num_done]() -> void {
+        for (int i = 0; i < 100; i++) {
+          if (try_slot()) {
+            num_done++;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    return num_done;
+  };
+
+  ASSERT_EQ(run_threads([shared_data]() -> bool {
+              return shared_data->TryAddStagingSlot(max_depth);
+            }),
+            max_depth);
+  ASSERT_EQ(shared_data->GetNumStagingSlots(), max_depth);
+  ASSERT_EQ(run_threads([shared_data]() -> bool {
+              return shared_data->TryRemoveStagingSlot(1);
+            }),
+            max_depth - 1);
+  ASSERT_EQ(shared_data->GetNumStagingSlots(), 1);
+  shared_data->Unref();
+}
+
+static const int kBatchSize = 4;
+static const int kNumElements = 4 * kBatchSize + 2;
+static const int kNumEpochs = 2;
+
+static Node* Int64Const(Graph* graph, const string& name, int64 value) {
+  Tensor tensor(DT_INT64, TensorShape({}));
+  tensor.scalar<int64>()() = value;
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(name, "Const")
+                  .Attr("dtype", DT_INT64)
+                  .Attr("value", tensor)
+                  .Finalize(graph, &node));
+  return node;
+}
+
+static const int64 kSecondOffset = 100;
+
+// Builds RangeDataset(0, kNumElements) -> BatchDatasetV2(kBatchSize) ->
+// RepeatDataset(kNumEpochs) -> PrefetchDataset -> Iterator "iterator", whose
+// elements x are read by "get_next" and computed as "y" = x * 2 + 1. With two
+// components, the range is zipped with RangeDataset(kSecondOffset, ...) and
+// its batches are added to y. Every epoch ends with a smaller batch
+static void BuildPrefetchPipeline(Graph* graph, int num_components) {
+  DataTypeVector output_types(num_components, DT_INT64);
+  std::vector<PartialTensorShape> output_shapes(num_components,
+                                                PartialTensorShape({-1}));
+  std::vector<PartialTensorShape> element_shapes(num_components,
+                                                 PartialTensorShape({}));
+
+  std::vector<NodeBuilder::NodeOut> ranges;
+  for (int i = 0; i < num_components; i++) {
+    const string suffix = i == 0 ? "" : "_" + to_string(i);
+    int64 offset = i * kSecondOffset;
+    Node* range;
+    TF_CHECK_OK(NodeBuilder("range" + suffix, "RangeDataset")
+                    .Input(Int64Const(graph, "start" + suffix, offset))
+                    .Input(Int64Const(graph, "stop" + suffix,
+                                      offset + kNumElements))
+                    .Input(Int64Const(graph, "step" + suffix, 1))
+                    .Attr("output_types", DataTypeVector{DT_INT64})
+                    .Attr("output_shapes", std::vector<PartialTensorShape>{
+                                               PartialTensorShape({})})
+                    .Finalize(graph, &range));
+    ranges.push_back(range);
+  }
+  Node* input = ranges[0].node;
+  if (num_components > 1) {
+    TF_CHECK_OK(NodeBuilder("zip", "ZipDataset")
+                    .Input(ranges)
+                    .Attr("output_types", output_types)
+                    .Attr("output_shapes", element_shapes)
+                    .Finalize(graph, &input));
+  }
+  Tensor drop_remainder(DT_BOOL, TensorShape({}));
+  drop_remainder.scalar<bool>()() = false;
+  Node* drop_remainder_node;
+  TF_CHECK_OK(NodeBuilder("drop_remainder", "Const")
+                  .Attr("dtype", DT_BOOL)
+                  .Attr("value", drop_remainder)
+                  .Finalize(graph, &drop_remainder_node));
+  Node* batch;
+  TF_CHECK_OK(NodeBuilder("batch", "BatchDatasetV2")
+                  .Input(input)
+                  .Input(Int64Const(graph, "batch_size", kBatchSize))
+                  .Input(drop_remainder_node)
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &batch));
+  Node* repeat;
+  TF_CHECK_OK(NodeBuilder("repeat", "RepeatDataset")
+                  .Input(batch)
+                  .Input(Int64Const(graph, "count", kNumEpochs))
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &repeat));
+  Node* prefetch;
+  TF_CHECK_OK(NodeBuilder("prefetch", "PrefetchDataset")
+                  .Input(repeat)
+                  .Input(Int64Const(graph, "buffer_size", 1))
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &prefetch));
+  Node* iterator;
+  TF_CHECK_OK(NodeBuilder("iterator", "Iterator")
+                  .Attr("shared_name", "")
+                  .Attr("container", "")
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &iterator));
+  Node* make_iterator;
+  TF_CHECK_OK(NodeBuilder("make_iterator", "MakeIterator")
+                  .Input(prefetch)
+                  .Input(iterator)
+                  .Finalize(graph, &make_iterator));
+  Node* get_next;
+  TF_CHECK_OK(NodeBuilder("get_next", "IteratorGetNext")
+                  .Input(iterator)
+                  .Attr("output_types", output_types)
+                  .Attr("output_shapes", output_shapes)
+                  .Finalize(graph, &get_next));
+
+  Node* mul;
+  TF_CHECK_OK(NodeBuilder("mul", "Mul")
+                  .Input(get_next, 0)
+                  .Input(Int64Const(graph, "two", 2))
+                  .Attr("T", DT_INT64)
+                  .Finalize(graph, &mul));
+  Node* y;
+  TF_CHECK_OK(NodeBuilder(num_components > 1 ? "add_one" : "y", "Add")
+                  .Input(mul)
+                  .Input(Int64Const(graph, "one", 1))
+                  .Attr("T", DT_INT64)
+                  .Finalize(graph, &y));
+  if (num_components > 1) {
+    TF_CHECK_OK(NodeBuilder("y", "Add")
+                    .Input(y)
+                    .Input(get_next, 1)
+                    .Attr("T", DT_INT64)
+                    .Finalize(graph, &y));
+  }
+}
+
+// Creates a session over the pipeline and makes its iterator
+static void CreatePrefetchSession(int num_components,
+                                  std::unique_ptr<Session>* session) {
+  Graph graph(OpRegistry::Global());
+  BuildPrefetchPipeline(&graph, num_components);
+  GraphDef gdef;
+  graph.ToGraphDef(&gdef);
+  session->reset(NewSession(SessionOptions()));
+  ASSERT_OK((*session)->Create(gdef));
+  ASSERT_OK((*session)->Run({}, {}, {"make_iterator"}, nullptr));
+}
+
+// Computes "y" for at most max_batches batches, or until the end of the
+// input when max_batches is -1, and checks every batch
+static void RunPrefetchPipeline(Session* session, int num_components,
+                                int max_batches, int* num_batches) {
+  *num_batches = 0;
+  int64 next_value = 0;
+  while (max_batches < 0 || *num_batches < max_batches) {
+    vector<Tensor> outputs;
+    Status status = session->Run({}, {"y:0"}, {}, &outputs);
+    if (errors::IsOutOfRange(status)) {
+      break;
+    }
+    ASSERT_OK(status);
+    const Tensor& y = outputs[0];
+    int expected_size = std::min<int64>(kBatchSize, kNumElements - next_value);
+    ASSERT_EQ(y.dims(), 1);
+    ASSERT_EQ(y.dim_size(0), expected_size) << "batch " << *num_batches;
+    for (int i = 0; i < expected_size; i++) {
+      int64 x = next_value + i;
+      int64 expected = x * 2 + 1;
+      if (num_components > 1) {
+        expected += kSecondOffset + x;
+      }
+      ASSERT_EQ(y.vec<int64>()(i), expected) << "batch " << *num_batches;
+    }
+    next_value = (next_value + expected_size) % kNumElements;
+    (*num_batches)++;
+  }
+}
+
+static const int kBatchesPerEpoch =
+    (kNumElements + kBatchSize - 1) / kBatchSize;
+
+// The smaller last batch of every epoch does not fit the device tensors
+// staged for the full batches: the NGraphEncapsulate copies it from the TF
+// tensors and staging resumes for the shapes of the next batches. All the
+// batches are computed right
+TEST(NGraphPrefetchDataset, SmallerLastBatch) {
+  bool prefetch_enabled = config::IsPrefetchEnabled();
+  config::EnablePrefetch();
+  ActivateNGraph();
+
+  std::unique_ptr<Session> session;
+  CreatePrefetchSession(1, &session);
+  int num_batches;
+  RunPrefetchPipeline(session.get(), 1, -1, &num_batches);
+  ASSERT_EQ(num_batches, kBatchesPerEpoch * kNumEpochs);
+
+  session.reset();
+  if (!prefetch_enabled) {
+    config::DisablePrefetch();
+  }
+}
+
+// The components of an element are copied to the device by one thread, or
+// in parallel on the copy pool, and all the batches are computed right
+// either way
+TEST(NGraphPrefetchDataset, CopyThreads) {
+  list<string> env_vars{"NGRAPH_TF_PREFETCH_COPY_THREADS"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  bool prefetch_enabled = config::IsPrefetchEnabled();
+  config::EnablePrefetch();
+  ActivateNGraph();
+
+  for (const string num_threads : {"1", "4"}) {
+    SetEnvVariable("NGRAPH_TF_PREFETCH_COPY_THREADS", num_threads);
+    std::unique_ptr<Session> session;
+    CreatePrefetchSession(2, &session);
+    int num_batches;
+    RunPrefetchPipeline(session.get(), 2, -1, &num_batches);
+    ASSERT_EQ(num_batches, kBatchesPerEpoch * kNumEpochs)
+        << num_threads << " copy threads";
+    session.reset();
+  }
+
+  if (!prefetch_enabled) {
+    config::DisablePrefetch();
+  }
+  UnsetEnvVariable("NGRAPH_TF_PREFETCH_COPY_THREADS");
+  RestoreEnv(env_map);
+}
+
+// Closing a session while its staging thread holds device tensors does not
+// hang, and a new session over the same graph computes all the batches
+TEST(NGraphPrefetchDataset, CloseWhileStaging) {
+  bool prefetch_enabled = config::IsPrefetchEnabled();
+  config::EnablePrefetch();
+  ActivateNGraph();
+
+  std::unique_ptr<Session> session;
+  CreatePrefetchSession(1, &session);
+  int num_batches;
+  RunPrefetchPipeline(session.get(), 1, 2, &num_batches);
+  ASSERT_EQ(num_batches, 2);
+  session.reset();
+
+  CreatePrefetchSession(1, &session);
+  RunPrefetchPipeline(session.get(), 1, -1, &num_batches);
+  ASSERT_EQ(num_batches, kBatchesPerEpoch * kNumEpochs);
+
+  session.reset();
+  if (!prefetch_enabled) {
+    config::DisablePrefetch();
+  }
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
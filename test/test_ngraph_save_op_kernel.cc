@@ -0,0 +1,219 @@
+/*******************************************************************************
+ * Copyright 2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+#include "ngraph_bridge/enable_variable_ops/ngraph_var.h"
+#include "ngraph_bridge/ngraph_utils.h"
+#include "test/test_utilities.h"
+#include "test/tf_fake_input.h"
+
+namespace tensorflow {
+namespace ngraph_bridge {
+namespace testing {
+
+// Creates an NGraphVar of two floats, with both tensors set to "value"
+static NGraphVar* CreateVar(float value) {
+  NGraphVar* var = new NGraphVar(DT_FLOAT, TensorShape{2}, "CPU");
+  Tensor initial_value = test::AsTensor<float>({value, value});
+  var->update_ng_tensor(&initial_value);
+  var->copy_ng_to_tf();
+  return var;
+}
+
+static void WriteVar(NGraphVar* var, float value) {
+  Tensor new_value = test::AsTensor<float>({value, value});
+  var->update_ng_tensor(&new_value);
+}
+
+static Tensor ReadVar(NGraphVar* var) {
+  Tensor value(DT_FLOAT, TensorShape({2}));
+  ReadNGTensor(var->ng_tensor(), &value);
+  return value;
+}
+
+class NGraphVarSnapshotTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    env_map_ = StoreEnv({"NGRAPH_TF_NGVARIABLE_BUFFER_SHARING"});
+    SetEnvVariable("NGRAPH_TF_NGVARIABLE_BUFFER_SHARING", "0");
+  }
+  void TearDown() override {
+    UnsetEnvVariable("NGRAPH_TF_NGVARIABLE_BUFFER_SHARING");
+    RestoreEnv(env_map_);
+  }
+
+ private:
+  unordered_map<string, string> env_map_;
+};
+
+// Test: The snapshot keeps the value of the variable when it was started,
+// whether or not the variable is written before it is read
+TEST_F(NGraphVarSnapshotTest, CopyOnWrite) {
+  NGraphVar* var = CreateVar(1.0);
+
+  var->begin_snapshot(1);
+  WriteVar(var, 5.0);
+  WriteVar(var, 6.0);
+  Tensor value;
+  ASSERT_OK(var->read_snapshot(1, &value));
+  test::ExpectTensorEqual<float>(value, test::AsTensor<float>({1.0, 1.0}));
+  test::ExpectTensorEqual<float>(ReadVar(var),
+                                 test::AsTensor<float>({6.0, 6.0}));
+
+  var->begin_snapshot(2);
+  ASSERT_OK(var->read_snapshot(2, &value));
+  test::ExpectTensorEqual<float>(value, test::AsTensor<float>({6.0, 6.0}));
+
+  // The snapshot ended
+  ASSERT_NOT_OK(var->read_snapshot(2, &value));
+  var->Unref();
+}
+
+// Test: A snapshot waits for the previous one to be read
+TEST_F(NGraphVarSnapshotTest, BeginWaitsForRead) {
+  NGraphVar* var = CreateVar(1.0);
+
+  var->begin_snapshot(1);
+  std::atomic<bool> started{false};
+  std::thread snapshotter([var, &started]() {
+    var->begin_snapshot(2);
+    started = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(started);
+  WriteVar(var, 5.0);
+
+  Tensor value;
+  ASSERT_OK(var->read_snapshot(1, &value));
+  snapshotter.join();
+  ASSERT_TRUE(started);
+  test::ExpectTensorEqual<float>(value, test::AsTensor<float>({1.0, 1.0}));
+  ASSERT_OK(var->read_snapshot(2, &value));
+  test::ExpectTensorEqual<float>(value, test::AsTensor<float>({5.0, 5.0}));
+  var->Unref();
+}
+
+// Test: A snapshot does not start while nGraph writes the variable, so it
+// never sees a partly written value
+TEST_F(NGraphVarSnapshotTest, ConcurrentWrite) {
+  NGraphVar* var = CreateVar(1.0);
+
+  std::atomic<bool> started{false};
+  std::thread snapshotter;
+  {
+    NGraphVarWriteLock write_lock;
+    write_lock.Add(var);
+    // Locking the same variable again is a no-op
+    write_lock.Add(var);
+    snapshotter = std::thread([var, &started]() {
+      var->begin_snapshot(1);
+      started = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(started);
+    Tensor new_value = test::AsTensor<float>({7.0, 7.0});
+    WriteNGTensor(var->ng_tensor(), &new_value);
+  }
+  snapshotter.join();
+
+  // Writes racing the snapshot go on while it is read
+  std::thread writer([var]() {
+    for (int i = 0; i < 100; i++) {
+      WriteVar(var, 8.0 + i);
+    }
+  });
+  Tensor value;
+  ASSERT_OK(var->read_snapshot(1, &value));
+  writer.join();
+  test::ExpectTensorEqual<float>(value, test::AsTensor<float>({7.0, 7.0}));
+  test::ExpectTensorEqual<float>(ReadVar(var),
+                                 test::AsTensor<float>({107.0, 107.0}));
+  var->Unref();
+}
+
+class NGraphSaveV2KernelTest : public tensorflow::OpsTestBase {};
+
+// Test: NGraphSaveV2 writes the variables from their NG Tensors along with
+// the regular inputs
+TEST_F(NGraphSaveV2KernelTest, KernelTest) {
+  list<string> env_vars{"NGRAPH_TF_NGVARIABLE_BUFFER_SHARING"};
+  const unordered_map<string, string>& env_map = StoreEnv(env_vars);
+  SetEnvVariable("NGRAPH_TF_NGVARIABLE_BUFFER_SHARING", "0");
+
+  // The NG Tensor is newer than the TF Tensor
+  NGraphVar* var = CreateVar(1.0);
+  WriteVar(var, 3.0);
+
+  ASSERT_OK(NodeDefBuilder("save", "NGraphSaveV2")
+                .Input(FakeInput(DT_STRING))
+                .Input(FakeInput(DT_STRING))
+                .Input(FakeInput(DT_STRING))
+                .Input(FakeInput({DT_FLOAT}))
+                .Attr("dtypes", {DT_FLOAT})
+                .Attr("variable_shared_names", {"var1", "", "var1"})
+                .Finalize(node_def()));
+  ASSERT_OK(InitOp());
+
+  // The Create function does not Ref the variable, the resource manager
+  // owns it
+  ASSERT_OK(device_->resource_manager()->Create<NGraphVar>(
+      device_->resource_manager()->default_container(), "var1", var));
+
+  const string prefix =
+      io::JoinPath(::testing::TmpDir(), "ngraph_save_v2_kernel_test");
+  AddInputFromArray<string>(TensorShape({}), {prefix});
+  AddInputFromArray<string>(TensorShape({3}), {"v", "t", "v_again"});
+  AddInputFromArray<string>(TensorShape({3}), {"", "", ""});
+  AddInputFromArray<float>(TensorShape({3}), {4.0, 5.0, 6.0});
+  ASSERT_OK(RunOpKernel());
+
+  // The snapshot was read, a new one can start right away
+  var->begin_snapshot(100);
+  Tensor unused;
+  ASSERT_OK(var->read_snapshot(100, &unused));
+
+  BundleReader reader(Env::Default(), prefix);
+  ASSERT_OK(reader.status());
+  Tensor value;
+  ASSERT_OK(reader.Lookup("v", &value));
+  test::ExpectTensorEqual<float>(value, test::AsTensor<float>({3.0, 3.0}));
+  ASSERT_OK(reader.Lookup("v_again", &value));
+  test::ExpectTensorEqual<float>(value, test::AsTensor<float>({3.0, 3.0}));
+  ASSERT_OK(reader.Lookup("t", &value));
+  test::ExpectTensorEqual<float>(value,
+                                 test::AsTensor<float>({4.0, 5.0, 6.0}));
+
+  UnsetEnvVariable("NGRAPH_TF_NGVARIABLE_BUFFER_SHARING");
+  RestoreEnv(env_map);
+}
+
+}  // testing
+}  // ngraph_bridge
+}  // tensorflow
@@ -68,6 +68,11 @@ class NGraphTensorManagerTest : public ::testing::Test {
     }
     NGraphCatalog::AddToPrefetchedInputIndexMap(
         ng_encap_graph_id, ng_encap_node_name, pref_indexes);
+    // the i-th prefetched input is fed by the i-th dataset component
+    for (int i = 0; i < prefetched_inp_indexes.size(); i++) {
+      NGraphCatalog::AddToPrefetchedInputComponentMap(
+          ng_encap_graph_id, ng_encap_node_name, prefetched_inp_indexes[i], i);
+    }
   }
 
   // Clears the Catalog
@@ -208,6 +213,8 @@ TEST_F(NGraphTensorManagerTest, NoVariablesHasPrefetch) {
   vector<int> expected_prefetched_inp_indexes = {1, 3};
   vector<int> expected_pipelined_inp_indexes_prefetched = {
       1, 3};  // as all inputs are pipelined
+  vector<int> expected_prefetched_inp_components = {0, 1};
+  vector<int> expected_pipelined_inp_indexes_not_prefetched = {0, 2, 4};
 
   EnterPrefetchInCatalog(ng_encap_graph_id, ng_encap_node_name,
                          expected_prefetched_inp_indexes);
@@ -230,6 +237,10 @@ TEST_F(NGraphTensorManagerTest, NoVariablesHasPrefetch) {
             tensor_manager.GetPrefetchedInputIndexes());
   ASSERT_EQ(expected_pipelined_inp_indexes_prefetched,
             tensor_manager.GetPipelinedInputIndexesThatArePrefetched());
+  ASSERT_EQ(expected_prefetched_inp_components,
+            tensor_manager.GetPrefetchedInputComponents());
+  ASSERT_EQ(expected_pipelined_inp_indexes_not_prefetched,
+            tensor_manager.GetPipelinedButNotPrefetchedInputIndexes());
 
   // clean up
   ClearCatalog();
@@ -247,13 +258,16 @@ TEST_F(NGraphTensorManagerTest, VariablesAndPrefetch) {
   vector<int> expected_pipelined_inp_indexes, expected_pipelined_out_indexes,
       expected_var_inp_indexes, expected_var_out_indexes,
       expected_out_indexes_need_copy, expected_prefetched_inp_indexes,
-      expected_pipelined_inp_indexes_prefetched;
+      expected_pipelined_inp_indexes_prefetched,
+      expected_pipelined_inp_indexes_not_prefetched;
+  vector<int> expected_prefetched_inp_components = {0, 1};
 
   if (ngraph_tf_are_variables_enabled()) {
     // expected values
     expected_pipelined_inp_indexes = {1, 3, 4, 6};
     expected_prefetched_inp_indexes = {3, 6};
     expected_pipelined_inp_indexes_prefetched = {1, 3};
+    expected_pipelined_inp_indexes_not_prefetched = {1, 4};
     expected_pipelined_out_indexes = {0, 2};
     expected_var_inp_indexes =
         FindComplement(number_of_inputs, expected_pipelined_inp_indexes);
@@ -271,6 +285,7 @@ TEST_F(NGraphTensorManagerTest, VariablesAndPrefetch) {
     expected_prefetched_inp_indexes = {3, 6};
     expected_pipelined_inp_indexes_prefetched = {
         3, 6};  // all inputs are pipelined
+    expected_pipelined_inp_indexes_not_prefetched = {0, 1, 2, 4, 5};
 
     expected_var_inp_indexes = {};
     expected_var_out_indexes = {};
@@ -301,6 +316,10 @@ TEST_F(NGraphTensorManagerTest, VariablesAndPrefetch) {
             tensor_manager.GetPrefetchedInputIndexes());
   ASSERT_EQ(expected_pipelined_inp_indexes_prefetched,
             tensor_manager.GetPipelinedInputIndexesThatArePrefetched());
+  ASSERT_EQ(expected_prefetched_inp_components,
+            tensor_manager.GetPrefetchedInputComponents());
+  ASSERT_EQ(expected_pipelined_inp_indexes_not_prefetched,
+            tensor_manager.GetPipelinedButNotPrefetchedInputIndexes());
   // clean up
   ClearCatalog();
 }
@@ -326,6 +345,28 @@ TEST_F(NGraphTensorManagerTest, PrefetchNotInPipeline) {
   ClearCatalog();
 }
 
+// check error
+TEST_F(NGraphTensorManagerTest, PrefetchComponentMissing) {
+  string ng_encap_node_name = "xyz_1";
+  int ng_encap_cluster_id = 1;
+  int ng_encap_graph_id = 1;
+  int number_of_inputs = 5;
+  int number_of_outputs = 2;
+
+  // the dataset component feeding the input is not in the catalog
+  unordered_set<int> prefetched_inp_indexes = {1};
+  NGraphCatalog::AddToPrefetchedInputIndexMap(
+      ng_encap_graph_id, ng_encap_node_name, prefetched_inp_indexes);
+
+  ASSERT_THROW(NGraphTensorManager tensor_manager(
+                   ng_encap_node_name, ng_encap_cluster_id, ng_encap_graph_id,
+                   number_of_inputs, number_of_outputs),
+               std::runtime_error);
+
+  // clean up
+  ClearCatalog();
+}
+
 }  // namespace testing
 }  // namespace ngraph_bridge
 }  // namespace tensorflow
\ No newline at end of file
@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * Copyright 2017-2019 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *******************************************************************************/
+#include "gtest/gtest.h"
+
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+
+#include "ngraph_bridge/enable_variable_ops/ngraph_var_arena.h"
+#include "test/test_utilities.h"
+
+using namespace std;
+
+namespace tensorflow {
+
+namespace ngraph_bridge {
+
+namespace testing {
+
+// Tensors are carved out of the arena back to back, at aligned offsets
+TEST(NGraphVarArena, ContiguousTensors) {
+  size_t size1 = NGraphVarArena::AlignedSize(DT_FLOAT, TensorShape({4, 5}));
+  size_t size2 = NGraphVarArena::AlignedSize(DT_INT32, TensorShape({3}));
+  ASSERT_EQ(size1 % Allocator::kAllocatorAlignment, 0);
+  ASSERT_GE(size1, 4 * 5 * sizeof(float));
+
+  NGraphVarArena* arena = new NGraphVarArena(size1 + size2);
+  {
+    Tensor t1(arena, DT_FLOAT, TensorShape({4, 5}));
+    Tensor t2(arena, DT_INT32, TensorShape({3}));
+    const char* base1 = static_cast<const char*>(DMAHelper::base(&t1));
+    const char* base2 = static_cast<const char*>(DMAHelper::base(&t2));
+    ASSERT_EQ(base1, arena->data());
+    ASSERT_EQ(base2, arena->data() + size1);
+    ASSERT_TRUE(arena->Contains(base1));
+    ASSERT_TRUE(arena->Contains(base2));
+    ASSERT_EQ(arena->size(), size1 + 3 * sizeof(int32));
+
+    // Does not fit anymore, allocated separately
+    Tensor t3(arena, DT_FLOAT, TensorShape({16}));
+    ASSERT_FALSE(arena->Contains(DMAHelper::base(&t3)));
+    t3.flat<float>().setZero();
+  }
+  // The tensors released their references
+  ASSERT_TRUE(arena->RefCountIsOne());
+  arena->Unref();
+}
+
+// Every NGraphVariable with a known shape gets the size of its backend's
+// arena
+TEST(NGraphVarArena, PlanVariableArenas) {
+  Graph graph(OpRegistry::Global());
+
+  auto add_variable = [&graph](const string& name,
+                               const PartialTensorShape& shape,
+                               const string& backend, Node** node) {
+    return NodeBuilder(name, "NGraphVariable")
+        .Attr("shape", shape)
+        .Attr("dtype", DT_FLOAT)
+        .Attr("ngraph_graph_id", 0)
+        .Attr("_ngraph_backend", backend)
+        .Finalize(&graph, node);
+  };
+
+  Node *var1, *var2, *var3, *var4;
+  ASSERT_OK(add_variable("Var1", PartialTensorShape({2, 2}), "CPU", &var1));
+  ASSERT_OK(add_variable("Var2", PartialTensorShape({100}), "CPU", &var2));
+  ASSERT_OK(add_variable("Var3", PartialTensorShape({-1, 2}), "CPU", &var3));
+  ASSERT_OK(
+      add_variable("Var4", PartialTensorShape({2, 2}), "INTERPRETER", &var4));
+
+  ASSERT_OK(PlanVariableArenas(&graph, 0));
+
+  int64 cpu_size =
+      NGraphVarArena::AlignedSize(DT_FLOAT, TensorShape({2, 2})) +
+      NGraphVarArena::AlignedSize(DT_FLOAT, TensorShape({100}));
+  int64 interpreter_size =
+      NGraphVarArena::AlignedSize(DT_FLOAT, TensorShape({2, 2}));
+
+  int64 arena_size;
+  ASSERT_OK(GetNodeAttr(var1->attrs(), "_ngraph_arena_size", &arena_size));
+  ASSERT_EQ(arena_size, cpu_size);
+  ASSERT_OK(GetNodeAttr(var2->attrs(), "_ngraph_arena_size", &arena_size));
+  ASSERT_EQ(arena_size, cpu_size);
+  ASSERT_FALSE(HasNodeAttr(var3->def(), "_ngraph_arena_size"));
+  ASSERT_OK(GetNodeAttr(var4->attrs(), "_ngraph_arena_size", &arena_size));
+  ASSERT_EQ(arena_size, interpreter_size);
+}
+
+}  // namespace testing
+
+}  // namespace ngraph_bridge
+
+}  // namespace tensorflow
@@ -22,6 +22,7 @@
 #include "tensorflow/core/public/session.h"
 
 #include "ngraph_bridge/ngraph_backend_manager.h"
+#include "ngraph_bridge/ngraph_cache_budget.h"
 #include "ngraph_bridge/ngraph_executor.h"
 #include "ngraph_bridge/version.h"
 #include "test/test_utilities.h"
@@ -124,6 +125,54 @@ TEST(ParallelExecutor, CompilerTest) {
   ASSERT_TRUE(cache_hit);
 }
 
+// A cached executable is charged to the process cache budget for its
+// serialized function and the pipelined I/O tensors only
+TEST(ParallelExecutor, CachedBytes) {
+  unique_ptr<tf::Graph> input_graph;
+  ASSERT_OK(LoadGraphFromPbTxt("test_axpy_launchop.pbtxt", input_graph));
+
+  tf::ngraph_bridge::BackendManager::CreateBackend("INTERPRETER");
+  NGraphExecutor executor(100, 500, 600, input_graph, "INTERPRETER", 10);
+
+  Tensor x(DT_FLOAT, TensorShape({2, 3}));
+  Tensor y(DT_FLOAT, TensorShape({2, 3}));
+  std::vector<Tensor> tf_input_tensors{x, y};
+  shared_ptr<ngraph::runtime::Executable> ng_exec;
+  shared_ptr<PipelinedTensorsStore> pts;
+  std::string ser_ng_function;
+  bool cache_hit = false;
+  int64 cached_bytes = NGraphCacheBudget::GetCachedBytes();
+  ASSERT_OK(executor.GetExecutableFunctionAndTensors(
+      tf_input_tensors, ng_exec, ser_ng_function, pts, cache_hit));
+  ASSERT_FALSE(cache_hit);
+
+  int64 expected_bytes = ser_ng_function.size();
+  if (pts != nullptr) {
+    const auto& tensor_manager = executor.GetTensorManager();
+    int64 io_bytes = 0;
+    for (int i : tensor_manager->GetPipelinedInputIndexes()) {
+      auto param = ng_exec->get_parameters()[i];
+      io_bytes += ng::shape_size(param->get_shape()) *
+                  param->get_element_type().size();
+    }
+    for (int i : tensor_manager->GetPipelinedOutputIndexes()) {
+      auto result = ng_exec->get_results()[i];
+      io_bytes += ng::shape_size(result->get_shape()) *
+                  result->get_element_type().size();
+    }
+    expected_bytes += io_bytes * executor.GetTensorPipelineDepth();
+  }
+  ASSERT_EQ(NGraphCacheBudget::GetCachedBytes() - cached_bytes,
+            expected_bytes);
+
+  // A cache hit does not charge the executable again
+  ASSERT_OK(executor.GetExecutableFunctionAndTensors(
+      tf_input_tensors, ng_exec, ser_ng_function, pts, cache_hit));
+  ASSERT_TRUE(cache_hit);
+  ASSERT_EQ(NGraphCacheBudget::GetCachedBytes() - cached_bytes,
+            expected_bytes);
+}
+
 TEST(ParallelExecutor, ExecuteOnSingleThread) {
   // Read the graph
   // We are using a graph with _Arg and _Retval
@@ -13,9 +13,12 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  *******************************************************************************/
+#include <algorithm>
 #include <cstdlib>
+#include <queue>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
@@ -23,7 +26,9 @@
 
 #include "gtest/gtest.h"
 #include "ngraph/event_tracing.hpp"
+#include "ngraph_bridge/ngraph_timer.h"
 #include "ngraph_bridge/thread_safe_queue.h"
+#include "test/test_utilities.h"
 
 using namespace std;
 
@@ -58,7 +63,8 @@ TEST(ThreadSafeQueue, Simple) {
       ngraph::Event evt_consumer_waiting_for_item("Consumer", "Waiting", "");
       consumer_state = WAITING_FOR_ITEM;
       // cout << "\033[1;32mWaiting\033[0m" << endl;
-      queue.GetNextAvailable();
+      unique_ptr<Session> item;
+      ASSERT_OK(queue.GetNextAvailable(&item));
       evt_consumer_waiting_for_item.Stop();
       // cout << "\033[1;32mGot Item: " << item_count << "\033[0m\n";
       item_count++;
@@ -87,7 +93,7 @@ TEST(ThreadSafeQueue, Simple) {
 
   // cout << "Now adding an item\n";
   ngraph::Event evt_producer_add("Producer", "Add", "");
-  queue.Add(nullptr);
+  ASSERT_OK(queue.Add(nullptr));
   evt_producer_add.Stop();
   ngraph::Event::write_trace(evt_producer_add);
 
@@ -105,8 +111,8 @@ TEST(ThreadSafeQueue, Simple) {
 
   ngraph::Event evt_producer_add_again("Producer", "Add-2", "");
 
-  queue.Add(nullptr);
-  queue.Add(nullptr);
+  ASSERT_OK(queue.Add(nullptr));
+  ASSERT_OK(queue.Add(nullptr));
   evt_producer_add_again.Stop();
   ngraph::Event::write_trace(evt_producer_add_again);
 
@@ -129,6 +135,180 @@ TEST(ThreadSafeQueue, Simple) {
 
   thread0.join();
 }
+
+TEST(ThreadSafeQueue, Fifo) {
+  // Unbounded, the ring buffer grows and keeps the order
+  ThreadSafeQueue<int> queue;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(queue.Add(i));
+  }
+  ASSERT_EQ(queue.Size(), 10u);
+  for (int i = 0; i < 10; i++) {
+    int item;
+    ASSERT_OK(queue.GetNextAvailable(&item));
+    ASSERT_EQ(item, i);
+  }
+  ASSERT_EQ(queue.Size(), 0u);
+}
+
+TEST(ThreadSafeQueue, Bounded) {
+  ThreadSafeQueue<int> queue(2);
+  ASSERT_EQ(queue.Capacity(), 2u);
+  ASSERT_OK(queue.Add(0));
+  ASSERT_OK(queue.Add(1));
+
+  // The producer waits for a free slot
+  atomic<bool> added{false};
+  std::thread producer([&]() {
+    ASSERT_OK(queue.Add(2));
+    added = true;
+  });
+  absl::SleepFor(absl::Milliseconds(50));
+  ASSERT_FALSE(added);
+  ASSERT_EQ(queue.Size(), 2u);
+
+  int item;
+  ASSERT_OK(queue.GetNextAvailable(&item));
+  ASSERT_EQ(item, 0);
+  producer.join();
+  ASSERT_TRUE(added);
+  ASSERT_OK(queue.GetNextAvailable(&item));
+  ASSERT_EQ(item, 1);
+  ASSERT_OK(queue.GetNextAvailable(&item));
+  ASSERT_EQ(item, 2);
+}
+
+TEST(ThreadSafeQueue, Timeout) {
+  ThreadSafeQueue<int> queue;
+  int item;
+  Status status = queue.GetNextAvailable(&item, absl::Milliseconds(10));
+  ASSERT_TRUE(errors::IsDeadlineExceeded(status)) << status;
+
+  ASSERT_OK(queue.Add(7));
+  ASSERT_OK(queue.GetNextAvailable(&item, absl::Milliseconds(10)));
+  ASSERT_EQ(item, 7);
+}
+
+TEST(ThreadSafeQueue, Terminate) {
+  ThreadSafeQueue<int> queue(1);
+  ASSERT_OK(queue.Add(0));
+
+  // Both a consumer of an empty queue and a producer to a full queue are
+  // woken up with the status
+  ThreadSafeQueue<int> empty_queue;
+  Status consumer_status;
+  Status producer_status;
+  std::thread consumer([&]() {
+    int item;
+    consumer_status = empty_queue.GetNextAvailable(&item);
+  });
+  std::thread producer([&]() { producer_status = queue.Add(1); });
+  absl::SleepFor(absl::Milliseconds(50));
+
+  empty_queue.Terminate(errors::Aborted("Shutting down"));
+  queue.Terminate(errors::Aborted("Shutting down"));
+  consumer.join();
+  producer.join();
+  ASSERT_TRUE(errors::IsAborted(consumer_status)) << consumer_status;
+  ASSERT_TRUE(errors::IsAborted(producer_status)) << producer_status;
+
+  // The later calls fail as well
+  int item;
+  ASSERT_TRUE(errors::IsAborted(queue.GetNextAvailable(&item)));
+  ASSERT_TRUE(errors::IsAborted(queue.Add(2)));
+}
+
+// The previous queue: unbounded std::queue that wakes all the waiters on
+// every Add
+template <typename T>
+class SignalAllQueue {
+ public:
+  Status GetNextAvailable(T* item) {
+    m_mutex.Lock();
+    while (m_queue.empty()) {
+      m_cv.Wait(&m_mutex);
+    }
+    *item = std::move(m_queue.front());
+    m_queue.pop();
+    m_mutex.Unlock();
+    return Status::OK();
+  }
+
+  Status Add(T item) {
+    m_mutex.Lock();
+    m_queue.push(std::move(item));
+    m_cv.SignalAll();
+    m_mutex.Unlock();
+    return Status::OK();
+  }
+
+ private:
+  queue<T> m_queue;
+  absl::CondVar m_cv;
+  absl::Mutex m_mutex;
+};
+
+// Passes num_items between one producer and num_consumers consumers, returns
+// the time taken in us. The most items the producer saw added but not yet
+// received is returned in max_in_flight
+template <typename QUEUE>
+static int PassItems(QUEUE& queue, int num_items, int num_consumers,
+                     int* max_in_flight) {
+  const int items_per_consumer = num_items / num_consumers;
+  atomic<int> received{0};
+  *max_in_flight = 0;
+  Timer timer;
+  std::vector<std::thread> consumers;
+  for (int i = 0; i < num_consumers; i++) {
+    consumers.emplace_back([&]() {
+      for (int j = 0; j < items_per_consumer; j++) {
+        int item;
+        if (queue.GetNextAvailable(&item).ok()) {
+          received++;
+        }
+      }
+    });
+  }
+  for (int i = 0; i < items_per_consumer * num_consumers; i++) {
+    queue.Add(i).IgnoreError();
+    *max_in_flight = std::max(*max_in_flight, i + 1 - received.load());
+  }
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+  int elapsed_us = timer.ElapsedInMicroSec();
+  EXPECT_EQ(received, items_per_consumer * num_consumers);
+  return elapsed_us;
+}
+
+// Passes items to several consumers through both queues. Every item is
+// received once, the bounded queue never holds more than its capacity (the
+// consumers may hold one item each that they did not count yet), and the
+// run ends in bounded time. Prints the time taken by each queue
+TEST(ThreadSafeQueue, Contention) {
+  const int num_items = 20000;
+  const int capacity = 16;
+  const int max_run_us = 30 * 1000 * 1000;
+  for (int num_consumers : {1, 4}) {
+    SignalAllQueue<int> signal_all_queue;
+    ThreadSafeQueue<int> unbounded_queue;
+    ThreadSafeQueue<int> bounded_queue(capacity);
+    int max_in_flight;
+    int signal_all_us = PassItems(signal_all_queue, num_items, num_consumers,
+                                  &max_in_flight);
+    int unbounded_us =
+        PassItems(unbounded_queue, num_items, num_consumers, &max_in_flight);
+    int bounded_us =
+        PassItems(bounded_queue, num_items, num_consumers, &max_in_flight);
+    ASSERT_LE(max_in_flight, capacity + num_consumers);
+    ASSERT_LT(unbounded_us, max_run_us);
+    ASSERT_LT(bounded_us, max_run_us);
+    cout << num_items << " items, " << num_consumers
+         << " consumers: SignalAll queue " << signal_all_us
+         << " us, unbounded ring " << unbounded_us << " us, bounded ring ("
+         << capacity << ") " << bounded_us << " us" << endl;
+  }
+}
 }
 
 }  // namespace ngraph_bridge